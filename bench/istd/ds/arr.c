@@ -0,0 +1,68 @@
+/**
+ * Array benchmarks
+ */
+
+#include "istd/util/bench.h"
+#include "istd/ds/arr.h"
+
+ibench_section$("default, istd, arr", "ISTD Arrays") {
+
+  ia_arr$(int) arr = ia_new_empty_array$(int);
+
+  ibench_case$("Push an int") {
+    ia_push$(&arr, 42);
+    // Keep memory bounded
+    if (ia_length(arr) == 1 << 16)
+      ia_truncate$(&arr, 0);
+  }
+
+  ibench_case$("Push and pop an int") {
+    ia_push$(&arr, 42);
+    ia_pop$(&arr);
+  }
+
+  ia_destroy_array(arr);
+
+  int items[64] = { 0 };
+  ia_arr$(int) dst = ia_new_empty_array$(int);
+
+  ibench_case$("Append 64 ints") {
+    ia_append$(&dst, items, 64);
+    if (ia_length(dst) >= 1 << 16)
+      ia_truncate$(&dst, 0);
+  }
+
+  ibench_case$("Allocate and destroy an empty array") {
+    ia_arr$(int) tmp = ia_new_empty_array$(int);
+    ibench_do_not_optimize$(tmp);
+    ia_destroy_array(tmp);
+  }
+
+  ia_destroy_array(dst);
+
+  // Snapshot of a large array, handed to a reader, and then changed
+  ia_arr$(int) big = ia_new_array_of$(1 << 20, int);
+
+  ibench_case$("Snapshot of 1M ints by copying, then push") {
+    ia_arr$(int) copy = ia_new_array_for$(ia_length(big), int);
+    ia_append$(&copy, big, ia_length(big));
+    ia_push$(&big, 42);
+    ia_pop$(&big);
+    ia_destroy_array(copy);
+  }
+
+  ibench_case$("Snapshot of 1M ints by sharing, then push") {
+    ia_arr$(int) snapshot = ia_share(big);
+    ia_push$(&big, 42);
+    ia_pop$(&big);
+    ia_destroy_array(snapshot);
+  }
+
+  ibench_case$("Snapshot of 1M ints by sharing, no changes") {
+    ia_arr$(int) snapshot = ia_share(big);
+    ibench_do_not_optimize$(snapshot);
+    ia_destroy_array(snapshot);
+  }
+
+  ia_destroy_array(big);
+}
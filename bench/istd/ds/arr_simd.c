@@ -0,0 +1,83 @@
+/**
+ * Vectorized array operations compared with loops
+ */
+
+#include "istd/util/bench.h"
+#include "istd/ds/arr.h"
+#include "istd/ds/arr_simd.h"
+#include <stdint.h>
+
+/// Items in arrays, 64 KB of int32_t, which fits into L2 cache
+#define ITEMS (16 * 1024)
+
+ibench_section$("default, istd, arr, simd", "ISTD Vectorized array operations") {
+
+  ia_arr$(int32_t) aligned = ia_new_aligned_array_of$(ITEMS, int32_t, IA_CACHE_LINE);
+  // Same items starting in the middle of a cache line, so every
+  // other 64-byte load is split between two lines
+  ia_arr$(int32_t) misaligned = ia_new_aligned_array_of$(ITEMS + 8, int32_t, IA_CACHE_LINE);
+  const int32_t* shifted = misaligned + 8;
+
+  for (size_t i = 0; i < ITEMS; ++i)
+    aligned[i] = misaligned[i + 8] = (int32_t) (i % 1000);
+
+  ibench_case$("Sum of 16K ints, loop") {
+    int64_t sum = 0;
+    for (size_t i = 0; i < ITEMS; ++i)
+      sum += aligned[i];
+    ibench_do_not_optimize$(sum);
+  }
+
+  ibench_case$("Sum of 16K ints, ia_simd_sum") {
+    ibench_do_not_optimize$(ia_simd_sum$(aligned));
+  }
+
+  ibench_case$("Find in 16K ints, loop") {
+    const int32_t* found = NULL;
+    for (size_t i = 0; i < ITEMS; ++i)
+      if (aligned[i] == -1) {
+        found = aligned + i;
+        break;
+      }
+    ibench_do_not_optimize$(found);
+  }
+
+  ibench_case$("Find in 16K ints, ia_simd_find") {
+    ibench_do_not_optimize$(ia_simd_find$(aligned, -1));
+  }
+
+  ibench_case$("Maximum of 16K ints, ia_simd_max") {
+    ibench_do_not_optimize$(ia_simd_max$(aligned));
+  }
+
+  ibench_case$("Compare 16K ints, ia_simd_equal") {
+    ibench_do_not_optimize$(ia_simd_equal$(aligned, aligned));
+  }
+
+  ibench_case$("Prefix sum of 16K ints, loop") {
+    for (size_t i = 1; i < ITEMS; ++i)
+      aligned[i] += aligned[i - 1];
+    ibench_do_not_optimize$(aligned[ITEMS - 1]);
+  }
+
+  ibench_case$("Prefix sum of 16K ints, ia_simd") {
+    ia_simd_prefix_sum$(aligned);
+    ibench_do_not_optimize$(aligned[ITEMS - 1]);
+  }
+
+  ia_simd_fill$(aligned, 1);
+
+  ibench_case$("Fill 16K ints, ia_simd_fill") {
+    ia_simd_fill$(aligned, 1);
+  }
+
+  ibench_case$("Sum of 16K ints, loop, misaligned") {
+    int64_t sum = 0;
+    for (size_t i = 0; i < ITEMS; ++i)
+      sum += shifted[i];
+    ibench_do_not_optimize$(sum);
+  }
+
+  ia_destroy_array(aligned);
+  ia_destroy_array(misaligned);
+}
@@ -0,0 +1,100 @@
+/**
+ * Set operations on sorted arrays compared with plain merge loops
+ */
+
+#include "istd/util/bench.h"
+#include "istd/ds/arr.h"
+#include "istd/ds/arr_sorted.h"
+#include <stdint.h>
+#include <stdio.h>
+
+static uint64_t next_random(uint64_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+/// Sorted array of about `count` ids below `range`
+static ia_arr$(uint32_t) random_set(uint64_t* rng, uint32_t range, size_t count) {
+  ia_arr$(uint32_t) set = ia_new_aligned_array_for$(count + count / 8, uint32_t, IA_CACHE_LINE);
+  for (uint32_t x = 0; x < range; ++x)
+    if (next_random(rng) % range < count)
+      ia_push$(&set, x);
+  return set;
+}
+
+/// The way posting lists were intersected before
+static size_t naive_intersect(uint32_t** out, const uint32_t* a, const uint32_t* b) {
+  ia_truncate$(out, 0);
+  size_t i = 0, j = 0;
+  while (i < ia_length(a) && j < ia_length(b)) {
+    if (a[i] < b[j])
+      ++i;
+    else if (a[i] > b[j])
+      ++j;
+    else {
+      ia_push$(out, a[i]);
+      ++i;
+      ++j;
+    }
+  }
+  return ia_length(*out);
+}
+
+
+ibench_section$("default, istd, sorted", "ISTD Set operations on sorted arrays") {
+
+  // Lists of 1M ids, and shorter ones, each a sample of the same 16M ids
+  static const size_t lengths[] = { 1000000, 100000, 10000, 1000 };
+  enum { LISTS = sizeof(lengths) / sizeof(lengths[0]) };
+  ia_arr$(uint32_t) lists[LISTS];
+  uint64_t rng = 88172645463325252ull;
+  for (size_t l = 0; l < LISTS; ++l)
+    lists[l] = random_set(&rng, 1 << 24, lengths[l]);
+
+  ia_arr$(uint32_t) out = ia_new_aligned_array_for$(2 * lengths[0], uint32_t, IA_CACHE_LINE);
+  ia_arr$(uint32_t) other = random_set(&rng, 1 << 24, lengths[0]);
+  char name[96];
+
+  for (size_t l = 0; l < LISTS; ++l) {
+    const uint32_t* a = l ? lists[l] : other;
+    const uint32_t* b = lists[0];
+
+    snprintf(name, sizeof(name), "Intersect 1M and %zuK ids, merge loop", lengths[l] / 1000);
+    ibench_case$(name) {
+      ibench_do_not_optimize$(naive_intersect(&out, a, b));
+    }
+
+    snprintf(name, sizeof(name), "Intersect 1M and %zuK ids", lengths[l] / 1000);
+    ibench_case$(name) {
+      ibench_do_not_optimize$(ia_sorted_intersect(&out, a, b));
+    }
+
+    snprintf(name, sizeof(name), "Union of 1M and %zuK ids", lengths[l] / 1000);
+    ibench_case$(name) {
+      ibench_do_not_optimize$(ia_sorted_union(&out, a, b));
+    }
+
+    snprintf(name, sizeof(name), "Difference of 1M and %zuK ids", lengths[l] / 1000);
+    ibench_case$(name) {
+      ibench_do_not_optimize$(ia_sorted_difference(&out, b, a));
+    }
+  }
+
+  // Half of the items are repeats
+  ia_arr$(uint32_t) repeated = ia_new_aligned_array_for$(2 * lengths[0], uint32_t, IA_CACHE_LINE);
+  for (size_t i = 0; i < ia_length(lists[0]); ++i) {
+    ia_push$(&repeated, lists[0][i]);
+    ia_push$(&repeated, lists[0][i]);
+  }
+  ibench_case$("Unique of 2M ids, 1M repeats") {
+    ibench_do_not_optimize$(ia_sorted_unique(&out, repeated));
+  }
+
+  for (size_t l = 0; l < LISTS; ++l)
+    ia_destroy_array(lists[l]);
+  ia_destroy_array(other);
+  ia_destroy_array(repeated);
+  ia_destroy_array(out);
+}
@@ -0,0 +1,123 @@
+/**
+ * B+-tree compared with a sorted array
+ */
+
+#include "istd/util/bench.h"
+#include "istd/ds/arr.h"
+#include "istd/ds/btree.h"
+#include <stdint.h>
+#include <string.h>
+
+IBTREE_DECLARE$(imap, int64_t, int64_t)
+IBTREE_DEFINE_NUMBERS$(imap, int64_t, int64_t)
+
+/// Keys in the tree and in the array
+#define KEYS (1 << 20)
+/// Keys looked up, in random order
+#define PROBES 4096
+
+static uint64_t next_random(uint64_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+/// Index of the first key not less than `key`
+static size_t lower_bound(const int64_t* keys, int64_t key) {
+  size_t lo = 0, hi = ia_length(keys);
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (keys[mid] < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void array_insert(int64_t** keys, int64_t key) {
+  size_t i = lower_bound(*keys, key);
+  ia_push$(keys, key);
+  memmove(&(*keys)[i + 1], &(*keys)[i], (ia_length(*keys) - i - 1) * sizeof(int64_t));
+  (*keys)[i] = key;
+}
+
+static void array_erase(int64_t** keys, int64_t key) {
+  size_t i = lower_bound(*keys, key);
+  memmove(&(*keys)[i], &(*keys)[i + 1], (ia_length(*keys) - i - 1) * sizeof(int64_t));
+  ia_pop$(keys);
+}
+
+
+ibench_section$("default, istd, btree", "ISTD B+-tree compared with a sorted array") {
+
+  // Even keys, so odd ones may be inserted
+  ia_arr$(int64_t) keys = ia_new_array_of$(KEYS, int64_t);
+  for (size_t i = 0; i < KEYS; ++i)
+    keys[i] = (int64_t) i * 2;
+
+  static int64_t probes[PROBES];
+  uint64_t rng = 88172645463325252ull;
+  for (size_t i = 0; i < PROBES; ++i)
+    probes[i] = (int64_t) (next_random(&rng) % KEYS) * 2;
+
+  imap_t tree;
+  imap_init(&tree);
+
+  ibench_case$("Load 1M sorted keys") {
+    imap_load(&tree, keys, keys);
+  }
+
+  size_t n = 0;
+
+  ibench_case$("Find among 1M keys, sorted array") {
+    ibench_do_not_optimize$(lower_bound(keys, probes[n]));
+    n = (n + 1) % PROBES;
+  }
+
+  ibench_case$("Find among 1M keys, tree") {
+    ibench_do_not_optimize$(imap_find(&tree, probes[n]));
+    n = (n + 1) % PROBES;
+  }
+
+  // Size stays the same, so iterations are alike
+  ibench_case$("Insert and erase a key among 1M, sorted array") {
+    array_insert(&keys, probes[n] + 1);
+    array_erase(&keys, probes[n] + 1);
+    n = (n + 1) % PROBES;
+  }
+
+  ibench_case$("Insert and erase a key among 1M, tree") {
+    imap_insert(&tree, probes[n] + 1, 0);
+    imap_erase(&tree, probes[n] + 1);
+    n = (n + 1) % PROBES;
+  }
+
+  ibench_case$("Scan 1000 keys, sorted array") {
+    int64_t sum = 0;
+    for (size_t i = lower_bound(keys, probes[n]); i < ia_length(keys) && keys[i] < probes[n] + 2000; ++i)
+      sum += keys[i];
+    ibench_do_not_optimize$(sum);
+    n = (n + 1) % PROBES;
+  }
+
+  ibench_case$("Scan 1000 keys, tree") {
+    int64_t sum = 0;
+    for (imap_iter_t it = imap_range(&tree, probes[n], probes[n] + 2000); imap_iter_valid(&it); imap_iter_next(&it))
+      sum += imap_iter_key(&it);
+    ibench_do_not_optimize$(sum);
+    n = (n + 1) % PROBES;
+  }
+
+  imap_t built;
+  ibench_case$("Insert 100000 keys in random order, tree") {
+    imap_init(&built);
+    for (size_t i = 0; i < 100000; ++i)
+      imap_insert(&built, (int64_t) (next_random(&rng) >> 1), 0);
+    imap_destroy(&built);
+  }
+
+  imap_destroy(&tree);
+  ia_destroy_array(keys);
+}
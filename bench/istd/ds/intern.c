@@ -0,0 +1,57 @@
+/**
+ * String interning benchmarks
+ */
+
+#include "istd/util/bench.h"
+#include "istd/ds/intern.h"
+#include <stdio.h>
+#include <string.h>
+
+#define NAMES 1024
+
+ibench_section$("default, istd, intern", "ISTD String interning") {
+
+  static char names[NAMES][32];
+  static size_t lengths[NAMES];
+  for (size_t i = 0; i < NAMES; ++i)
+    lengths[i] = (size_t) snprintf(names[i], sizeof(names[i]), "some_identifier_%zu", i);
+
+  iintern_pool_t pool;
+  iintern_init(&pool, false);
+  static const char* interned[NAMES];
+  for (size_t i = 0; i < NAMES; ++i)
+    interned[i] = iintern(&pool, names[i], lengths[i]);
+
+  size_t n = 0;
+
+  ibench_case$("Intern existing string") {
+    ibench_do_not_optimize$(iintern(&pool, names[n], lengths[n]));
+    n = (n + 1) % NAMES;
+  }
+
+  iintern_pool_t concurrent;
+  iintern_init(&concurrent, true);
+  for (size_t i = 0; i < NAMES; ++i)
+    iintern(&concurrent, names[i], lengths[i]);
+
+  ibench_case$("Intern existing string, concurrent pool") {
+    ibench_do_not_optimize$(iintern(&concurrent, names[n], lengths[n]));
+    n = (n + 1) % NAMES;
+  }
+  iintern_destroy(&concurrent);
+
+  // Equal prefixes make strcmp() read most of the string
+  ibench_case$("Compare with strcmp") {
+    size_t m = (n * 7 + 3) % NAMES;
+    ibench_do_not_optimize$(strcmp(names[n], names[m]) == 0);
+    n = (n + 1) % NAMES;
+  }
+
+  ibench_case$("Compare interned pointers") {
+    size_t m = (n * 7 + 3) % NAMES;
+    ibench_do_not_optimize$(interned[n] == interned[m]);
+    n = (n + 1) % NAMES;
+  }
+
+  iintern_destroy(&pool);
+}
@@ -0,0 +1,100 @@
+/**
+ * Compressed arrays compared with plain ones
+ */
+
+#include "istd/util/bench.h"
+#include "istd/ds/arr.h"
+#include "istd/ds/arr_simd.h"
+#include "istd/ds/packed.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/// Values in each array, 64 MB of `uint64_t` ones
+#define VALUES (1 << 23)
+#define PROBES 4096
+
+static uint64_t next_random(uint64_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+
+ibench_section$("default, istd, packed", "ISTD Compressed arrays compared with plain ones") {
+
+  // Sorted ids, with gaps up to 32
+  ia_arr$(uint32_t) ids = ia_new_aligned_array_of$(VALUES, uint32_t, IA_CACHE_LINE);
+  // Timestamps in microseconds, an event every millisecond or so
+  ia_arr$(int64_t) times = ia_new_aligned_array_of$(VALUES, int64_t, IA_CACHE_LINE);
+  uint64_t rng = 88172645463325252ull;
+  uint32_t id = 0;
+  int64_t time = 1700000000000000;
+  for (size_t i = 0; i < VALUES; ++i) {
+    ids[i] = id += (uint32_t) (next_random(&rng) % 32);
+    times[i] = time += 500 + (int64_t) (next_random(&rng) % 1000);
+  }
+
+  static size_t probes[PROBES];
+  for (size_t i = 0; i < PROBES; ++i)
+    probes[i] = next_random(&rng) % VALUES;
+
+  ipacked_t packed_ids, packed_times;
+  ibench_case$("Encode 8M sorted uint32_t, deltas") {
+    ipacked_encode_u32(&packed_ids, ids, IPACKED_DELTA);
+    ipacked_destroy(&packed_ids);
+  }
+  ipacked_encode_u32(&packed_ids, ids, IPACKED_DELTA);
+  ipacked_encode_u64(&packed_times, (const uint64_t*) times, IPACKED_DELTA);
+
+  char name[96];
+  ibench_case$("Sum 8M uint32_t, plain array, 32 MB") {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < VALUES; ++i)
+      sum += ids[i];
+    ibench_do_not_optimize$(sum);
+  }
+
+  snprintf(name, sizeof(name), "Sum 8M uint32_t, deltas, %zu MB", ipacked_bytes(&packed_ids) >> 20);
+  ibench_case$(name) {
+    ibench_do_not_optimize$(ipacked_sum(&packed_ids));
+  }
+
+  ibench_case$("Sum 8M uint64_t, plain array, 64 MB") {
+    ibench_do_not_optimize$(ia_simd_sum$(times));
+  }
+
+  snprintf(name, sizeof(name), "Sum 8M uint64_t, deltas, %zu MB", ipacked_bytes(&packed_times) >> 20);
+  ibench_case$(name) {
+    ibench_do_not_optimize$(ipacked_sum(&packed_times));
+  }
+
+  ibench_case$("Unpack 8M uint32_t into an array") {
+    ia_arr$(uint32_t) copy = ipacked_to_u32(&packed_ids);
+    ibench_do_not_optimize$(copy[VALUES - 1]);
+    ia_destroy_array(copy);
+  }
+
+  size_t n = 0;
+
+  ibench_case$("Get a random uint32_t, plain array") {
+    ibench_do_not_optimize$(ids[probes[n]]);
+    n = (n + 1) % PROBES;
+  }
+
+  ibench_case$("Get a random uint32_t, deltas") {
+    ibench_do_not_optimize$(ipacked_get(&packed_ids, probes[n]));
+    n = (n + 1) % PROBES;
+  }
+
+  uint32_t block[IPACKED_BLOCK];
+  ibench_case$("Unpack a random block of uint32_t") {
+    ibench_do_not_optimize$(ipacked_block_u32(&packed_ids, probes[n] / IPACKED_BLOCK, block));
+    n = (n + 1) % PROBES;
+  }
+
+  ipacked_destroy(&packed_ids);
+  ipacked_destroy(&packed_times);
+  ia_destroy_array(ids);
+  ia_destroy_array(times);
+}
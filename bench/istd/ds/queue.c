@@ -0,0 +1,210 @@
+/**
+ * Bounded MPMC queue compared with an array under a mutex
+ */
+
+#include "istd/util/bench.h"
+#include "istd/ds/arr.h"
+#include "istd/ds/queue.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define THREADS 8
+#define CAPACITY 1024
+/// Items moved through the queue in one iteration
+#define ROUND 16000
+#define BATCH 16
+
+//---- Array under a mutex, the way queues were made before
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty, not_full;
+  ia_arr$(uint64_t) ring;
+  /// Numbers of items pushed and popped so far
+  size_t pushed, popped;
+} locked_t;
+
+static void locked_init(locked_t* q) {
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_cond_init(&q->not_empty, NULL);
+  pthread_cond_init(&q->not_full, NULL);
+  q->ring = ia_new_array_of$(CAPACITY, uint64_t);
+  q->pushed = q->popped = 0;
+}
+
+static void locked_destroy(locked_t* q) {
+  pthread_mutex_destroy(&q->lock);
+  pthread_cond_destroy(&q->not_empty);
+  pthread_cond_destroy(&q->not_full);
+  ia_destroy_array(q->ring);
+}
+
+static void locked_push(locked_t* q, const uint64_t* items, size_t n) {
+  pthread_mutex_lock(&q->lock);
+  for (size_t i = 0; i < n; ++i) {
+    while (q->pushed - q->popped == CAPACITY)
+      pthread_cond_wait(&q->not_full, &q->lock);
+    q->ring[q->pushed++ % CAPACITY] = items[i];
+  }
+  pthread_cond_broadcast(&q->not_empty);
+  pthread_mutex_unlock(&q->lock);
+}
+
+static void locked_pop(locked_t* q, uint64_t* items, size_t n) {
+  pthread_mutex_lock(&q->lock);
+  for (size_t i = 0; i < n; ++i) {
+    while (q->pushed == q->popped)
+      pthread_cond_wait(&q->not_empty, &q->lock);
+    items[i] = q->ring[q->popped++ % CAPACITY];
+  }
+  pthread_cond_broadcast(&q->not_full);
+  pthread_mutex_unlock(&q->lock);
+}
+
+//---- Workers
+
+static iqueue_t queue;
+static locked_t locked;
+
+/// Setup of current iteration
+static struct {
+  bool use_locked;
+  size_t producers, consumers, batch;
+} round_setup;
+
+static pthread_barrier_t round_start, round_end;
+static atomic_bool quit;
+static _Atomic uint64_t checksum;
+
+static void produce(size_t share, size_t batch) {
+  uint64_t items[BATCH];
+  for (size_t done = 0; done < share; done += batch) {
+    for (size_t i = 0; i < batch; ++i)
+      items[i] = done + i;
+    if (round_setup.use_locked)
+      locked_push(&locked, items, batch);
+    else
+      iqueue_push_many(&queue, items, batch);
+  }
+}
+
+static void consume(size_t share, size_t batch) {
+  uint64_t items[BATCH], sum = 0;
+  for (size_t done = 0; done < share; done += batch) {
+    if (round_setup.use_locked)
+      locked_pop(&locked, items, batch);
+    else
+      for (size_t got = 0; got < batch;)
+        got += iqueue_pop_many(&queue, items + got, batch - got);
+    for (size_t i = 0; i < batch; ++i)
+      sum += items[i];
+  }
+  atomic_fetch_add_explicit(&checksum, sum, memory_order_relaxed);
+}
+
+static void* worker_main(void* arg) {
+  size_t id = (size_t) arg;
+  for (;;) {
+    pthread_barrier_wait(&round_start);
+    if (atomic_load(&quit))
+      break;
+    size_t p = round_setup.producers, c = round_setup.consumers;
+    if (id < p)
+      produce(ROUND / p, round_setup.batch);
+    else if (id < p + c)
+      consume(ROUND / c, round_setup.batch);
+    pthread_barrier_wait(&round_end);
+  }
+  return NULL;
+}
+
+static void run_round(void) {
+  pthread_barrier_wait(&round_start);
+  pthread_barrier_wait(&round_end);
+}
+
+//---- Round trips
+
+static iqueue_t there, back;
+
+/// Sends every item back, until it gets zero
+static void* echo_main(void* arg) {
+  (void) arg;
+  uint64_t x;
+  while (iqueue_pop(&there, &x) && x)
+    iqueue_push(&back, &x);
+  return NULL;
+}
+
+
+ibench_section$("default, istd, queue", "ISTD Bounded MPMC queue") {
+
+  iqueue_init_for$(&queue, CAPACITY, uint64_t);
+  locked_init(&locked);
+
+  pthread_t threads[THREADS];
+  pthread_barrier_init(&round_start, NULL, THREADS + 1);
+  pthread_barrier_init(&round_end, NULL, THREADS + 1);
+  atomic_store(&quit, false);
+  for (size_t i = 0; i < THREADS; ++i)
+    pthread_create(&threads[i], NULL, worker_main, (void*) i);
+
+  static const size_t ratios[][2] = { { 1, 1 }, { 1, 4 }, { 4, 1 }, { 4, 4 } };
+
+  for (size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); ++r) {
+    round_setup.producers = ratios[r][0];
+    round_setup.consumers = ratios[r][1];
+    char name[64];
+
+    round_setup.use_locked = true;
+    round_setup.batch = 1;
+    snprintf(name, sizeof(name), "16000 items, %zu:%zu, mutex", ratios[r][0], ratios[r][1]);
+    ibench_case$(name) {
+      run_round();
+    }
+
+    round_setup.use_locked = false;
+    snprintf(name, sizeof(name), "16000 items, %zu:%zu, iqueue", ratios[r][0], ratios[r][1]);
+    ibench_case$(name) {
+      run_round();
+    }
+
+    round_setup.batch = BATCH;
+    snprintf(name, sizeof(name), "16000 items, %zu:%zu, iqueue, batches of %d", ratios[r][0], ratios[r][1], BATCH);
+    ibench_case$(name) {
+      run_round();
+    }
+  }
+
+  atomic_store(&quit, true);
+  pthread_barrier_wait(&round_start);
+  for (size_t i = 0; i < THREADS; ++i)
+    pthread_join(threads[i], NULL);
+  pthread_barrier_destroy(&round_start);
+  pthread_barrier_destroy(&round_end);
+
+  iqueue_destroy(&queue);
+  locked_destroy(&locked);
+
+  // Latency: one item there and back, with the other side waiting
+  iqueue_init_for$(&there, 16, uint64_t);
+  iqueue_init_for$(&back, 16, uint64_t);
+  pthread_t echo;
+  pthread_create(&echo, NULL, echo_main, NULL);
+
+  uint64_t x = 1;
+  ibench_case$("Round trip between two threads") {
+    iqueue_push(&there, &x);
+    iqueue_pop(&back, &x);
+  }
+
+  x = 0;
+  iqueue_push(&there, &x);
+  pthread_join(echo, NULL);
+  iqueue_destroy(&there);
+  iqueue_destroy(&back);
+
+  ibench_do_not_optimize$(atomic_load(&checksum));
+}
@@ -0,0 +1,110 @@
+/**
+ * Loading many small files compared with reading them one by one
+ */
+
+#include "istd/util/bench.h"
+#include "istd/io/loader.h"
+#include "istd/ds/arr.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FILES 2000
+
+/// The way files were read before, each with its own round trips
+static size_t read_one_by_one(const char* const* paths, iloader_file_t* files) {
+  size_t bytes = 0;
+  for (size_t i = 0; i < FILES; ++i) {
+    int fd = open(paths[i], O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    fstat(fd, &st);
+    files[i].data = ia_new_array_for$((size_t) st.st_size, char);
+    ssize_t got = read(fd, files[i].data, (size_t) st.st_size);
+    ia_set_length$(&files[i].data, got > 0 ? (size_t) got : 0);
+    close(fd);
+    bytes += ia_length(files[i].data);
+  }
+  iloader_release(files, FILES);
+  return bytes;
+}
+
+/// Drop files from page cache, so they are read from disk again
+static void evict(const char* const* paths) {
+  for (size_t i = 0; i < FILES; ++i) {
+    int fd = open(paths[i], O_RDONLY | O_CLOEXEC);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+static size_t load(const char* const* paths, iloader_file_t* files, iloader_way_t way) {
+  iloader_load(paths, FILES, files, way);
+  size_t bytes = 0;
+  for (size_t i = 0; i < FILES; ++i)
+    bytes += ia_length(files[i].data);
+  iloader_release(files, FILES);
+  return bytes;
+}
+
+
+ibench_section$("default, istd, io", "ISTD Loading files") {
+
+  // Config and asset files of 100 bytes to 16KB, in page cache
+  char dir[] = "/tmp/istd-loader-bench-XXXXXX";
+  mkdtemp(dir);
+  char* paths[FILES];
+  char buffer[16384];
+  for (size_t i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = (char) ('a' + i % 26);
+  for (size_t i = 0; i < FILES; ++i) {
+    paths[i] = malloc(64);
+    snprintf(paths[i], 64, "%s/%zu.conf", dir, i);
+    FILE* f = fopen(paths[i], "wb");
+    fwrite(buffer, 1, 100 + i * 7919 % (sizeof(buffer) - 100), f);
+    fclose(f);
+  }
+
+  const char* const* names = (const char* const*) paths;
+  iloader_file_t* files = malloc(FILES * sizeof(iloader_file_t));
+
+  ibench_case$("2000 files, one by one") {
+    ibench_do_not_optimize$(read_one_by_one(names, files));
+  }
+
+  ibench_case$("2000 files, io_uring") {
+    ibench_do_not_optimize$(load(names, files, ILOADER_URING));
+  }
+
+  ibench_case$("2000 files, threads") {
+    ibench_do_not_optimize$(load(names, files, ILOADER_THREADS));
+  }
+
+  // Evicting files costs the same in each case below
+  ibench_case$("2000 files evicted") {
+    evict(names);
+  }
+
+  ibench_case$("2000 files evicted, one by one") {
+    evict(names);
+    ibench_do_not_optimize$(read_one_by_one(names, files));
+  }
+
+  ibench_case$("2000 files evicted, io_uring") {
+    evict(names);
+    ibench_do_not_optimize$(load(names, files, ILOADER_URING));
+  }
+
+  ibench_case$("2000 files evicted, threads") {
+    evict(names);
+    ibench_do_not_optimize$(load(names, files, ILOADER_THREADS));
+  }
+
+  free(files);
+  for (size_t i = 0; i < FILES; ++i) {
+    unlink(paths[i]);
+    free(paths[i]);
+  }
+  rmdir(dir);
+}
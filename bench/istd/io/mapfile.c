@@ -0,0 +1,100 @@
+/**
+ * Lines of mapped files compared with reading into arrays
+ */
+
+#include "istd/util/bench.h"
+#include "istd/io/mapfile.h"
+#include "istd/ds/arr.h"
+#include "istd/util/err.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/// The way logs were read before: into a buffer, and then into an array
+static size_t read_lines(const char* path) {
+  FILE* file = fopen(path, "rb");
+  ia_arr$(char) text = ia_new_empty_array$(char);
+  char buffer[1 << 16];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)))
+    ia_append$(&text, buffer, n);
+  fclose(file);
+
+  size_t lines = 0;
+  for (size_t i = 0; i < ia_length(text); ++i)
+    lines += text[i] == '\n';
+  ia_destroy_array(text);
+  return lines;
+}
+
+static size_t memchr_lines(const imapfile_t* f) {
+  size_t lines = 0;
+  const char* end = f->data + f->size;
+  for (const char* p = f->data; (p = memchr(p, '\n', (size_t) (end - p))); ++p)
+    lines++;
+  return lines;
+}
+
+static size_t mapped_lines(const imapfile_t* f, bool check_utf8) {
+  size_t lines = 0;
+  imapfile_span_t line;
+  for (imapfile_iter_t it = imapfile_lines(f, check_utf8); imapfile_next(&it, &line);)
+    lines += line.len > 0;
+  return lines;
+}
+
+
+ibench_section$("default, istd, io", "ISTD Mapped files") {
+
+  // 256MB log of lines of 20 to 200 bytes, a few with UTF8
+  char path[] = "/tmp/istd-mapfile-bench-XXXXXX";
+  int fd = mkstemp(path);
+  FILE* file = fdopen(fd, "wb");
+  uint64_t rng = 88172645463325252ull;
+  char line[256];
+  for (size_t size = 0; size < 256 << 20;) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    int len = snprintf(line, sizeof(line), "2024-01-01 12:00:%02u [%s] request %llu took %ums %.*s\n",
+                       (unsigned) (rng % 60), rng % 16 ? "info" : "ошибка",
+                       (unsigned long long) (rng >> 20), (unsigned) (rng % 1000),
+                       (int) (rng % 140), "................................................................"
+                       "................................................................................");
+    fputs(line, file);
+    size += (size_t) len;
+  }
+  fclose(file);
+
+  ibench_case$("Read 256MB into array, count lines") {
+    ibench_do_not_optimize$(read_lines(path));
+  }
+
+  imapfile_t f;
+  if (!imapfile_open(&f, path))
+    panic$("Cannot map %s", path);
+
+  ibench_case$("Mapped 256MB, memchr() lines") {
+    ibench_do_not_optimize$(memchr_lines(&f));
+  }
+
+  ibench_case$("Mapped 256MB, lines") {
+    ibench_do_not_optimize$(mapped_lines(&f, false));
+  }
+
+  ibench_case$("Mapped 256MB, lines checked for UTF8") {
+    ibench_do_not_optimize$(mapped_lines(&f, true));
+  }
+
+  imapfile_close(&f);
+
+  // Mapping, and first touch of each page, are part of the cost
+  ibench_case$("Map and unmap 256MB, lines") {
+    imapfile_open(&f, path);
+    ibench_do_not_optimize$(mapped_lines(&f, false));
+    imapfile_close(&f);
+  }
+
+  unlink(path);
+}
@@ -0,0 +1,64 @@
+/**
+ * Cost of calling accessors instead of inlining them
+ */
+
+#include "istd/util/bench.h"
+#include "istd/util/utf8.h"
+#include "istd/ds/arr.h"
+#include <string.h>
+
+// Accessors as they were before, calls into the library which the
+// compiler can not see through
+
+__attribute__((noinline)) static size_t length_call(const void* arr) {
+  __asm__ volatile("");
+  return ia_length(arr);
+}
+
+__attribute__((noinline)) static const char* next_call(const char* ptr, rune* cp) {
+  __asm__ volatile("");
+  return utf8_next(ptr, cp);
+}
+
+ibench_section$("default, istd, inline", "ISTD Inlined accessors") {
+
+  ia_arr$(int) numbers = ia_new_array_of$(4096, int);
+  for (size_t i = 0; i < ia_length(numbers); ++i)
+    numbers[i] = (int) i;
+
+  ia_arr$(char) text = ia_new_empty_array$(char);
+  const char* piece = "Съешь же ещё этих мягких французских булок. 中文 ";
+  while (ia_length(text) + strlen(piece) <= 4096)
+    ia_append$(&text, piece, strlen(piece));
+
+  ibench_case$("Sum 4K ints, ia_length() inlined") {
+    int sum = 0;
+    for (size_t i = 0; i < ia_length(numbers); ++i)
+      sum += numbers[i];
+    ibench_do_not_optimize$(sum);
+  }
+
+  ibench_case$("Sum 4K ints, ia_length() called") {
+    int sum = 0;
+    for (size_t i = 0; i < length_call(numbers); ++i)
+      sum += numbers[i];
+    ibench_do_not_optimize$(sum);
+  }
+
+  ibench_case$("Decode 4K of text, utf8_next() inlined") {
+    rune cp = 0, sum = 0;
+    for (const char* p = utf8_next(text, &cp); cp != 0; p = utf8_next(p, &cp))
+      sum += cp;
+    ibench_do_not_optimize$(sum);
+  }
+
+  ibench_case$("Decode 4K of text, utf8_next() called") {
+    rune cp = 0, sum = 0;
+    for (const char* p = next_call(text, &cp); cp != 0; p = next_call(p, &cp))
+      sum += cp;
+    ibench_do_not_optimize$(sum);
+  }
+
+  ia_destroy_array(numbers);
+  ia_destroy_array(text);
+}
@@ -0,0 +1,35 @@
+/**
+ * Logging benchmarks
+ */
+
+#include "istd/util/bench.h"
+#include "istd/util/log.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+ibench_section$("default, istd, log", "ISTD Logging") {
+
+  FILE* null_file = fopen("/dev/null", "w");
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (!null_file || null_fd < 0)
+    return;
+
+  ibench_case$("fprintf") {
+    fprintf(null_file, "%s: request %d took %.3f ms\n", "bench", 42, 1.5);
+  }
+
+  ilog_start(null_fd);
+
+  ibench_case$("ilog_info$") {
+    ilog_info$("request %d took %.3f ms", 42, 1.5);
+  }
+
+  ibench_case$("ilog_info$ with string") {
+    ilog_info$("%s: request %d took %.3f ms", "bench", 42, 1.5);
+  }
+
+  ilog_stop();
+  fclose(null_file);
+  close(null_fd);
+}
@@ -0,0 +1,174 @@
+/**
+ * Switches between coroutines compared with switches between threads
+ */
+
+#include "istd/util/bench.h"
+#include "istd/util/coro.h"
+#include "istd/util/loop.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/// Round trips between two sides in one iteration
+#define ROUND 1000
+
+typedef struct {
+  icoro_t co;
+  int i;
+} counter_t;
+
+static void count_up(counter_t* f, int* out) {
+  icoro$(&f->co) {
+    for (f->i = 0;; ++f->i) {
+      *out = f->i;
+      icoro_yield$(&f->co);
+    }
+  }
+}
+
+//---- Tasks
+
+typedef struct {
+  iloop_task_t task;
+  iloop_task_t* partner;
+  int i, fd;
+  char byte;
+} pinger_t;
+
+/// Wakes partner and waits to be woken, ROUND times
+static void ping_wake(iloop_task_t* task) {
+  pinger_t* p = (pinger_t*) task;
+  icoro$(&task->co) {
+    for (p->i = 0; p->i < ROUND; ++p->i) {
+      iloop_wake(p->partner);
+      iloop_park$(task);
+    }
+    iloop_wake(p->partner);
+  }
+}
+
+/// Sends a byte and waits for the reply, ROUND times
+static void ping_socket(iloop_task_t* task) {
+  pinger_t* p = (pinger_t*) task;
+  icoro$(&task->co) {
+    for (p->i = 0; p->i < ROUND; ++p->i) {
+      if (write(p->fd, &p->byte, 1) != 1)
+        icoro_return$(&task->co);
+      iloop_wait_fd$(task, p->fd, ILOOP_READ);
+      if (read(p->fd, &p->byte, 1) != 1)
+        icoro_return$(&task->co);
+    }
+  }
+}
+
+/// Replies to ROUND bytes
+static void pong_socket(iloop_task_t* task) {
+  pinger_t* p = (pinger_t*) task;
+  icoro$(&task->co) {
+    for (p->i = 0; p->i < ROUND; ++p->i) {
+      iloop_wait_fd$(task, p->fd, ILOOP_READ);
+      if (read(p->fd, &p->byte, 1) != 1 || write(p->fd, &p->byte, 1) != 1)
+        icoro_return$(&task->co);
+    }
+  }
+}
+
+//---- Threads
+
+static sem_t ping_sem, pong_sem;
+static int thread_fd;
+static atomic_bool use_sockets;
+
+/// Answers ROUND pings through semaphores or a socket
+static void* pong_thread(void* arg) {
+  (void) arg;
+  char byte;
+  for (int i = 0; i < ROUND; ++i) {
+    if (atomic_load(&use_sockets)) {
+      if (read(thread_fd, &byte, 1) != 1 || write(thread_fd, &byte, 1) != 1)
+        break;
+    } else {
+      sem_wait(&ping_sem);
+      sem_post(&pong_sem);
+    }
+  }
+  return NULL;
+}
+
+
+ibench_section$("default, istd, loop", "ISTD Coroutines compared with threads") {
+
+  counter_t counter = { .co = ICORO_INIT };
+  int value;
+
+  ibench_case$("Resume a coroutine") {
+    count_up(&counter, &value);
+    ibench_do_not_optimize$(value);
+  }
+
+  iloop_t loop;
+  iloop_init(&loop);
+
+  ibench_case$("1000 round trips between tasks") {
+    pinger_t a = { .byte = 0 }, b = { .byte = 0 };
+    a.partner = &b.task;
+    b.partner = &a.task;
+    iloop_spawn(&loop, &a.task, ping_wake);
+    iloop_spawn(&loop, &b.task, ping_wake);
+    iloop_run(&loop);
+  }
+
+  sem_init(&ping_sem, 0, 0);
+  sem_init(&pong_sem, 0, 0);
+  atomic_store(&use_sockets, false);
+
+  ibench_case$("1000 round trips between threads") {
+    pthread_t t;
+    pthread_create(&t, NULL, pong_thread, NULL);
+    for (int i = 0; i < ROUND; ++i) {
+      sem_post(&ping_sem);
+      sem_wait(&pong_sem);
+    }
+    pthread_join(t, NULL);
+  }
+
+  sem_destroy(&ping_sem);
+  sem_destroy(&pong_sem);
+
+  int fds[2];
+  if (!socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds)) {
+
+    ibench_case$("1000 socket round trips between tasks") {
+      pinger_t ping = { .fd = fds[0] }, pong = { .fd = fds[1] };
+      iloop_spawn(&loop, &ping.task, ping_socket);
+      iloop_spawn(&loop, &pong.task, pong_socket);
+      iloop_run(&loop);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  // Threads block in read(), so sockets are blocking here
+  if (!socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+    thread_fd = fds[1];
+    atomic_store(&use_sockets, true);
+
+    ibench_case$("1000 socket round trips between threads") {
+      pthread_t t;
+      pthread_create(&t, NULL, pong_thread, NULL);
+      char byte = 0;
+      for (int i = 0; i < ROUND; ++i)
+        if (write(fds[0], &byte, 1) != 1 || read(fds[0], &byte, 1) != 1)
+          break;
+      pthread_join(t, NULL);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  iloop_destroy(&loop);
+}
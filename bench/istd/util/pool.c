@@ -0,0 +1,129 @@
+/**
+ * Thread-caching allocator compared with the system allocator
+ */
+
+#include "istd/util/bench.h"
+#include "istd/util/out.h"
+#include "istd/util/pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define THREADS 4
+#define SLOTS 256
+/// Allocations done by each thread in one iteration
+#define ROUND 1000
+
+typedef struct {
+  void* (*alloc)(size_t);
+  void (*release)(void*);
+} allocator_t;
+
+static const allocator_t system_allocator = { malloc, free };
+static const allocator_t pool_allocator = { ipool_malloc, ipool_free };
+
+/// Allocator used by workers in current iteration
+static const allocator_t* current;
+static pthread_barrier_t round_start, round_end;
+static atomic_bool quit;
+
+typedef struct {
+  void* slots[SLOTS];
+  /// Allocator of blocks in slots
+  const allocator_t* owner;
+  uint32_t rng;
+} worker_t;
+
+/// Replace random blocks with new ones, of random small sizes
+static void churn(worker_t* w, const allocator_t* a) {
+  w->owner = a;
+  for (size_t i = 0; i < ROUND; ++i) {
+    w->rng ^= w->rng << 13;
+    w->rng ^= w->rng >> 17;
+    w->rng ^= w->rng << 5;
+    size_t slot = w->rng % SLOTS;
+    a->release(w->slots[slot]);
+    w->slots[slot] = a->alloc(16 + (w->rng >> 16) % 500);
+    *(char*) w->slots[slot] = 1;
+  }
+}
+
+static void release_all(worker_t* w) {
+  for (size_t i = 0; i < SLOTS; ++i) {
+    if (w->slots[i])
+      w->owner->release(w->slots[i]);
+    w->slots[i] = NULL;
+  }
+}
+
+static void* worker_main(void* arg) {
+  worker_t* w = arg;
+  for (;;) {
+    pthread_barrier_wait(&round_start);
+    if (atomic_load(&quit))
+      break;
+    const allocator_t* a = current;
+    if (a)
+      churn(w, a);
+    else
+      release_all(w);
+    pthread_barrier_wait(&round_end);
+  }
+  return NULL;
+}
+
+/// Run one round in all workers, `NULL` allocator frees their blocks
+static void run_round(const allocator_t* a) {
+  current = a;
+  pthread_barrier_wait(&round_start);
+  pthread_barrier_wait(&round_end);
+}
+
+ibench_section$("default, istd, pool", "ISTD Thread-caching allocator") {
+
+  worker_t single = { .rng = 12345 };
+
+  ibench_case$("malloc, 1 thread") {
+    churn(&single, &system_allocator);
+  }
+  release_all(&single);
+
+  ibench_case$("ipool, 1 thread") {
+    churn(&single, &pool_allocator);
+  }
+  release_all(&single);
+
+  static worker_t workers[THREADS];
+  pthread_t threads[THREADS];
+  pthread_barrier_init(&round_start, NULL, THREADS + 1);
+  pthread_barrier_init(&round_end, NULL, THREADS + 1);
+  atomic_store(&quit, false);
+  for (size_t i = 0; i < THREADS; ++i) {
+    workers[i].rng = (uint32_t) (i + 1) * 2654435761u;
+    pthread_create(&threads[i], NULL, worker_main, &workers[i]);
+  }
+
+  // Slots keep blocks of one allocator only, so they are emptied in between
+  ibench_case$("malloc, 4 threads") {
+    run_round(&system_allocator);
+  }
+  run_round(NULL);
+
+  ibench_case$("ipool, 4 threads") {
+    run_round(&pool_allocator);
+  }
+
+  // While blocks of workers are still allocated
+  ipool_stats_t stats = ipool_stats();
+  iout_printf(iout_stderr(), "\n    ipool: %.1f%% cache hits, %.1f%% fragmentation, %zu KB mapped\n",
+              stats.hit_rate * 100, stats.fragmentation * 100, stats.mapped_bytes / 1024);
+  run_round(NULL);
+
+  atomic_store(&quit, true);
+  pthread_barrier_wait(&round_start);
+  for (size_t i = 0; i < THREADS; ++i)
+    pthread_join(threads[i], NULL);
+  pthread_barrier_destroy(&round_start);
+  pthread_barrier_destroy(&round_end);
+}
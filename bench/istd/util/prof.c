@@ -0,0 +1,47 @@
+/**
+ * Profiling overhead benchmarks
+ */
+
+#include "istd/util/bench.h"
+#include "istd/util/prof.h"
+
+ibench_section$("default, istd, prof", "ISTD Profiling overhead") {
+
+  int x = 0;
+
+  ibench_case$("Empty block") {
+    ibench_do_not_optimize$(x);
+  }
+
+  ibench_case$("Zone, not recording") {
+    iprof_zone$("bench zone") {
+      ibench_do_not_optimize$(x);
+    }
+  }
+
+  iprof_thread_init();
+  iprof_start();
+  size_t n = 0;
+
+  ibench_case$("Zone, recording") {
+    iprof_zone$("bench zone") {
+      ibench_do_not_optimize$(x);
+    }
+    // Keep buffer from filling up
+    if (++n == IPROF_BUFFER_EVENTS) {
+      iprof_reset();
+      n = 0;
+    }
+  }
+
+  ibench_case$("Counter, recording") {
+    iprof_counter_add$("bench counter", 1);
+    if (++n == IPROF_BUFFER_EVENTS) {
+      iprof_reset();
+      n = 0;
+    }
+  }
+
+  iprof_stop();
+  iprof_reset();
+}
@@ -0,0 +1,54 @@
+/**
+ * UTF8 benchmarks
+ */
+
+#include "istd/util/bench.h"
+#include "istd/util/unicode.h"
+#include "istd/util/utf8.h"
+#include "istd/util/utf8_search.h"
+#include "istd/ds/arr.h"
+#include <string.h>
+
+/// Build a text by repeating `piece` up to `len` bytes
+static ia_arr$(char) repeat(const char* piece, size_t len) {
+  ia_arr$(char) text = ia_new_empty_array$(char);
+  size_t n = strlen(piece);
+  while (ia_length(text) + n <= len)
+    ia_append$(&text, piece, n);
+  return text;
+}
+
+ibench_section$("default, istd, unicode", "ISTD UTF8") {
+
+  ia_arr$(char) ascii = repeat("The quick brown fox jumps over the lazy dog. ", 4096);
+  ia_arr$(char) mixed = repeat("Съешь же ещё этих мягких французских булок. 中文 ", 4096);
+
+  ibench_case$("Decode 4K of ASCII") {
+    rune cp = 0, sum = 0;
+    for (const char* p = utf8_next(ascii, &cp); cp != 0; p = utf8_next(p, &cp))
+      sum += cp;
+    ibench_do_not_optimize$(sum);
+  }
+
+  ibench_case$("Decode 4K of mixed text") {
+    rune cp = 0, sum = 0;
+    for (const char* p = utf8_next(mixed, &cp); cp != 0; p = utf8_next(p, &cp))
+      sum += cp;
+    ibench_do_not_optimize$(sum);
+  }
+
+  ibench_case$("Length of 4K of mixed text") {
+    ibench_do_not_optimize$(utf8_length(mixed));
+  }
+
+  ibench_case$("Display width of 4K of mixed text") {
+    ibench_do_not_optimize$(utf8_display_width(mixed));
+  }
+
+  ibench_case$("Find a missing word in 4K of mixed text") {
+    ibench_do_not_optimize$(utf8_find(mixed, ia_length(mixed), "булочек", strlen("булочек")));
+  }
+
+  ia_destroy_array(ascii);
+  ia_destroy_array(mixed);
+}
@@ -8,38 +8,91 @@
  *                                                      ┌─ zero byte for string
  *                                                      │  functions to work
  *                                                      ▼
- * -----------------------------------------------------------
- *   | len | availiable | element 1 | element 2 | ... | \0 |
- * -----------------------------------------------------------
- *   ▲                        ▲ 
- *   │                        └─ pointer given to you points here
+ * ---------------------------------------------------------------------
+ *   | len | availiable | align | element 1 | element 2 | ... | \0 |
+ * ---------------------------------------------------------------------
+ *   ▲                                ▲
+ *   │                                └─ pointer given to you points here
  *   │
  *   └─ beginning of allocated memory
  * ```
  *
  * *(I just love making those diagrams)*
  *
+ * Elements are aligned to `alignof(max_align_t)`. Arrays created with
+ * `ia_new_aligned_array_for$()` and friends are aligned more, to a cache
+ * line or a page: then the header is placed right before aligned
+ * elements, after some unused bytes at the beginning of allocated memory.
+ *
  * Contrary to previous version, this uses way less macros
  * and more separate functions, reducing amount of possible macro errors.
  *
+ * Arrays may be shared by many holders with `ia_share()`, which counts
+ * one more holder instead of copying items, so a snapshot is handed to
+ * reader threads at once:
+ *
+ *   ia_arr$(int) snapshot = ia_share(arr);   // Readers get this one
+ *   ia_push$(&arr, 42);                      // Copied here, once
+ *   ...
+ *   ia_destroy_array(snapshot);              // By each holder
+ *
+ * Operations which take `&arr` copy items of a shared array first, and
+ * leave other holders with the old one. Items written by index are not
+ * noticed, so call `ia_unshare$()` before writing them. Arrays which
+ * were never shared pay for one load per operation.
+ *
  * 
  */
 
 #ifndef ISTD_ARR
 #define ISTD_ARR
 
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdalign.h>
 
+//------ Internals, used by getters -----------------------------------------//
+
+/// \internal
+/// The actual array object.
+/// When using all methods of this library, you get/pass pointer to the `data`.
+typedef struct {
+
+  /// Number of items currently in the array
+  size_t length;
+
+  /// Number of items which can be fitted into this array without reallocation.
+  size_t availiable;
+
+  /// Alignment of `data`, in bytes
+  unsigned alignment;
+
+  /// Number of unused bytes before this struct in allocated memory
+  unsigned padding;
+
+  /// Number of holders besides the first one, see `ia_share()`
+  _Atomic unsigned shares;
+
+  /// Array with element data
+  alignas(alignof(max_align_t)) char data[];
+} _ia_actual_array_t;
+
+
 //------ Getter functions ----------------------------------------------------//
 
+// Getters are called in loop conditions all the time, so they are
+// defined here to be inlined, instead of being calls into the library.
 
 /// \brief Get length of given dynamic array
 ///
 /// If given `arr` is `NULL`, then this function will return `0`.
 /// This is well-defined behaviour.
 ///
-size_t ia_length(const void* arr);
+static inline size_t ia_length(const void* arr) {
+  if (!arr) return 0;
+  return ((const _ia_actual_array_t*) ((const char*) arr - offsetof(_ia_actual_array_t, data)))->length;
+}
 
 
 /// \brief Number of items which can be fitted into given array without reallocation
@@ -48,11 +101,44 @@ size_t ia_length(const void* arr);
 ///
 /// Again, this function will accept `arr = NULL` and return `0`.
 ///
-size_t ia_avail(const void* arr);
+static inline size_t ia_avail(const void* arr) {
+  if (!arr) return 0;
+  return ((const _ia_actual_array_t*) ((const char*) arr - offsetof(_ia_actual_array_t, data)))->availiable;
+}
+
+
+/// \brief Alignment of items of given array, in bytes
+///
+/// It is at least `alignof(max_align_t)`, or what was given to
+/// `ia_alloc_aligned_array()`. Returns `0` for `NULL`.
+///
+static inline size_t ia_alignment(const void* arr) {
+  if (!arr) return 0;
+  return ((const _ia_actual_array_t*) ((const char*) arr - offsetof(_ia_actual_array_t, data)))->alignment;
+}
+
+
+/// \brief Whether given array has other holders, so it would be copied before changes
+///
+/// Answer may be out of date at once, if other holders run in other
+/// threads. Returns `false` for `NULL`.
+///
+static inline bool ia_is_shared(const void* arr) {
+  if (!arr) return false;
+  return atomic_load_explicit(
+      &((_ia_actual_array_t*) ((const char*) arr - offsetof(_ia_actual_array_t, data)))->shares,
+      memory_order_acquire) != 0;
+}
 
 
 //------ Array creation/destruction ------------------------------------------//
 
+/// \brief Alignment to a cache line, so arrays of different threads do not share lines
+#define IA_CACHE_LINE 64
+
+/// \brief Alignment to a page
+#define IA_PAGE 4096
+
 /// \brief A wrapper to use when typing arrays.
 ///
 /// So instead `int*` you would use `ia_arr(int)`, which compiles to the
@@ -85,6 +171,16 @@ size_t ia_avail(const void* arr);
 void* ia_alloc_array(size_t prealloc, size_t len, size_t item_size);
 
 
+/// \brief Allocate an array with items aligned to `alignment` bytes
+///
+/// Same as `ia_alloc_array()`, but items start at an address which is
+/// a multiple of `alignment`. It must be a power of two, up to 1 MB;
+/// values below `alignof(max_align_t)` give usual arrays. Alignment is
+/// kept when the array grows.
+///
+void* ia_alloc_aligned_array(size_t prealloc, size_t len, size_t item_size, size_t alignment);
+
+
 /// \brief Allocate empty array for elements of given `type`.
 ///
 /// May return `NULL` if your system has totally ran out of memory.
@@ -109,13 +205,58 @@ void* ia_alloc_array(size_t prealloc, size_t len, size_t item_size);
   ((type*) ia_alloc_array((amount), 0, sizeof(type)))
 
 
+/// \brief Allocate array with preallocated space for `amount` of items of
+///        given `type`, aligned to `alignment` bytes.
+///
+/// Use `IA_CACHE_LINE` for arrays used by different threads, or for
+/// data processed with wide vector loads, and `IA_PAGE` for large
+/// buffers.
+///
+#define ia_new_aligned_array_for$(amount, type, alignment) \
+  ((type*) ia_alloc_aligned_array((amount), 0, sizeof(type), (alignment)))
+
+
+/// \brief Allocate array with `amount` of zero-initialized items of given
+///        `type`, aligned to `alignment` bytes.
+///
+#define ia_new_aligned_array_of$(amount, type, alignment) \
+  ((type*) ia_alloc_aligned_array(0, (amount), sizeof(type), (alignment)))
+
+
 /// \brief Free memory of given array.
 ///
 /// Will happily accept `NULL` and do nothing, like `free()`
 ///
+/// Shared array is freed by the last of its holders, and others only
+/// stop holding it.
+///
 void ia_destroy_array(void* array);
 
 
+/// \brief Hold given array once more, and return it.
+///
+/// Items are not copied: holders see the same array, until one of them
+/// changes it through an operation taking `&arr`, which gives that holder
+/// a copy of its own. Each holder calls `ia_destroy_array()` once. Arrays
+/// may be shared and destroyed from any thread.
+///
+/// Returns `NULL` for `NULL`.
+///
+void* ia_share(const void* array);
+
+
+void _ia_generic_unshare(void** array, size_t item_size);
+
+
+/// \brief Make `*array` the only holder of its items, copying them if it is shared.
+///
+/// Call it before writing items by index, or passing the array to
+/// functions which write them, such as `ia_simd_fill$()`.
+///
+#define ia_unshare$(array) \
+  _ia_generic_unshare((void**) (array), sizeof(typeof(**array)))
+
+
 //------ Common operations ---------------------------------------------------//
 
 
@@ -151,4 +292,62 @@ void _ia_generic_pop(void** array, size_t item_size);
 #define ia_pop$(array) _ia_generic_pop((void**) (array), sizeof(typeof(**array)))
 
 
+/// \internal
+/// Internals of `ia_append$()` macro.
+void _ia_generic_append(void** array, const void* items, size_t count, size_t item_size);
+
+
+/// \brief Append `count` items from `items` to the end of given array.
+///
+/// Works like `count` calls to `ia_push$()`, but grows the array at most
+/// once and copies all items with one `memcpy`.
+///
+/// Just like with `ia_push$()`, if `*array` is `NULL`, a new array
+/// is created.
+///
+/// \param array Pointer to array to append items to (`&arr`)
+/// \param items Pointer to the first of items to append
+/// \param count Number of items to append
+///
+#define ia_append$(array, items, count) \
+  _ia_generic_append((void**) (array), (items), (count), sizeof(typeof(**array)))
+
+
+void _ia_generic_truncate(void** array, size_t len, size_t item_size);
+
+
+/// \brief Shrink array to `len` items, keeping the allocated space.
+///
+/// Truncating to length larger than current one is an error,
+/// and will panic.
+///
+#define ia_truncate$(array, len) \
+  _ia_generic_truncate((void**) (array), (len), sizeof(typeof(**array)))
+
+
+void _ia_generic_reserve(void** array, size_t count, size_t item_size);
+
+
+/// \brief Make room for `count` more items, so that many pushes do not reallocate.
+///
+/// Length stays the same. Like with `ia_push$()`, if `*array` is `NULL`,
+/// a new array is created.
+///
+#define ia_reserve$(array, count) \
+  _ia_generic_reserve((void**) (array), (count), sizeof(typeof(**array)))
+
+
+void _ia_generic_set_length(void** array, size_t len, size_t item_size);
+
+
+/// \brief Set length of array to `len` items, which fit in its room.
+///
+/// Used after writing items straight into room made with `ia_reserve$()`:
+/// items past old length keep what was written there. Length larger
+/// than `ia_avail()` is an error, and will panic.
+///
+#define ia_set_length$(array, len) \
+  _ia_generic_set_length((void**) (array), (len), sizeof(typeof(**array)))
+
+
 #endif
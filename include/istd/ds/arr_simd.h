@@ -0,0 +1,98 @@
+/**
+ * \file
+ * \brief Vectorized operations on arrays of numbers
+ *
+ * Scans over `ia_arr$()` of `int32_t`, `int64_t`, `float` and `double`,
+ * done with AVX-512 or AVX2 when the CPU has them, and with plain loops
+ * otherwise:
+ *
+ *   ia_arr$(int32_t) arr = ia_new_aligned_array_of$(n, int32_t, IA_CACHE_LINE);
+ *   ia_simd_fill$(arr, 7);
+ *   int64_t total = ia_simd_sum$(arr);
+ *   const int32_t* seven = ia_simd_find$(arr, 7);
+ *
+ * Each operation has a function for each type (`ia_simd_sum_i32()`,
+ * `ia_simd_sum_f64()`, ...), and a macro picking one by the type of
+ * array. All of them work on `ia_length()` items of given arrays.
+ *
+ * Items may have any alignment, but arrays aligned to `IA_CACHE_LINE`
+ * never have vector loads split between two cache lines.
+ *
+ * Vectorized sums add items in different order than a loop would, so
+ * sums of `float` and `double` may differ in last bits between CPUs.
+ */
+
+#ifndef ISTD_ARR_SIMD
+#define ISTD_ARR_SIMD
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//------ Functions for each type ---------------------------------------------//
+
+/// \internal Declare all operations for items of type `T`, summed into `S`
+#define _IA_SIMD_DECLARE$(sfx, T, S) \
+  void ia_simd_fill_##sfx(T* arr, T value); \
+  S ia_simd_sum_##sfx(const T* arr); \
+  T ia_simd_min_##sfx(const T* arr); \
+  T ia_simd_max_##sfx(const T* arr); \
+  const T* ia_simd_find_##sfx(const T* arr, T value); \
+  bool ia_simd_equal_##sfx(const T* a, const T* b); \
+  void ia_simd_prefix_sum_##sfx(T* arr);
+
+_IA_SIMD_DECLARE$(i32, int32_t, int64_t)
+_IA_SIMD_DECLARE$(i64, int64_t, int64_t)
+_IA_SIMD_DECLARE$(f32, float, double)
+_IA_SIMD_DECLARE$(f64, double, double)
+
+
+//------ Operations ----------------------------------------------------------//
+
+/// \internal Pick function for the type of items of `arr`
+#define _ia_simd_pick$(op, arr) _Generic(*(arr), \
+    int32_t: ia_simd_##op##_i32, \
+    int64_t: ia_simd_##op##_i64, \
+    float: ia_simd_##op##_f32, \
+    double: ia_simd_##op##_f64)
+
+/// \brief Set all items of the array to `value`.
+#define ia_simd_fill$(arr, value) _ia_simd_pick$(fill, arr)((arr), (value))
+
+/// \brief Sum of all items, `0` for empty array.
+///
+/// Integers are summed as `int64_t`, and floating point numbers as
+/// `double`. Sum must fit into `int64_t`.
+///
+#define ia_simd_sum$(arr) _ia_simd_pick$(sum, arr)(arr)
+
+/// \brief Smallest item of the array, which must not be empty.
+///
+/// Result is unspecified if the array has NaNs.
+///
+#define ia_simd_min$(arr) _ia_simd_pick$(min, arr)(arr)
+
+/// \brief Largest item of the array, which must not be empty.
+///
+/// Result is unspecified if the array has NaNs.
+///
+#define ia_simd_max$(arr) _ia_simd_pick$(max, arr)(arr)
+
+/// \brief Pointer to the first item equal to `value`, or `NULL`.
+#define ia_simd_find$(arr, value) _ia_simd_pick$(find, arr)((arr), (value))
+
+/// \brief Check if arrays have the same length and equal items.
+///
+/// Items are compared with `==`, so `-0.0` is equal to `0.0`,
+/// and NaN is not equal to anything.
+///
+#define ia_simd_equal$(a, b) _ia_simd_pick$(equal, a)((a), (b))
+
+/// \brief Replace each item with sum of it and all items before it.
+///
+/// Sums are computed in the type of items, so for integers they must
+/// not overflow it.
+///
+#define ia_simd_prefix_sum$(arr) _ia_simd_pick$(prefix_sum, arr)(arr)
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * \file
+ * \brief Set operations on sorted arrays
+ *
+ * Arrays of `uint32_t` ids, sorted and without repeats, such as posting
+ * lists, are intersected, joined and subtracted:
+ *
+ *   ia_arr$(uint32_t) found = ia_new_empty_array$(uint32_t);
+ *   ia_sorted_intersect(&found, docs_with_foo, docs_with_bar);
+ *   ia_sorted_difference(&found, found_before, docs_with_baz);
+ *
+ * Results replace what was in output array, which may be reused for
+ * many operations, so only its first ones allocate. Output must not be
+ * one of the inputs, except for `ia_sorted_unique()`.
+ *
+ * Each operation picks its way by the sizes of inputs. Arrays of
+ * similar size are walked side by side, a block of items at a time:
+ * each item of one block is compared with every item of the other with
+ * a few vector compares, when the CPU has SSE4.2 or AVX2 (see
+ * `istd/util/cpu.h`). When one array is much shorter, each of its items
+ * is looked up in the longer one with galloping search, which doubles
+ * its step until it passes the item, and then bisects the last step:
+ * a lookup costs the logarithm of distance to the previous one, so few
+ * items of the longer array are read at all.
+ */
+
+#ifndef ISTD_ARR_SORTED
+#define ISTD_ARR_SORTED
+
+#include "istd/ds/arr.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/// \brief Ratio of lengths from which shorter array is looked up in the longer one
+#define IA_SORTED_GALLOP_RATIO 32
+
+/// \brief Put items which are both in `a` and `b` into `*out`.
+///
+/// Returns their number.
+///
+size_t ia_sorted_intersect(ia_arr$(uint32_t)* out, const uint32_t* a, const uint32_t* b);
+
+/// \brief Put items which are in `a` or `b` into `*out`, once each.
+size_t ia_sorted_union(ia_arr$(uint32_t)* out, const uint32_t* a, const uint32_t* b);
+
+/// \brief Put items of `a` which are not in `b` into `*out`.
+size_t ia_sorted_difference(ia_arr$(uint32_t)* out, const uint32_t* a, const uint32_t* b);
+
+/// \brief Put items of sorted `a` into `*out`, dropping repeats.
+///
+/// `a` may have repeats, and `*out` may be `a` itself, to drop them in
+/// place.
+///
+size_t ia_sorted_unique(ia_arr$(uint32_t)* out, const uint32_t* a);
+
+#endif
@@ -0,0 +1,517 @@
+/**
+ * \file
+ * \brief Ordered maps as B+-trees, generated for each key and value type
+ *
+ * Sorted `ia_arr$()` gives fast lookups, but each insert moves half of
+ * it. B+-tree keeps keys in sorted nodes of a few cache lines, so an
+ * insert moves at most one node, and a lookup reads one node per level:
+ *
+ * ```
+ *                      ┌──────────┐
+ *                      │ 40 │ 80  │                  inner nodes: keys
+ *                      └─┬────┬───┴─┐                and children
+ *            ┌───────────┘    │     └──────────┐
+ *       ┌────▼─────┐    ┌─────▼────┐      ┌────▼─────┐
+ *       │ 10 20 30 ├───►│ 40 50 70 ├─────►│ 80 90    │  leaves: keys,
+ *       └──────────┘    └──────────┘      └──────────┘  values, next leaf
+ * ```
+ *
+ * Tree type and its functions are generated by two macros: declarations
+ * go to a header, and definitions to one source file.
+ *
+ *   // ids.h
+ *   IBTREE_DECLARE$(ids, int64_t, uint32_t)
+ *
+ *   // ids.c
+ *   IBTREE_DEFINE_NUMBERS$(ids, int64_t, uint32_t)
+ *
+ *   ids_t tree;
+ *   ids_init(&tree);
+ *   ids_insert(&tree, 42, 7);
+ *   uint32_t* v = ids_find(&tree, 42);
+ *
+ *   for (ids_iter_t it = ids_range(&tree, 10, 100); ids_iter_valid(&it); ids_iter_next(&it))
+ *     printf("%ld: %u\n", ids_iter_key(&it), *ids_iter_value(&it));
+ *
+ *   ids_destroy(&tree);
+ *
+ * Position of a key within a node is the number of smaller keys, counted
+ * without branches. Trees of numbers, defined with
+ * `IBTREE_DEFINE_NUMBERS$()`, count over the whole node, unused slots
+ * masked out, so the loop has fixed length and the compiler turns it
+ * into vector compares: faster than a binary search over a few cache
+ * lines. Other keys are ordered by a `less(a, b)` macro or function
+ * given to `IBTREE_DEFINE$()`, which is called for used slots only.
+ *
+ * Nodes are allocated from chunks aligned to a cache line, and are freed
+ * together with the tree. Erasing never merges nodes: after erasing most
+ * keys, rebuild the tree with `name_load()`.
+ */
+
+#ifndef ISTD_DS_BTREE
+#define ISTD_DS_BTREE
+
+#include "istd/ds/arr.h"
+#include "istd/util/cpu.h"
+#include "istd/util/err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/// \brief Bytes of keys in a node
+#define IBTREE_NODE_BYTES 256
+
+/// \brief Number of keys in a node, for keys of type `K`
+#define IBTREE_SLOTS$(K) \
+  (IBTREE_NODE_BYTES / sizeof(K) < 8 ? 8 : IBTREE_NODE_BYTES / sizeof(K))
+
+/// \brief Maximum number of levels of inner nodes
+#define IBTREE_MAX_HEIGHT 32
+
+/// \internal Order of numbers
+#define _IBTREE_LESS$(a, b) ((a) < (b))
+
+//------ Internals -----------------------------------------------------------//
+
+/// \internal Nodes of one size, allocated in chunks
+typedef struct {
+  ia_arr$(char*) chunks;
+  size_t node_size;
+  /// Nodes given out from the last chunk
+  size_t used;
+} _ibtree_slab_t;
+
+/// \internal Prepare slab for nodes of `node_size` bytes
+void _ibtree_slab_init(_ibtree_slab_t* slab, size_t node_size);
+
+/// \internal Free all nodes of the slab
+void _ibtree_slab_destroy(_ibtree_slab_t* slab);
+
+/// \internal New zeroed node, aligned to a cache line
+void* _ibtree_slab_alloc(_ibtree_slab_t* slab);
+
+/// \internal Bytes of all chunks of the slab
+size_t _ibtree_slab_bytes(const _ibtree_slab_t* slab);
+
+
+//------ Declarations --------------------------------------------------------//
+
+/// \brief Declare tree `name_t` mapping keys `K` to values `V`, with its functions.
+///
+/// - `void name_init(name_t* t)` creates an empty tree.
+/// - `void name_destroy(name_t* t)` frees all nodes.
+/// - `V* name_find(const name_t* t, K key)` gives value of `key`, or `NULL`.
+/// - `bool name_insert(name_t* t, K key, V value)` adds `key`, or replaces
+///   its value. Returns `true` if the key is new.
+/// - `bool name_erase(name_t* t, K key)` removes `key`, returns `true` if
+///   it was there.
+/// - `void name_load(name_t* t, K const* keys, V const* values)` replaces
+///   contents with items of two `ia_arr$()` of the same length. Keys must
+///   be sorted, without repeats. Leaves are filled up completely.
+/// - `size_t name_count(const name_t* t)` gives number of keys.
+/// - `size_t name_memory(const name_t* t)` gives bytes taken by nodes.
+///
+/// Iterators go over keys in order:
+///
+/// - `name_iter_t name_begin(const name_t* t)` starts from the smallest key.
+/// - `name_iter_t name_lower_bound(const name_t* t, K key)` starts from
+///   the first key not less than `key`.
+/// - `name_iter_t name_range(const name_t* t, K from, K to)` goes over
+///   keys in `[from, to)`.
+/// - `name_iter_valid()`, `name_iter_next()`, `name_iter_key()` and
+///   `name_iter_value()` take a pointer to the iterator.
+///
+/// Inserts and erases invalidate iterators.
+///
+#define IBTREE_DECLARE$(name, K, V)                                            \
+                                                                               \
+  typedef struct name##_leaf_t name##_leaf_t;                                  \
+  struct name##_leaf_t {                                                       \
+    K keys[IBTREE_SLOTS$(K)];                                                  \
+    V values[IBTREE_SLOTS$(K)];                                                \
+    name##_leaf_t* next;                                                       \
+    unsigned n;                                                                \
+  };                                                                           \
+                                                                               \
+  /* Child `i + 1` has keys not less than `keys[i]` */                         \
+  typedef struct {                                                             \
+    K keys[IBTREE_SLOTS$(K)];                                                  \
+    void* children[IBTREE_SLOTS$(K) + 1];                                      \
+    unsigned n;                                                                \
+  } name##_inner_t;                                                            \
+                                                                               \
+  typedef struct {                                                             \
+    /* Leaf when `height` is zero */                                           \
+    void* root;                                                                \
+    /* Number of levels of inner nodes */                                      \
+    unsigned height;                                                           \
+    size_t count;                                                              \
+    name##_leaf_t* first;                                                      \
+    _ibtree_slab_t leaves, inners;                                             \
+  } name##_t;                                                                  \
+                                                                               \
+  typedef struct {                                                             \
+    const name##_leaf_t* leaf;                                                 \
+    /* Current key, and end of keys of the leaf within the range */            \
+    unsigned i, end;                                                           \
+    bool bounded;                                                              \
+    K to;                                                                      \
+  } name##_iter_t;                                                             \
+                                                                               \
+  void name##_init(name##_t* t);                                               \
+  void name##_destroy(name##_t* t);                                            \
+  V* name##_find(const name##_t* t, K key);                                    \
+  bool name##_insert(name##_t* t, K key, V value);                             \
+  bool name##_erase(name##_t* t, K key);                                       \
+  void name##_load(name##_t* t, K const* keys, V const* values);               \
+  size_t name##_memory(const name##_t* t);                                     \
+  name##_iter_t name##_begin(const name##_t* t);                               \
+  name##_iter_t name##_lower_bound(const name##_t* t, K key);                  \
+  name##_iter_t name##_range(const name##_t* t, K from, K to);                 \
+  void _##name##_iter_settle(name##_iter_t* it);                               \
+                                                                               \
+  static inline size_t name##_count(const name##_t* t) {                       \
+    return t->count;                                                           \
+  }                                                                            \
+                                                                               \
+  static inline bool name##_iter_valid(const name##_iter_t* it) {              \
+    return it->leaf != NULL;                                                   \
+  }                                                                            \
+                                                                               \
+  static inline K name##_iter_key(const name##_iter_t* it) {                   \
+    return it->leaf->keys[it->i];                                              \
+  }                                                                            \
+                                                                               \
+  static inline V* name##_iter_value(const name##_iter_t* it) {                \
+    return (V*) &it->leaf->values[it->i];                                      \
+  }                                                                            \
+                                                                               \
+  static inline void name##_iter_next(name##_iter_t* it) {                     \
+    if (++it->i >= it->end)                                                    \
+      _##name##_iter_settle(it);                                               \
+  }
+
+
+//------ Definitions ---------------------------------------------------------//
+
+#ifdef ICPU_X86
+#define _IBTREE_TARGET_AVX2 ICPU_TARGET_AVX2
+#define _IBTREE_TARGET_AVX512 ICPU_TARGET_AVX512
+#else
+#define _IBTREE_TARGET_AVX2
+#define _IBTREE_TARGET_AVX512
+#endif
+
+/// \internal Define descent from the root to the leaf where `key` belongs,
+/// compiled for given `target`.
+///
+/// Stores number of keys of the leaf less than `key` into `index`, and,
+/// when `path` is not `NULL`, inner nodes on the way and numbers of
+/// children taken into `path` and `slots`.
+///
+#define _IBTREE_DESCEND$(name, K, sfx, target)                                 \
+  __attribute__((unused)) target static name##_leaf_t* _##name##_descend_##sfx( \
+      const name##_t* t, K key,                                                \
+      name##_inner_t** path, unsigned* slots, unsigned* index) {               \
+    void* node = t->root;                                                      \
+    for (unsigned h = 0; h < t->height; ++h) {                                 \
+      name##_inner_t* in = (name##_inner_t*) node;                             \
+      unsigned s = _##name##_count_not_greater(in->keys, in->n, key);          \
+      if (path) {                                                              \
+        path[h] = in;                                                          \
+        slots[h] = s;                                                          \
+      }                                                                        \
+      node = in->children[s];                                                  \
+    }                                                                          \
+    name##_leaf_t* leaf = (name##_leaf_t*) node;                               \
+    *index = _##name##_count_less(leaf->keys, leaf->n, key);                   \
+    return leaf;                                                               \
+  }
+
+/// \brief Define functions of tree `name_t`, declared with `IBTREE_DECLARE$()`.
+///
+/// `less(a, b)` is a function or a macro telling if key `a` goes
+/// before key `b`.
+///
+#define IBTREE_DEFINE$(name, K, V, less) _IBTREE_DEFINE$(name, K, V, less, false)
+
+/// \brief Define functions of tree `name_t` with keys of a numeric type.
+///
+/// Keys are searched with vector compares.
+///
+#define IBTREE_DEFINE_NUMBERS$(name, K, V) _IBTREE_DEFINE$(name, K, V, _IBTREE_LESS$, true)
+
+/// \internal Define functions, comparing all slots of nodes if `whole_node`
+#define _IBTREE_DEFINE$(name, K, V, less, whole_node)                          \
+                                                                               \
+  enum { _##name##_SLOTS = IBTREE_SLOTS$(K) };                                 \
+                                                                               \
+  /* Number of keys less than `key`. Loop over all slots has fixed */          \
+  /* length, and is vectorized */                                              \
+  static inline unsigned _##name##_count_less(                                 \
+      K const* keys, unsigned n, K key) {                                      \
+    unsigned count = 0;                                                        \
+    if (whole_node)                                                            \
+      for (unsigned i = 0; i < _##name##_SLOTS; ++i)                           \
+        count += (i < n) & (less(keys[i], key));                               \
+    else                                                                       \
+      for (unsigned i = 0; i < n; ++i)                                         \
+        count += (less(keys[i], key));                                         \
+    return count;                                                              \
+  }                                                                            \
+                                                                               \
+  /* Number of keys not greater than `key`: index of child to go to */         \
+  static inline unsigned _##name##_count_not_greater(                          \
+      K const* keys, unsigned n, K key) {                                      \
+    unsigned count = 0;                                                        \
+    if (whole_node)                                                            \
+      for (unsigned i = 0; i < _##name##_SLOTS; ++i)                           \
+        count += (i < n) & !(less(key, keys[i]));                              \
+    else                                                                       \
+      for (unsigned i = 0; i < n; ++i)                                         \
+        count += !(less(key, keys[i]));                                        \
+    return count;                                                              \
+  }                                                                            \
+                                                                               \
+  /* Node search is inlined into versions for each level of CPU */             \
+  _IBTREE_DESCEND$(name, K, scalar, )                                          \
+  _IBTREE_DESCEND$(name, K, avx2, _IBTREE_TARGET_AVX2)                         \
+  _IBTREE_DESCEND$(name, K, avx512, _IBTREE_TARGET_AVX512)                     \
+                                                                               \
+  icpu_dispatch$(_##name##_descend, name##_leaf_t*,                            \
+                 (const name##_t* t, K key, name##_inner_t** path,             \
+                  unsigned* slots, unsigned* index),                           \
+                 _##name##_descend_scalar, NULL,                               \
+                 icpu_x86$(_##name##_descend_avx2),                            \
+                 icpu_x86$(_##name##_descend_avx512))                          \
+                                                                               \
+  static void _##name##_leaf_put(name##_leaf_t* leaf, unsigned i, K key, V value) { \
+    memmove(&leaf->keys[i + 1], &leaf->keys[i], (leaf->n - i) * sizeof(K));    \
+    memmove(&leaf->values[i + 1], &leaf->values[i], (leaf->n - i) * sizeof(V)); \
+    leaf->keys[i] = key;                                                       \
+    leaf->values[i] = value;                                                   \
+    leaf->n++;                                                                 \
+  }                                                                            \
+                                                                               \
+  static void _##name##_inner_put(name##_inner_t* in, unsigned i, K key, void* child) { \
+    memmove(&in->keys[i + 1], &in->keys[i], (in->n - i) * sizeof(K));          \
+    memmove(&in->children[i + 2], &in->children[i + 1], (in->n - i) * sizeof(void*)); \
+    in->keys[i] = key;                                                         \
+    in->children[i + 1] = child;                                               \
+    in->n++;                                                                   \
+  }                                                                            \
+                                                                               \
+  void name##_init(name##_t* t) {                                              \
+    memset(t, 0, sizeof(*t));                                                  \
+    _ibtree_slab_init(&t->leaves, sizeof(name##_leaf_t));                      \
+    _ibtree_slab_init(&t->inners, sizeof(name##_inner_t));                     \
+    t->first = (name##_leaf_t*) _ibtree_slab_alloc(&t->leaves);                \
+    t->root = t->first;                                                        \
+  }                                                                            \
+                                                                               \
+  void name##_destroy(name##_t* t) {                                           \
+    _ibtree_slab_destroy(&t->leaves);                                          \
+    _ibtree_slab_destroy(&t->inners);                                          \
+    t->root = t->first = NULL;                                                 \
+    t->count = 0;                                                              \
+  }                                                                            \
+                                                                               \
+  V* name##_find(const name##_t* t, K key) {                                   \
+    unsigned i;                                                                \
+    name##_leaf_t* leaf = _##name##_descend(t, key, NULL, NULL, &i);           \
+    if (i < leaf->n && !(less(key, leaf->keys[i])))                            \
+      return &leaf->values[i];                                                 \
+    return NULL;                                                               \
+  }                                                                            \
+                                                                               \
+  bool name##_insert(name##_t* t, K key, V value) {                            \
+                                                                               \
+    name##_inner_t* path[IBTREE_MAX_HEIGHT];                                   \
+    unsigned slots[IBTREE_MAX_HEIGHT];                                         \
+    unsigned i;                                                                \
+    name##_leaf_t* leaf = _##name##_descend(t, key, path, slots, &i);          \
+    if (i < leaf->n && !(less(key, leaf->keys[i]))) {                          \
+      leaf->values[i] = value;                                                 \
+      return false;                                                            \
+    }                                                                          \
+                                                                               \
+    t->count++;                                                                \
+    if (leaf->n < _##name##_SLOTS) {                                           \
+      _##name##_leaf_put(leaf, i, key, value);                                 \
+      return true;                                                             \
+    }                                                                          \
+                                                                               \
+    /* Split the leaf in halves, or leave it full when the key goes */         \
+    /* after all others */                                                     \
+    bool append = i == leaf->n;                                                \
+    for (unsigned h = 0; h < t->height; ++h)                                   \
+      append &= slots[h] == path[h]->n;                                        \
+    unsigned half = append ? _##name##_SLOTS : _##name##_SLOTS / 2;            \
+    name##_leaf_t* right = (name##_leaf_t*) _ibtree_slab_alloc(&t->leaves);    \
+    right->n = leaf->n - half;                                                 \
+    memcpy(right->keys, &leaf->keys[half], right->n * sizeof(K));              \
+    memcpy(right->values, &leaf->values[half], right->n * sizeof(V));          \
+    leaf->n = half;                                                            \
+    right->next = leaf->next;                                                  \
+    leaf->next = right;                                                        \
+    if (i < half || (i == half && !append))                                    \
+      _##name##_leaf_put(leaf, i, key, value);                                 \
+    else                                                                       \
+      _##name##_leaf_put(right, i - half, key, value);                         \
+                                                                               \
+    /* Separator and new node, which go to the parent */                       \
+    K sep = right->keys[0];                                                    \
+    void* child = right;                                                       \
+                                                                               \
+    for (unsigned h = t->height; h-- > 0;) {                                   \
+      name##_inner_t* in = path[h];                                            \
+      unsigned s = slots[h];                                                   \
+      if (in->n < _##name##_SLOTS) {                                           \
+        _##name##_inner_put(in, s, sep, child);                                \
+        return true;                                                           \
+      }                                                                        \
+                                                                               \
+      /* Full node with the new key, split around the middle key */            \
+      K keys[_##name##_SLOTS + 1];                                             \
+      void* children[_##name##_SLOTS + 2];                                     \
+      memcpy(keys, in->keys, s * sizeof(K));                                   \
+      keys[s] = sep;                                                           \
+      memcpy(&keys[s + 1], &in->keys[s], (in->n - s) * sizeof(K));             \
+      memcpy(children, in->children, (s + 1) * sizeof(void*));                 \
+      children[s + 1] = child;                                                 \
+      memcpy(&children[s + 2], &in->children[s + 1], (in->n - s) * sizeof(void*)); \
+                                                                               \
+      unsigned mid = append ? _##name##_SLOTS : _##name##_SLOTS / 2;           \
+      name##_inner_t* split = (name##_inner_t*) _ibtree_slab_alloc(&t->inners); \
+      in->n = mid;                                                             \
+      memcpy(in->keys, keys, mid * sizeof(K));                                 \
+      memcpy(in->children, children, (mid + 1) * sizeof(void*));               \
+      split->n = _##name##_SLOTS - mid;                                        \
+      memcpy(split->keys, &keys[mid + 1], split->n * sizeof(K));               \
+      memcpy(split->children, &children[mid + 1], (split->n + 1) * sizeof(void*)); \
+                                                                               \
+      sep = keys[mid];                                                         \
+      child = split;                                                           \
+    }                                                                          \
+                                                                               \
+    check$(t->height < IBTREE_MAX_HEIGHT, "Tree " #name " is too high");       \
+    name##_inner_t* root = (name##_inner_t*) _ibtree_slab_alloc(&t->inners);   \
+    root->n = 1;                                                               \
+    root->keys[0] = sep;                                                       \
+    root->children[0] = t->root;                                               \
+    root->children[1] = child;                                                 \
+    t->root = root;                                                            \
+    t->height++;                                                               \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  bool name##_erase(name##_t* t, K key) {                                      \
+    unsigned i;                                                                \
+    name##_leaf_t* leaf = _##name##_descend(t, key, NULL, NULL, &i);           \
+    if (i == leaf->n || less(key, leaf->keys[i]))                              \
+      return false;                                                            \
+    leaf->n--;                                                                 \
+    memmove(&leaf->keys[i], &leaf->keys[i + 1], (leaf->n - i) * sizeof(K));    \
+    memmove(&leaf->values[i], &leaf->values[i + 1], (leaf->n - i) * sizeof(V)); \
+    t->count--;                                                                \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  void name##_load(name##_t* t, K const* keys, V const* values) {              \
+                                                                               \
+    size_t n = ia_length(keys);                                                \
+    check$(ia_length(values) == n, "Should load as many values as keys");      \
+    for (size_t i = 1; i < n; ++i)                                             \
+      check$(less(keys[i - 1], keys[i]), "Keys to load should be sorted, without repeats"); \
+                                                                               \
+    name##_destroy(t);                                                         \
+    name##_init(t);                                                            \
+    t->count = n;                                                              \
+    if (!n)                                                                    \
+      return;                                                                  \
+                                                                               \
+    /* Nodes of the level being built, and their smallest keys */              \
+    size_t width = (n + _##name##_SLOTS - 1) / _##name##_SLOTS;                \
+    ia_arr$(void*) level = ia_new_array_of$(width, void*);                     \
+    ia_arr$(K) mins = ia_new_array_of$(width, K);                              \
+                                                                               \
+    name##_leaf_t* prev = NULL;                                                \
+    for (size_t j = 0; j < width; ++j) {                                       \
+      name##_leaf_t* leaf = j ? (name##_leaf_t*) _ibtree_slab_alloc(&t->leaves) : t->first; \
+      size_t from = j * _##name##_SLOTS;                                       \
+      leaf->n = (unsigned) (n - from < _##name##_SLOTS ? n - from : _##name##_SLOTS); \
+      memcpy(leaf->keys, &keys[from], leaf->n * sizeof(K));                    \
+      memcpy(leaf->values, &values[from], leaf->n * sizeof(V));                \
+      if (prev)                                                                \
+        prev->next = leaf;                                                     \
+      prev = leaf;                                                             \
+      level[j] = leaf;                                                         \
+      mins[j] = leaf->keys[0];                                                 \
+    }                                                                          \
+                                                                               \
+    while (width > 1) {                                                        \
+      size_t up = (width + _##name##_SLOTS) / (_##name##_SLOTS + 1);           \
+      for (size_t j = 0; j < up; ++j) {                                        \
+        name##_inner_t* in = (name##_inner_t*) _ibtree_slab_alloc(&t->inners); \
+        size_t from = j * (_##name##_SLOTS + 1);                               \
+        size_t to = from + _##name##_SLOTS + 1 < width ? from + _##name##_SLOTS + 1 : width; \
+        in->n = (unsigned) (to - from - 1);                                    \
+        for (size_t c = from; c < to; ++c) {                                   \
+          in->children[c - from] = level[c];                                   \
+          if (c > from)                                                        \
+            in->keys[c - from - 1] = mins[c];                                  \
+        }                                                                      \
+        level[j] = in;                                                         \
+        mins[j] = mins[from];                                                  \
+      }                                                                        \
+      width = up;                                                              \
+      t->height++;                                                             \
+    }                                                                          \
+                                                                               \
+    t->root = level[0];                                                        \
+    ia_destroy_array(level);                                                   \
+    ia_destroy_array(mins);                                                    \
+  }                                                                            \
+                                                                               \
+  size_t name##_memory(const name##_t* t) {                                    \
+    return _ibtree_slab_bytes(&t->leaves) + _ibtree_slab_bytes(&t->inners);    \
+  }                                                                            \
+                                                                               \
+  /* Go to the next leaf when keys of this one are over, and stop */           \
+  /* at the end of the range */                                                \
+  void _##name##_iter_settle(name##_iter_t* it) {                              \
+    while (it->leaf && it->i >= it->end) {                                     \
+      if (it->end < it->leaf->n) {                                             \
+        it->leaf = NULL;                                                       \
+        return;                                                                \
+      }                                                                        \
+      it->leaf = it->leaf->next;                                               \
+      it->i = 0;                                                               \
+      if (it->leaf)                                                            \
+        it->end = it->bounded ? _##name##_count_less(it->leaf->keys, it->leaf->n, it->to) : it->leaf->n; \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  name##_iter_t name##_begin(const name##_t* t) {                              \
+    name##_iter_t it = { .leaf = t->first, .end = t->first->n };               \
+    _##name##_iter_settle(&it);                                                \
+    return it;                                                                 \
+  }                                                                            \
+                                                                               \
+  name##_iter_t name##_lower_bound(const name##_t* t, K key) {                 \
+    name##_iter_t it = { .leaf = NULL };                                       \
+    it.leaf = _##name##_descend(t, key, NULL, NULL, &it.i);                    \
+    it.end = it.leaf->n;                                                       \
+    _##name##_iter_settle(&it);                                                \
+    return it;                                                                 \
+  }                                                                            \
+                                                                               \
+  name##_iter_t name##_range(const name##_t* t, K from, K to) {                \
+    name##_iter_t it = { .bounded = true, .to = to };                          \
+    it.leaf = _##name##_descend(t, from, NULL, NULL, &it.i);                   \
+    it.end = _##name##_count_less(it.leaf->keys, it.leaf->n, to);              \
+    _##name##_iter_settle(&it);                                                \
+    return it;                                                                 \
+  }
+
+#endif
@@ -0,0 +1,135 @@
+/**
+ * \file
+ * \brief String interning
+ *
+ * Pool keeps one copy of each distinct string, and gives the same
+ * pointer for equal strings, so interned strings are compared with
+ * `==` instead of `strcmp()`:
+ *
+ *   iintern_pool_t pool;
+ *   iintern_init(&pool, false);
+ *
+ *   const char* a = iintern_cstr(&pool, "identifier");
+ *   const char* b = iintern(&pool, buf, len);
+ *   if (a == b) ...
+ *
+ *   iintern_destroy(&pool);
+ *
+ * Strings are stored one after another in chunks of `IINTERN_CHUNK`
+ * bytes, which are never moved, so pointers stay valid until the pool is
+ * destroyed. Each string is `\0`-terminated and is preceded by its
+ * length, hash and id:
+ *
+ * ```
+ * ┌──────┬─────┬────┬───────────────┬────┬──────┬─────
+ * │ hash │ len │ id │ s t r i n g   │ \0 │ hash │ ...
+ * └──────┴─────┴────┴───────────────┴────┴──────┴─────
+ *                   ▲ pointer given to you
+ * ```
+ *
+ * Ids are numbers from zero, given in order of interning, so they may
+ * index arrays of per-string data.
+ *
+ * Strings are found through an open-addressing hash table of pointers.
+ * Pool created as concurrent may be used by many threads at once:
+ * lookups take no locks, and strings are added under a mutex. When the
+ * table grows, old one is kept until the pool is destroyed, as some
+ * thread may still be reading it.
+ */
+
+#ifndef ISTD_DS_INTERN
+#define ISTD_DS_INTERN
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// \brief Size of chunks of string storage. Longer strings get a chunk of their own.
+#define IINTERN_CHUNK (64 * 1024)
+
+//------ Internals -----------------------------------------------------------//
+
+/// \internal String in the pool, with its header
+typedef struct {
+  uint64_t hash;
+  uint32_t length;
+  uint32_t id;
+  char str[];
+} _iintern_entry_t;
+
+/// \internal Hash table, defined in `intern.c`
+typedef struct _iintern_table_t _iintern_table_t;
+
+/// \internal Chunk of string storage, defined in `intern.c`
+typedef struct _iintern_chunk_t _iintern_chunk_t;
+
+
+//------ Pool ----------------------------------------------------------------//
+
+/// \brief Pool of interned strings
+typedef struct {
+  /// Hash table, linked to previous ones, which are freed with the pool
+  _Atomic(_iintern_table_t*) table;
+  /// Chunk strings are added to, linked to previous ones
+  _iintern_chunk_t* chunk;
+  /// Number of strings
+  _Atomic size_t count;
+  bool concurrent;
+  pthread_mutex_t lock;
+} iintern_pool_t;
+
+/// \brief Memory used by a pool
+typedef struct {
+  /// Number of distinct strings
+  size_t strings;
+  /// Bytes of strings, with terminating `\0`
+  size_t string_bytes;
+  /// Bytes of all chunks, including headers of strings and unused space
+  size_t chunk_bytes;
+  /// Bytes of the hash table, and of tables kept after growing
+  size_t index_bytes;
+  /// Part of the hash table which is used
+  double load;
+} iintern_stats_t;
+
+
+/// \brief Create empty pool. Concurrent pool may be used by many threads.
+void iintern_init(iintern_pool_t* pool, bool concurrent);
+
+/// \brief Free all memory of the pool. Its strings become invalid.
+void iintern_destroy(iintern_pool_t* pool);
+
+/// \brief Interned copy of `len` bytes of `str`.
+///
+/// String may contain `\0` bytes, and does not have to be terminated.
+///
+const char* iintern(iintern_pool_t* pool, const char* str, size_t len);
+
+/// \brief Interned copy of `\0`-terminated string.
+const char* iintern_cstr(iintern_pool_t* pool, const char* str);
+
+/// \brief Interned string equal to `len` bytes of `str`, or `NULL`
+/// if there is none. Never adds a string, and never takes a lock.
+const char* iintern_find(const iintern_pool_t* pool, const char* str, size_t len);
+
+/// \brief Number of strings in the pool.
+size_t iintern_count(const iintern_pool_t* pool);
+
+/// \brief Memory used by the pool.
+iintern_stats_t iintern_stats(const iintern_pool_t* pool);
+
+
+/// \brief Length of interned string, in bytes.
+static inline size_t iintern_length(const char* interned) {
+  return ((const _iintern_entry_t*) (interned - offsetof(_iintern_entry_t, str)))->length;
+}
+
+/// \brief Id of interned string, unique within its pool.
+static inline uint32_t iintern_id(const char* interned) {
+  return ((const _iintern_entry_t*) (interned - offsetof(_iintern_entry_t, str)))->id;
+}
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * \file
+ * \brief Compressed arrays of integers
+ *
+ * Array of `uint32_t` or `uint64_t` values, cut into blocks of
+ * `IPACKED_BLOCK` values. Each block stores its values as offsets from
+ * a base, packed in as few bits as the largest offset needs:
+ *
+ *   Mode            | Base         | Offsets                  | Good for
+ *   ----------------|--------------|--------------------------|-----------------
+ *   `IPACKED_FOR`   | Least value  | Value minus base         | Small or clustered values
+ *   `IPACKED_DELTA` | First value  | Value minus value 4 back | Sorted values
+ *
+ * Offsets go to 4 lanes in turn, and each lane is packed into its own
+ * bits of consecutive words, so 4 offsets are unpacked with a few shifts
+ * of one SSE vector:
+ *
+ * ```
+ *  offsets  o0 o1 o2 o3 o4 o5 o6 o7 ...
+ *
+ *  words    ┌──────────┬──────────┬──────────┬──────────┐
+ *           │ .. o4 o0 │ .. o5 o1 │ .. o6 o2 │ .. o7 o3 │  ...
+ *           └──────────┴──────────┴──────────┴──────────┘
+ *              lane 0     lane 1     lane 2     lane 3
+ * ```
+ *
+ * For the same reason deltas are taken 4 values back, and are summed up
+ * by adding whole vectors. Blocks of `uint64_t` values whose offsets do
+ * not fit in 32 bits are stored as they are.
+ *
+ *   ia_arr$(uint32_t) ids = ...;       // sorted
+ *   ipacked_t p;
+ *   ipacked_encode_u32(&p, ids, IPACKED_DELTA);
+ *
+ *   uint64_t id = ipacked_get(&p, 1000);
+ *   ia_arr$(uint32_t) copy = ipacked_to_u32(&p);
+ *
+ *   ipacked_destroy(&p);
+ *
+ * Unpacking and packing are done with SSE when the CPU has it (see
+ * `istd/util/cpu.h`), and with plain loops otherwise.
+ */
+
+#ifndef ISTD_DS_PACKED
+#define ISTD_DS_PACKED
+
+#include "istd/ds/arr.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/// \brief Number of values in a block
+#define IPACKED_BLOCK 128
+
+/// \brief How values of a block are turned into offsets
+typedef enum {
+  IPACKED_FOR,
+  IPACKED_DELTA,
+} ipacked_mode_t;
+
+/// \brief Where a block is, and how to unpack it
+typedef struct {
+  /// Value offsets are taken from
+  uint64_t base;
+  /// First word of the block in `words`
+  uint32_t offset;
+  /// Bits of each offset, `0` to `32`, or `64` for values stored as they are
+  uint32_t bits;
+} ipacked_block_t;
+
+/// \brief Compressed array
+typedef struct {
+  ia_arr$(ipacked_block_t) blocks;
+  /// Packed offsets of all blocks, aligned to `IA_CACHE_LINE`
+  ia_arr$(uint32_t) words;
+  size_t length;
+  /// Bytes of each value, `4` or `8`
+  uint32_t width;
+  ipacked_mode_t mode;
+} ipacked_t;
+
+
+/// \brief Compress all values of `arr` into `p`.
+void ipacked_encode_u32(ipacked_t* p, const uint32_t* arr, ipacked_mode_t mode);
+
+/// \brief Compress all values of `arr` into `p`.
+void ipacked_encode_u64(ipacked_t* p, const uint64_t* arr, ipacked_mode_t mode);
+
+/// \brief Free memory of the compressed array.
+void ipacked_destroy(ipacked_t* p);
+
+/// \brief Number of values.
+static inline size_t ipacked_length(const ipacked_t* p) {
+  return p->length;
+}
+
+/// \brief Number of blocks.
+static inline size_t ipacked_blocks(const ipacked_t* p) {
+  return ia_length(p->blocks);
+}
+
+/// \brief Bytes taken by the compressed array, to compare with `length * width`.
+size_t ipacked_bytes(const ipacked_t* p);
+
+
+/// \brief Value at index `i`, unpacked on its own.
+///
+/// Costs a few shifts in `IPACKED_FOR` mode, and up to 32 of them in
+/// `IPACKED_DELTA` mode; use `ipacked_block_u32()` or
+/// `ipacked_block_u64()` to read many values near each other.
+///
+uint64_t ipacked_get(const ipacked_t* p, size_t i);
+
+/// \brief Unpack block `b` of `uint32_t` values into `out`.
+///
+/// `out` has room for `IPACKED_BLOCK` values. Returns number of values
+/// in the block, which is less than `IPACKED_BLOCK` only for the last one.
+///
+size_t ipacked_block_u32(const ipacked_t* p, size_t b, uint32_t* out);
+
+/// \brief Unpack block `b` of `uint64_t` values into `out`.
+size_t ipacked_block_u64(const ipacked_t* p, size_t b, uint64_t* out);
+
+/// \brief Unpack all `uint32_t` values into a new array.
+ia_arr$(uint32_t) ipacked_to_u32(const ipacked_t* p);
+
+/// \brief Unpack all `uint64_t` values into a new array.
+ia_arr$(uint64_t) ipacked_to_u64(const ipacked_t* p);
+
+/// \brief Sum of all values, wrapping around as `uint64_t` does.
+uint64_t ipacked_sum(const ipacked_t* p);
+
+#endif
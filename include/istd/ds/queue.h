@@ -0,0 +1,145 @@
+/**
+ * \file
+ * \brief Bounded queue for many producers and many consumers
+ *
+ * Queue has a fixed number of cells, and moves items of fixed size
+ * between threads without locks. It is a ring of cells, each with a
+ * sequence number telling whether the cell is free or full on current
+ * lap around the ring (Vyukov's bounded MPMC queue):
+ *
+ * ```
+ *              tail (pop)       head (push)
+ *                  ▼                 ▼
+ *  ┌─────┬─────┬─────┬─────┬─────┬─────┬─────┬─────┐
+ *  │ 8   │ 9   │ 3 ▪ │ 4 ▪ │ 5 ▪ │ 5   │ 6   │ 7   │  sequence, ▪ full
+ *  └─────┴─────┴─────┴─────┴─────┴─────┴─────┴─────┘
+ * ```
+ *
+ * Producer owns the cell at `head` when its sequence equals `head`, and
+ * takes it by moving `head` with compare-and-swap; consumer does the
+ * same with `tail`, when sequence is `tail + 1`. Threads contend only on
+ * these cursors, which live on cache lines of their own.
+ *
+ *   iqueue_t q;
+ *   iqueue_init_for$(&q, 1024, job_t);
+ *
+ *   // Producers
+ *   iqueue_push(&q, &job);
+ *   ...
+ *   iqueue_close(&q);
+ *
+ *   // Consumers
+ *   job_t job;
+ *   while (iqueue_pop(&q, &job))
+ *     run(&job);
+ *
+ *   iqueue_destroy(&q);
+ *
+ * `iqueue_try_*()` never wait. `iqueue_push()` and `iqueue_pop()` spin
+ * for a moment, and then sleep on a futex until the other side makes
+ * room or brings an item. Batches move up to a given number of items
+ * with one compare-and-swap.
+ */
+
+#ifndef ISTD_DS_QUEUE
+#define ISTD_DS_QUEUE
+
+#include "istd/ds/arr.h"
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// \brief Queue of items of fixed size
+typedef struct {
+  /// Cells, `stride` bytes each: sequence number, and then the item
+  ia_arr$(char) cells;
+  size_t mask, item_size, stride;
+
+  /// Position of next push
+  alignas(IA_CACHE_LINE) _Atomic size_t head;
+  /// Position of next pop
+  alignas(IA_CACHE_LINE) _Atomic size_t tail;
+
+  /// Futex words, changed when items are pushed or popped while someone sleeps
+  alignas(IA_CACHE_LINE) _Atomic uint32_t pushed, popped;
+  /// Number of threads which may sleep in `iqueue_pop()` and `iqueue_push()`,
+  /// and were not woken yet
+  _Atomic uint32_t pop_sleepers, push_sleepers;
+  _Atomic bool closed;
+} iqueue_t;
+
+
+/// \brief Create a queue for `capacity` items of `item_size` bytes.
+///
+/// Capacity is rounded up to a power of two, and is at least `2`.
+///
+void iqueue_init(iqueue_t* q, size_t capacity, size_t item_size);
+
+/// \brief Create a queue for `capacity` items of given `type`.
+#define iqueue_init_for$(q, capacity, type) iqueue_init((q), (capacity), sizeof(type))
+
+/// \brief Free memory of the queue. No thread may use it any more.
+void iqueue_destroy(iqueue_t* q);
+
+/// \brief Number of items the queue may hold.
+static inline size_t iqueue_capacity(const iqueue_t* q) {
+  return q->mask + 1;
+}
+
+/// \brief Number of items in the queue, which may be out of date at once.
+size_t iqueue_length(iqueue_t* q);
+
+
+/// \brief Copy item into the queue. Returns `false` if the queue is full.
+bool iqueue_try_push(iqueue_t* q, const void* item);
+
+/// \brief Copy item out of the queue. Returns `false` if the queue is empty.
+bool iqueue_try_pop(iqueue_t* q, void* item);
+
+/// \brief Push first items of `n` given ones, as many as there is room for.
+///
+/// Items are taken in order, and stay together in the queue. Returns
+/// number of pushed items, `0` if the queue is full.
+///
+size_t iqueue_try_push_many(iqueue_t* q, const void* items, size_t n);
+
+/// \brief Pop up to `max` items into `items`. Returns their number.
+size_t iqueue_try_pop_many(iqueue_t* q, void* items, size_t max);
+
+
+/// \brief Push item, waiting while the queue is full.
+///
+/// Returns `false` without pushing if the queue is closed.
+///
+bool iqueue_push(iqueue_t* q, const void* item);
+
+/// \brief Pop item, waiting while the queue is empty.
+///
+/// Returns `false` when the queue is closed and has no items left.
+///
+bool iqueue_pop(iqueue_t* q, void* item);
+
+/// \brief Push all `n` items, waiting for room as needed.
+///
+/// Returns number of pushed items, which is less than `n` only if the
+/// queue is closed.
+///
+size_t iqueue_push_many(iqueue_t* q, const void* items, size_t n);
+
+/// \brief Pop at least one item, up to `max`, waiting while the queue is empty.
+///
+/// Returns `0` when the queue is closed and has no items left.
+///
+size_t iqueue_pop_many(iqueue_t* q, void* items, size_t max);
+
+/// \brief Tell consumers no more items will come, and wake everyone who waits.
+///
+/// Items which are already in the queue may still be popped. Call it
+/// once producers are done: items pushed while the queue is being closed
+/// may be left in it.
+///
+void iqueue_close(iqueue_t* q);
+
+#endif
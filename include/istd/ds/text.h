@@ -0,0 +1,178 @@
+/**
+ * \file
+ * \brief Editable text containers: gap buffer and rope
+ *
+ * Inserting into the middle of `ia_arr$(char)` moves the whole tail of
+ * the text. This header has two containers which avoid that:
+ *
+ *  - **Gap buffer**, for small texts edited around one cursor. It is
+ *    one buffer with a hole at the cursor:
+ *
+ *    ```
+ *    ┌───────────────┬─────────────────┬──────────────┐
+ *    │ text before   │       gap       │ text after   │
+ *    └───────────────┴─────────────────┴──────────────┘
+ *                    ▲ cursor
+ *    ```
+ *
+ *    Typing fills the gap, deleting widens it, and moving the cursor
+ *    moves text from one side of the gap to the other.
+ *
+ *  - **Rope**, for large documents. Text is split into chunks of up to
+ *    `ITEXT_CHUNK` bytes, stored in a balanced tree (a treap) in order.
+ *    Every node caches number of bytes, codepoints and newlines in its
+ *    subtree, so edits, and seeks by codepoint or by line, are `O(log n)`.
+ *
+ * All positions are byte offsets, and must be on codepoint boundaries.
+ * Codepoints are never split between chunks or around the gap, so
+ * `utf8_next()`/`utf8_prev()` are used to walk the text.
+ */
+
+#ifndef ISTD_DS_TEXT
+#define ISTD_DS_TEXT
+
+#include "istd/ds/arr.h"
+#include "istd/util/utf8.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//------ Gap buffer ----------------------------------------------------------//
+
+/// \brief Gap buffer
+typedef struct {
+
+  /// Buffer with text and the gap, `capacity + 1` bytes long.
+  /// Last byte is always `\0`.
+  char* data;
+
+  /// Size of the buffer, including the gap
+  size_t capacity;
+
+  /// Gap occupies bytes `[gap_begin, gap_end)`. Cursor is at `gap_begin`.
+  size_t gap_begin, gap_end;
+
+} itext_gap_t;
+
+
+/// \brief Create gap buffer with copy of given text, and cursor at the end.
+void itext_gap_init(itext_gap_t* gap, const char* str, size_t len);
+
+/// \brief Free memory of the gap buffer.
+void itext_gap_destroy(itext_gap_t* gap);
+
+/// \brief Length of the text, in bytes.
+size_t itext_gap_length(const itext_gap_t* gap);
+
+/// \brief Byte offset of the cursor.
+size_t itext_gap_cursor(const itext_gap_t* gap);
+
+/// \brief Move cursor to given byte offset.
+void itext_gap_seek(itext_gap_t* gap, size_t pos);
+
+/**
+ * \brief Move cursor one codepoint forward.
+ *
+ * Codepoint passed over is stored in `cp`, if it is not `NULL`.
+ * Invalid UTF8 is passed one byte at a time, with that byte as `cp`.
+ *
+ * \returns `false` if cursor is at the end of the text
+ */
+bool itext_gap_forward(itext_gap_t* gap, rune* cp);
+
+/// \brief Move cursor one codepoint backward. Same as `itext_gap_forward()`.
+bool itext_gap_backward(itext_gap_t* gap, rune* cp);
+
+/// \brief Insert text at the cursor, and move cursor after it.
+void itext_gap_insert(itext_gap_t* gap, const char* str, size_t len);
+
+/// \brief Erase up to `n` codepoints before the cursor, like backspace does.
+/// \returns Number of codepoints erased
+size_t itext_gap_erase_backward(itext_gap_t* gap, size_t n);
+
+/// \brief Erase up to `n` codepoints after the cursor, like delete does.
+/// \returns Number of codepoints erased
+size_t itext_gap_erase_forward(itext_gap_t* gap, size_t n);
+
+/// \brief Append the whole text to `*out`.
+void itext_gap_copy(const itext_gap_t* gap, ia_arr$(char)* out);
+
+
+//------ Rope ----------------------------------------------------------------//
+
+/// \brief Maximal number of bytes in one rope chunk.
+#define ITEXT_CHUNK 512
+
+/// \brief Counts cached in rope nodes
+typedef struct {
+  size_t bytes;
+  size_t codepoints;
+  size_t newlines;
+} itext_counts_t;
+
+/// \internal Node of the rope, defined in `text.c`
+typedef struct itext_node_t itext_node_t;
+
+/// \brief Rope
+typedef struct {
+  itext_node_t* root;
+  /// State of random generator for node priorities
+  uint64_t seed;
+} itext_rope_t;
+
+
+/// \brief Create rope with copy of given text.
+void itext_rope_init(itext_rope_t* rope, const char* str, size_t len);
+
+/// \brief Free all memory of the rope.
+void itext_rope_destroy(itext_rope_t* rope);
+
+/// \brief Number of bytes, codepoints and newlines in the whole rope.
+itext_counts_t itext_rope_counts(const itext_rope_t* rope);
+
+/**
+ * \brief Number of bytes, codepoints and newlines before byte `pos`.
+ *
+ * `codepoints` is then index of codepoint at `pos`, and `newlines` is
+ * index of the line containing it (counting from zero).
+ */
+itext_counts_t itext_rope_counts_before(const itext_rope_t* rope, size_t pos);
+
+/// \brief Insert `len` bytes of `str` at byte offset `pos`.
+void itext_rope_insert(itext_rope_t* rope, size_t pos, const char* str, size_t len);
+
+/// \brief Delete `len` bytes starting from byte offset `pos`.
+void itext_rope_delete(itext_rope_t* rope, size_t pos, size_t len);
+
+/**
+ * \brief Byte offset of `cp`-th codepoint.
+ *
+ * Number of codepoints gives length of the text,
+ * larger values are an error, and will panic.
+ */
+size_t itext_rope_byte_of_codepoint(const itext_rope_t* rope, size_t cp);
+
+/**
+ * \brief Byte offset of the beginning of `line`-th line (from zero).
+ *
+ * Number of newlines gives the beginning of the last line,
+ * larger values are an error, and will panic.
+ */
+size_t itext_rope_byte_of_line(const itext_rope_t* rope, size_t line);
+
+/**
+ * \brief Decode codepoint at `pos`, and return position after it.
+ *
+ * At the end of the text `cp` is set to `0` and `pos` is returned,
+ * just like `utf8_next()` does. Invalid UTF8 is passed one byte at a time.
+ */
+size_t itext_rope_next(const itext_rope_t* rope, size_t pos, rune* cp);
+
+/// \brief Decode codepoint before `pos`, and return its position.
+/// At the beginning of the text `cp` is set to `0` and `0` is returned.
+size_t itext_rope_prev(const itext_rope_t* rope, size_t pos, rune* cp);
+
+/// \brief Append `len` bytes of the text starting from `pos` to `*out`.
+void itext_rope_copy(const itext_rope_t* rope, size_t pos, size_t len, ia_arr$(char)* out);
+
+#endif
@@ -0,0 +1,74 @@
+/**
+ * \file
+ * \brief Many files read into arrays at once
+ *
+ * Reading each of thousands of small files costs `open()`, `read()` and
+ * `close()`, a round trip to the kernel each, and the disk is asked for
+ * one file at a time. Loader asks for many at once instead:
+ *
+ *   const char* paths[] = { "app.conf", "themes/dark.conf", "ui/main.layout" };
+ *   iloader_file_t files[3];
+ *   iloader_load(paths, 3, files, ILOADER_AUTO);
+ *   for (size_t i = 0; i < 3; ++i)
+ *     if (files[i].error)
+ *       ilog_warn$("Cannot read %s: %s", paths[i], strerror(files[i].error));
+ *   ...
+ *   iloader_release(files, 3);
+ *
+ * With io_uring, opens, reads and closes of up to `ILOADER_BATCH` files
+ * are queued, and handed to the kernel together with one system call,
+ * which also waits for the ones done before, so the disk is asked for
+ * many files at once. Each file is read straight into its array,
+ * allocated once the open file is sized. The ring is set up for each
+ * call, so it pays off for many files at once, not for one.
+ *
+ * When the kernel has no io_uring, or does not allow it, files are read
+ * by a few threads with `pread()`, each taking the next file in turn.
+ */
+
+#ifndef ISTD_IO_LOADER
+#define ISTD_IO_LOADER
+
+#include "istd/ds/arr.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/// \brief Number of files opened and read at once with io_uring
+#define ILOADER_BATCH 64
+
+/// \brief Largest number of threads reading files when there is no io_uring
+#define ILOADER_MAX_THREADS 8
+
+/// \brief Way files are read
+typedef enum {
+  /// io_uring when the kernel has it, and threads otherwise
+  ILOADER_AUTO,
+  /// Same as `ILOADER_AUTO`, but never falls back to threads
+  ILOADER_URING,
+  ILOADER_THREADS,
+} iloader_way_t;
+
+/// \brief Contents of a loaded file
+typedef struct {
+  /// Bytes of the file, followed by `\0` as in all ia arrays, with
+  /// exactly the room for them. `NULL` if the file was not read.
+  ia_arr$(char) data;
+  /// `errno` of the failure to read the file, or 0
+  int error;
+} iloader_file_t;
+
+/// \brief Read `count` files at `paths` into `files`.
+///
+/// Each file is read to the size it had when it was opened. Files which
+/// cannot be read get their `errno` in `error`, and others are read
+/// anyway.
+///
+/// Returns `false`, with `errno` set and no files read, only when
+/// `ILOADER_URING` was asked for and io_uring cannot be used.
+///
+bool iloader_load(const char* const* paths, size_t count, iloader_file_t* files, iloader_way_t way);
+
+/// \brief Destroy arrays of `count` loaded `files`.
+void iloader_release(iloader_file_t* files, size_t count);
+
+#endif
@@ -0,0 +1,111 @@
+/**
+ * \file
+ * \brief Files mapped into memory, read record by record
+ *
+ * File is mapped read-only, so its bytes are read straight from page
+ * cache, without copying them into buffers. Kernel is told the file is
+ * read from start to end, so it reads ahead far, and may drop pages
+ * which were read.
+ *
+ * Records are spans of the file between separators, such as lines.
+ * They point into the mapping, and stay valid until the file is closed:
+ *
+ *   imapfile_t f;
+ *   if (!imapfile_open(&f, "app.log"))
+ *     panic$("Cannot open log: %s", strerror(errno));
+ *
+ *   imapfile_span_t line;
+ *   for (imapfile_iter_t it = imapfile_lines(&f, true); imapfile_next(&it, &line);)
+ *     parse(line.ptr, line.len);
+ *
+ *   imapfile_close(&f);
+ *
+ * Separators are found 64 bytes at a time with vector compares (see
+ * `istd/util/cpu.h`), into a mask of their positions. Each record then
+ * costs one count of trailing zeros, instead of a call to `memchr()`.
+ *
+ * Iterator may check that each record is valid UTF8 with
+ * `utf8_valid()`, and skip the ones which are not.
+ */
+
+#ifndef ISTD_IO_MAPFILE
+#define ISTD_IO_MAPFILE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// \brief File mapped into memory
+typedef struct {
+  /// Bytes of the file, which are not `\0`-terminated
+  const char* data;
+  size_t size;
+} imapfile_t;
+
+/// \brief Map file at `path` for reading.
+///
+/// Returns `false` and leaves `errno` set, if the file cannot be opened
+/// or mapped. Empty file is opened, with no bytes.
+///
+bool imapfile_open(imapfile_t* f, const char* path);
+
+/// \brief Unmap the file. Its records are not valid any more.
+void imapfile_close(imapfile_t* f);
+
+
+/// \brief Bytes of a record, without its separator
+typedef struct {
+  const char* ptr;
+  size_t len;
+} imapfile_span_t;
+
+/// \brief Position in records of some bytes
+typedef struct {
+  /// Beginning of next record
+  const char* begin;
+  /// Block of up to 64 bytes, whose separators are in `mask`
+  const char* block;
+  const char* end;
+  /// Bits of separators in `block` after `begin`
+  uint64_t mask;
+  char sep;
+  bool check_utf8;
+  /// Number of records skipped, because they were not valid UTF8
+  size_t invalid;
+} imapfile_iter_t;
+
+
+/// \brief Go over records of `size` bytes of `data`, separated by `sep`.
+///
+/// Bytes after last separator make a record, if there are any. With
+/// `check_utf8`, only records of valid UTF8 are given.
+///
+/// Bytes do not have to come from a mapped file.
+///
+imapfile_iter_t imapfile_records(const char* data, size_t size, char sep, bool check_utf8);
+
+/// \brief Go over lines of the file, separated by `\n`.
+///
+/// Lines keep `\r` of `\r\n` line ends.
+///
+static inline imapfile_iter_t imapfile_lines(const imapfile_t* f, bool check_utf8) {
+  return imapfile_records(f->data, f->size, '\n', check_utf8);
+}
+
+/// \internal Find next record, when it is not in `mask` already, or has to be checked
+bool _imapfile_next_slow(imapfile_iter_t* it, imapfile_span_t* span);
+
+/// \brief Put next record into `span`. Returns `false` when there are no more records.
+static inline bool imapfile_next(imapfile_iter_t* it, imapfile_span_t* span) {
+  if (!it->mask || it->check_utf8)
+    return _imapfile_next_slow(it, span);
+
+  const char* sep = it->block + __builtin_ctzll(it->mask);
+  it->mask &= it->mask - 1;
+  span->ptr = it->begin;
+  span->len = (size_t) (sep - it->begin);
+  it->begin = sep + 1;
+  return true;
+}
+
+#endif
@@ -0,0 +1,67 @@
+/**
+ * \file
+ * \brief Allocation entry points of the library.
+ *
+ * All memory istd allocates for itself (arrays, `calloc_checked$()`,
+ * containers) goes through these functions, and should be freed with
+ * `istd_free()`. They are thin wrappers around `malloc()` and friends,
+ * or, when built with `ISTD_ALLOC_POOL` (meson option `pool`), around the
+ * thread-caching allocator of `istd/util/pool.h`. Wrappers also allow
+ * to count allocations:
+ *
+ * When `ISTD_ALLOC_STATS` is defined (it is, in test builds), every call
+ * updates counters returned by `istd_alloc_stats()`. The test runner
+ * uses them to report leaks of each test case, and to check allocation
+ * budgets with `itest_check_allocs_le$()`.
+ */
+
+#ifndef ISTD_UTIL_ALLOC
+#define ISTD_UTIL_ALLOC
+
+#include <stddef.h>
+
+#if defined(TEST) && !defined(ISTD_ALLOC_STATS)
+#define ISTD_ALLOC_STATS
+#endif
+
+/// \brief Same as `malloc()`.
+void* istd_malloc(size_t size);
+
+/// \brief Same as `calloc()`.
+void* istd_calloc(size_t num, size_t size);
+
+/// \brief Same as `realloc()`.
+void* istd_realloc(void* ptr, size_t size);
+
+/// \brief Same as `free()`, for memory from functions above.
+void istd_free(void* ptr);
+
+
+/// \brief Allocation counters
+///
+/// Sizes are in bytes actually taken from the allocator, which
+/// may be more than requested. Reallocation counts as one free
+/// and one allocation.
+///
+typedef struct {
+  /// Number of allocations
+  size_t allocs;
+  /// Number of frees
+  size_t frees;
+  /// Number of bytes allocated, in total
+  size_t bytes;
+  /// Number of blocks not freed yet
+  size_t live_blocks;
+  /// Number of bytes not freed yet
+  size_t live_bytes;
+  /// Largest `live_bytes` since last `istd_alloc_reset_peak()`
+  size_t peak_bytes;
+} istd_alloc_stats_t;
+
+/// \brief Current counters. All are zero without `ISTD_ALLOC_STATS`.
+istd_alloc_stats_t istd_alloc_stats(void);
+
+/// \brief Start tracking peak memory from current `live_bytes`.
+void istd_alloc_reset_peak(void);
+
+#endif
@@ -0,0 +1,157 @@
+/**
+ * \file
+ * \brief Microbenchmarks, a sibling of `istd/util/test.h`.
+ *
+ * Benchmarks are grouped into sections, registered just like test
+ * sections, and are selected by tags on the command line of the
+ * `benches` executable:
+ *
+ *   ibench_section$("default, arr", "Array benchmarks") {
+ *
+ *     ia_arr$(int) arr = ia_new_empty_array$(int);
+ *
+ *     ibench_case$("Push") {
+ *       ia_push$(&arr, 42);
+ *     }
+ *
+ *     ia_destroy_array(arr);
+ *   }
+ *
+ * Code before the case runs once, body of the case is run many times.
+ * Each case is run in three steps:
+ *
+ *  - Warmup and calibration: case is run in batches, and batch size is
+ *    adjusted until one batch takes `IBENCH_BATCH_NS`, and at least
+ *    `IBENCH_WARMUP_NS` have passed.
+ *  - Sampling: `IBENCH_SAMPLES` batches are timed, each giving time
+ *    (and cycles) of one iteration.
+ *  - Report: median, 99th percentile and median absolute deviation of
+ *    the samples are printed.
+ *
+ * Results may be written as JSON (`--json=FILE`), or saved as a named
+ * baseline (`--save=NAME`). Run with `--compare=NAME` compares every case
+ * with the baseline using Mann–Whitney U test, and when some case became
+ * slower by more than `--threshold` (`IBENCH_THRESHOLD` by default) with
+ * significance `IBENCH_ALPHA`, the runner exits with non-zero status.
+ *
+ * Cycles are read from the hardware counter via `perf_event_open()`, or
+ * from the time stamp counter when that is not permitted.
+ */
+
+#ifndef ISTD_UTIL_BENCH
+#define ISTD_UTIL_BENCH
+
+#include "istd/util/macro.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+//==== Settings, may be redefined when building the runner
+
+#ifndef IBENCH_WARMUP_NS
+/// Minimal time of warmup, nanoseconds
+#define IBENCH_WARMUP_NS 50000000ull
+#endif
+
+#ifndef IBENCH_BATCH_NS
+/// Time of one sampled batch, nanoseconds
+#define IBENCH_BATCH_NS 1000000ull
+#endif
+
+#ifndef IBENCH_SAMPLES
+/// Number of sampled batches
+#define IBENCH_SAMPLES 100
+#endif
+
+#ifndef IBENCH_THRESHOLD
+/// Relative slowdown of median which counts as a regression
+#define IBENCH_THRESHOLD 0.05
+#endif
+
+#ifndef IBENCH_ALPHA
+/// Significance level of comparison with a baseline
+#define IBENCH_ALPHA 0.01
+#endif
+
+//==== Internals, used by macros
+
+/// State checked on every iteration
+typedef struct {
+  /// Iterations left in current batch
+  size_t left;
+} _ibench_state_t;
+
+extern _ibench_state_t _ibench_state;
+
+/// Registers given function in list of all benchmarks to be run.
+///
+void _ibench_register_function(
+    const char* id,
+    const char* name,
+    void(*fn)(void)
+  );
+
+/// Begins given benchmark case.
+///
+void _ibench_begin_case(const char* name);
+
+/// Ends a batch and starts the next one.
+/// Returns `false` when the case is done.
+///
+bool _ibench_next_batch(void);
+
+
+//==== Macros themselves
+
+// Same as `_itest_section_internal$()`
+#define _ibench_section_internal$(id, name, bench_fn, user_fn)                 \
+  static void user_fn (void);                                                  \
+  __attribute__((constructor)) static void bench_fn (void) {                   \
+    _ibench_register_function((id), (name), &user_fn);                         \
+  }                                                                            \
+                                                                               \
+  static void user_fn (void)
+
+
+/// \brief A benchmark section.
+///
+/// Registered and selected by tags just like `itest_section$()`.
+///
+#define ibench_section$(id, name)                                              \
+    _ibench_section_internal$(                                                 \
+        id, name,                                                              \
+        im_concat$(_ibench_section_init__, __COUNTER__),                       \
+        im_concat$(_ibench_section__, __COUNTER__)                             \
+    )
+
+
+/// \brief A benchmark case.
+///
+/// Its body is the code being measured, and is run as many times as
+/// the runner wants. Only a decrement and a comparison are added to
+/// each iteration, time is taken once per batch.
+///
+/// Do not `break` or `return` out of the case, results will be lost.
+///
+#define ibench_case$(name)                                                     \
+    for (_ibench_begin_case(name);                                             \
+         _ibench_state.left-- > 0 || _ibench_next_batch(); )
+
+
+/// \brief Make compiler think `value` is used.
+///
+/// Result of the code being measured, when not used, may be thrown away
+/// together with the code. Passing it here prevents that.
+///
+#define ibench_do_not_optimize$(value) do {                                    \
+    __typeof__(value) _ibench_value = (value);                                 \
+    __asm__ volatile("" : : "r"(&_ibench_value) : "memory");                   \
+  } while(0)
+
+/// \brief Make compiler think all memory was read and written.
+///
+/// Prevents stores from being thrown away, or loads from being
+/// moved out of the loop.
+///
+#define ibench_clobber$() __asm__ volatile("" : : : "memory")
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * \file
+ * \brief Stackless coroutines
+ *
+ * A coroutine is a function which may return in the middle, and be
+ * called again to continue from there. Place where to continue is kept
+ * in `icoro_t`, and everything else which must survive between calls is
+ * kept in a frame: a struct of your own, which may be allocated anywhere
+ * (on the heap, in an arena, in an array of frames). Local variables of
+ * the function do not survive a yield.
+ *
+ *   typedef struct {
+ *     icoro_t co;
+ *     int i;
+ *   } counter_t;
+ *
+ *   void count(counter_t* f, int* out) {
+ *     icoro$(&f->co) {
+ *       for (f->i = 0; f->i < 3; ++f->i) {
+ *         *out = f->i;
+ *         icoro_yield$(&f->co);
+ *       }
+ *     }
+ *   }
+ *
+ *   counter_t f = { .co = ICORO_INIT };
+ *   while (count(&f, &x), !icoro_done(&f.co))
+ *     printf("%d\n", x);      // 0, 1, 2
+ *
+ * Resume points are `case` labels of a `switch` around the body (this is
+ * Duff's device), so a resume costs a call and a jump. For the same
+ * reason yields must not be placed inside `switch` statements of the
+ * body, and coroutine functions return `void`.
+ *
+ * `istd/util/loop.h` runs coroutines as tasks waiting for I/O and timers.
+ */
+
+#ifndef ISTD_UTIL_CORO
+#define ISTD_UTIL_CORO
+
+#include <stdbool.h>
+
+/// \brief State of a coroutine
+typedef struct {
+  /// Resume point, `0` before start, `-1` after the end
+  int line;
+} icoro_t;
+
+/// \brief Initializer of coroutine which has not started yet
+#define ICORO_INIT { 0 }
+
+/// \brief Make coroutine start from the beginning on next call.
+static inline void icoro_init(icoro_t* co) {
+  co->line = 0;
+}
+
+/// \brief Check if coroutine has reached its end.
+static inline bool icoro_done(const icoro_t* co) {
+  return co->line < 0;
+}
+
+
+/// \brief Body of a coroutine
+///
+/// Runs the body from the beginning, or from the last yield. When the
+/// body ends, coroutine is done, and next calls skip the body.
+///
+#define icoro$(co)                                                             \
+  switch ((co)->line)                                                          \
+    case 0:                                                                    \
+      for (int _icoro_once = 1; _icoro_once; _icoro_once = 0, (co)->line = -1)
+
+
+/// \internal Yield with resume point `n`
+#define _icoro_yield_at$(co, n) do {                                           \
+    (co)->line = (n);                                                          \
+    return;                                                                    \
+    case (n):;                                                                 \
+  } while (0)
+
+/// \brief Return from the coroutine, and continue after this on next call.
+#define icoro_yield$(co) _icoro_yield_at$(co, __COUNTER__ + 1)
+
+/// \brief Yield until `cond` is true. Checked on each call.
+#define icoro_await$(co, cond)                                                 \
+  while (!(cond))                                                              \
+    icoro_yield$(co)
+
+/// \brief End the coroutine early.
+#define icoro_return$(co) do {                                                 \
+    (co)->line = -1;                                                           \
+    return;                                                                    \
+  } while (0)
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * \file
+ * \brief CPU feature detection and dispatch of vectorized code
+ *
+ * Features are read once with CPUID, and checked against what the OS
+ * saves on context switches (XGETBV), so AVX is not used where its
+ * registers would be lost. Features are grouped into levels, each one
+ * including the ones below:
+ *
+ *   Level           | Instructions
+ *   ----------------|---------------------------------------------------
+ *   `ICPU_SCALAR`   | Baseline of the target, no dispatched vector code
+ *   `ICPU_SSE42`    | SSSE3, SSE4.1, SSE4.2, POPCNT
+ *   `ICPU_AVX2`     | AVX, AVX2, FMA, BMI1, BMI2
+ *   `ICPU_AVX512`   | AVX-512 F, BW, VL, DQ
+ *
+ * A function with versions for several levels is declared with
+ * `icpu_dispatch$()`. It becomes a pointer to the best version for
+ * current level, so a call costs one indirect jump:
+ *
+ *   static size_t count_scalar(const char* s, size_t n) { ... }
+ *   ICPU_TARGET_AVX2 static size_t count_avx2(const char* s, size_t n) { ... }
+ *
+ *   icpu_dispatch$(count, size_t, (const char* s, size_t n),
+ *                  count_scalar, NULL, icpu_x86$(count_avx2), NULL)
+ *
+ *   size_t n = count(str, len);
+ *
+ * Level may be lowered with `ISTD_CPU` environment variable, set to
+ * `scalar`, `sse4.2`, `avx2` or `avx512`, or with `icpu_set_level()`.
+ * Test runner uses that to run sections tagged `simd` under every level
+ * the machine supports, so fallbacks are tested too.
+ */
+
+#ifndef ISTD_UTIL_CPU
+#define ISTD_UTIL_CPU
+
+#include "istd/util/macro.h"
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ICPU_X86
+#endif
+
+/// \brief Groups of features, from slowest to fastest
+typedef enum {
+  ICPU_SCALAR,
+  ICPU_SSE42,
+  ICPU_AVX2,
+  ICPU_AVX512,
+  ICPU_LEVELS
+} icpu_level_t;
+
+/// \brief Features of the CPU, which may be used on this OS
+typedef struct {
+  bool sse2, ssse3, sse41, sse42, popcnt;
+  bool avx, avx2, fma, bmi1, bmi2;
+  bool avx512f, avx512bw, avx512vl, avx512dq;
+} icpu_features_t;
+
+/// \brief Features of this CPU, detected on first call.
+const icpu_features_t* icpu_features(void);
+
+/// \brief Highest level this CPU supports.
+icpu_level_t icpu_detected_level(void);
+
+/// \brief Level used by dispatched functions.
+///
+/// It is the detected level, lowered by `ISTD_CPU` variable
+/// if it is set.
+///
+icpu_level_t icpu_level(void);
+
+/// \brief Change level of all dispatched functions.
+///
+/// Level higher than detected one is lowered to it. Returns level
+/// actually set. Must not be called while other threads may call
+/// dispatched functions.
+///
+icpu_level_t icpu_set_level(icpu_level_t level);
+
+/// \brief Name of the level, as used by `ISTD_CPU`.
+const char* icpu_level_name(icpu_level_t level);
+
+
+//---- Dispatch
+
+#ifdef ICPU_X86
+
+/// \brief Compile function for instructions of a level
+#define ICPU_TARGET_SSE42 __attribute__((target("ssse3,sse4.1,sse4.2,popcnt")))
+#define ICPU_TARGET_AVX2 __attribute__((target("avx2,fma,bmi,bmi2,popcnt")))
+#define ICPU_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl,avx512dq,avx2,fma,bmi,bmi2,popcnt")))
+
+/// \brief Given function on x86, `NULL` elsewhere, for `icpu_dispatch$()`
+#define icpu_x86$(fn) fn
+
+#else
+
+#define icpu_x86$(fn) NULL
+
+#endif
+
+
+/// \internal Dispatched function, in list of all of them
+typedef struct _icpu_slot_t {
+  struct _icpu_slot_t* next;
+  /// Point function to the version for given level
+  void (*select)(icpu_level_t level);
+} _icpu_slot_t;
+
+/// \internal Add function to the list, and select its version
+void _icpu_register(_icpu_slot_t* slot);
+
+
+/// \brief Define `static` function `name`, calling one of given versions
+///
+/// Each of `scalar`, `sse42`, `avx2` and `avx512` is a function with
+/// `ret` result and `params` parameters, made for that level, or `NULL`
+/// if there is no version for it. The best version not above current
+/// level is called. `scalar` must not be `NULL`.
+///
+/// Until constructors of the program have run, `scalar` is called.
+///
+#define icpu_dispatch$(name, ret, params, scalar, sse42, avx2, avx512)       \
+  static ret (*name) params = scalar;                                        \
+                                                                             \
+  static void im_concat$(_icpu_select_, name)(icpu_level_t level) {          \
+    ret (*versions[ICPU_LEVELS]) params = { scalar, sse42, avx2, avx512 };   \
+    for (int l = (int) level; l >= 0; --l)                                   \
+      if (versions[l]) {                                                     \
+        name = versions[l];                                                  \
+        return;                                                              \
+      }                                                                      \
+  }                                                                          \
+                                                                             \
+  static _icpu_slot_t im_concat$(_icpu_slot_, name) = {                      \
+    .select = im_concat$(_icpu_select_, name)                                \
+  };                                                                         \
+                                                                             \
+  __attribute__((constructor)) static void im_concat$(_icpu_init_, name)(void) { \
+    _icpu_register(&im_concat$(_icpu_slot_, name));                          \
+  }
+
+#endif
@@ -30,7 +30,8 @@ void* _istd_calloc_checked(size_t num, size_t item_size, const char* errmsg);
 
 /// \brief Allocate memory and fail if it wasn't allocated
 ///
-/// If `msg` is `NULL`, it will print the default error message
+/// If `msg` is `NULL`, it will print the default error message.
+/// Memory should be freed with `istd_free()`.
 ///
 #define calloc_checked$(num, type, msg) \
   ((type*) _istd_calloc_checked((num), sizeof(type), (msg)))
@@ -0,0 +1,127 @@
+/**
+ * \file
+ * \brief Asynchronous logging.
+ *
+ * Logging a message does not format it. Instead, pointer to the format
+ * string and raw values of arguments (strings are copied) are put into
+ * a ring buffer of the calling thread. A background thread started by
+ * `ilog_start()` takes messages from all threads, formats them, and
+ * writes them in batches with one `writev()`.
+ *
+ *   ilog_start(STDERR_FILENO);
+ *   ilog_info$("Loaded %zu items from %s", n, path);
+ *   ...
+ *   ilog_stop();
+ *
+ * Before `ilog_start()` and after `ilog_stop()` messages are formatted
+ * and written right away, to `stderr`.
+ *
+ * Every format string should be a literal, as it is kept by pointer.
+ * Conversions of `printf()` are supported, except `%n` and wide strings.
+ * As with `printf()`, strings with precision, such as spans logged with
+ * `%.*s`, are read only up to it, and do not need `\0` at the end.
+ *
+ * Each thread has its own ring, written only by that thread and read
+ * only by the writer (or by a thread calling `ilog_flush()`), so no locks
+ * are taken when logging. When the ring is full, message is dropped and
+ * counted. Rings are allocated on first message of each thread.
+ *
+ * Messages below `ILOG_LEVEL` are removed at compile time, together with
+ * evaluation of their arguments.
+ */
+
+#ifndef ISTD_UTIL_LOG
+#define ISTD_UTIL_LOG
+
+#include "istd/util/err.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/// Severity of a message
+typedef enum {
+  ILOG_DEBUG,
+  ILOG_INFO,
+  ILOG_WARN,
+  ILOG_ERROR,
+  ILOG_FATAL,
+} ilog_level_t;
+
+// Same values as in `ilog_level_t`, for the preprocessor
+#define _ILOG_DEBUG 0
+#define _ILOG_INFO  1
+#define _ILOG_WARN  2
+#define _ILOG_ERROR 3
+#define _ILOG_FATAL 4
+
+#ifndef ILOG_LEVEL
+#ifdef NDEBUG
+/// Least severe messages which are compiled in
+#define ILOG_LEVEL _ILOG_INFO
+#else
+#define ILOG_LEVEL _ILOG_DEBUG
+#endif
+#endif
+
+#ifndef ILOG_RING_SIZE
+/// Size of ring buffer of one thread, in bytes. Must be a power of two.
+#define ILOG_RING_SIZE (64 * 1024)
+#endif
+
+/// Longer strings in arguments are truncated
+#define ILOG_MAX_STRING 1024
+
+
+/// \brief Start background writer, which writes messages to `fd`.
+void ilog_start(int fd);
+
+/// \brief Write all messages, and stop background writer.
+void ilog_stop(void);
+
+/// \brief Write all messages logged so far, in calling thread.
+///
+/// Used by `panic$()`, so that messages before a panic are not lost.
+///
+void ilog_flush(void);
+
+/// \brief Number of messages dropped since the start, because rings were full.
+size_t ilog_dropped(void);
+
+
+//==== Internals, used by macros
+
+__attribute__((format(printf, 3, 4)))
+void _ilog_write(ilog_level_t level, const char* location, const char* fmt, ...);
+
+
+//==== Macros themselves
+
+/// \brief Log a message with given severity
+#define ilog$(level, ...) _ilog_write((level), location$(), __VA_ARGS__)
+
+#if ILOG_LEVEL <= _ILOG_DEBUG
+#define ilog_debug$(...) ilog$(ILOG_DEBUG, __VA_ARGS__)
+#else
+#define ilog_debug$(...) ((void) 0)
+#endif
+
+#if ILOG_LEVEL <= _ILOG_INFO
+#define ilog_info$(...) ilog$(ILOG_INFO, __VA_ARGS__)
+#else
+#define ilog_info$(...) ((void) 0)
+#endif
+
+#if ILOG_LEVEL <= _ILOG_WARN
+#define ilog_warn$(...) ilog$(ILOG_WARN, __VA_ARGS__)
+#else
+#define ilog_warn$(...) ((void) 0)
+#endif
+
+#if ILOG_LEVEL <= _ILOG_ERROR
+#define ilog_error$(...) ilog$(ILOG_ERROR, __VA_ARGS__)
+#else
+#define ilog_error$(...) ((void) 0)
+#endif
+
+#define ilog_fatal$(...) ilog$(ILOG_FATAL, __VA_ARGS__)
+
+#endif
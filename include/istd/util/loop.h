@@ -0,0 +1,158 @@
+/**
+ * \file
+ * \brief Single-threaded event loop for coroutines
+ *
+ * Tasks are coroutines of `istd/util/coro.h`, run by a loop built on
+ * `epoll` and `timerfd`. A task runs until it waits for a file
+ * descriptor, a timer, or for being woken up by another task, and then
+ * the loop runs other tasks. Thousands of connections are served by one
+ * thread this way, with a switch between tasks costing a function call.
+ *
+ *   typedef struct {
+ *     iloop_task_t task;
+ *     int fd;
+ *     char buf[256];
+ *     ssize_t got;
+ *   } echo_t;
+ *
+ *   void echo(iloop_task_t* task) {
+ *     echo_t* e = (echo_t*) task;
+ *     icoro$(&task->co) {
+ *       for (;;) {
+ *         iloop_wait_fd$(task, e->fd, ILOOP_READ);
+ *         if ((e->got = read(e->fd, e->buf, sizeof(e->buf))) <= 0)
+ *           break;
+ *         write(e->fd, e->buf, e->got);
+ *       }
+ *     }
+ *   }
+ *
+ *   iloop_t loop;
+ *   iloop_init(&loop);
+ *   iloop_spawn(&loop, &e.task, echo);
+ *   iloop_run(&loop);
+ *   iloop_destroy(&loop);
+ *
+ * Tasks are given as frames, which begin with `iloop_task_t`, and belong
+ * to the caller: loop never allocates or frees them. File descriptors
+ * should be non-blocking. Each descriptor may be waited for by one task
+ * at a time.
+ */
+
+#ifndef ISTD_UTIL_LOOP
+#define ISTD_UTIL_LOOP
+
+#include "istd/ds/arr.h"
+#include "istd/util/coro.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// \brief Events of a file descriptor
+enum {
+  ILOOP_READ = 1,
+  ILOOP_WRITE = 2,
+  /// Other side has closed the connection, never waited for
+  ILOOP_HANGUP = 4,
+  /// Error on the descriptor, never waited for
+  ILOOP_ERROR = 8,
+};
+
+typedef struct iloop_t iloop_t;
+typedef struct iloop_task_t iloop_task_t;
+
+/// \brief Body of a task, a coroutine
+typedef void (*iloop_fn_t)(iloop_task_t* task);
+
+/// \brief Task, put at the beginning of its frame
+struct iloop_task_t {
+  icoro_t co;
+  iloop_fn_t fn;
+  iloop_t* loop;
+  /// Next task in the queue of ready tasks
+  iloop_task_t* next;
+  /// Time the task sleeps until, in `iloop_now()` nanoseconds
+  uint64_t deadline;
+  /// Events which have woken the task from `iloop_wait_fd$()`
+  unsigned events;
+  /// Task is in the queue of ready tasks
+  bool ready;
+};
+
+/// \brief Event loop
+struct iloop_t {
+  int epoll_fd, timer_fd;
+  iloop_task_t *ready_head, *ready_tail;
+  /// Sleeping tasks, as a heap ordered by deadline
+  ia_arr$(iloop_task_t*) timers;
+  /// Deadline timerfd is set to, `0` if it is not set
+  uint64_t armed;
+  /// Number of tasks which are not done
+  size_t live;
+  /// Number of tasks waiting for file descriptors
+  size_t waiting_fds;
+  /// Number of times tasks were resumed
+  uint64_t resumes;
+};
+
+
+/// \brief Create a loop.
+void iloop_init(iloop_t* loop);
+
+/// \brief Close descriptors of the loop. Tasks which are not done are left as they are.
+void iloop_destroy(iloop_t* loop);
+
+/// \brief Start a task, which will run on next iteration of the loop.
+void iloop_spawn(iloop_t* loop, iloop_task_t* task, iloop_fn_t fn);
+
+/// \brief Run tasks until all of them are done, or can never run again.
+///
+/// Returns number of tasks which are not done. They are waiting for
+/// `iloop_wake()`, which no other task could call.
+///
+size_t iloop_run(iloop_t* loop);
+
+/// \brief Resume a task which waits in `iloop_park$()`.
+///
+/// Waking a task which is already ready, or done, does nothing. Tasks waiting
+/// for descriptors or timers must not be woken.
+///
+void iloop_wake(iloop_task_t* task);
+
+/// \brief Current time of `CLOCK_MONOTONIC`, in nanoseconds.
+uint64_t iloop_now(void);
+
+
+/// \internal Wake the task when `fd` has any of `events`
+void _iloop_watch_fd(iloop_task_t* task, int fd, unsigned events);
+
+/// \internal Wake the task at `deadline`
+void _iloop_sleep_until(iloop_task_t* task, uint64_t deadline);
+
+
+/// \brief Wait until `fd` is ready for any of `events`.
+///
+/// `task->events` tells which events happened, including `ILOOP_HANGUP`
+/// and `ILOOP_ERROR`.
+///
+#define iloop_wait_fd$(task, fd, events) do {                                  \
+    _iloop_watch_fd((task), (fd), (events));                                   \
+    icoro_yield$(&(task)->co);                                                 \
+  } while (0)
+
+/// \brief Sleep for `ns` nanoseconds.
+#define iloop_sleep$(task, ns) do {                                            \
+    _iloop_sleep_until((task), iloop_now() + (ns));                            \
+    icoro_yield$(&(task)->co);                                                 \
+  } while (0)
+
+/// \brief Let other ready tasks run, and continue after them.
+#define iloop_yield$(task) do {                                                \
+    iloop_wake(task);                                                          \
+    icoro_yield$(&(task)->co);                                                 \
+  } while (0)
+
+/// \brief Wait until another task calls `iloop_wake()` for this one.
+#define iloop_park$(task) icoro_yield$(&(task)->co)
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * \file
+ * \brief Buffered terminal output.
+ *
+ * Text is collected in a buffer and written with one `write()` when the
+ * buffer grows over `IOUT_FLUSH_SIZE`, when `iout_flush()` is called, or
+ * at the end of each line, if output goes to a terminal.
+ *
+ *   iout_t* out = iout_stderr();
+ *   iout_printf(out, ESC_GREEN "ok" ESC_RESET " %s\n", name);
+ *
+ * When output is not a terminal (or `NO_COLOR` is set), escape codes of
+ * `istd/util/tty.h` are removed from the text, so files and pipes get
+ * clean text.
+ *
+ * Writers are not thread-safe.
+ */
+
+#ifndef ISTD_UTIL_OUT
+#define ISTD_UTIL_OUT
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef IOUT_FLUSH_SIZE
+/// Buffer is written when it grows over that many bytes
+#define IOUT_FLUSH_SIZE (16 * 1024)
+#endif
+
+/// \brief Buffered writer
+typedef struct {
+  int fd;
+  /// Escape codes are written as is, instead of being removed
+  bool colors;
+  /// Buffer is written after every newline
+  bool line_buffered;
+  /// State of removal of an escape code split between writes
+  unsigned char escape;
+  char* buf;
+  size_t len, cap;
+} iout_t;
+
+
+/// \brief Create writer to `fd`, checking if it is a terminal.
+void iout_init(iout_t* out, int fd);
+
+/// \brief Write everything buffered, and free the buffer.
+void iout_destroy(iout_t* out);
+
+/// \brief Writer to `stderr`, created on first use and flushed at exit.
+iout_t* iout_stderr(void);
+
+/// \brief Append `len` bytes of text.
+void iout_write(iout_t* out, const char* text, size_t len);
+
+/// \brief Append a null-terminated string.
+void iout_puts(iout_t* out, const char* text);
+
+/// \brief Append formatted text.
+__attribute__((format(printf, 2, 3)))
+void iout_printf(iout_t* out, const char* fmt, ...);
+
+/// \brief Same as `iout_printf()`.
+void iout_vprintf(iout_t* out, const char* fmt, va_list args);
+
+/// \brief Write everything buffered.
+void iout_flush(iout_t* out);
+
+/// \brief Replace beginning of a line above the cursor with `text`,
+/// returning cursor to the beginning of its line.
+///
+/// Only possible on a terminal, otherwise nothing is written.
+///
+/// \returns `false` if output is not a terminal
+///
+bool iout_rewrite_above(iout_t* out, unsigned lines_up, const char* text);
+
+/// \brief Remove escape codes from text, in place.
+/// \returns new length of the text
+size_t iout_strip_escapes(char* text, size_t len);
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * \file
+ * \brief Size-class allocator with per-thread caches.
+ *
+ * Small sizes (up to `IPOOL_MAX_SMALL`) are rounded up to one of size
+ * classes: multiples of 16 up to 128 bytes, then four classes between
+ * each two powers of two. Blocks of each class are cut from spans of
+ * `IPOOL_SPAN_SIZE` bytes, taken from the system with `mmap()`.
+ *
+ * Every thread keeps free blocks of each class in its own cache, so
+ * most allocations and frees take no locks. When the cache of a class
+ * is empty, a batch of blocks is taken from the central list of that
+ * class; when it holds too many, a batch is given back. Memory of freed
+ * small blocks is reused, but is not returned to the system.
+ *
+ * Larger sizes are mapped directly and unmapped on free.
+ *
+ * istd routes its own allocations here when built with `ISTD_ALLOC_POOL`
+ * (see `istd/util/alloc.h`), but functions are always available.
+ */
+
+#ifndef ISTD_UTIL_POOL
+#define ISTD_UTIL_POOL
+
+#include <stddef.h>
+
+/// Size of spans small blocks are cut from, a power of two
+#define IPOOL_SPAN_SIZE (256 * 1024)
+
+/// Largest size served from size classes
+#define IPOOL_MAX_SMALL (32 * 1024)
+
+/// Largest number of blocks moved between a thread and central list at once
+#define IPOOL_MAX_BATCH 32
+
+
+/// \brief Same as `malloc()`. Blocks are aligned to 16 bytes.
+void* ipool_malloc(size_t size);
+
+/// \brief Same as `calloc()`.
+void* ipool_calloc(size_t num, size_t size);
+
+/// \brief Same as `realloc()`. Block stays in place when new size has
+/// the same size class.
+void* ipool_realloc(void* ptr, size_t size);
+
+/// \brief Same as `free()`, for memory from functions above.
+void ipool_free(void* ptr);
+
+/// \brief Number of bytes usable in the block, at least the requested size.
+size_t ipool_usable_size(const void* ptr);
+
+/// \brief Give all blocks cached by current thread back to central lists.
+///
+/// Done automatically when a thread exits.
+///
+void ipool_thread_flush(void);
+
+
+/// \brief Statistics of the allocator
+typedef struct {
+  /// Bytes taken from the system
+  size_t mapped_bytes;
+  /// Bytes in blocks currently allocated, with rounding to size classes
+  size_t used_bytes;
+  /// Part of mapped bytes not allocated: `1 - used / mapped`
+  double fragmentation;
+  /// Small allocations served by thread caches
+  size_t cache_hits;
+  /// Small allocations which had to go to central lists
+  size_t cache_misses;
+  /// Part of small allocations served by thread caches
+  double hit_rate;
+  /// Batches moved between threads and central lists, both ways
+  size_t batches;
+  /// Number of spans and of large blocks mapped
+  size_t spans, large_blocks;
+} ipool_stats_t;
+
+/// \brief Current statistics, summed over all threads.
+ipool_stats_t ipool_stats(void);
+
+#endif
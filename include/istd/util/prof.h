@@ -0,0 +1,185 @@
+/**
+ * \file
+ * \brief Profiling zones, counters and gauges.
+ *
+ * Code is instrumented like this:
+ *
+ *   iprof_zone$("parse") {
+ *     ...
+ *     iprof_counter_add$("bytes parsed", len);
+ *   }
+ *   iprof_gauge_set$("queue length", ia_length(queue));
+ *
+ * Nothing is recorded until `iprof_start()` is called, and then every
+ * zone records its beginning and end into a buffer of its thread. That
+ * buffer is only written by its thread, so there are no locks, and it
+ * is allocated once, on first record in that thread (or by
+ * `iprof_thread_init()`). When buffer is full, new events are dropped
+ * and counted.
+ *
+ * After recording, events can be written as Chrome trace-event JSON
+ * (open it in `chrome://tracing` or Perfetto), or summarized in a table.
+ *
+ * With `ISTD_NO_PROF` defined all macros compile to nothing, with body
+ * of the zone run as usual.
+ */
+
+#ifndef ISTD_UTIL_PROF
+#define ISTD_UTIL_PROF
+
+#include "istd/ds/arr.h"
+#include "istd/util/macro.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/// Maximal nesting of zones, deeper zones are not recorded
+#define IPROF_MAX_DEPTH 64
+
+/// Number of events in buffer of one thread
+#define IPROF_BUFFER_EVENTS (1 << 15)
+
+//==== Results
+
+/// Kind of a recorded event
+typedef enum {
+  IPROF_ZONE,
+  IPROF_COUNTER,
+  IPROF_GAUGE,
+} iprof_kind_t;
+
+/// Summary of all events with the same name and kind
+typedef struct {
+  const char* name;
+  iprof_kind_t kind;
+  /// Number of events
+  size_t count;
+  /// Zones: total, shortest and longest time, nanoseconds
+  double total_ns, min_ns, max_ns;
+  /// Counters: sum of additions;
+  /// gauges: last, smallest and largest value set
+  int64_t value, min, max;
+} iprof_stat_t;
+
+
+/// \brief Start recording.
+void iprof_start(void);
+
+/// \brief Stop recording. Zones opened before are still recorded when closed.
+void iprof_stop(void);
+
+/// \brief Forget everything recorded.
+///
+/// Other threads should not be recording at that moment.
+///
+void iprof_reset(void);
+
+/// \brief Allocate buffer of current thread, if it was not done yet.
+void iprof_thread_init(void);
+
+/// \brief Number of events dropped because buffers were full.
+size_t iprof_dropped(void);
+
+/// \brief Summary of recorded events, one item per name and kind,
+/// sorted by kind, and then by total time or by name.
+///
+/// Resulting array should be freed with `ia_destroy_array()`.
+///
+ia_arr$(iprof_stat_t) iprof_collect(void);
+
+/// \brief Print `iprof_collect()` as a table.
+void iprof_print_summary(FILE* out);
+
+/// \brief Write all events in Chrome trace-event format.
+/// \returns `false` if file could not be written
+bool iprof_write_trace(const char* path);
+
+
+//==== Internals, used by macros
+
+/// Zone which has begun, but has not ended yet
+typedef struct {
+  const char* name;
+  /// Timestamp, or `0` if zone is not recorded
+  uint64_t begin;
+} _iprof_open_zone_t;
+
+typedef struct {
+  unsigned depth;
+  _iprof_open_zone_t open[IPROF_MAX_DEPTH];
+} _iprof_stack_t;
+
+extern atomic_bool _iprof_enabled;
+extern _Thread_local _iprof_stack_t _iprof_stack;
+
+/// Write an event into buffer of current thread
+void _iprof_record(iprof_kind_t kind, const char* name, uint64_t begin, uint64_t end_or_value, unsigned depth);
+
+/// Timestamp in ticks, converted to time when events are dumped.
+static inline uint64_t _iprof_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+static inline bool _iprof_is_enabled(void) {
+  return atomic_load_explicit(&_iprof_enabled, memory_order_relaxed);
+}
+
+static inline void _iprof_begin(const char* name) {
+  unsigned depth = _iprof_stack.depth++;
+  if (depth < IPROF_MAX_DEPTH) {
+    _iprof_stack.open[depth].name = name;
+    _iprof_stack.open[depth].begin = _iprof_is_enabled() ? _iprof_now() : 0;
+  }
+}
+
+static inline void _iprof_end(void) {
+  unsigned depth = --_iprof_stack.depth;
+  if (depth < IPROF_MAX_DEPTH && _iprof_stack.open[depth].begin)
+    _iprof_record(IPROF_ZONE, _iprof_stack.open[depth].name,
+                  _iprof_stack.open[depth].begin, _iprof_now(), depth);
+}
+
+static inline void _iprof_value(iprof_kind_t kind, const char* name, int64_t value) {
+  if (_iprof_is_enabled())
+    _iprof_record(kind, name, _iprof_now(), (uint64_t) value, _iprof_stack.depth);
+}
+
+
+//==== Macros themselves
+
+#ifndef ISTD_NO_PROF
+
+/// \brief Profiling zone, records time spent in the following block.
+///
+/// Do not jump out of the zone with `break`, `return` or `goto`,
+/// it will not be closed then.
+///
+#define iprof_zone$(name) im_with$(_iprof_begin(name), _iprof_end())
+
+/// \brief Add `delta` to a counter.
+#define iprof_counter_add$(name, delta) _iprof_value(IPROF_COUNTER, (name), (int64_t) (delta))
+
+/// \brief Set value of a gauge.
+#define iprof_gauge_set$(name, value) _iprof_value(IPROF_GAUGE, (name), (int64_t) (value))
+
+#else
+
+#define iprof_zone$(name) im_with$((void) (name), (void) 0)
+#define iprof_counter_add$(name, delta) ((void) (name), (void) (delta))
+#define iprof_gauge_set$(name, value) ((void) (name), (void) (value))
+
+#endif
+
+#endif
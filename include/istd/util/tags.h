@@ -0,0 +1,49 @@
+/**
+ * \file
+ * \brief Tag lists, used to select test and benchmark sections.
+ *
+ * Sections are registered with comma-separated list of tags
+ * (`"default, istd, unicode"`), and runners select sections by
+ * tags given on the command line.
+ */
+
+#ifndef ISTD_UTIL_TAGS
+#define ISTD_UTIL_TAGS
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// Maximal number of tags in one list
+#define ITAGS_MAX 256
+
+/// \brief List of tags
+typedef struct {
+  /// Pointers to tags
+  const char** tags;
+  /// Number of tags
+  size_t ntags;
+  /// Memory where tags are stored, if list owns it
+  char* storage;
+} itags_t;
+
+
+/// \brief Parse comma-separated list of tags.
+///
+/// Whitespace around tags is ignored, as are empty tags.
+///
+void itags_parse(itags_t* tags, const char* list);
+
+/// \brief Collect tags given on the command line.
+///
+/// All arguments not starting with `-` are tags. If there are none,
+/// list contains only `default` tag.
+///
+void itags_from_args(itags_t* tags, int argc, const char** argv);
+
+/// \brief Check if two lists have a tag in common.
+bool itags_intersect(const itags_t* a, const itags_t* b);
+
+/// \brief Free memory of the list.
+void itags_destroy(itags_t* tags);
+
+#endif
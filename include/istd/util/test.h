@@ -7,8 +7,10 @@
 #define ISTD_UTIL_TEST
 
 #include "istd/util/macro.h"
+#include "istd/util/out.h"
 #include "istd/util/tty.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -42,6 +44,15 @@ __attribute__((noreturn)) void _itest_die(void);
 
 bool _itest_has_something_failed(void);
 
+/// Number of allocations made since current test case began.
+///
+size_t _itest_case_allocs(void);
+
+/// Largest amount of memory allocated by current test case
+/// at one time, in bytes.
+///
+size_t _itest_case_peak_bytes(void);
+
 
 //==== Macros themselves
 
@@ -160,14 +171,20 @@ bool _itest_has_something_failed(void);
 
 //---- Padded printf
 
-#define _itest_print$(...) fprintf(stderr, "        " __VA_ARGS__);
+#define _itest_print$(...) iout_printf(iout_stderr(), "        " __VA_ARGS__);
+
+/// Last line of a failure. Output is flushed, as the case may crash next.
+#define _itest_end_failure$() do {                                             \
+    _itest_print$("\n");                                                       \
+    iout_flush(iout_stderr());                                                 \
+  } while(0)
 
 //---- Basic checks
 
 /// Fail. Just fail with message, not checking anything.
 #define itest_fail$(...) do {                                                  \
     _itest_mark_failed(__VA_ARGS__);                                           \
-    _itest_print$("\n");                                                       \
+    _itest_end_failure$();                                                     \
   } while(0);
 
 /// Check what some condition is met.
@@ -177,7 +194,7 @@ bool _itest_has_something_failed(void);
     _itest_print$("Expected " _ITEST_ESC_EXPR "%s" ESC_RESET " to be "         \
                   _ITEST_ESC_C "true\n" ESC_RESET,                             \
                   #condition);                                                 \
-    _itest_print$("\n");                                                       \
+    _itest_end_failure$();                                                     \
   }
 
 //---- Comparsion using given operator, internals
@@ -190,22 +207,22 @@ bool _itest_has_something_failed(void);
     _itest_mark_failed(__VA_ARGS__);                                           \
     _itest_print$("Expected "                                                  \
                   _ITEST_ESC_A);                                               \
-    fputs(#a, stderr);                                                         \
-    fprintf(stderr, ESC_RESET                                                  \
-            " to be " _ITEST_ESC_C im_str$(op) ESC_RESET " "                   \
-            _ITEST_ESC_B);                                                     \
-    fputs(#b, stderr);                                                         \
-    fprintf(stderr, ESC_RESET "\n");                                           \
+    iout_puts(iout_stderr(), #a);                                              \
+    iout_printf(iout_stderr(), ESC_RESET                                       \
+                " to be " _ITEST_ESC_C im_str$(op) ESC_RESET " "               \
+                _ITEST_ESC_B);                                                 \
+    iout_puts(iout_stderr(), #b);                                              \
+    iout_printf(iout_stderr(), ESC_RESET "\n");                                \
     _itest_print$("Instead got:\n");                                           \
     _itest_print$("  " _ITEST_ESC_EXPR);                                       \
-    fputs(#a, stderr);                                                         \
-    fprintf(stderr, ESC_RESET                                                  \
-                  ESC_GRAY " = " _ITEST_ESC_A fmt ESC_RESET "\n", a_var);      \
+    iout_puts(iout_stderr(), #a);                                              \
+    iout_printf(iout_stderr(), ESC_RESET                                       \
+                ESC_GRAY " = " _ITEST_ESC_A fmt ESC_RESET "\n", a_var);        \
     _itest_print$("  " _ITEST_ESC_EXPR);                                       \
-    fputs(#b, stderr);                                                         \
-    fprintf(stderr, ESC_RESET                                                  \
-                  ESC_GRAY " = " _ITEST_ESC_B fmt ESC_RESET "\n", b_var);      \
-    _itest_print$("\n");                                                       \
+    iout_puts(iout_stderr(), #b);                                              \
+    iout_printf(iout_stderr(), ESC_RESET                                       \
+                ESC_GRAY " = " _ITEST_ESC_B fmt ESC_RESET "\n", b_var);        \
+    _itest_end_failure$();                                                     \
   }} while(0)
 
 
@@ -247,4 +264,17 @@ bool _itest_has_something_failed(void);
 #define itest_check_ptr_null$(a, ...)  _itest_check_op$(a, NULL, ==, const void*, "%p", __VA_ARGS__)
 #define itest_check_ptr_notnull$(a, ...)  _itest_check_op$(a, NULL, != , const void*, "%p", __VA_ARGS__)
 
+//---- Allocation budgets
+//
+// Only memory allocated by the library is counted (see `istd/util/alloc.h`),
+// and only in test builds. Memory not freed at the end of a case is
+// reported as leaked.
+
+/// Check that current test case has made at most `n` allocations so far.
+/// With `n = 0` makes sure some code path does not allocate at all.
+#define itest_check_allocs_le$(n, ...) _itest_check_op$(_itest_case_allocs(), n, <=, unsigned long long, "%llu", __VA_ARGS__)
+
+/// Check that current test case has never had more than `n` bytes allocated at once.
+#define itest_check_peak_bytes_le$(n, ...) _itest_check_op$(_itest_case_peak_bytes(), n, <=, unsigned long long, "%llu", __VA_ARGS__)
+
 #endif
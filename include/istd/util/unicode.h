@@ -0,0 +1,83 @@
+/**
+ * \file
+ * \brief Display width and grapheme clusters
+ *
+ * As noted in `utf8.h`, one visible glyph may be made of several
+ * codepoints. This header provides functions to find out where those
+ * glyphs (*extended grapheme clusters*, as UAX #29 calls them)
+ * begin and end, and how many terminal columns they take.
+ *
+ * Properties come from tables generated at build time by
+ * `tools/gen_unicode_tables.py`. Lookup is three array reads per
+ * codepoint, and all tables take around 14KiB.
+ */
+
+#ifndef ISTD_UNICODE
+#define ISTD_UNICODE
+
+#include "istd/util/utf8.h"
+#include <stddef.h>
+
+/// \brief Value returned by `unicode_width()` for control characters.
+#define UNICODE_NONPRINTABLE (-1)
+
+/**
+ * \brief Number of terminal columns given codepoint takes.
+ *
+ * Works like `wcwidth()`:
+ *
+ *  - `0` for combining marks, format characters and such,
+ *  - `2` for East Asian wide and fullwidth characters,
+ *  - `UNICODE_NONPRINTABLE` for C0/C1 control characters,
+ *  - `1` for everything else.
+ *
+ * \note Width of the glyph is not a sum of widths of its codepoints,
+ *       use `utf8_next_grapheme()` to get that.
+ */
+int unicode_width(rune cp);
+
+/**
+ * \brief Skip one grapheme cluster
+ *
+ * ```
+ *    e  + ◌́   x
+ * 65 cc 81    78
+ * --------    --
+ * é           x
+ * │           └─ returned
+ * └─ str
+ * ```
+ *
+ * Works like `utf8_next()`, but skips whole extended grapheme cluster
+ * instead of one codepoint. `str` must point to the beginning of
+ * a cluster (beginning of the string is always one).
+ *
+ * If `width` is not `NULL`, number of terminal columns taken by the
+ * cluster is stored there. Nonprintable clusters are treated as
+ * zero-width.
+ *
+ * If end of the string is reached, `str` is returned and `width` is
+ * set to `0`.
+ *
+ * If string contains invalid UTF8, `NULL` is returned and `errno`
+ * is set to `EILSEQ`.
+ *
+ * \param [in] str String to read cluster from
+ * \param [out] width Pointer to put width of the cluster into, or `NULL`
+ * \returns Pointer after the cluster
+ */
+const char* utf8_next_grapheme(const char* str, size_t* width);
+
+/**
+ * \brief Number of terminal columns `\0`-terminated string takes.
+ *
+ * This is a sum of cluster widths, as returned by
+ * `utf8_next_grapheme()`. Newlines and other control characters are
+ * counted as zero-width.
+ *
+ * If `str` contains invalid UTF8, `UTF8_INVALID` is returned and
+ * `errno` is set to `EILSEQ`.
+ */
+size_t utf8_display_width(const char* str);
+
+#endif
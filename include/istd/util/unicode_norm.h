@@ -0,0 +1,97 @@
+/**
+ * \file
+ * \brief Unicode normalization and case folding
+ *
+ * The same text can be encoded in several ways: `é` may be one codepoint
+ * `U+00E9`, or `e` followed by combining acute accent `U+0301`. To compare
+ * such strings, they must be brought to one canonical form first:
+ *
+ *  - NFD splits every character into base and combining marks,
+ *  - NFC does that, and then combines everything which can be combined
+ *    back into precomposed characters.
+ *
+ * Case folding maps characters so that strings differing only by
+ * case become equal (`"Straße"` and `"STRASSE"` both become `"strasse"`).
+ * Full folding is used, so one codepoint may become several.
+ *
+ * Most strings are already normalized, so both operations check that first
+ * and return the original string without copying it. Otherwise result is
+ * appended to given `ia_arr$(char)`.
+ *
+ * Tables are generated at build time by `tools/gen_unicode_tables.py`.
+ */
+
+#ifndef ISTD_UNICODE_NORM
+#define ISTD_UNICODE_NORM
+
+#include "istd/ds/arr.h"
+#include "istd/util/utf8.h"
+
+/// \brief Normalization form
+typedef enum {
+  UNICODE_NFC, ///< Canonical composition
+  UNICODE_NFD, ///< Canonical decomposition
+} unicode_form_t;
+
+
+/// \brief Result of `utf8_quick_check()`
+typedef enum {
+  UNICODE_QC_YES,     ///< String is normalized
+  UNICODE_QC_NO,      ///< String is not normalized
+  UNICODE_QC_MAYBE,   ///< Cannot tell without normalizing
+  UNICODE_QC_INVALID, ///< String is not valid UTF8
+} unicode_qc_t;
+
+
+/**
+ * \brief Quickly check if given string is in given normalization form.
+ *
+ * This is a single pass over the string, with no allocations. For NFC
+ * some characters (mostly combining marks) may or may not be combined
+ * with the previous ones, and `UNICODE_QC_MAYBE` is returned for them.
+ *
+ * If `str` contains invalid UTF8, `UNICODE_QC_INVALID` is returned
+ * and `errno` is set to `EILSEQ`.
+ */
+unicode_qc_t utf8_quick_check(const char* str, unicode_form_t form);
+
+
+/**
+ * \brief Normalize given string.
+ *
+ * If `str` is already in requested form, `str` itself is returned,
+ * and `*out` is left untouched.
+ *
+ * Otherwise, normalized string is appended to `*out` (if `*out` is
+ * `NULL`, new array is created), and pointer to the beginning of
+ * appended text is returned. It is `\0`-terminated, like all char
+ * arrays are.
+ *
+ * If `str` contains invalid UTF8, `NULL` is returned and
+ * `errno` is set to `EILSEQ`.
+ *
+ * ```
+ * ia_arr$(char) buf = NULL;
+ * const char* a = utf8_normalize(user_input, UNICODE_NFC, &buf);
+ * ```
+ *
+ * \param [in] str String to normalize
+ * \param [in] form Normalization form to bring string to
+ * \param [in,out] out Array to append normalized string to
+ * \returns Normalized string
+ */
+const char* utf8_normalize(const char* str, unicode_form_t form, ia_arr$(char)* out);
+
+
+/**
+ * \brief Apply full case folding to given string.
+ *
+ * Returns `str` if folding does not change anything, and works just like
+ * `utf8_normalize()` otherwise.
+ *
+ * \note Case folding may denormalize a string. For caseless comparison
+ *       of arbitrary strings, fold them and then normalize.
+ */
+const char* utf8_casefold(const char* str, ia_arr$(char)* out);
+
+#endif
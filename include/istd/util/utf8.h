@@ -6,6 +6,9 @@
 #ifndef ISTD_UTF8
 #define ISTD_UTF8
 
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -20,6 +23,49 @@
 typedef uint32_t rune;
 
 
+//==== Internals, used by inline functions
+
+/// Value of `_utf8_cp_len()` for continuation bytes
+#define _UTF8_BAD_CODEPOINT 0
+
+/// Get length of utf8 codepoint starting from
+/// that byte or `_UTF8_BAD_CODEPOINT` if this is cont. byte
+static inline size_t _utf8_cp_len(uint8_t byte) {
+
+  if ((byte >> 6) == 2) // 0b10xxxxxx
+    return _UTF8_BAD_CODEPOINT;
+  else if ((byte >> 5) == 6) // 0b110xxxxx
+    return 2;
+  else if ((byte >> 4) == 14) // 0b1110xxxx
+    return 3;
+  else if ((byte >> 3) == 30) // 0b11110xxx
+    return 4;
+  else
+    return 1;
+}
+
+/// Check if given byte is continuation byte
+static inline bool _utf8_is_continuation(uint8_t ch) {
+  // in form of 0b10xxxxxx
+  return (ch >> 6) == 2;
+}
+
+/// Trim top `nb` bits of given number.
+static inline uint8_t _utf8_trim_top_bits(uint8_t num, size_t nb) {
+  return (uint8_t) (num << nb) >> nb;
+}
+
+/// Decode UTF8 codepoint starting from that position
+static inline rune _utf8_decode(const uint8_t* ptr, size_t len) {
+  rune res = _utf8_trim_top_bits(ptr[0], len);
+  for (size_t i = 1; i < len; ++i)
+    res = (res << 6) + _utf8_trim_top_bits(ptr[i], 1);
+  return res;
+}
+
+//==== Decoding
+
+
 /**
  * \brief Extract one codepoint from given string, advance forwards
  *
@@ -46,7 +92,39 @@ typedef uint32_t rune;
  * \param [out] cp Pointer to put decoded codepoint into, or `NULL`
  * \returns Pointer pointing after extracted codepoint
  */
-const char* utf8_next(const char* ptr, rune* cp);
+static inline const char* utf8_next(const char* ptr, rune* cp) {
+
+  assert(ptr);
+
+  // End of the string reached (`\0` was found)
+  if (*ptr == '\0') {
+    if (cp)
+      *cp = 0;
+    return ptr;
+  }
+
+  // Decode codepoint length
+  size_t len = _utf8_cp_len((uint8_t) ptr[0]);
+  if (len == _UTF8_BAD_CODEPOINT)
+    goto decoding_failed;
+
+  // Check continuation bytes
+  for (size_t i = 1; i < len; ++i)
+    if (!_utf8_is_continuation((uint8_t) ptr[i]))
+      goto decoding_failed;
+
+  // Decode codepoint if user wants it.
+  if (cp)
+    *cp = _utf8_decode((const uint8_t*) ptr, len);
+
+  // Return advanced location
+  return ptr + len;
+
+ decoding_failed:
+  // Set errno and fail
+  errno = EILSEQ;
+  return NULL;
+}
 
 /**
  * \brief Advance backwards and extract one codepoint from given string.
@@ -92,6 +170,19 @@ const char* utf8_prev(const char* ptr, const char* begin, rune* cp);
  */
 size_t utf8_length(const char* str);
 
+/**
+ * \brief Check that `len` bytes of `str` are valid UTF8.
+ *
+ * Stricter than `utf8_next()`: overlong encodings, surrogates,
+ * codepoints above U+10FFFF and codepoints cut by the end of the span
+ * are invalid too. `\0` bytes are valid. Runs of ASCII are checked 16
+ * bytes at a time.
+ *
+ * \param [in] str Text to check, which does not have to be `\0`-terminated
+ * \param [in] len Length of the text, in bytes
+ */
+bool utf8_valid(const char* str, size_t len);
+
 /**
  * \brief Encode UTF8 codepoint into given buffer.
  *
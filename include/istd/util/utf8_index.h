@@ -0,0 +1,103 @@
+/**
+ * \file
+ * \brief Codepoint index for random access into long UTF8 strings
+ *
+ * Finding N-th codepoint of UTF8 string requires walking the string from
+ * its beginning. This index stores checkpoints to make that walk short:
+ *
+ * ```
+ *   codepoints:  0         K         2K        3K
+ *                │         │         │         │
+ *   bytes:       ├─────────┴──┬──────┴─────┬───┴────┬──────
+ *                0            K            2K       3K
+ *
+ *   cp_offsets = [ byte of cp 0, byte of cp K, byte of cp 2K, ... ]
+ *   block_cps  = [ cps before byte 0, cps before byte K, ... ]
+ * ```
+ *
+ * So translation in each direction is one array lookup, and then a scan
+ * of at most `K` codepoints (or bytes). Both scans and index building
+ * count lead bytes 64 bytes at a time with SIMD.
+ *
+ * Index does not own the string and does not validate it. For invalid
+ * UTF8, each byte which is not a continuation byte counts as
+ * a codepoint.
+ */
+
+#ifndef ISTD_UTF8_INDEX
+#define ISTD_UTF8_INDEX
+
+#include "istd/ds/arr.h"
+#include <stddef.h>
+
+/// \brief Stride used when `0` is passed to `utf8_index_init()`.
+#define UTF8_INDEX_DEFAULT_STRIDE 256
+
+/// \brief Index of codepoint positions in UTF8 string.
+typedef struct {
+
+  /// Checkpoints are placed every `1 << stride_shift`
+  /// codepoints and bytes.
+  size_t stride_shift;
+
+  /// Length of indexed string, in bytes
+  size_t num_bytes;
+
+  /// Number of codepoints in the string
+  size_t num_codepoints;
+
+  /// Byte offset of every `K`-th codepoint
+  ia_arr$(size_t) cp_offsets;
+
+  /// Number of codepoints beginning before every `K`-th byte
+  ia_arr$(size_t) block_cps;
+
+} utf8_index_t;
+
+
+/**
+ * \brief Build index of given string.
+ *
+ * \param [out] idx Index to initialize
+ * \param [in] str String to index, not necessarily `\0`-terminated
+ * \param [in] len Length of the string, in bytes
+ * \param [in] stride Distance between checkpoints (`K`). Must be a power
+ *                    of two, not less than 64. Pass `0` to use
+ *                    `UTF8_INDEX_DEFAULT_STRIDE`.
+ */
+void utf8_index_init(utf8_index_t* idx, const char* str, size_t len, size_t stride);
+
+/// \brief Free memory used by the index.
+void utf8_index_destroy(utf8_index_t* idx);
+
+/**
+ * \brief Update index after the string was edited.
+ *
+ * Bytes before `pos` must be the same as when the index was built.
+ * The rest of the string may be changed in any way. Only part of the
+ * index after `pos` is rebuilt, so edits near the end are cheap.
+ *
+ * \param [in,out] idx Index to update
+ * \param [in] str Edited string (it may have been moved)
+ * \param [in] len New length of the string, in bytes
+ * \param [in] pos First byte which was changed
+ */
+void utf8_index_update(utf8_index_t* idx, const char* str, size_t len, size_t pos);
+
+/**
+ * \brief Byte offset of `cp`-th codepoint.
+ *
+ * Passing `cp` equal to number of codepoints gives length of the
+ * string. Larger values are an error, and will panic.
+ */
+size_t utf8_index_byte_of(const utf8_index_t* idx, const char* str, size_t cp);
+
+/**
+ * \brief Index of the codepoint containing given byte.
+ *
+ * Passing `byte` equal to length of the string gives number of
+ * codepoints in it. Larger values are an error, and will panic.
+ */
+size_t utf8_index_codepoint_of(const utf8_index_t* idx, const char* str, size_t byte);
+
+#endif
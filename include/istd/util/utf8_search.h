@@ -0,0 +1,78 @@
+/**
+ * \file
+ * \brief Substring and byte set search in UTF8 text
+ *
+ * Unlike `strstr()` and friends, all functions here work on
+ * length-bounded spans, which do not have to be `\0`-terminated.
+ * So they can be used on parts of larger buffers, or on
+ * `ia_arr$(char)` with known length.
+ */
+
+#ifndef ISTD_UTF8_SEARCH
+#define ISTD_UTF8_SEARCH
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \brief Find first occurence of `needle` in `hay`.
+ *
+ * Returns pointer to the beginning of found occurence, or `NULL` if
+ * there is none. Empty `needle` is found at the beginning of `hay`.
+ *
+ * Match never begins or ends in the middle of a codepoint of `hay`,
+ * even if `needle` itself begins with continuation bytes or ends with
+ * truncated codepoint. For valid UTF8 that cannot happen anyway.
+ *
+ * Candidates are found by comparing first and last bytes of the needle
+ * 16 positions at a time, and then checked with `memcmp()`. If that
+ * gives too many false candidates, search switches to Two-Way algorithm,
+ * so it is linear in worst case.
+ *
+ * \param [in] hay Text to search in
+ * \param [in] hay_len Length of the text, in bytes
+ * \param [in] needle Text to search for
+ * \param [in] needle_len Length of the needle, in bytes
+ */
+const char* utf8_find(const char* hay, size_t hay_len, const char* needle, size_t needle_len);
+
+
+/**
+ * \brief Set of bytes, for `utf8_find_any_of_set()`.
+ *
+ * Stored as a 16x16 bit table: byte `b` is in the set if bit `(b >> 4) & 7`
+ * of `low[b & 15]` (for `b < 0x80`) or `high[b & 15]` (for others) is set.
+ * This way membership of 16 bytes can be checked with a few shuffles.
+ */
+typedef struct {
+  uint8_t low[16];
+  uint8_t high[16];
+} utf8_byteset_t;
+
+
+/// \brief Make a set of `n` given bytes.
+void utf8_byteset_init(utf8_byteset_t* set, const char* bytes, size_t n);
+
+/// \brief Add a byte to the set.
+void utf8_byteset_add(utf8_byteset_t* set, uint8_t byte);
+
+/// \brief Check if byte is in the set.
+static inline int utf8_byteset_has(const utf8_byteset_t* set, uint8_t byte) {
+  uint8_t row = byte < 0x80 ? set->low[byte & 15] : set->high[byte & 15];
+  return (row >> ((byte >> 4) & 7)) & 1;
+}
+
+
+/**
+ * \brief Find first byte of `str` which belongs to given set.
+ *
+ * Returns `NULL` if no such byte is found in `len` bytes of `str`.
+ *
+ * Bytes are matched as is, so for sets of ASCII characters (delimiters,
+ * whitespace and such) result is always at a codepoint boundary.
+ *
+ * Uses SSSE3 shuffles when the CPU supports them.
+ */
+const char* utf8_find_any_of_set(const char* str, size_t len, const utf8_byteset_t* set);
+
+#endif
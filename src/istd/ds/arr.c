@@ -1,73 +1,102 @@
 #include <assert.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "istd/ds/arr.h"
+#include "istd/util/alloc.h"
 #include "istd/util/err.h"
-
-/// The actual array object
-/// When using all methods of this library, you get/pass pointer to the `data`.
-typedef struct {
-
-  /// Number of items currently in the array
-  size_t length;
-
-  /// Number of items which can be fitted into this array without reallocation.
-  size_t availiable;
-
-  /// Array with element data
-  alignas(alignof(max_align_t)) char data[];
-} _ia_actual_array_t;
-
+#include "istd/util/prof.h"
 
 /// Get array struct of that pointer
-_ia_actual_array_t* actual_array(const void* arr) {
+static _ia_actual_array_t* actual_array(const void* arr) {
   assert(arr);
   return (_ia_actual_array_t*) (((char*) arr) - offsetof(_ia_actual_array_t, data));
 }
 
-char* zero_byte(const void* array, size_t item_size) {
+static char* zero_byte(const void* array, size_t item_size) {
   _ia_actual_array_t* actual = actual_array(array);
   return actual->data + actual->length * item_size;
 }
 
-/// Get length of array with elements starting at that pointer
-size_t ia_length(const void* arr) {
-  if (!arr) return 0;
-  return actual_array(arr)->length;  
+/// Bytes to allocate for PREALLOC items, with space to align them
+static size_t allocation_size(size_t prealloc, size_t item_size, size_t alignment) {
+  size_t extra = alignment - alignof(max_align_t);
+  if (prealloc > (SIZE_MAX - sizeof(_ia_actual_array_t) - extra - 1) / item_size)
+    panic$("Array of %zu items of size %zu bytes is too large", prealloc, item_size);
+  return sizeof(_ia_actual_array_t) + extra + item_size * prealloc + 1;
 }
 
-
-/// Get number of avail. space for items in that array.
-size_t ia_avail(const void *arr) {
-  if (!arr) return 0;
-  return actual_array(arr)->availiable;
+/// Number of bytes before the array struct in MEMORY, for its data to be aligned
+static size_t padding_in(const char* memory, size_t alignment) {
+  uintptr_t data = (uintptr_t) memory + sizeof(_ia_actual_array_t);
+  return (size_t) (((data + alignment - 1) & ~(uintptr_t) (alignment - 1)) - data);
 }
 
+/// Beginning of allocated memory of that array
+static char* allocation_of(_ia_actual_array_t* arr) {
+  return (char*) arr - arr->padding;
+}
 
 /// Allocate array with LEN elems and space for PREALLOC.
 void* ia_alloc_array(size_t prealloc, size_t len, size_t item_size) {
+  return ia_alloc_aligned_array(prealloc, len, item_size, 0);
+}
+
+/// Allocate array of LEN items copied from ITEMS, or zeroed if it is NULL
+static void* allocate(size_t prealloc, size_t len, size_t item_size, size_t alignment, const void* items) {
 
   assert(item_size);
 
+  if (alignment & (alignment - 1) || alignment > 1 << 20)
+    panic$("Array alignment must be a power of two up to 1 MB, not %zu", alignment);
+  if (alignment < alignof(max_align_t))
+    alignment = alignof(max_align_t);
+
   if (prealloc < len)
     prealloc = len;
 
-  _ia_actual_array_t* arr = 
-    (_ia_actual_array_t*) calloc(
-        1, sizeof(_ia_actual_array_t) + item_size * prealloc + 1);
-  if (!arr) // ENOMEM is set by calloc
+  // Copied items need no zeroing first, and room past them is left
+  // untouched, which is cheaper for large arrays
+  size_t size = allocation_size(prealloc, item_size, alignment);
+  char* memory = (char*) (items ? istd_malloc(size) : istd_calloc(1, size));
+  if (!memory) // ENOMEM is set by calloc
     panic$(
         "Failed to allocate space for %zu items of size %zu bytes",
         prealloc, item_size
       );
 
+  size_t padding = padding_in(memory, alignment);
+  _ia_actual_array_t* arr = (_ia_actual_array_t*) (memory + padding);
   arr->length = len;
   arr->availiable = prealloc;
-  
+  arr->alignment = (unsigned) alignment;
+  arr->padding = (unsigned) padding;
+  atomic_init(&arr->shares, 0);
+
+  if (items) {
+    memcpy(arr->data, items, len * item_size);
+    *zero_byte(arr->data, item_size) = '\0';
+  }
+
   return arr->data;
 }
 
+void* ia_alloc_aligned_array(size_t prealloc, size_t len, size_t item_size, size_t alignment) {
+  return allocate(prealloc, len, item_size, alignment, NULL);
+}
+
+
+/// Stop holding that array, and free it if no one else holds it
+static void release(_ia_actual_array_t* arr) {
+  // Only holder frees at once. Otherwise count goes down, and the one
+  // which finds it at zero frees: count wraps around then, but no one
+  // reads it any more
+  if (atomic_load_explicit(&arr->shares, memory_order_acquire) == 0 ||
+      atomic_fetch_sub_explicit(&arr->shares, 1, memory_order_acq_rel) == 0)
+    istd_free(allocation_of(arr));
+}
 
 /// Free that array
 void ia_destroy_array(void *array) {
@@ -75,7 +104,36 @@ void ia_destroy_array(void *array) {
   if (!array) // Not freeing null.
     return;
 
-  free(actual_array(array));
+  release(actual_array(array));
+}
+
+void* ia_share(const void* array) {
+
+  if (!array)
+    return NULL;
+
+  atomic_fetch_add_explicit(&actual_array(array)->shares, 1, memory_order_relaxed);
+  return (void*) array;
+}
+
+/// Give that array a copy of its items, if they are shared
+static void must_own(void** array, size_t item_size) {
+
+  _ia_actual_array_t* arr = actual_array(*array);
+  if (atomic_load_explicit(&arr->shares, memory_order_acquire) == 0)
+    return;
+
+  void* copy = allocate(arr->availiable, arr->length, item_size, arr->alignment, arr->data);
+  release(arr);
+  *array = copy;
+}
+
+void _ia_generic_unshare(void** array, size_t item_size) {
+
+  assert(array);
+
+  if (*array)
+    must_own(array, item_size);
 }
 
 
@@ -84,22 +142,48 @@ static void array_must_have_space(void** array, size_t avail, size_t item_size)
 
   assert(array);
 
-  _ia_actual_array_t* arr = array ? actual_array(*array) : NULL;
+  // Pushing into NULL creates a new array
+  if (!*array) {
+    *array = ia_alloc_array(avail, 0, item_size);
+    return;
+  }
 
-  while (ia_avail(arr->data) < avail) {
-    size_t nw = ia_avail(arr->data) * 3 / 2 + 1;
-    arr = (_ia_actual_array_t*) realloc(
-        arr,
-        nw * item_size + 1 + sizeof(_ia_actual_array_t)
+  must_own(array, item_size);
+
+  _ia_actual_array_t* arr = actual_array(*array);
+
+  if (arr->availiable >= avail)
+    return;
+
+  size_t nw = arr->availiable;
+  while (nw < avail)
+    nw = nw * 3 / 2 + 1;
+
+  size_t alignment = arr->alignment, padding = arr->padding;
+  char* memory;
+  iprof_zone$("ia grow") {
+    memory = (char*) istd_realloc(
+        allocation_of(arr),
+        allocation_size(nw, item_size, alignment)
     );
-    arr->availiable = nw;
-    if (!arr)
-      panic$(
-          "Failed to grow array with %zu-byte items to be "
-          "able to fit %zu of them",
-          item_size, arr->availiable
-      );
   }
+  if (!memory)
+    panic$(
+        "Failed to grow array with %zu-byte items to be "
+        "able to fit %zu of them",
+        item_size, nw
+    );
+
+  // Reallocated memory may be aligned differently, then
+  // the header and items are moved to be aligned again
+  size_t new_padding = padding_in(memory, alignment);
+  if (new_padding != padding)
+    memmove(memory + new_padding, memory + padding,
+            sizeof(_ia_actual_array_t) + ((_ia_actual_array_t*) (memory + padding))->length * item_size + 1);
+
+  arr = (_ia_actual_array_t*) (memory + new_padding);
+  arr->padding = (unsigned) new_padding;
+  arr->availiable = nw;
 
   *array = arr->data;
 }
@@ -123,7 +207,58 @@ void _ia_generic_pop(void **array, size_t item_size) {
   if (ia_length(*array) == 0)
     panic$("Cannot pop() from empty array");
 
+  must_own(array, item_size);
   _ia_actual_array_t* arr = actual_array(*array);
   arr->length--;
   *zero_byte(*array, item_size) = '\0';
 }
+
+void _ia_generic_append(void** array, const void* items, size_t count, size_t item_size) {
+
+  assert(array);
+  assert(items || count == 0);
+
+  array_must_have_space(array, ia_length(*array) + count, item_size);
+  _ia_actual_array_t* arr = actual_array(*array);
+  if (count)
+    memcpy(arr->data + item_size * arr->length, items, item_size * count);
+  arr->length += count;
+  *zero_byte(*array, item_size) = '\0';
+}
+
+void _ia_generic_truncate(void** array, size_t len, size_t item_size) {
+
+  assert(array);
+
+  if (len > ia_length(*array))
+    panic$("Cannot truncate array of %zu items to %zu items", ia_length(*array), len);
+
+  if (!*array)
+    return;
+
+  must_own(array, item_size);
+  actual_array(*array)->length = len;
+  *zero_byte(*array, item_size) = '\0';
+}
+
+void _ia_generic_reserve(void** array, size_t count, size_t item_size) {
+
+  assert(array);
+
+  array_must_have_space(array, ia_length(*array) + count, item_size);
+}
+
+void _ia_generic_set_length(void** array, size_t len, size_t item_size) {
+
+  assert(array);
+
+  if (len > ia_avail(*array))
+    panic$("Cannot set length of array with room for %zu items to %zu", ia_avail(*array), len);
+
+  if (!*array)
+    return;
+
+  must_own(array, item_size);
+  actual_array(*array)->length = len;
+  *zero_byte(*array, item_size) = '\0';
+}
@@ -0,0 +1,287 @@
+#include "istd/ds/arr_simd.h"
+#include "istd/ds/arr.h"
+#include "istd/util/cpu.h"
+#include "istd/util/err.h"
+#include <assert.h>
+#include <string.h>
+
+#ifdef ICPU_X86
+#include <immintrin.h>
+#endif
+
+// Kernels are written once with vector extensions of GCC and Clang, and
+// compiled for AVX2 and AVX-512 levels of `istd/util/cpu.h`. Vectors are
+// read and written with `memcpy()`, so items do not have to be aligned.
+
+//==== Plain loops
+
+#define SCALAR_KERNELS$(sfx, T, S) \
+  \
+  static void fill_##sfx##_scalar(T* a, size_t len, T value) { \
+    for (size_t i = 0; i < len; ++i) \
+      a[i] = value; \
+  } \
+  \
+  static S sum_##sfx##_scalar(const T* a, size_t len) { \
+    S sum = 0; \
+    for (size_t i = 0; i < len; ++i) \
+      sum += a[i]; \
+    return sum; \
+  } \
+  \
+  static T min_##sfx##_scalar(const T* a, size_t len) { \
+    T m = a[0]; \
+    for (size_t i = 1; i < len; ++i) \
+      if (a[i] < m) m = a[i]; \
+    return m; \
+  } \
+  \
+  static T max_##sfx##_scalar(const T* a, size_t len) { \
+    T m = a[0]; \
+    for (size_t i = 1; i < len; ++i) \
+      if (a[i] > m) m = a[i]; \
+    return m; \
+  } \
+  \
+  static const T* find_##sfx##_scalar(const T* a, size_t len, T value) { \
+    for (size_t i = 0; i < len; ++i) \
+      if (a[i] == value) return a + i; \
+    return NULL; \
+  } \
+  \
+  static bool equal_##sfx##_scalar(const T* a, const T* b, size_t len) { \
+    for (size_t i = 0; i < len; ++i) \
+      if (a[i] != b[i]) return false; \
+    return true; \
+  } \
+  \
+  static void prefix_sum_##sfx##_scalar(T* a, size_t len) { \
+    for (size_t i = 1; i < len; ++i) \
+      a[i] += a[i - 1]; \
+  }
+
+SCALAR_KERNELS$(i32, int32_t, int64_t)
+SCALAR_KERNELS$(i64, int64_t, int64_t)
+SCALAR_KERNELS$(f32, float, double)
+SCALAR_KERNELS$(f64, double, double)
+
+
+//==== Vector kernels
+
+#ifdef ICPU_X86
+
+/// Check if any lane of comparison result is set
+#define ANY_AVX2(mask) (!_mm256_testz_si256((__m256i) (mask), (__m256i) (mask)))
+#define ANY_AVX512(mask) (_mm512_test_epi64_mask((__m512i) (mask), (__m512i) (mask)) != 0)
+
+// In-vector prefix sums of vectors with N lanes: log2(N) additions of the
+// vector shifted up by 1, 2, 4, ... lanes, with zeroes shifted in.
+// Lanes of `zero` are 0..N-1 in the shuffle, and lanes of `v` are N..2N-1.
+
+#define SCAN_4(v, zero) \
+  v += __builtin_shufflevector(zero, v, 0, 4, 5, 6); \
+  v += __builtin_shufflevector(zero, v, 0, 0, 4, 5);
+
+#define SCAN_8(v, zero) \
+  v += __builtin_shufflevector(zero, v, 0, 8, 9, 10, 11, 12, 13, 14); \
+  v += __builtin_shufflevector(zero, v, 0, 0, 8, 9, 10, 11, 12, 13); \
+  v += __builtin_shufflevector(zero, v, 0, 0, 0, 0, 8, 9, 10, 11);
+
+#define SCAN_16(v, zero) \
+  v += __builtin_shufflevector(zero, v, 0, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30); \
+  v += __builtin_shufflevector(zero, v, 0, 0, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29); \
+  v += __builtin_shufflevector(zero, v, 0, 0, 0, 0, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27); \
+  v += __builtin_shufflevector(zero, v, 0, 0, 0, 0, 0, 0, 0, 0, 16, 17, 18, 19, 20, 21, 22, 23);
+
+/// Kernels for items of type T, summed into S, with W-byte vectors,
+/// compiled with TARGET attribute. SCAN is the in-vector prefix sum
+/// for W / sizeof(T) lanes.
+#define VECTOR_KERNELS$(sfx, T, S, isa, TARGET, W, ANY, SCAN) \
+  \
+  typedef T sfx##_##isa##_t __attribute__((vector_size(W))); \
+  typedef S sfx##_##isa##_sum_t __attribute__((vector_size(W / sizeof(T) * sizeof(S)))); \
+  \
+  TARGET \
+  static void fill_##sfx##_##isa(T* a, size_t len, T value) { \
+    const size_t n = W / sizeof(T); \
+    sfx##_##isa##_t v = (sfx##_##isa##_t) { 0 } + value; \
+    size_t i = 0; \
+    for (; i + n <= len; i += n) \
+      memcpy(a + i, &v, W); \
+    for (; i < len; ++i) \
+      a[i] = value; \
+  } \
+  \
+  TARGET \
+  static S sum_##sfx##_##isa(const T* a, size_t len) { \
+    const size_t n = W / sizeof(T); \
+    sfx##_##isa##_sum_t acc = { 0 }; \
+    size_t i = 0; \
+    for (; i + n <= len; i += n) { \
+      sfx##_##isa##_t v; \
+      memcpy(&v, a + i, W); \
+      acc += __builtin_convertvector(v, sfx##_##isa##_sum_t); \
+    } \
+    S sum = 0; \
+    for (size_t k = 0; k < n; ++k) \
+      sum += acc[k]; \
+    for (; i < len; ++i) \
+      sum += a[i]; \
+    return sum; \
+  } \
+  \
+  VECTOR_MINMAX$(min, <, sfx, T, isa, TARGET, W) \
+  VECTOR_MINMAX$(max, >, sfx, T, isa, TARGET, W) \
+  \
+  TARGET \
+  static const T* find_##sfx##_##isa(const T* a, size_t len, T value) { \
+    const size_t n = W / sizeof(T); \
+    sfx##_##isa##_t needle = (sfx##_##isa##_t) { 0 } + value; \
+    size_t i = 0; \
+    for (; i + n <= len; i += n) { \
+      sfx##_##isa##_t v; \
+      memcpy(&v, a + i, W); \
+      /* Found item is among next n, which are checked below */ \
+      if (ANY(v == needle)) \
+        break; \
+    } \
+    for (; i < len; ++i) \
+      if (a[i] == value) return a + i; \
+    return NULL; \
+  } \
+  \
+  TARGET \
+  static bool equal_##sfx##_##isa(const T* a, const T* b, size_t len) { \
+    const size_t n = W / sizeof(T); \
+    size_t i = 0; \
+    for (; i + n <= len; i += n) { \
+      sfx##_##isa##_t x, y; \
+      memcpy(&x, a + i, W); \
+      memcpy(&y, b + i, W); \
+      if (ANY(x != y)) \
+        return false; \
+    } \
+    for (; i < len; ++i) \
+      if (a[i] != b[i]) return false; \
+    return true; \
+  } \
+  \
+  TARGET \
+  static void prefix_sum_##sfx##_##isa(T* a, size_t len) { \
+    const size_t n = W / sizeof(T); \
+    const sfx##_##isa##_t zero = { 0 }; \
+    sfx##_##isa##_t carry = zero; \
+    size_t i = 0; \
+    for (; i + n <= len; i += n) { \
+      sfx##_##isa##_t v; \
+      memcpy(&v, a + i, W); \
+      SCAN(v, zero) \
+      v += carry; \
+      memcpy(a + i, &v, W); \
+      carry = zero + v[n - 1]; \
+    } \
+    for (i = i ? i : 1; i < len; ++i) \
+      a[i] += a[i - 1]; \
+  }
+
+/// Smallest or largest item, depending on CMP
+#define VECTOR_MINMAX$(name, CMP, sfx, T, isa, TARGET, W) \
+  TARGET \
+  static T name##_##sfx##_##isa(const T* a, size_t len) { \
+    const size_t n = W / sizeof(T); \
+    T m = a[0]; \
+    size_t i = 0; \
+    if (len >= n) { \
+      sfx##_##isa##_t best; \
+      memcpy(&best, a, W); \
+      for (i = n; i + n <= len; i += n) { \
+        sfx##_##isa##_t v; \
+        memcpy(&v, a + i, W); \
+        typeof(v CMP best) better = v CMP best; \
+        /* Blend on bits, which works for floating point vectors too */ \
+        best = (sfx##_##isa##_t) (((typeof(better)) v & better) | ((typeof(better)) best & ~better)); \
+      } \
+      m = best[0]; \
+      for (size_t k = 1; k < n; ++k) \
+        if (best[k] CMP m) m = best[k]; \
+    } \
+    for (; i < len; ++i) \
+      if (a[i] CMP m) m = a[i]; \
+    return m; \
+  }
+
+VECTOR_KERNELS$(i32, int32_t, int64_t, avx2, ICPU_TARGET_AVX2, 32, ANY_AVX2, SCAN_8)
+VECTOR_KERNELS$(i64, int64_t, int64_t, avx2, ICPU_TARGET_AVX2, 32, ANY_AVX2, SCAN_4)
+VECTOR_KERNELS$(f32, float, double, avx2, ICPU_TARGET_AVX2, 32, ANY_AVX2, SCAN_8)
+VECTOR_KERNELS$(f64, double, double, avx2, ICPU_TARGET_AVX2, 32, ANY_AVX2, SCAN_4)
+
+VECTOR_KERNELS$(i32, int32_t, int64_t, avx512, ICPU_TARGET_AVX512, 64, ANY_AVX512, SCAN_16)
+VECTOR_KERNELS$(i64, int64_t, int64_t, avx512, ICPU_TARGET_AVX512, 64, ANY_AVX512, SCAN_8)
+VECTOR_KERNELS$(f32, float, double, avx512, ICPU_TARGET_AVX512, 64, ANY_AVX512, SCAN_16)
+VECTOR_KERNELS$(f64, double, double, avx512, ICPU_TARGET_AVX512, 64, ANY_AVX512, SCAN_8)
+
+#endif
+
+
+//==== Dispatch
+
+/// Pointer `kernel` to the version of the kernel for current CPU level
+#define DISPATCHED$(kernel, ret, params) \
+  icpu_dispatch$(kernel, ret, params, kernel##_scalar, NULL, \
+                 icpu_x86$(kernel##_avx2), icpu_x86$(kernel##_avx512))
+
+#define DISPATCHED_KERNELS$(sfx, T, S) \
+  DISPATCHED$(fill_##sfx, void, (T* a, size_t len, T value)) \
+  DISPATCHED$(sum_##sfx, S, (const T* a, size_t len)) \
+  DISPATCHED$(min_##sfx, T, (const T* a, size_t len)) \
+  DISPATCHED$(max_##sfx, T, (const T* a, size_t len)) \
+  DISPATCHED$(find_##sfx, const T*, (const T* a, size_t len, T value)) \
+  DISPATCHED$(equal_##sfx, bool, (const T* a, const T* b, size_t len)) \
+  DISPATCHED$(prefix_sum_##sfx, void, (T* a, size_t len))
+
+DISPATCHED_KERNELS$(i32, int32_t, int64_t)
+DISPATCHED_KERNELS$(i64, int64_t, int64_t)
+DISPATCHED_KERNELS$(f32, float, double)
+DISPATCHED_KERNELS$(f64, double, double)
+
+
+//==== Implementations
+
+#define PUBLIC$(sfx, T, S) \
+  \
+  void ia_simd_fill_##sfx(T* arr, T value) { \
+    fill_##sfx(arr, ia_length(arr), value); \
+  } \
+  \
+  S ia_simd_sum_##sfx(const T* arr) { \
+    return sum_##sfx(arr, ia_length(arr)); \
+  } \
+  \
+  T ia_simd_min_##sfx(const T* arr) { \
+    check$(ia_length(arr), "Cannot find minimum of empty array"); \
+    return min_##sfx(arr, ia_length(arr)); \
+  } \
+  \
+  T ia_simd_max_##sfx(const T* arr) { \
+    check$(ia_length(arr), "Cannot find maximum of empty array"); \
+    return max_##sfx(arr, ia_length(arr)); \
+  } \
+  \
+  const T* ia_simd_find_##sfx(const T* arr, T value) { \
+    return find_##sfx(arr, ia_length(arr), value); \
+  } \
+  \
+  bool ia_simd_equal_##sfx(const T* a, const T* b) { \
+    if (ia_length(a) != ia_length(b)) \
+      return false; \
+    return equal_##sfx(a, b, ia_length(a)); \
+  } \
+  \
+  void ia_simd_prefix_sum_##sfx(T* arr) { \
+    prefix_sum_##sfx(arr, ia_length(arr)); \
+  }
+
+PUBLIC$(i32, int32_t, int64_t)
+PUBLIC$(i64, int64_t, int64_t)
+PUBLIC$(f32, float, double)
+PUBLIC$(f64, double, double)
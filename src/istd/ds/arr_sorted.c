@@ -0,0 +1,405 @@
+#include "istd/ds/arr_sorted.h"
+#include "istd/ds/arr.h"
+#include "istd/util/cpu.h"
+#include "istd/util/err.h"
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef ICPU_X86
+#include <immintrin.h>
+#endif
+
+/// Items written past the end of results by vector stores
+#define SLACK 8
+
+/// Whether shorter array of `small` items is looked up in the longer one
+static bool skewed(size_t small, size_t large) {
+  return large / IA_SORTED_GALLOP_RATIO >= small;
+}
+
+/// Index of the first item of `a` from `from` on, which is not less than `x`
+static size_t gallop(const uint32_t* a, size_t from, size_t len, uint32_t x) {
+  if (from >= len || a[from] >= x)
+    return from;
+
+  // Items up to `lo` are less than `x`
+  size_t lo = from, step = 1;
+  while (lo + step < len && a[lo + step] < x) {
+    lo += step;
+    step *= 2;
+  }
+  size_t hi = lo + step < len ? lo + step : len;
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (a[mid] < x)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return hi;
+}
+
+/// Copy `count` items to `out`, and return their number. Empty arrays
+/// may be `NULL`, which `memcpy()` must not be given even for no items.
+static size_t copy_items(uint32_t* out, const uint32_t* items, size_t count) {
+  if (count)
+    memcpy(out, items, count * sizeof(uint32_t));
+  return count;
+}
+
+
+//==== Walking side by side
+
+// Kernels write items of `a` which are in `b`, or which are not in it,
+// depending on `keep`. Each one returns number of written items, and may
+// write garbage into `SLACK` items after them.
+
+/// Finish walk at `a[i]` and `b[j]`, with `n` items written so far.
+///
+/// First `pending` items of `a` were compared with some of `b` already,
+/// and bits of `matched` tell which of them were found there.
+///
+static size_t walk_tail(const uint32_t* a, size_t i, size_t na, const uint32_t* b, size_t j, size_t nb,
+                         unsigned matched, size_t pending, uint32_t* out, size_t n, bool keep) {
+
+  for (size_t end = i + pending < na ? i + pending : na; i < end; ++i, matched >>= 1) {
+    bool found = matched & 1;
+    if (!found) {
+      while (j < nb && b[j] < a[i])
+        ++j;
+      found = j < nb && b[j] == a[i];
+    }
+    if (found == keep)
+      out[n++] = a[i];
+  }
+
+  // Without branches, which would be mispredicted half the time
+  while (i < na && j < nb) {
+    uint32_t x = a[i], y = b[j];
+    out[n] = x;
+    n += keep ? x == y : x < y;
+    i += x <= y;
+    j += y <= x;
+  }
+
+  if (!keep)
+    n += copy_items(out + n, a + i, na - i);
+  return n;
+}
+
+static size_t walk_scalar(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out, bool keep) {
+  return walk_tail(a, 0, na, b, 0, nb, 0, 0, out, 0, keep);
+}
+
+/// Items of `a` which differ from the ones before them, `prev` being
+/// the one before `a[0]`
+static size_t unique_scalar(const uint32_t* a, size_t len, uint32_t prev, uint32_t* out) {
+  size_t n = 0;
+  for (size_t i = 0; i < len; ++i) {
+    uint32_t x = a[i];
+    out[n] = x;
+    n += x != prev;
+    prev = x;
+  }
+  return n;
+}
+
+
+//==== Vector kernels
+
+// Blocks of `a` and `b` are compared all against all, by comparing `a`
+// with `b` rotated by each number of lanes. Block with the smaller last
+// item is done with, and its found items are packed together and
+// stored; both blocks are done with when their last items are equal.
+
+#ifdef ICPU_X86
+
+#define Z 0x80
+
+/// Shuffles of bytes, moving lanes set in index to the beginning of a vector
+static const uint8_t compress_4[16][16] __attribute__((aligned(16))) = {
+  { Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z },
+  { 0, 1, 2, 3, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z },
+  { 4, 5, 6, 7, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z },
+  { 0, 1, 2, 3, 4, 5, 6, 7, Z, Z, Z, Z, Z, Z, Z, Z },
+  { 8, 9, 10, 11, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z },
+  { 0, 1, 2, 3, 8, 9, 10, 11, Z, Z, Z, Z, Z, Z, Z, Z },
+  { 4, 5, 6, 7, 8, 9, 10, 11, Z, Z, Z, Z, Z, Z, Z, Z },
+  { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, Z, Z, Z, Z },
+  { 12, 13, 14, 15, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z },
+  { 0, 1, 2, 3, 12, 13, 14, 15, Z, Z, Z, Z, Z, Z, Z, Z },
+  { 4, 5, 6, 7, 12, 13, 14, 15, Z, Z, Z, Z, Z, Z, Z, Z },
+  { 0, 1, 2, 3, 4, 5, 6, 7, 12, 13, 14, 15, Z, Z, Z, Z },
+  { 8, 9, 10, 11, 12, 13, 14, 15, Z, Z, Z, Z, Z, Z, Z, Z },
+  { 0, 1, 2, 3, 8, 9, 10, 11, 12, 13, 14, 15, Z, Z, Z, Z },
+  { 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, Z, Z, Z, Z },
+  { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+};
+
+#undef Z
+
+ICPU_TARGET_SSE42
+static size_t store_4(uint32_t* out, __m128i v, unsigned lanes) {
+  __m128i shuffle = _mm_load_si128((const __m128i*) compress_4[lanes]);
+  _mm_storeu_si128((__m128i*) out, _mm_shuffle_epi8(v, shuffle));
+  return (size_t) __builtin_popcount(lanes);
+}
+
+ICPU_TARGET_SSE42
+static size_t walk_sse42(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out, bool keep) {
+  size_t i = 0, j = 0, n = 0;
+  unsigned matched = 0;
+  while (i + 4 <= na && j + 4 <= nb) {
+    __m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*) (b + j));
+    __m128i eq = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                     _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+        _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                     _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+    matched |= (unsigned) _mm_movemask_ps(_mm_castsi128_ps(eq));
+
+    uint32_t last_a = a[i + 3], last_b = b[j + 3];
+    if (last_a <= last_b) {
+      n += store_4(out + n, va, keep ? matched : ~matched & 0xF);
+      matched = 0;
+      i += 4;
+    }
+    j += last_b <= last_a ? 4 : 0;
+  }
+  return walk_tail(a, i, na, b, j, nb, matched, 4, out, n, keep);
+}
+
+ICPU_TARGET_SSE42
+static size_t unique_sse42(const uint32_t* a, size_t len, uint32_t prev, uint32_t* out) {
+  size_t i = 0, n = 0;
+  // Last item of previous block is in last lane
+  __m128i before = _mm_cvtsi32_si128((int) prev);
+  before = _mm_shuffle_epi32(before, _MM_SHUFFLE(0, 0, 0, 0));
+  for (; i + 4 <= len; i += 4) {
+    // Items are loaded before anything is stored over them
+    __m128i v = _mm_loadu_si128((const __m128i*) (a + i));
+    __m128i shifted = _mm_alignr_epi8(v, before, 12);
+    unsigned same = (unsigned) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, shifted)));
+    n += store_4(out + n, v, ~same & 0xF);
+    before = v;
+  }
+  // Whole vectors were stored, so in place the items before `a + i` are
+  // overwritten, and last one is taken from the register
+  prev = (uint32_t) _mm_extract_epi32(before, 3);
+  return n + unique_scalar(a + i, len - i, prev, out + n);
+}
+
+/// Move lanes set in `lanes` to the beginning of a vector, and store it
+ICPU_TARGET_AVX2
+static size_t store_8(uint32_t* out, __m256i v, unsigned lanes) {
+  // Indices of set lanes, a byte each, are gathered from all indices
+  uint64_t bytes = _pdep_u64(lanes, 0x0101010101010101ull) * 0xFF;
+  uint64_t indices = _pext_u64(0x0706050403020100ull, bytes);
+  __m256i shuffle = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128((long long) indices));
+  _mm256_storeu_si256((__m256i*) out, _mm256_permutevar8x32_epi32(v, shuffle));
+  return (size_t) __builtin_popcount(lanes);
+}
+
+ICPU_TARGET_AVX2
+static size_t walk_avx2(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out, bool keep) {
+  size_t i = 0, j = 0, n = 0;
+  unsigned matched = 0;
+  while (i + 8 <= na && j + 8 <= nb) {
+    __m256i va = _mm256_loadu_si256((const __m256i*) (a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i*) (b + j));
+    // Rotations within halves, and then with halves swapped
+    __m256i vs = _mm256_permute2x128_si256(vb, vb, 1);
+    __m256i eq = _mm256_or_si256(
+        _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi32(va, vb),
+                            _mm256_cmpeq_epi32(va, _mm256_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm256_or_si256(_mm256_cmpeq_epi32(va, _mm256_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                            _mm256_cmpeq_epi32(va, _mm256_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))))),
+        _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi32(va, vs),
+                            _mm256_cmpeq_epi32(va, _mm256_shuffle_epi32(vs, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm256_or_si256(_mm256_cmpeq_epi32(va, _mm256_shuffle_epi32(vs, _MM_SHUFFLE(1, 0, 3, 2))),
+                            _mm256_cmpeq_epi32(va, _mm256_shuffle_epi32(vs, _MM_SHUFFLE(2, 1, 0, 3))))));
+    matched |= (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+
+    uint32_t last_a = a[i + 7], last_b = b[j + 7];
+    if (last_a <= last_b) {
+      n += store_8(out + n, va, keep ? matched : ~matched & 0xFF);
+      matched = 0;
+      i += 8;
+    }
+    j += last_b <= last_a ? 8 : 0;
+  }
+  return walk_tail(a, i, na, b, j, nb, matched, 8, out, n, keep);
+}
+
+ICPU_TARGET_AVX2
+static size_t unique_avx2(const uint32_t* a, size_t len, uint32_t prev, uint32_t* out) {
+  size_t i = 0, n = 0;
+  const __m256i up = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+  __m256i before = _mm256_set1_epi32((int) prev);
+  for (; i + 8 <= len; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*) (a + i));
+    // Items moved up a lane, with last item of previous block in first lane
+    __m256i shifted = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(v, up),
+                                         _mm256_permutevar8x32_epi32(before, up), 0x01);
+    unsigned same = (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, shifted)));
+    n += store_8(out + n, v, ~same & 0xFF);
+    before = v;
+  }
+  // Items before `a + i` may be overwritten, as above
+  prev = (uint32_t) _mm256_extract_epi32(before, 7);
+  return n + unique_scalar(a + i, len - i, prev, out + n);
+}
+
+#endif
+
+
+//==== Dispatch
+
+icpu_dispatch$(walk, size_t, (const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out, bool keep),
+               walk_scalar, icpu_x86$(walk_sse42), icpu_x86$(walk_avx2), NULL)
+
+icpu_dispatch$(unique_run, size_t, (const uint32_t* a, size_t len, uint32_t prev, uint32_t* out),
+               unique_scalar, icpu_x86$(unique_sse42), icpu_x86$(unique_avx2), NULL)
+
+
+//==== Galloping
+
+/// Items of `small` which are in `large`
+static size_t gallop_intersect(const uint32_t* small, size_t ns, const uint32_t* large, size_t nl, uint32_t* out) {
+  size_t n = 0;
+  for (size_t i = 0, j = 0; i < ns; ++i) {
+    j = gallop(large, j, nl, small[i]);
+    if (j == nl)
+      break;
+    out[n] = small[i];
+    n += large[j] == small[i];
+  }
+  return n;
+}
+
+/// Items of `a` which are not in much longer `b`
+static size_t gallop_lookup_difference(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+  size_t n = 0;
+  for (size_t i = 0, j = 0; i < na; ++i) {
+    j = gallop(b, j, nb, a[i]);
+    out[n] = a[i];
+    n += j == nb || b[j] != a[i];
+  }
+  return n;
+}
+
+/// Items of `a` which are not in much shorter `b`, copied between the ones which are
+static size_t gallop_skip_difference(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+  size_t n = 0, i = 0;
+  for (size_t j = 0; j < nb && i < na; ++j) {
+    size_t p = gallop(a, i, na, b[j]);
+    n += copy_items(out + n, a + i, p - i);
+    i = p + (p < na && a[p] == b[j]);
+  }
+  return n + copy_items(out + n, a + i, na - i);
+}
+
+/// Items of `large`, with the ones of much shorter `small` put between them
+static size_t gallop_union(const uint32_t* small, size_t ns, const uint32_t* large, size_t nl, uint32_t* out) {
+  size_t n = 0, j = 0;
+  for (size_t i = 0; i < ns; ++i) {
+    size_t p = gallop(large, j, nl, small[i]);
+    n += copy_items(out + n, large + j, p - j);
+    out[n++] = small[i];
+    j = p + (p < nl && large[p] == small[i]);
+  }
+  return n + copy_items(out + n, large + j, nl - j);
+}
+
+static size_t merge_union(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out) {
+  size_t i = 0, j = 0, n = 0;
+  while (i < na && j < nb) {
+    uint32_t x = a[i], y = b[j];
+    out[n++] = x < y ? x : y;
+    i += x <= y;
+    j += y <= x;
+  }
+  n += copy_items(out + n, a + i, na - i);
+  return n + copy_items(out + n, b + j, nb - j);
+}
+
+
+//==== Operations
+
+/// Empty `*out`, and make room in it for `count` items
+static uint32_t* output_for(ia_arr$(uint32_t)* out, size_t count, const uint32_t* a, const uint32_t* b) {
+  check$(!*out || (*out != a && *out != b), "Output of a set operation should not be one of its inputs");
+  ia_truncate$(out, 0);
+  ia_reserve$(out, count + SLACK);
+  check$(*out, "Should allocate result of a set operation");
+  return *out;
+}
+
+size_t ia_sorted_intersect(ia_arr$(uint32_t)* out, const uint32_t* a, const uint32_t* b) {
+  size_t na = ia_length(a), nb = ia_length(b), n;
+  uint32_t* o = output_for(out, na < nb ? na : nb, a, b);
+
+  if (skewed(na, nb))
+    n = gallop_intersect(a, na, b, nb, o);
+  else if (skewed(nb, na))
+    n = gallop_intersect(b, nb, a, na, o);
+  else
+    n = walk(a, na, b, nb, o, true);
+
+  ia_set_length$(out, n);
+  return n;
+}
+
+size_t ia_sorted_union(ia_arr$(uint32_t)* out, const uint32_t* a, const uint32_t* b) {
+  size_t na = ia_length(a), nb = ia_length(b), n;
+  uint32_t* o = output_for(out, na + nb, a, b);
+
+  if (skewed(na, nb))
+    n = gallop_union(a, na, b, nb, o);
+  else if (skewed(nb, na))
+    n = gallop_union(b, nb, a, na, o);
+  else
+    n = merge_union(a, na, b, nb, o);
+
+  ia_set_length$(out, n);
+  return n;
+}
+
+size_t ia_sorted_difference(ia_arr$(uint32_t)* out, const uint32_t* a, const uint32_t* b) {
+  size_t na = ia_length(a), nb = ia_length(b), n;
+  uint32_t* o = output_for(out, na, a, b);
+
+  if (skewed(na, nb))
+    n = gallop_lookup_difference(a, na, b, nb, o);
+  else if (skewed(nb, na))
+    n = gallop_skip_difference(a, na, b, nb, o);
+  else
+    n = walk(a, na, b, nb, o, false);
+
+  ia_set_length$(out, n);
+  return n;
+}
+
+size_t ia_sorted_unique(ia_arr$(uint32_t)* out, const uint32_t* a) {
+  size_t len = ia_length(a);
+  // Items are written at or before the ones they come from, so `a` may
+  // be the output, and no room past its length is needed
+  if (*out == a) {
+    ia_unshare$(out);
+    a = *out;
+  } else {
+    ia_truncate$(out, 0);
+    ia_reserve$(out, len);
+    check$(*out, "Should allocate result of a set operation");
+  }
+  if (!len)
+    return 0;
+
+  (*out)[0] = a[0];
+  size_t n = 1 + unique_run(a + 1, len - 1, a[0], *out + 1);
+  ia_set_length$(out, n);
+  return n;
+}
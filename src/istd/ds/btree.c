@@ -0,0 +1,42 @@
+#include "istd/ds/btree.h"
+#include "istd/util/err.h"
+
+/// Bytes of a chunk of nodes
+#define CHUNK_BYTES (64 * 1024)
+
+static size_t nodes_per_chunk(const _ibtree_slab_t* slab) {
+  size_t n = CHUNK_BYTES / slab->node_size;
+  return n ? n : 1;
+}
+
+void _ibtree_slab_init(_ibtree_slab_t* slab, size_t node_size) {
+  // Whole cache lines, so each node starts a line of its own
+  slab->node_size = (node_size + IA_CACHE_LINE - 1) & ~(size_t) (IA_CACHE_LINE - 1);
+  slab->chunks = ia_new_empty_array$(char*);
+  slab->used = 0;
+}
+
+void _ibtree_slab_destroy(_ibtree_slab_t* slab) {
+  for (size_t i = 0; i < ia_length(slab->chunks); ++i)
+    ia_destroy_array(slab->chunks[i]);
+  ia_destroy_array(slab->chunks);
+  slab->chunks = NULL;
+}
+
+void* _ibtree_slab_alloc(_ibtree_slab_t* slab) {
+
+  size_t count = ia_length(slab->chunks);
+  if (!count || slab->used == nodes_per_chunk(slab)) {
+    char* chunk = ia_alloc_aligned_array(0, nodes_per_chunk(slab) * slab->node_size, 1, IA_CACHE_LINE);
+    check$(chunk, "Should allocate nodes of a tree");
+    ia_push$(&slab->chunks, chunk);
+    slab->used = 0;
+    count++;
+  }
+
+  return slab->chunks[count - 1] + slab->used++ * slab->node_size;
+}
+
+size_t _ibtree_slab_bytes(const _ibtree_slab_t* slab) {
+  return ia_length(slab->chunks) * nodes_per_chunk(slab) * slab->node_size;
+}
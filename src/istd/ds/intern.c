@@ -0,0 +1,230 @@
+#include "istd/ds/intern.h"
+#include "istd/util/alloc.h"
+#include "istd/util/err.h"
+#include <string.h>
+
+/// Number of slots in a new table
+#define INITIAL_SLOTS 64
+
+struct _iintern_table_t {
+  /// Table used before this one
+  _iintern_table_t* prev;
+  size_t mask;
+  _Atomic(const _iintern_entry_t*) slots[];
+};
+
+struct _iintern_chunk_t {
+  _iintern_chunk_t* prev;
+  size_t size, used;
+  alignas(8) char data[];
+};
+
+//==== Helpers
+
+static size_t round_up8(size_t n) {
+  return (n + 7) & ~(size_t) 7;
+}
+
+/// Hash eight bytes at a time
+static uint64_t hash_bytes(const char* str, size_t len) {
+
+  uint64_t h = 0x9e3779b97f4a7c15ull ^ len;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t word;
+    memcpy(&word, str + i, 8);
+    h = (h ^ word) * 0xff51afd7ed558ccdull;
+    h ^= h >> 32;
+  }
+
+  uint64_t tail = 0;
+  memcpy(&tail, str + i, len - i);
+  h = (h ^ tail) * 0xc4ceb9fe1a85ec53ull;
+  return h ^ (h >> 29);
+}
+
+static _iintern_table_t* new_table(size_t slots) {
+  _iintern_table_t* t = (_iintern_table_t*) istd_calloc(
+      1, sizeof(_iintern_table_t) + slots * sizeof(t->slots[0]));
+  check$(t, "Should allocate intern table of %zu slots", slots);
+  t->mask = slots - 1;
+  return t;
+}
+
+/// Find string in the table. If it is not there, store
+/// index of the free slot it would take into `free_slot`.
+static const _iintern_entry_t* find_in(
+    const _iintern_table_t* t, uint64_t hash,
+    const char* str, size_t len, size_t* free_slot
+  ) {
+
+  for (size_t i = hash & t->mask;; i = (i + 1) & t->mask) {
+    const _iintern_entry_t* e = atomic_load_explicit(&t->slots[i], memory_order_acquire);
+    if (!e) {
+      if (free_slot)
+        *free_slot = i;
+      return NULL;
+    }
+    if (e->hash == hash && e->length == len && !memcmp(e->str, str, len))
+      return e;
+  }
+}
+
+/// Replace the table with one twice as large. Must hold the lock.
+static _iintern_table_t* grow(iintern_pool_t* pool, _iintern_table_t* old) {
+
+  _iintern_table_t* t = new_table((old->mask + 1) * 2);
+  for (size_t i = 0; i <= old->mask; ++i) {
+    const _iintern_entry_t* e = atomic_load_explicit(&old->slots[i], memory_order_relaxed);
+    if (!e)
+      continue;
+    size_t j = e->hash & t->mask;
+    while (atomic_load_explicit(&t->slots[j], memory_order_relaxed))
+      j = (j + 1) & t->mask;
+    atomic_store_explicit(&t->slots[j], e, memory_order_relaxed);
+  }
+
+  // Readers may still be looking into the old table
+  t->prev = old;
+  atomic_store_explicit(&pool->table, t, memory_order_release);
+  return t;
+}
+
+/// Copy string into the chunk, allocating a new chunk if needed
+static _iintern_entry_t* store(iintern_pool_t* pool, const char* str, size_t len, uint64_t hash, size_t id) {
+
+  size_t need = round_up8(sizeof(_iintern_entry_t) + len + 1);
+  _iintern_chunk_t* chunk = pool->chunk;
+
+  if (!chunk || chunk->used + need > chunk->size) {
+    size_t size = need > IINTERN_CHUNK ? need : IINTERN_CHUNK;
+    _iintern_chunk_t* nw = (_iintern_chunk_t*) istd_malloc(sizeof(_iintern_chunk_t) + size);
+    check$(nw, "Should allocate intern chunk of %zu bytes", size);
+    nw->prev = chunk;
+    nw->size = size;
+    nw->used = 0;
+    pool->chunk = chunk = nw;
+  }
+
+  _iintern_entry_t* e = (_iintern_entry_t*) (chunk->data + chunk->used);
+  chunk->used += need;
+
+  e->hash = hash;
+  e->length = (uint32_t) len;
+  e->id = (uint32_t) id;
+  memcpy(e->str, str, len);
+  e->str[len] = '\0';
+  return e;
+}
+
+//==== Implementations
+
+void iintern_init(iintern_pool_t* pool, bool concurrent) {
+
+  check$(pool, "Intern pool must be not null");
+
+  pool->table = new_table(INITIAL_SLOTS);
+  pool->chunk = NULL;
+  pool->count = 0;
+  pool->concurrent = concurrent;
+  check$(!pthread_mutex_init(&pool->lock, NULL), "Should create a lock of intern pool");
+}
+
+void iintern_destroy(iintern_pool_t* pool) {
+
+  for (_iintern_table_t* t = atomic_load(&pool->table); t; ) {
+    _iintern_table_t* prev = t->prev;
+    istd_free(t);
+    t = prev;
+  }
+
+  for (_iintern_chunk_t* c = pool->chunk; c; ) {
+    _iintern_chunk_t* prev = c->prev;
+    istd_free(c);
+    c = prev;
+  }
+
+  pthread_mutex_destroy(&pool->lock);
+  pool->table = NULL;
+  pool->chunk = NULL;
+  pool->count = 0;
+}
+
+const char* iintern(iintern_pool_t* pool, const char* str, size_t len) {
+
+  check$(len < UINT32_MAX, "Interned strings must be shorter than 4 GB");
+
+  uint64_t hash = hash_bytes(str, len);
+  const _iintern_entry_t* e = find_in(
+      atomic_load_explicit(&pool->table, memory_order_acquire), hash, str, len, NULL);
+  if (e)
+    return e->str;
+
+  if (pool->concurrent)
+    pthread_mutex_lock(&pool->lock);
+
+  // String might have been added while the lock was taken
+  _iintern_table_t* t = atomic_load_explicit(&pool->table, memory_order_relaxed);
+  size_t slot;
+  e = find_in(t, hash, str, len, &slot);
+
+  if (!e) {
+    size_t count = atomic_load_explicit(&pool->count, memory_order_relaxed);
+    check$(count < UINT32_MAX, "Pool should have less than 2^32 strings");
+
+    // Keep table at most 3/4 full
+    if ((count + 1) * 4 > (t->mask + 1) * 3) {
+      t = grow(pool, t);
+      find_in(t, hash, str, len, &slot);
+    }
+
+    e = store(pool, str, len, hash, count);
+    // Entry is complete before it can be seen
+    atomic_store_explicit(&t->slots[slot], e, memory_order_release);
+    atomic_store_explicit(&pool->count, count + 1, memory_order_release);
+  }
+
+  if (pool->concurrent)
+    pthread_mutex_unlock(&pool->lock);
+
+  return e->str;
+}
+
+const char* iintern_cstr(iintern_pool_t* pool, const char* str) {
+  return iintern(pool, str, strlen(str));
+}
+
+const char* iintern_find(const iintern_pool_t* pool, const char* str, size_t len) {
+  const _iintern_entry_t* e = find_in(
+      atomic_load_explicit(&pool->table, memory_order_acquire), hash_bytes(str, len), str, len, NULL);
+  return e ? e->str : NULL;
+}
+
+size_t iintern_count(const iintern_pool_t* pool) {
+  return atomic_load_explicit(&pool->count, memory_order_acquire);
+}
+
+iintern_stats_t iintern_stats(const iintern_pool_t* pool) {
+
+  iintern_pool_t* p = (iintern_pool_t*) pool;
+  if (p->concurrent)
+    pthread_mutex_lock(&p->lock);
+
+  iintern_stats_t stats = { .strings = atomic_load(&p->count) };
+
+  const _iintern_table_t* table = atomic_load(&p->table);
+  for (size_t i = 0; i <= table->mask; ++i) {
+    const _iintern_entry_t* e = atomic_load_explicit(&table->slots[i], memory_order_relaxed);
+    if (e)
+      stats.string_bytes += e->length + 1;
+  }
+  for (const _iintern_table_t* t = table; t; t = t->prev)
+    stats.index_bytes += sizeof(_iintern_table_t) + (t->mask + 1) * sizeof(t->slots[0]);
+  for (const _iintern_chunk_t* c = p->chunk; c; c = c->prev)
+    stats.chunk_bytes += sizeof(_iintern_chunk_t) + c->size;
+  stats.load = (double) stats.strings / (double) (table->mask + 1);
+
+  if (p->concurrent)
+    pthread_mutex_unlock(&p->lock);
+  return stats;
+}
@@ -0,0 +1,452 @@
+#include "istd/ds/packed.h"
+#include "istd/util/cpu.h"
+#include "istd/util/err.h"
+#include <string.h>
+
+// Block of 128 offsets is 32 rows of 4 lanes, offset `4 * j + l` being
+// row `j` of lane `l`. Each lane is a stream of `bits`-bit offsets, lowest
+// bits first, going through words `l`, `l + 4`, `l + 8`, ... so a block
+// takes `4 * bits` words.
+
+/// Rows of a block
+#define ROWS (IPACKED_BLOCK / 4)
+
+/// Block of values stored as they are
+#define RAW_BITS 64
+
+/// Words of a block packed with given bits
+static size_t block_words(unsigned bits) {
+  return bits == RAW_BITS ? IPACKED_BLOCK * 2 : bits * 4;
+}
+
+/// Offset in row `j` of lane `l`
+static uint32_t extract(const uint32_t* in, unsigned bits, size_t j, size_t l) {
+  if (!bits)
+    return 0;
+  size_t pos = j * bits;
+  const uint32_t* w = in + pos / 32 * 4 + l;
+  unsigned shift = pos % 32;
+  uint64_t x = w[0] >> shift;
+  if (shift + bits > 32)
+    x |= (uint64_t) w[4] << (32 - shift);
+  return (uint32_t) (x & ((1ull << bits) - 1));
+}
+
+
+//==== Plain loops
+
+static void pack_scalar(const uint32_t* in, uint32_t* out, unsigned bits) {
+  for (size_t l = 0; l < 4; ++l) {
+    uint64_t buf = 0;
+    unsigned have = 0;
+    uint32_t* w = out + l;
+    for (size_t j = 0; j < ROWS; ++j) {
+      buf |= (uint64_t) in[4 * j + l] << have;
+      have += bits;
+      if (have >= 32) {
+        *w = (uint32_t) buf;
+        w += 4;
+        buf >>= 32;
+        have -= 32;
+      }
+    }
+  }
+}
+
+static void unpack_offsets_scalar(const uint32_t* in, uint32_t* d, unsigned bits) {
+  const uint64_t mask = (1ull << bits) - 1;
+  for (size_t l = 0; l < 4; ++l) {
+    uint64_t buf = 0;
+    unsigned have = 0;
+    const uint32_t* w = in + l;
+    for (size_t j = 0; j < ROWS; ++j) {
+      if (have < bits) {
+        buf |= (uint64_t) *w << have;
+        w += 4;
+        have += 32;
+      }
+      d[4 * j + l] = (uint32_t) (buf & mask);
+      buf >>= bits;
+      have -= bits;
+    }
+  }
+}
+
+static void unpack_u32_scalar(const uint32_t* in, uint32_t* out, unsigned bits, uint64_t base, bool delta) {
+  uint32_t d[IPACKED_BLOCK];
+  unpack_offsets_scalar(in, d, bits);
+  for (size_t k = 0; k < IPACKED_BLOCK; ++k)
+    out[k] = (delta && k >= 4 ? out[k - 4] : (uint32_t) base) + d[k];
+}
+
+static void unpack_u64_scalar(const uint32_t* in, uint64_t* out, unsigned bits, uint64_t base, bool delta) {
+  uint32_t d[IPACKED_BLOCK];
+  unpack_offsets_scalar(in, d, bits);
+  for (size_t k = 0; k < IPACKED_BLOCK; ++k)
+    out[k] = (delta && k >= 4 ? out[k - 4] : base) + d[k];
+}
+
+static uint64_t sum_block_scalar(const uint32_t* in, unsigned bits, uint64_t base, bool delta, bool wide) {
+  uint64_t out[IPACKED_BLOCK], sum = 0;
+  unpack_u64_scalar(in, out, bits, base, delta);
+  for (size_t k = 0; k < IPACKED_BLOCK; ++k)
+    sum += wide ? out[k] : (uint32_t) out[k];
+  return sum;
+}
+
+
+//==== Vector kernels
+
+#ifdef ICPU_X86
+
+typedef uint32_t v4u32_t __attribute__((vector_size(16)));
+typedef uint64_t v4u64_t __attribute__((vector_size(32)));
+
+/// Call `CASE(bits, isa)` for each of 1 to 32 bits
+#define EACH_BITS$(CASE, isa) \
+  CASE(1, isa) CASE(2, isa) CASE(3, isa) CASE(4, isa) CASE(5, isa) CASE(6, isa) CASE(7, isa) CASE(8, isa) \
+  CASE(9, isa) CASE(10, isa) CASE(11, isa) CASE(12, isa) CASE(13, isa) CASE(14, isa) CASE(15, isa) CASE(16, isa) \
+  CASE(17, isa) CASE(18, isa) CASE(19, isa) CASE(20, isa) CASE(21, isa) CASE(22, isa) CASE(23, isa) CASE(24, isa) \
+  CASE(25, isa) CASE(26, isa) CASE(27, isa) CASE(28, isa) CASE(29, isa) CASE(30, isa) CASE(31, isa) CASE(32, isa)
+
+#define PACK_CASE$(b, isa) case b: pack_rows_##isa(in, out, b); break;
+#define UNPACK_CASE$(b, isa) case b: unpack_rows_##isa(in, d, b); break;
+
+// Rows are packed and unpacked with all 4 lanes in one vector. Loops are
+// unrolled for each number of bits, so all shifts are constant.
+
+/// Kernels compiled with TARGET attribute
+#define VECTOR_KERNELS$(isa, TARGET) \
+  \
+  TARGET __attribute__((always_inline)) \
+  static inline void pack_rows_##isa(const uint32_t* in, uint32_t* out, const unsigned bits) { \
+    v4u32_t acc = { 0 }; \
+    unsigned shift = 0; \
+    _Pragma("GCC unroll 32") \
+    for (unsigned j = 0; j < ROWS; ++j) { \
+      v4u32_t v; \
+      memcpy(&v, in + 4 * j, 16); \
+      acc |= v << shift; \
+      shift += bits; \
+      if (shift >= 32) { \
+        memcpy(out, &acc, 16); \
+        out += 4; \
+        shift -= 32; \
+        acc = shift ? v >> (bits - shift) : (v4u32_t) { 0 }; \
+      } \
+    } \
+  } \
+  \
+  TARGET __attribute__((always_inline)) \
+  static inline void unpack_rows_##isa(const uint32_t* in, v4u32_t* d, const unsigned bits) { \
+    const v4u32_t mask = (v4u32_t) { 0 } + (uint32_t) ((1ull << bits) - 1); \
+    v4u32_t w; \
+    memcpy(&w, in, 16); \
+    unsigned shift = 0; \
+    _Pragma("GCC unroll 32") \
+    for (unsigned j = 0; j < ROWS; ++j) { \
+      v4u32_t v = w >> shift; \
+      shift += bits; \
+      /* Last row ends at the end of a word, and reads nothing more */ \
+      if (shift >= 32 && j + 1 < ROWS) { \
+        shift -= 32; \
+        in += 4; \
+        memcpy(&w, in, 16); \
+        if (shift) \
+          v |= w << (bits - shift); \
+      } \
+      d[j] = v & mask; \
+    } \
+  } \
+  \
+  TARGET \
+  static void pack_##isa(const uint32_t* in, uint32_t* out, unsigned bits) { \
+    switch (bits) { \
+      EACH_BITS$(PACK_CASE$, isa) \
+    } \
+  } \
+  \
+  TARGET \
+  static void unpack_offsets_##isa(const uint32_t* in, v4u32_t* d, unsigned bits) { \
+    switch (bits) { \
+      case 0: memset(d, 0, ROWS * sizeof(v4u32_t)); break; \
+      EACH_BITS$(UNPACK_CASE$, isa) \
+    } \
+  } \
+  \
+  TARGET \
+  static void unpack_u32_##isa(const uint32_t* in, uint32_t* out, unsigned bits, uint64_t base, bool delta) { \
+    v4u32_t d[ROWS]; \
+    unpack_offsets_##isa(in, d, bits); \
+    v4u32_t acc = (v4u32_t) { 0 } + (uint32_t) base; \
+    for (size_t j = 0; j < ROWS; ++j) { \
+      v4u32_t v = d[j] + acc; \
+      if (delta) \
+        acc = v; \
+      memcpy(out + 4 * j, &v, 16); \
+    } \
+  } \
+  \
+  TARGET \
+  static void unpack_u64_##isa(const uint32_t* in, uint64_t* out, unsigned bits, uint64_t base, bool delta) { \
+    v4u32_t d[ROWS]; \
+    unpack_offsets_##isa(in, d, bits); \
+    v4u64_t acc = (v4u64_t) { 0 } + base; \
+    for (size_t j = 0; j < ROWS; ++j) { \
+      v4u64_t v = __builtin_convertvector(d[j], v4u64_t) + acc; \
+      if (delta) \
+        acc = v; \
+      memcpy(out + 4 * j, &v, 32); \
+    } \
+  } \
+  \
+  TARGET \
+  static uint64_t sum_block_##isa(const uint32_t* in, unsigned bits, uint64_t base, bool delta, bool wide) { \
+    v4u32_t d[ROWS]; \
+    unpack_offsets_##isa(in, d, bits); \
+    v4u64_t sum = { 0 }; \
+    if (!delta) { \
+      for (size_t j = 0; j < ROWS; ++j) \
+        sum += __builtin_convertvector(d[j], v4u64_t); \
+      return sum[0] + sum[1] + sum[2] + sum[3] + base * IPACKED_BLOCK; \
+    } \
+    if (wide) { \
+      v4u64_t acc = (v4u64_t) { 0 } + base; \
+      for (size_t j = 0; j < ROWS; ++j) \
+        sum += acc += __builtin_convertvector(d[j], v4u64_t); \
+    } else { \
+      v4u32_t acc = (v4u32_t) { 0 } + (uint32_t) base; \
+      for (size_t j = 0; j < ROWS; ++j) \
+        sum += __builtin_convertvector(acc += d[j], v4u64_t); \
+    } \
+    return sum[0] + sum[1] + sum[2] + sum[3]; \
+  }
+
+VECTOR_KERNELS$(sse42, ICPU_TARGET_SSE42)
+VECTOR_KERNELS$(avx2, ICPU_TARGET_AVX2)
+
+#endif
+
+
+//==== Dispatch
+
+// Offsets are unpacked the same way on both levels; AVX2 widens them
+// to 64 bits and adds bases in one register instead of two
+#define DISPATCHED$(kernel, ret, params) \
+  icpu_dispatch$(kernel, ret, params, kernel##_scalar, \
+                 icpu_x86$(kernel##_sse42), icpu_x86$(kernel##_avx2), NULL)
+
+DISPATCHED$(pack, void, (const uint32_t* in, uint32_t* out, unsigned bits))
+DISPATCHED$(unpack_u32, void, (const uint32_t* in, uint32_t* out, unsigned bits, uint64_t base, bool delta))
+DISPATCHED$(unpack_u64, void, (const uint32_t* in, uint64_t* out, unsigned bits, uint64_t base, bool delta))
+DISPATCHED$(sum_block, uint64_t, (const uint32_t* in, unsigned bits, uint64_t base, bool delta, bool wide))
+
+
+//==== Encoding
+
+/// Turn values of a block into offsets, and add them to the array
+static void encode_block(ipacked_t* p, const uint64_t* v) {
+  const bool wide = p->width == 8;
+  ipacked_block_t block = { .offset = (uint32_t) ia_length(p->words) };
+  uint64_t off[IPACKED_BLOCK], max = 0;
+
+  if (p->mode == IPACKED_DELTA) {
+    block.base = v[0];
+    for (size_t k = 0; k < IPACKED_BLOCK; ++k) {
+      off[k] = v[k] - v[k >= 4 ? k - 4 : 0];
+      // Deltas of 32-bit values wrap around as 32-bit ones
+      if (!wide)
+        off[k] = (uint32_t) off[k];
+      max |= off[k];
+    }
+  } else {
+    block.base = v[0];
+    for (size_t k = 1; k < IPACKED_BLOCK; ++k)
+      if (v[k] < block.base) block.base = v[k];
+    for (size_t k = 0; k < IPACKED_BLOCK; ++k)
+      max |= off[k] = v[k] - block.base;
+  }
+
+  uint32_t words[IPACKED_BLOCK * 2];
+  if (max > UINT32_MAX) {
+    block.bits = RAW_BITS;
+    memcpy(words, v, sizeof(words));
+  } else {
+    block.bits = max ? 64 - (uint32_t) __builtin_clzll(max) : 0;
+    uint32_t narrow[IPACKED_BLOCK];
+    for (size_t k = 0; k < IPACKED_BLOCK; ++k)
+      narrow[k] = (uint32_t) off[k];
+    if (block.bits)
+      pack(narrow, words, block.bits);
+  }
+
+  check$(ia_length(p->words) + block_words(block.bits) <= UINT32_MAX, "Compressed array should fit 4G words");
+  ia_append$(&p->words, words, block_words(block.bits));
+  ia_push$(&p->blocks, block);
+}
+
+static void encode_all(ipacked_t* p, const void* arr, size_t len, uint32_t width, ipacked_mode_t mode) {
+  p->length = len;
+  p->width = width;
+  p->mode = mode;
+  p->blocks = ia_new_array_for$((len + IPACKED_BLOCK - 1) / IPACKED_BLOCK, ipacked_block_t);
+  p->words = ia_new_aligned_array_for$(0, uint32_t, IA_CACHE_LINE);
+  check$(p->blocks && p->words, "Should allocate compressed array");
+
+  for (size_t start = 0; start < len; start += IPACKED_BLOCK) {
+    uint64_t v[IPACKED_BLOCK];
+    size_t n = len - start < IPACKED_BLOCK ? len - start : IPACKED_BLOCK;
+    for (size_t k = 0; k < n; ++k)
+      v[k] = width == 8 ? ((const uint64_t*) arr)[start + k] : ((const uint32_t*) arr)[start + k];
+    // Last block is filled up with its last value, which adds no bits
+    for (size_t k = n; k < IPACKED_BLOCK; ++k)
+      v[k] = v[n - 1];
+    encode_block(p, v);
+  }
+}
+
+void ipacked_encode_u32(ipacked_t* p, const uint32_t* arr, ipacked_mode_t mode) {
+  encode_all(p, arr, ia_length(arr), 4, mode);
+}
+
+void ipacked_encode_u64(ipacked_t* p, const uint64_t* arr, ipacked_mode_t mode) {
+  encode_all(p, arr, ia_length(arr), 8, mode);
+}
+
+void ipacked_destroy(ipacked_t* p) {
+  ia_destroy_array(p->blocks);
+  ia_destroy_array(p->words);
+  p->blocks = NULL;
+  p->words = NULL;
+  p->length = 0;
+}
+
+size_t ipacked_bytes(const ipacked_t* p) {
+  return sizeof(*p) + ia_length(p->blocks) * sizeof(ipacked_block_t) + ia_length(p->words) * sizeof(uint32_t);
+}
+
+
+//==== Decoding
+
+/// Number of values in block `b`
+static size_t values_in(const ipacked_t* p, size_t b) {
+  size_t rest = p->length - b * IPACKED_BLOCK;
+  return rest < IPACKED_BLOCK ? rest : IPACKED_BLOCK;
+}
+
+uint64_t ipacked_get(const ipacked_t* p, size_t i) {
+  check$(i < p->length, "Index %zu is out of %zu values", i, p->length);
+
+  const ipacked_block_t* block = &p->blocks[i / IPACKED_BLOCK];
+  const uint32_t* in = p->words + block->offset;
+  size_t k = i % IPACKED_BLOCK;
+
+  if (block->bits == RAW_BITS) {
+    uint64_t v;
+    memcpy(&v, in + 2 * k, sizeof(v));
+    return v;
+  }
+
+  uint64_t v = block->base + extract(in, block->bits, k / 4, k % 4);
+  if (p->mode == IPACKED_DELTA)
+    for (size_t j = 0; j < k / 4; ++j)
+      v += extract(in, block->bits, j, k % 4);
+  return p->width == 8 ? v : (uint32_t) v;
+}
+
+/// Unpack whole block `b` into `out`
+static void block_u32(const ipacked_t* p, size_t b, uint32_t* out) {
+  const ipacked_block_t* block = &p->blocks[b];
+  unpack_u32(p->words + block->offset, out, block->bits, block->base, p->mode == IPACKED_DELTA);
+}
+
+static void block_u64(const ipacked_t* p, size_t b, uint64_t* out) {
+  const ipacked_block_t* block = &p->blocks[b];
+  if (block->bits == RAW_BITS)
+    memcpy(out, p->words + block->offset, IPACKED_BLOCK * sizeof(uint64_t));
+  else
+    unpack_u64(p->words + block->offset, out, block->bits, block->base, p->mode == IPACKED_DELTA);
+}
+
+size_t ipacked_block_u32(const ipacked_t* p, size_t b, uint32_t* out) {
+  check$(p->width == 4, "Values of 64 bits cannot be unpacked into 32 bits");
+  check$(b < ipacked_blocks(p), "Block %zu is out of %zu blocks", b, ipacked_blocks(p));
+  block_u32(p, b, out);
+  return values_in(p, b);
+}
+
+size_t ipacked_block_u64(const ipacked_t* p, size_t b, uint64_t* out) {
+  check$(p->width == 8, "Values of 32 bits should be unpacked into 32 bits");
+  check$(b < ipacked_blocks(p), "Block %zu is out of %zu blocks", b, ipacked_blocks(p));
+  block_u64(p, b, out);
+  return values_in(p, b);
+}
+
+// Whole blocks go straight into the array; only the last one, which may
+// not fill a block, goes through a buffer
+
+ia_arr$(uint32_t) ipacked_to_u32(const ipacked_t* p) {
+  check$(p->width == 4, "Values of 64 bits cannot be unpacked into 32 bits");
+  ia_arr$(uint32_t) arr = ia_new_aligned_array_of$(p->length, uint32_t, IA_CACHE_LINE);
+  check$(arr, "Should allocate unpacked array");
+
+  size_t full = p->length / IPACKED_BLOCK;
+  for (size_t b = 0; b < full; ++b)
+    block_u32(p, b, arr + b * IPACKED_BLOCK);
+  if (full < ipacked_blocks(p)) {
+    uint32_t last[IPACKED_BLOCK];
+    block_u32(p, full, last);
+    memcpy(arr + full * IPACKED_BLOCK, last, values_in(p, full) * sizeof(uint32_t));
+  }
+  return arr;
+}
+
+ia_arr$(uint64_t) ipacked_to_u64(const ipacked_t* p) {
+  check$(p->width == 8, "Values of 32 bits should be unpacked into 32 bits");
+  ia_arr$(uint64_t) arr = ia_new_aligned_array_of$(p->length, uint64_t, IA_CACHE_LINE);
+  check$(arr, "Should allocate unpacked array");
+
+  size_t full = p->length / IPACKED_BLOCK;
+  for (size_t b = 0; b < full; ++b)
+    block_u64(p, b, arr + b * IPACKED_BLOCK);
+  if (full < ipacked_blocks(p)) {
+    uint64_t last[IPACKED_BLOCK];
+    block_u64(p, full, last);
+    memcpy(arr + full * IPACKED_BLOCK, last, values_in(p, full) * sizeof(uint64_t));
+  }
+  return arr;
+}
+
+uint64_t ipacked_sum(const ipacked_t* p) {
+  const bool wide = p->width == 8, delta = p->mode == IPACKED_DELTA;
+  uint64_t sum = 0;
+
+  size_t full = p->length / IPACKED_BLOCK;
+  for (size_t b = 0; b < full; ++b) {
+    const ipacked_block_t* block = &p->blocks[b];
+    const uint32_t* in = p->words + block->offset;
+    if (block->bits == RAW_BITS)
+      for (size_t k = 0; k < IPACKED_BLOCK; ++k) {
+        uint64_t v;
+        memcpy(&v, in + 2 * k, sizeof(v));
+        sum += v;
+      }
+    else
+      sum += sum_block(in, block->bits, block->base, delta, wide);
+  }
+
+  if (full < ipacked_blocks(p)) {
+    uint64_t last[IPACKED_BLOCK];
+    if (wide)
+      block_u64(p, full, last);
+    else {
+      uint32_t narrow[IPACKED_BLOCK];
+      block_u32(p, full, narrow);
+      for (size_t k = 0; k < IPACKED_BLOCK; ++k)
+        last[k] = narrow[k];
+    }
+    for (size_t k = 0; k < values_in(p, full); ++k)
+      sum += last[k];
+  }
+  return sum;
+}
@@ -0,0 +1,225 @@
+#include "istd/ds/queue.h"
+#include "istd/util/err.h"
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+/// Failed attempts of a waiting thread before it goes to sleep
+#define SPINS 64
+
+//==== Helpers
+
+static _Atomic size_t* sequence_at(iqueue_t* q, size_t pos) {
+  return (_Atomic size_t*) (q->cells + (pos & q->mask) * q->stride);
+}
+
+static char* item_at(iqueue_t* q, size_t pos) {
+  return q->cells + (pos & q->mask) * q->stride + sizeof(size_t);
+}
+
+static void relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+/// Returns `0` when woken by `futex_wake()`
+static long futex_wait(_Atomic uint32_t* word, uint32_t seen) {
+  return syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+}
+
+/// Wakes up to `n` threads waiting on `word`, and counts them out of
+/// `sleepers`, so next calls do not wake them again before they run
+static void futex_wake(_Atomic uint32_t* word, _Atomic uint32_t* sleepers, size_t n) {
+  atomic_fetch_add_explicit(word, 1, memory_order_release);
+  long woken = syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, n > INT_MAX ? INT_MAX : (int) n, NULL, NULL, 0);
+  if (woken > 0)
+    atomic_fetch_sub_explicit(sleepers, (uint32_t) woken, memory_order_relaxed);
+}
+
+/// Wake up to `n` threads sleeping on `word`, if there are any.
+///
+/// Fence pairs with one in `sleep_on()`: either the sleeper is seen
+/// here, or the sleeper sees cells changed before this call.
+///
+static void notify(_Atomic uint32_t* word, _Atomic uint32_t* sleepers, size_t n) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(sleepers, memory_order_relaxed))
+    futex_wake(word, sleepers, n);
+}
+
+/// Take up to `n` cells at `cursor`, which are ready when their sequence
+/// is position plus `offset`. Stores position of the first one into `pos`.
+static size_t claim(iqueue_t* q, _Atomic size_t* cursor, size_t offset, size_t n, size_t* pos) {
+
+  size_t p = atomic_load_explicit(cursor, memory_order_relaxed);
+  for (;;) {
+    size_t k = 0;
+    while (k < n && atomic_load_explicit(sequence_at(q, p + k), memory_order_acquire) == p + k + offset)
+      ++k;
+
+    if (!k) {
+      // Either the queue is full (empty), or someone took the cell first
+      size_t now = atomic_load_explicit(cursor, memory_order_relaxed);
+      if (now == p)
+        return 0;
+      p = now;
+      continue;
+    }
+
+    if (atomic_compare_exchange_weak_explicit(cursor, &p, p + k, memory_order_relaxed, memory_order_relaxed)) {
+      *pos = p;
+      return k;
+    }
+  }
+}
+
+//==== Implementations
+
+void iqueue_init(iqueue_t* q, size_t capacity, size_t item_size) {
+
+  check$(item_size, "Items of queue must have nonzero size");
+  check$(capacity <= SIZE_MAX / 4, "Capacity of queue is too large: %zu", capacity);
+
+  size_t cells = 2;
+  while (cells < capacity)
+    cells *= 2;
+  size_t stride = (sizeof(size_t) + item_size + 7) & ~(size_t) 7;
+  check$(stride <= SIZE_MAX / cells, "Queue of %zu items of %zu bytes is too large", cells, item_size);
+
+  memset(q, 0, sizeof(*q));
+  q->cells = ia_alloc_aligned_array(0, cells * stride, 1, IA_CACHE_LINE);
+  q->mask = cells - 1;
+  q->item_size = item_size;
+  q->stride = stride;
+
+  for (size_t i = 0; i < cells; ++i)
+    atomic_init(sequence_at(q, i), i);
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+  atomic_init(&q->pushed, 0);
+  atomic_init(&q->popped, 0);
+  atomic_init(&q->pop_sleepers, 0);
+  atomic_init(&q->push_sleepers, 0);
+  atomic_init(&q->closed, false);
+}
+
+void iqueue_destroy(iqueue_t* q) {
+  ia_destroy_array(q->cells);
+  q->cells = NULL;
+}
+
+size_t iqueue_length(iqueue_t* q) {
+  size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+  // Cursors are read at different moments
+  return head > tail ? (head - tail > q->mask + 1 ? q->mask + 1 : head - tail) : 0;
+}
+
+size_t iqueue_try_push_many(iqueue_t* q, const void* items, size_t n) {
+
+  size_t pos, k = claim(q, &q->head, 0, n, &pos);
+  for (size_t i = 0; i < k; ++i) {
+    memcpy(item_at(q, pos + i), (const char*) items + i * q->item_size, q->item_size);
+    atomic_store_explicit(sequence_at(q, pos + i), pos + i + 1, memory_order_release);
+  }
+
+  if (k)
+    notify(&q->pushed, &q->pop_sleepers, k);
+  return k;
+}
+
+size_t iqueue_try_pop_many(iqueue_t* q, void* items, size_t max) {
+
+  size_t pos, k = claim(q, &q->tail, 1, max, &pos);
+  for (size_t i = 0; i < k; ++i) {
+    memcpy((char*) items + i * q->item_size, item_at(q, pos + i), q->item_size);
+    // Cell is free on the next lap
+    atomic_store_explicit(sequence_at(q, pos + i), pos + i + q->mask + 1, memory_order_release);
+  }
+
+  if (k)
+    notify(&q->popped, &q->push_sleepers, k);
+  return k;
+}
+
+bool iqueue_try_push(iqueue_t* q, const void* item) {
+  return iqueue_try_push_many(q, item, 1);
+}
+
+bool iqueue_try_pop(iqueue_t* q, void* item) {
+  return iqueue_try_pop_many(q, item, 1);
+}
+
+/// Sleep until items are popped (`push` is true) or pushed, unless the
+/// attempt made after announcing the sleep succeeds. Returns its result.
+static size_t sleep_on(iqueue_t* q, bool push, void* items, size_t n) {
+
+  _Atomic uint32_t* word = push ? &q->popped : &q->pushed;
+  _Atomic uint32_t* sleepers = push ? &q->push_sleepers : &q->pop_sleepers;
+
+  uint32_t seen = atomic_load_explicit(word, memory_order_acquire);
+  atomic_fetch_add_explicit(sleepers, 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+
+  size_t k = push ? iqueue_try_push_many(q, items, n) : iqueue_try_pop_many(q, items, n);
+  // Thread woken by `futex_wake()` was counted out by the waker
+  if (k || atomic_load(&q->closed) || futex_wait(word, seen))
+    atomic_fetch_sub_explicit(sleepers, 1, memory_order_relaxed);
+  return k;
+}
+
+size_t iqueue_push_many(iqueue_t* q, const void* items, size_t n) {
+
+  size_t done = 0;
+  for (unsigned spins = 0; done < n && !atomic_load(&q->closed);) {
+    const char* rest = (const char*) items + done * q->item_size;
+    size_t k = iqueue_try_push_many(q, rest, n - done);
+    if (!k && ++spins > SPINS)
+      k = sleep_on(q, true, (void*) rest, n - done);
+    else if (!k)
+      relax();
+
+    if (k)
+      spins = 0;
+    done += k;
+  }
+  return done;
+}
+
+size_t iqueue_pop_many(iqueue_t* q, void* items, size_t max) {
+
+  if (!max)
+    return 0;
+
+  for (unsigned spins = 0;;) {
+    size_t k = iqueue_try_pop_many(q, items, max);
+    if (k)
+      return k;
+    // Items pushed before closing are seen after it
+    if (atomic_load(&q->closed))
+      return iqueue_try_pop_many(q, items, max);
+
+    if (++spins <= SPINS)
+      relax();
+    else if ((k = sleep_on(q, false, items, max)))
+      return k;
+  }
+}
+
+bool iqueue_push(iqueue_t* q, const void* item) {
+  return iqueue_push_many(q, item, 1);
+}
+
+bool iqueue_pop(iqueue_t* q, void* item) {
+  return iqueue_pop_many(q, item, 1);
+}
+
+void iqueue_close(iqueue_t* q) {
+  atomic_store(&q->closed, true);
+  atomic_thread_fence(memory_order_seq_cst);
+  futex_wake(&q->pushed, &q->pop_sleepers, SIZE_MAX);
+  futex_wake(&q->popped, &q->push_sleepers, SIZE_MAX);
+}
@@ -0,0 +1,692 @@
+/**
+ * \brief Implementation of gap buffer and rope.
+ *
+ * Rope is a treap: binary search tree by position in the text, and a heap
+ * by random node priority. Random priorities keep it balanced with high
+ * probability, and two operations are enough to do everything else:
+ *
+ *  - `split()` cuts the tree into text before and after given position,
+ *    splitting a chunk in two if needed;
+ *  - `merge()` concatenates two trees.
+ *
+ * Typing and deleting mostly change one chunk, so those are done in place,
+ * only updating cached counts on the path to the root.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "istd/ds/arr.h"
+#include "istd/ds/text.h"
+#include "istd/util/alloc.h"
+#include "istd/util/err.h"
+#include "istd/util/utf8.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+/// Length of codepoint at `ptr`, decoding it into `cp`.
+/// Invalid UTF8 is treated as one-byte codepoints.
+static size_t step_forward(const char* ptr, rune* cp) {
+  const char* next = utf8_next(ptr, cp);
+  if (next == NULL || next == ptr) {
+    *cp = (uint8_t) *ptr;
+    return 1;
+  }
+  return (size_t) (next - ptr);
+}
+
+/// Length of codepoint before `ptr`, decoding it into `cp`.
+/// Invalid UTF8 is treated as one-byte codepoints.
+static size_t step_backward(const char* ptr, const char* begin, rune* cp) {
+  const char* prev = utf8_prev(ptr, begin, cp);
+  if (prev == NULL) {
+    *cp = (uint8_t) ptr[-1];
+    return 1;
+  }
+  return (size_t) (ptr - prev);
+}
+
+//==== Gap buffer
+
+/// Size of the gap of new buffer
+#define GAP_MIN 64
+
+void itext_gap_init(itext_gap_t* gap, const char* str, size_t len) {
+
+  assert(gap);
+  assert(str || len == 0);
+
+  gap->capacity = len + GAP_MIN;
+  gap->data = calloc_checked$(gap->capacity + 1, char, "Failed to allocate gap buffer");
+  if (len)
+    memcpy(gap->data, str, len);
+  gap->gap_begin = len;
+  gap->gap_end = gap->capacity;
+}
+
+void itext_gap_destroy(itext_gap_t* gap) {
+  assert(gap);
+  istd_free(gap->data);
+  gap->data = NULL;
+  gap->capacity = gap->gap_begin = gap->gap_end = 0;
+}
+
+size_t itext_gap_length(const itext_gap_t* gap) {
+  assert(gap);
+  return gap->capacity - (gap->gap_end - gap->gap_begin);
+}
+
+size_t itext_gap_cursor(const itext_gap_t* gap) {
+  assert(gap);
+  return gap->gap_begin;
+}
+
+/// Move `n` bytes from before the gap to after it
+static void shift_back(itext_gap_t* gap, size_t n) {
+  memmove(gap->data + gap->gap_end - n, gap->data + gap->gap_begin - n, n);
+  gap->gap_begin -= n;
+  gap->gap_end -= n;
+}
+
+/// Move `n` bytes from after the gap to before it
+static void shift_forward(itext_gap_t* gap, size_t n) {
+  memmove(gap->data + gap->gap_begin, gap->data + gap->gap_end, n);
+  gap->gap_begin += n;
+  gap->gap_end += n;
+}
+
+void itext_gap_seek(itext_gap_t* gap, size_t pos) {
+
+  assert(gap);
+  check$(pos <= itext_gap_length(gap),
+         "Cannot seek to %zu in text of %zu bytes", pos, itext_gap_length(gap));
+
+  if (pos < gap->gap_begin)
+    shift_back(gap, gap->gap_begin - pos);
+  else
+    shift_forward(gap, pos - gap->gap_begin);
+}
+
+bool itext_gap_forward(itext_gap_t* gap, rune* cp) {
+
+  assert(gap);
+
+  rune dummy;
+  if (!cp)
+    cp = &dummy;
+
+  if (gap->gap_end == gap->capacity) {
+    *cp = 0;
+    return false;
+  }
+
+  // Buffer ends with `\0`, so decoder will stop there
+  shift_forward(gap, step_forward(gap->data + gap->gap_end, cp));
+  return true;
+}
+
+bool itext_gap_backward(itext_gap_t* gap, rune* cp) {
+
+  assert(gap);
+
+  rune dummy;
+  if (!cp)
+    cp = &dummy;
+
+  if (gap->gap_begin == 0) {
+    *cp = 0;
+    return false;
+  }
+
+  shift_back(gap, step_backward(gap->data + gap->gap_begin, gap->data, cp));
+  return true;
+}
+
+/// Make sure the gap fits `n` more bytes
+static void gap_must_have_space(itext_gap_t* gap, size_t n) {
+
+  if (gap->gap_end - gap->gap_begin >= n)
+    return;
+
+  size_t len = itext_gap_length(gap);
+  size_t tail = gap->capacity - gap->gap_end;
+  size_t capacity = MAX(gap->capacity * 2, len + n + GAP_MIN);
+
+  char* data = calloc_checked$(capacity + 1, char, "Failed to grow gap buffer");
+  memcpy(data, gap->data, gap->gap_begin);
+  memcpy(data + capacity - tail, gap->data + gap->gap_end, tail);
+  istd_free(gap->data);
+
+  gap->data = data;
+  gap->capacity = capacity;
+  gap->gap_end = capacity - tail;
+}
+
+void itext_gap_insert(itext_gap_t* gap, const char* str, size_t len) {
+
+  assert(gap);
+  assert(str || len == 0);
+
+  gap_must_have_space(gap, len);
+  if (len)
+    memcpy(gap->data + gap->gap_begin, str, len);
+  gap->gap_begin += len;
+}
+
+size_t itext_gap_erase_backward(itext_gap_t* gap, size_t n) {
+
+  assert(gap);
+
+  size_t erased = 0;
+  for (; erased < n && gap->gap_begin > 0; ++erased) {
+    rune cp;
+    gap->gap_begin -= step_backward(gap->data + gap->gap_begin, gap->data, &cp);
+  }
+  return erased;
+}
+
+size_t itext_gap_erase_forward(itext_gap_t* gap, size_t n) {
+
+  assert(gap);
+
+  size_t erased = 0;
+  for (; erased < n && gap->gap_end < gap->capacity; ++erased) {
+    rune cp;
+    gap->gap_end += step_forward(gap->data + gap->gap_end, &cp);
+  }
+  return erased;
+}
+
+void itext_gap_copy(const itext_gap_t* gap, ia_arr$(char)* out) {
+
+  assert(gap);
+  assert(out);
+
+  ia_append$(out, gap->data, gap->gap_begin);
+  ia_append$(out, gap->data + gap->gap_end, gap->capacity - gap->gap_end);
+}
+
+//==== Rope nodes
+
+struct itext_node_t {
+  itext_node_t* left;
+  itext_node_t* right;
+  uint64_t priority;
+
+  /// Counts of this node's own text
+  itext_counts_t own;
+
+  /// Counts of the whole subtree, including this node
+  itext_counts_t sum;
+
+  /// Text of the node, `\0`-terminated
+  char text[ITEXT_CHUNK + 1];
+};
+
+static const itext_counts_t no_counts = { 0, 0, 0 };
+
+static inline itext_counts_t sum_of(const itext_node_t* t) {
+  return t ? t->sum : no_counts;
+}
+
+static inline itext_counts_t add_counts(itext_counts_t a, itext_counts_t b) {
+  return (itext_counts_t) {
+    .bytes = a.bytes + b.bytes,
+    .codepoints = a.codepoints + b.codepoints,
+    .newlines = a.newlines + b.newlines,
+  };
+}
+
+static inline itext_counts_t sub_counts(itext_counts_t a, itext_counts_t b) {
+  return (itext_counts_t) {
+    .bytes = a.bytes - b.bytes,
+    .codepoints = a.codepoints - b.codepoints,
+    .newlines = a.newlines - b.newlines,
+  };
+}
+
+/// Count bytes, codepoints and newlines in the text
+static itext_counts_t count_text(const char* str, size_t len) {
+  itext_counts_t c = { .bytes = len };
+  for (size_t i = 0; i < len; ++i) {
+    c.codepoints += !_utf8_is_continuation((uint8_t) str[i]);
+    c.newlines += str[i] == '\n';
+  }
+  return c;
+}
+
+static void update(itext_node_t* t) {
+  t->sum = add_counts(add_counts(sum_of(t->left), t->own), sum_of(t->right));
+}
+
+/// xorshift64*, good enough for treap priorities
+static uint64_t next_priority(itext_rope_t* rope) {
+  rope->seed ^= rope->seed >> 12;
+  rope->seed ^= rope->seed << 25;
+  rope->seed ^= rope->seed >> 27;
+  return rope->seed * UINT64_C(2685821657736338717);
+}
+
+static itext_node_t* new_node(itext_rope_t* rope, const char* str, size_t len) {
+  assert(len <= ITEXT_CHUNK);
+
+  itext_node_t* t = calloc_checked$(1, itext_node_t, "Failed to allocate rope node");
+  memcpy(t->text, str, len);
+  t->text[len] = '\0';
+  t->own = t->sum = count_text(str, len);
+  t->priority = next_priority(rope);
+  return t;
+}
+
+static void free_tree(itext_node_t* t) {
+  if (!t)
+    return;
+  free_tree(t->left);
+  free_tree(t->right);
+  istd_free(t);
+}
+
+//==== Split and merge
+
+static itext_node_t* merge(itext_node_t* a, itext_node_t* b) {
+  if (!a) return b;
+  if (!b) return a;
+
+  if (a->priority > b->priority) {
+    a->right = merge(a->right, b);
+    update(a);
+    return a;
+  } else {
+    b->left = merge(a, b->left);
+    update(b);
+    return b;
+  }
+}
+
+/// Split tree into `[0, pos)` and `[pos, ...)`
+static void split(itext_rope_t* rope, itext_node_t* t, size_t pos,
+                  itext_node_t** l, itext_node_t** r) {
+
+  if (!t) {
+    *l = *r = NULL;
+    return;
+  }
+
+  size_t left_bytes = sum_of(t->left).bytes;
+
+  if (pos <= left_bytes) {
+    split(rope, t->left, pos, l, &t->left);
+    update(t);
+    *r = t;
+    return;
+  }
+
+  pos -= left_bytes;
+
+  if (pos >= t->own.bytes) {
+    split(rope, t->right, pos - t->own.bytes, &t->right, r);
+    update(t);
+    *l = t;
+    return;
+  }
+
+  // Split is inside of this node's chunk
+  itext_node_t* tail = new_node(rope, t->text + pos, t->own.bytes - pos);
+  t->text[pos] = '\0';
+  t->own = count_text(t->text, pos);
+  *r = merge(tail, t->right);
+  t->right = NULL;
+  update(t);
+  *l = t;
+}
+
+/// Build tree of given text, cutting it into chunks on codepoint boundaries
+static itext_node_t* build(itext_rope_t* rope, const char* str, size_t len) {
+
+  itext_node_t* root = NULL;
+
+  while (len) {
+    size_t n = MIN(len, (size_t) ITEXT_CHUNK);
+    if (n < len) {
+      size_t cut = n;
+      while (cut > 0 && _utf8_is_continuation((uint8_t) str[cut]))
+        --cut;
+      if (cut > 0) // Otherwise it is not UTF8 anyway
+        n = cut;
+    }
+
+    root = merge(root, new_node(rope, str, n));
+    str += n;
+    len -= n;
+  }
+
+  return root;
+}
+
+//==== In-place edits
+
+/// Insert into the chunk containing `pos`, if it has enough space
+static bool insert_in_place(itext_node_t* t, size_t pos, const char* str,
+                            size_t len, itext_counts_t added) {
+  if (!t)
+    return false;
+
+  size_t left_bytes = sum_of(t->left).bytes;
+  bool done;
+
+  if (pos < left_bytes) {
+    done = insert_in_place(t->left, pos, str, len, added);
+  } else if (pos <= left_bytes + t->own.bytes) {
+    if (t->own.bytes + len > ITEXT_CHUNK)
+      return false;
+
+    size_t off = pos - left_bytes;
+    memmove(t->text + off + len, t->text + off, t->own.bytes - off + 1);
+    memcpy(t->text + off, str, len);
+    t->own = add_counts(t->own, added);
+    done = true;
+  } else {
+    done = insert_in_place(t->right, pos - left_bytes - t->own.bytes, str, len, added);
+  }
+
+  if (done)
+    t->sum = add_counts(t->sum, added);
+  return done;
+}
+
+/// Delete from one chunk, if the whole range is inside of it
+static bool delete_in_place(itext_node_t* t, size_t pos, size_t len) {
+  if (!t)
+    return false;
+
+  size_t left_bytes = sum_of(t->left).bytes;
+
+  if (pos < left_bytes) {
+    if (pos + len > left_bytes || !delete_in_place(t->left, pos, len))
+      return false;
+    update(t);
+    return true;
+  }
+
+  pos -= left_bytes;
+
+  if (pos < t->own.bytes) {
+    // Keep at least something in the node, otherwise
+    // it is better to remove it completely
+    if (pos + len > t->own.bytes || len == t->own.bytes)
+      return false;
+
+    itext_counts_t removed = count_text(t->text + pos, len);
+    memmove(t->text + pos, t->text + pos + len, t->own.bytes - pos - len + 1);
+    t->own = sub_counts(t->own, removed);
+    t->sum = sub_counts(t->sum, removed);
+    return true;
+  }
+
+  if (!delete_in_place(t->right, pos - t->own.bytes, len))
+    return false;
+  update(t);
+  return true;
+}
+
+//==== Rope
+
+void itext_rope_init(itext_rope_t* rope, const char* str, size_t len) {
+
+  assert(rope);
+  assert(str || len == 0);
+
+  rope->seed = UINT64_C(0x9E3779B97F4A7C15);
+  rope->root = build(rope, str, len);
+}
+
+void itext_rope_destroy(itext_rope_t* rope) {
+  assert(rope);
+  free_tree(rope->root);
+  rope->root = NULL;
+}
+
+itext_counts_t itext_rope_counts(const itext_rope_t* rope) {
+  assert(rope);
+  return sum_of(rope->root);
+}
+
+itext_counts_t itext_rope_counts_before(const itext_rope_t* rope, size_t pos) {
+
+  assert(rope);
+  check$(pos <= sum_of(rope->root).bytes,
+         "Position %zu is out of text of %zu bytes", pos, sum_of(rope->root).bytes);
+
+  itext_counts_t acc = no_counts;
+  const itext_node_t* t = rope->root;
+
+  while (t) {
+    itext_counts_t left = sum_of(t->left);
+    if (pos < left.bytes) {
+      t = t->left;
+      continue;
+    }
+
+    acc = add_counts(acc, left);
+    pos -= left.bytes;
+
+    if (pos <= t->own.bytes)
+      return add_counts(acc, count_text(t->text, pos));
+
+    acc = add_counts(acc, t->own);
+    pos -= t->own.bytes;
+    t = t->right;
+  }
+
+  return acc;
+}
+
+void itext_rope_insert(itext_rope_t* rope, size_t pos, const char* str, size_t len) {
+
+  assert(rope);
+  assert(str || len == 0);
+  check$(pos <= sum_of(rope->root).bytes,
+         "Cannot insert at %zu into text of %zu bytes", pos, sum_of(rope->root).bytes);
+
+  if (len == 0)
+    return;
+
+  if (insert_in_place(rope->root, pos, str, len, count_text(str, len)))
+    return;
+
+  itext_node_t *l, *r;
+  split(rope, rope->root, pos, &l, &r);
+  rope->root = merge(merge(l, build(rope, str, len)), r);
+}
+
+void itext_rope_delete(itext_rope_t* rope, size_t pos, size_t len) {
+
+  assert(rope);
+  check$(pos + len <= sum_of(rope->root).bytes,
+         "Cannot delete %zu bytes at %zu from text of %zu bytes",
+         len, pos, sum_of(rope->root).bytes);
+
+  if (len == 0)
+    return;
+
+  if (delete_in_place(rope->root, pos, len))
+    return;
+
+  itext_node_t *l, *mid, *r;
+  split(rope, rope->root, pos, &l, &r);
+  split(rope, r, len, &mid, &r);
+  free_tree(mid);
+  rope->root = merge(l, r);
+}
+
+size_t itext_rope_byte_of_codepoint(const itext_rope_t* rope, size_t cp) {
+
+  assert(rope);
+  itext_counts_t total = sum_of(rope->root);
+  check$(cp <= total.codepoints,
+         "Codepoint %zu is out of text of %zu codepoints", cp, total.codepoints);
+
+  if (cp == total.codepoints)
+    return total.bytes;
+
+  size_t byte = 0;
+  const itext_node_t* t = rope->root;
+
+  while (true) {
+    itext_counts_t left = sum_of(t->left);
+    if (cp < left.codepoints) {
+      t = t->left;
+      continue;
+    }
+
+    byte += left.bytes;
+    cp -= left.codepoints;
+
+    if (cp < t->own.codepoints) {
+      // `cp`-th lead byte of the chunk
+      size_t i = 0;
+      for (;; ++i)
+        if (!_utf8_is_continuation((uint8_t) t->text[i]) && cp-- == 0)
+          return byte + i;
+    }
+
+    byte += t->own.bytes;
+    cp -= t->own.codepoints;
+    t = t->right;
+  }
+}
+
+size_t itext_rope_byte_of_line(const itext_rope_t* rope, size_t line) {
+
+  assert(rope);
+  itext_counts_t total = sum_of(rope->root);
+  check$(line <= total.newlines,
+         "Line %zu is out of text of %zu lines", line, total.newlines + 1);
+
+  if (line == 0)
+    return 0;
+
+  // Find `line`-th newline, line begins after it
+  size_t byte = 0;
+  const itext_node_t* t = rope->root;
+
+  while (true) {
+    itext_counts_t left = sum_of(t->left);
+    if (line <= left.newlines) {
+      t = t->left;
+      continue;
+    }
+
+    byte += left.bytes;
+    line -= left.newlines;
+
+    if (line <= t->own.newlines) {
+      for (size_t i = 0;; ++i)
+        if (t->text[i] == '\n' && --line == 0)
+          return byte + i + 1;
+    }
+
+    byte += t->own.bytes;
+    line -= t->own.newlines;
+    t = t->right;
+  }
+}
+
+/// Find node with byte `pos` in it. If `before` is set, finds node with
+/// byte `pos - 1`, so that its text can be read backwards from `pos`.
+static const itext_node_t* locate(const itext_node_t* t, size_t pos, bool before, size_t* offset) {
+
+  while (t) {
+    size_t left_bytes = sum_of(t->left).bytes;
+    if (before ? pos <= left_bytes : pos < left_bytes) {
+      t = t->left;
+      continue;
+    }
+
+    pos -= left_bytes;
+    if (before ? pos <= t->own.bytes : pos < t->own.bytes) {
+      *offset = pos;
+      return t;
+    }
+
+    pos -= t->own.bytes;
+    t = t->right;
+  }
+
+  return NULL;
+}
+
+size_t itext_rope_next(const itext_rope_t* rope, size_t pos, rune* cp) {
+
+  assert(rope);
+
+  rune dummy;
+  if (!cp)
+    cp = &dummy;
+
+  size_t offset = 0;
+  const itext_node_t* t = locate(rope->root, pos, false, &offset);
+  if (!t) {
+    check$(pos == sum_of(rope->root).bytes, "Position %zu is out of the text", pos);
+    *cp = 0;
+    return pos;
+  }
+
+  return pos + step_forward(t->text + offset, cp);
+}
+
+size_t itext_rope_prev(const itext_rope_t* rope, size_t pos, rune* cp) {
+
+  assert(rope);
+  check$(pos <= sum_of(rope->root).bytes, "Position %zu is out of the text", pos);
+
+  rune dummy;
+  if (!cp)
+    cp = &dummy;
+
+  size_t offset = 0;
+  const itext_node_t* t = pos ? locate(rope->root, pos, true, &offset) : NULL;
+  if (!t) {
+    *cp = 0;
+    return 0;
+  }
+
+  return pos - step_backward(t->text + offset, t->text, cp);
+}
+
+/// Append `[pos, pos + len)` of the subtree to `*out`
+static void copy_range(const itext_node_t* t, size_t pos, size_t len, ia_arr$(char)* out) {
+
+  if (!t || len == 0)
+    return;
+
+  size_t end = pos + len;
+  size_t own_begin = sum_of(t->left).bytes;
+  size_t own_end = own_begin + t->own.bytes;
+
+  if (pos < own_begin)
+    copy_range(t->left, pos, MIN(end, own_begin) - pos, out);
+
+  size_t a = MAX(pos, own_begin), b = MIN(end, own_end);
+  if (a < b)
+    ia_append$(out, t->text + (a - own_begin), b - a);
+
+  if (end > own_end) {
+    size_t from = MAX(pos, own_end);
+    copy_range(t->right, from - own_end, end - from, out);
+  }
+}
+
+void itext_rope_copy(const itext_rope_t* rope, size_t pos, size_t len, ia_arr$(char)* out) {
+
+  assert(rope);
+  assert(out);
+  check$(pos + len <= sum_of(rope->root).bytes,
+         "Cannot copy %zu bytes at %zu from text of %zu bytes",
+         len, pos, sum_of(rope->root).bytes);
+
+  copy_range(rope->root, pos, len, out);
+}
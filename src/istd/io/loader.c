@@ -0,0 +1,414 @@
+#include "istd/io/loader.h"
+#include "istd/util/alloc.h"
+#include "istd/util/err.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/// Largest read asked for at once, as io_uring takes 32-bit lengths
+#define MAX_READ (1u << 30)
+
+void iloader_release(iloader_file_t* files, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    ia_destroy_array(files[i].data);
+    files[i].data = NULL;
+  }
+}
+
+/// Put `data` with `got` bytes read into `file`, or `error`
+static void finish_file(iloader_file_t* file, ia_arr$(char) data, size_t got, int error) {
+  if (error) {
+    ia_destroy_array(data);
+    data = NULL;
+  } else
+    ia_set_length$(&data, got);
+  file->data = data;
+  file->error = error;
+}
+
+
+//==== Threads
+
+typedef struct {
+  const char* const* paths;
+  iloader_file_t* files;
+  size_t count;
+  /// Index of next file to be read by some thread
+  atomic_size_t next;
+} threads_job_t;
+
+static void pread_file(const char* path, iloader_file_t* file) {
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    finish_file(file, NULL, 0, errno);
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st)) {
+    finish_file(file, NULL, 0, errno);
+    close(fd);
+    return;
+  }
+
+  size_t size = (size_t) st.st_size;
+  ia_arr$(char) data = ia_new_array_for$(size, char);
+  size_t got = 0;
+  int error = 0;
+  while (got < size) {
+    ssize_t n = pread(fd, data + got, size - got, (off_t) got);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      error = n ? errno : 0;
+      break;
+    }
+    got += (size_t) n;
+  }
+  close(fd);
+  finish_file(file, data, got, error);
+}
+
+static void* threads_worker(void* arg) {
+  threads_job_t* job = (threads_job_t*) arg;
+  for (size_t i; (i = atomic_fetch_add(&job->next, 1)) < job->count;)
+    pread_file(job->paths[i], &job->files[i]);
+  return NULL;
+}
+
+static void load_with_threads(const char* const* paths, size_t count, iloader_file_t* files) {
+  threads_job_t job = { .paths = paths, .files = files, .count = count };
+  atomic_init(&job.next, 0);
+
+  // Calling thread reads too, and alone if no thread can be started
+  pthread_t threads[ILOADER_MAX_THREADS - 1];
+  size_t started = 0;
+  while (started < ILOADER_MAX_THREADS - 1 && started + 1 < count
+         && !pthread_create(&threads[started], NULL, threads_worker, &job))
+    started++;
+
+  threads_worker(&job);
+  for (size_t i = 0; i < started; ++i)
+    pthread_join(threads[i], NULL);
+}
+
+
+//==== io_uring
+
+/// Rings shared with the kernel
+typedef struct {
+  int fd;
+  void* sq_ring;
+  void* cq_ring;
+  size_t sq_ring_size;
+  size_t cq_ring_size;
+  struct io_uring_sqe* sqes;
+  size_t sqes_size;
+
+  unsigned* sq_tail;
+  unsigned sq_mask;
+  /// Tail after entries written so far, given to the kernel on submit
+  unsigned tail;
+  /// Entries the kernel has not taken yet
+  unsigned to_submit;
+
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned cq_mask;
+  struct io_uring_cqe* cqes;
+} uring_t;
+
+static void uring_close(uring_t* ring) {
+  if (ring->sqes)
+    munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  if (ring->sq_ring)
+    munmap(ring->sq_ring, ring->sq_ring_size);
+  close(ring->fd);
+}
+
+/// Whether the kernel can do each operation the loader asks for
+static bool uring_has_ops(int fd) {
+  enum { OPS = 64 };
+  alignas(struct io_uring_probe) char buffer[sizeof(struct io_uring_probe) + OPS * sizeof(struct io_uring_probe_op)];
+  memset(buffer, 0, sizeof(buffer));
+  struct io_uring_probe* probe = (struct io_uring_probe*) buffer;
+  if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, OPS) < 0)
+    return false;
+
+  static const uint8_t needed[] = { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE };
+  for (size_t i = 0; i < sizeof(needed); ++i)
+    if (needed[i] > probe->last_op || !(probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED))
+      return false;
+  return true;
+}
+
+/// Set up rings for `entries` operations at once. Returns `false` with
+/// `errno` set, when io_uring cannot be used.
+static bool uring_open(uring_t* ring, unsigned entries) {
+
+  memset(ring, 0, sizeof(*ring));
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring->fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0)
+    return false;
+
+  if (!uring_has_ops(ring->fd)) {
+    close(ring->fd);
+    errno = ENOSYS;
+    return false;
+  }
+
+  ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single && ring->cq_ring_size > ring->sq_ring_size)
+    ring->sq_ring_size = ring->cq_ring_size;
+
+  ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring->fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ring == MAP_FAILED) {
+    ring->sq_ring = NULL;
+    goto fail;
+  }
+  ring->cq_ring = single ? ring->sq_ring
+                         : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                ring->fd, IORING_OFF_CQ_RING);
+  if (ring->cq_ring == MAP_FAILED) {
+    ring->cq_ring = NULL;
+    goto fail;
+  }
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring->fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) {
+    ring->sqes = NULL;
+    goto fail;
+  }
+
+  char* sq = (char*) ring->sq_ring;
+  char* cq = (char*) ring->cq_ring;
+  ring->sq_tail = (unsigned*) (sq + params.sq_off.tail);
+  ring->tail = *ring->sq_tail;
+  ring->sq_mask = *(unsigned*) (sq + params.sq_off.ring_mask);
+  ring->cq_head = (unsigned*) (cq + params.cq_off.head);
+  ring->cq_tail = (unsigned*) (cq + params.cq_off.tail);
+  ring->cq_mask = *(unsigned*) (cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+
+  // Entries are always taken in order, so each slot of the ring points
+  // to the entry of the same index
+  unsigned* array = (unsigned*) (sq + params.sq_off.array);
+  for (unsigned i = 0; i < params.sq_entries; ++i)
+    array[i] = i;
+  return true;
+
+ fail: {
+    int err = errno;
+    uring_close(ring);
+    errno = err;
+    return false;
+  }
+}
+
+/// Next free entry of submission ring, which has room for all operations
+/// the loader has in flight
+static struct io_uring_sqe* uring_entry(uring_t* ring, uint8_t opcode, uint64_t user_data) {
+  struct io_uring_sqe* sqe = &ring->sqes[ring->tail++ & ring->sq_mask];
+  ring->to_submit++;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->user_data = user_data;
+  return sqe;
+}
+
+/// Hand written entries to the kernel, and wait until something is done.
+/// Entries the kernel has not taken stay in the ring for the next call.
+static void uring_submit_and_wait(uring_t* ring) {
+  __atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+  long taken;
+  while ((taken = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0)) < 0)
+    check$(errno == EINTR || errno == EAGAIN || errno == EBUSY, "Should submit to io_uring");
+  ring->to_submit -= (unsigned) taken;
+}
+
+
+/// Step of reading a file, in low bits of `user_data`
+enum { STEP_OPEN, STEP_READ, STEP_CLOSE, STEP_BITS = 2 };
+
+/// File being read through io_uring, with one operation in flight
+typedef struct {
+  size_t file;
+  int fd;
+  int error;
+  size_t size;
+  size_t got;
+  ia_arr$(char) data;
+} uring_slot_t;
+
+typedef struct {
+  uring_t ring;
+  const char* const* paths;
+  iloader_file_t* files;
+  uring_slot_t slots[ILOADER_BATCH];
+  /// Indices of free slots, `free_count` of them
+  unsigned free[ILOADER_BATCH];
+  unsigned free_count;
+} uring_job_t;
+
+static void queue_step(uring_job_t* job, unsigned index, unsigned step) {
+  uring_slot_t* slot = &job->slots[index];
+  struct io_uring_sqe* sqe;
+
+  switch (step) {
+  case STEP_OPEN:
+    sqe = uring_entry(&job->ring, IORING_OP_OPENAT, index << STEP_BITS | STEP_OPEN);
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uintptr_t) job->paths[slot->file];
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    break;
+  case STEP_READ: {
+    size_t left = slot->size - slot->got;
+    sqe = uring_entry(&job->ring, IORING_OP_READ, index << STEP_BITS | STEP_READ);
+    sqe->fd = slot->fd;
+    sqe->addr = (uintptr_t) (slot->data + slot->got);
+    sqe->len = left < MAX_READ ? (unsigned) left : MAX_READ;
+    sqe->off = slot->got;
+    break;
+  }
+  case STEP_CLOSE:
+    sqe = uring_entry(&job->ring, IORING_OP_CLOSE, index << STEP_BITS | STEP_CLOSE);
+    sqe->fd = slot->fd;
+    break;
+  }
+}
+
+/// Queue opening file at `file`, in a free slot
+static void start_file(uring_job_t* job, size_t file) {
+  unsigned index = job->free[--job->free_count];
+  uring_slot_t* slot = &job->slots[index];
+  slot->file = file;
+  slot->fd = -1;
+  slot->error = 0;
+  slot->size = slot->got = 0;
+  slot->data = NULL;
+  queue_step(job, index, STEP_OPEN);
+}
+
+static void end_file(uring_job_t* job, unsigned index) {
+  uring_slot_t* slot = &job->slots[index];
+  finish_file(&job->files[slot->file], slot->data, slot->got, slot->error);
+  job->free[job->free_count++] = index;
+}
+
+/// Go on with the file after a step is done with `result`
+static void step_done(uring_job_t* job, unsigned index, unsigned step, int result) {
+  uring_slot_t* slot = &job->slots[index];
+
+  switch (step) {
+  case STEP_OPEN: {
+    if (result < 0) {
+      slot->error = -result;
+      end_file(job, index);
+      return;
+    }
+    // Sizing an open file is a short call, while statx through the ring
+    // is always handed to a kernel worker
+    struct stat st;
+    slot->fd = result;
+    if (fstat(slot->fd, &st)) {
+      slot->error = errno;
+      queue_step(job, index, STEP_CLOSE);
+      return;
+    }
+    // File is read straight into its array
+    slot->size = (size_t) st.st_size;
+    slot->data = ia_new_array_for$(slot->size, char);
+    queue_step(job, index, slot->size ? STEP_READ : STEP_CLOSE);
+    return;
+  }
+
+  case STEP_READ:
+    if (result == -EINTR || result == -EAGAIN) {
+      queue_step(job, index, STEP_READ);
+      return;
+    }
+    if (result < 0)
+      slot->error = -result;
+    else
+      slot->got += (size_t) result;
+    // File may have been cut since it was sized
+    queue_step(job, index, result > 0 && slot->got < slot->size ? STEP_READ : STEP_CLOSE);
+    return;
+
+  case STEP_CLOSE:
+    end_file(job, index);
+    return;
+  }
+}
+
+static bool load_with_uring(const char* const* paths, size_t count, iloader_file_t* files) {
+
+  uring_job_t* job = (uring_job_t*) istd_calloc(1, sizeof(uring_job_t));
+  check$(job, "Should allocate %zu bytes to load files", sizeof(uring_job_t));
+  if (!uring_open(&job->ring, ILOADER_BATCH)) {
+    int err = errno;
+    istd_free(job);
+    errno = err;
+    return false;
+  }
+  job->paths = paths;
+  job->files = files;
+  for (unsigned i = 0; i < ILOADER_BATCH; ++i)
+    job->free[i] = ILOADER_BATCH - 1 - i;
+  job->free_count = ILOADER_BATCH;
+
+  uring_t* ring = &job->ring;
+  size_t next = 0;
+  while (next < count || job->free_count < ILOADER_BATCH) {
+    while (next < count && job->free_count)
+      start_file(job, next++);
+
+    uring_submit_and_wait(ring);
+
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      const struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+      unsigned index = (unsigned) (cqe->user_data >> STEP_BITS);
+      unsigned step = (unsigned) (cqe->user_data & ((1 << STEP_BITS) - 1));
+      step_done(job, index, step, cqe->res);
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+  }
+
+  uring_close(ring);
+  istd_free(job);
+  return true;
+}
+
+
+bool iloader_load(const char* const* paths, size_t count, iloader_file_t* files, iloader_way_t way) {
+  if (!count)
+    return true;
+
+  if (way != ILOADER_THREADS && load_with_uring(paths, count, files))
+    return true;
+  if (way == ILOADER_URING)
+    return false;
+
+  load_with_threads(paths, count, files);
+  return true;
+}
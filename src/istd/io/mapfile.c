@@ -0,0 +1,158 @@
+#include "istd/io/mapfile.h"
+#include "istd/util/cpu.h"
+#include "istd/util/utf8.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef ICPU_X86
+#include <immintrin.h>
+#endif
+
+bool imapfile_open(imapfile_t* f, const char* path) {
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st)) {
+    int err = errno;
+    close(fd);
+    errno = err;
+    return false;
+  }
+
+  f->size = (size_t) st.st_size;
+  f->data = "";
+  if (f->size) {
+    // Mapping keeps the file open
+    void* data = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    close(fd);
+    if (data == MAP_FAILED) {
+      errno = err;
+      return false;
+    }
+    madvise(data, f->size, MADV_SEQUENTIAL);
+    f->data = data;
+  } else
+    close(fd);
+
+  return true;
+}
+
+void imapfile_close(imapfile_t* f) {
+  if (f->size)
+    munmap((void*) f->data, f->size);
+  f->data = "";
+  f->size = 0;
+}
+
+
+//==== Finding separators
+
+/// Eight bytes at a time: bytes equal to `sep` become zero, which sets
+/// their top bit exactly, and a multiply gathers the top bits
+static uint64_t find_seps_scalar(const char* p, char sep) {
+  const uint64_t low = 0x7F7F7F7F7F7F7F7Full;
+  const uint64_t needle = 0x0101010101010101ull * (uint8_t) sep;
+  uint64_t mask = 0;
+  for (unsigned i = 0; i < 64; i += 8) {
+    uint64_t word;
+    memcpy(&word, p + i, 8);
+    word ^= needle;
+    uint64_t zero = ~(((word & low) + low) | word) & ~low;
+    mask |= ((zero >> 7) * 0x0102040810204080ull >> 56) << i;
+  }
+  return mask;
+}
+
+#ifdef ICPU_X86
+
+ICPU_TARGET_SSE42
+static uint64_t find_seps_sse42(const char* p, char sep) {
+  const __m128i needle = _mm_set1_epi8(sep);
+  uint64_t mask = 0;
+  for (unsigned i = 0; i < 64; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*) (p + i));
+    mask |= (uint64_t) (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)) << i;
+  }
+  return mask;
+}
+
+ICPU_TARGET_AVX2
+static uint64_t find_seps_avx2(const char* p, char sep) {
+  const __m256i needle = _mm256_set1_epi8(sep);
+  __m256i lo = _mm256_loadu_si256((const __m256i*) p);
+  __m256i hi = _mm256_loadu_si256((const __m256i*) (p + 32));
+  uint32_t lo_mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle));
+  uint32_t hi_mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle));
+  return (uint64_t) hi_mask << 32 | lo_mask;
+}
+
+#endif
+
+/// Bits of separators in 64 bytes from `p`
+icpu_dispatch$(find_seps, uint64_t, (const char* p, char sep),
+               find_seps_scalar, icpu_x86$(find_seps_sse42), icpu_x86$(find_seps_avx2), NULL)
+
+/// Bits of separators in the block at `p`, which may end early at `end`
+static uint64_t block_mask(const char* p, const char* end, char sep) {
+  if (end - p >= 64)
+    return find_seps(p, sep);
+
+  uint64_t mask = 0;
+  for (unsigned i = 0; p + i < end; ++i)
+    mask |= (uint64_t) (p[i] == sep) << i;
+  return mask;
+}
+
+
+//==== Records
+
+imapfile_iter_t imapfile_records(const char* data, size_t size, char sep, bool check_utf8) {
+  imapfile_iter_t it = {
+    .begin = data,
+    .block = data,
+    .end = data + size,
+    .sep = sep,
+    .check_utf8 = check_utf8,
+  };
+  if (size)
+    it.mask = block_mask(data, it.end, sep);
+  return it;
+}
+
+bool _imapfile_next_slow(imapfile_iter_t* it, imapfile_span_t* span) {
+  for (;;) {
+    if (it->begin >= it->end)
+      return false;
+
+    while (!it->mask) {
+      // No more separators, so the rest is the last record
+      if (it->end - it->block <= 64) {
+        span->ptr = it->begin;
+        span->len = (size_t) (it->end - it->begin);
+        it->begin = it->end;
+        goto found;
+      }
+      it->block += 64;
+      it->mask = block_mask(it->block, it->end, it->sep);
+    }
+
+    const char* sep = it->block + __builtin_ctzll(it->mask);
+    it->mask &= it->mask - 1;
+    span->ptr = it->begin;
+    span->len = (size_t) (sep - it->begin);
+    it->begin = sep + 1;
+
+   found:
+    if (!it->check_utf8 || utf8_valid(span->ptr, span->len))
+      return true;
+    it->invalid++;
+  }
+}
@@ -0,0 +1,120 @@
+#include "istd/util/alloc.h"
+#include <stdlib.h>
+
+//==== Allocator behind the wrappers
+
+#ifdef ISTD_ALLOC_POOL
+
+#include "istd/util/pool.h"
+
+#define sys_malloc(size) ipool_malloc(size)
+#define sys_calloc(num, size) ipool_calloc(num, size)
+#define sys_realloc(ptr, size) ipool_realloc(ptr, size)
+#define sys_free(ptr) ipool_free(ptr)
+#define sys_usable_size(ptr) ipool_usable_size(ptr)
+
+#else
+
+#include <malloc.h>
+
+#define sys_malloc(size) malloc(size)
+#define sys_calloc(num, size) calloc(num, size)
+#define sys_realloc(ptr, size) realloc(ptr, size)
+#define sys_free(ptr) free(ptr)
+#define sys_usable_size(ptr) malloc_usable_size(ptr)
+
+#endif
+
+#ifdef ISTD_ALLOC_STATS
+
+#include <stdatomic.h>
+
+//==== Counters
+
+static _Atomic size_t allocs, frees, bytes, live_blocks, live_bytes, peak_bytes;
+
+#define usable_size(ptr) sys_usable_size(ptr)
+
+static void count_alloc(size_t size) {
+  atomic_fetch_add_explicit(&allocs, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&bytes, size, memory_order_relaxed);
+  atomic_fetch_add_explicit(&live_blocks, 1, memory_order_relaxed);
+  size_t live = atomic_fetch_add_explicit(&live_bytes, size, memory_order_relaxed) + size;
+
+  size_t peak = atomic_load_explicit(&peak_bytes, memory_order_relaxed);
+  while (live > peak && !atomic_compare_exchange_weak_explicit(
+           &peak_bytes, &peak, live, memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+static void count_free(size_t size) {
+  atomic_fetch_add_explicit(&frees, 1, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&live_blocks, 1, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&live_bytes, size, memory_order_relaxed);
+}
+
+istd_alloc_stats_t istd_alloc_stats(void) {
+  return (istd_alloc_stats_t) {
+    .allocs = atomic_load_explicit(&allocs, memory_order_relaxed),
+    .frees = atomic_load_explicit(&frees, memory_order_relaxed),
+    .bytes = atomic_load_explicit(&bytes, memory_order_relaxed),
+    .live_blocks = atomic_load_explicit(&live_blocks, memory_order_relaxed),
+    .live_bytes = atomic_load_explicit(&live_bytes, memory_order_relaxed),
+    .peak_bytes = atomic_load_explicit(&peak_bytes, memory_order_relaxed),
+  };
+}
+
+void istd_alloc_reset_peak(void) {
+  atomic_store_explicit(&peak_bytes, atomic_load_explicit(&live_bytes, memory_order_relaxed),
+                        memory_order_relaxed);
+}
+
+#else
+
+#define usable_size(ptr) ((size_t) 0)
+#define count_alloc(size) ((void) (size))
+#define count_free(size) ((void) (size))
+
+istd_alloc_stats_t istd_alloc_stats(void) {
+  return (istd_alloc_stats_t) { 0 };
+}
+
+void istd_alloc_reset_peak(void) {}
+
+#endif
+
+//==== Allocation
+
+void* istd_malloc(size_t size) {
+  void* ptr = sys_malloc(size);
+  if (ptr)
+    count_alloc(usable_size(ptr));
+  return ptr;
+}
+
+void* istd_calloc(size_t num, size_t size) {
+  void* ptr = sys_calloc(num, size);
+  if (ptr)
+    count_alloc(usable_size(ptr));
+  return ptr;
+}
+
+void* istd_realloc(void* ptr, size_t size) {
+
+  if (!ptr)
+    return istd_malloc(size);
+
+  // Old block is counted as freed, even if it is reused
+  size_t old_size = usable_size(ptr);
+  void* nw = sys_realloc(ptr, size);
+  if (nw) {
+    count_free(old_size);
+    count_alloc(usable_size(nw));
+  }
+  return nw;
+}
+
+void istd_free(void* ptr) {
+  if (ptr)
+    count_free(usable_size(ptr));
+  sys_free(ptr);
+}
@@ -0,0 +1,824 @@
+#include "istd/util/bench.h"
+#include "istd/ds/arr.h"
+#include "istd/util/alloc.h"
+#include "istd/util/err.h"
+#include "istd/util/out.h"
+#include "istd/util/tags.h"
+#include "istd/util/tty.h"
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+
+//==== Internal structures
+
+typedef struct ibench_section_t {
+  struct ibench_section_t *prev;
+  void (*fn)(void);
+  itags_t tags;
+  const char* name;
+} ibench_section_t;
+
+typedef enum {
+  PHASE_IDLE,
+  PHASE_WARMUP,
+  PHASE_SAMPLING,
+} ibench_phase_t;
+
+/// Cycle counter in use
+typedef enum {
+  CYCLES_NONE,
+  CYCLES_PERF,
+  CYCLES_TSC,
+} ibench_cycles_t;
+
+/// Results of one case
+typedef struct {
+  char* section;
+  char* name;
+  /// Iterations in one batch
+  size_t batch;
+  double median_ns, mad_ns, p99_ns, median_cycles;
+  /// Time of one iteration for each batch, sorted
+  ia_arr$(double) samples;
+} ibench_result_t;
+
+//==== Global variables here
+
+_ibench_state_t _ibench_state;
+
+static ibench_section_t* last_registered_bench;
+
+static struct {
+  const char* section;
+  const char* name;
+  ibench_phase_t phase;
+
+  /// Iterations in one batch
+  size_t batch;
+  uint64_t batch_start_ns;
+  uint64_t batch_start_cycles;
+  uint64_t warmup_start_ns;
+
+  /// Time and cycles of one iteration, for each sampled batch
+  double ns[IBENCH_SAMPLES];
+  double cycles[IBENCH_SAMPLES];
+  size_t nsamples;
+} run;
+
+static bool            cycles_initialized;
+static ibench_cycles_t cycles_source;
+static int             perf_fd = -1;
+
+static ia_arr$(ibench_result_t) results;
+static ia_arr$(ibench_result_t) baseline;
+static bool                     has_baseline;
+static double                   regression_threshold = IBENCH_THRESHOLD;
+static size_t                   regressions;
+
+//==== Clocks
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/// Choose where to read cycles from: hardware counter of this
+/// thread, if kernel allows it, or time stamp counter.
+static void init_cycles(void) {
+
+  cycles_initialized = true;
+
+#ifdef __linux__
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  perf_fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  if (perf_fd >= 0) {
+    cycles_source = CYCLES_PERF;
+    return;
+  }
+#endif
+
+#ifdef HAVE_RDTSC
+  cycles_source = CYCLES_TSC;
+#else
+  cycles_source = CYCLES_NONE;
+#endif
+}
+
+static uint64_t now_cycles(void) {
+  switch (cycles_source) {
+    case CYCLES_PERF: {
+      uint64_t value = 0;
+      if (read(perf_fd, &value, sizeof(value)) != (ssize_t) sizeof(value))
+        return 0;
+      return value;
+    }
+#ifdef HAVE_RDTSC
+    case CYCLES_TSC:
+      return __rdtsc();
+#endif
+    default:
+      return 0;
+  }
+}
+
+//==== Statistics
+
+static int compare_doubles(const void* a, const void* b) {
+  double x = *(const double*) a, y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+/// Value at given quantile of sorted array, nearest rank
+static double quantile(const double* sorted, size_t n, double q) {
+  size_t rank = (size_t) (q * (double) n + 0.5);
+  if (rank > 0)
+    --rank;
+  return sorted[rank < n ? rank : n - 1];
+}
+
+/// Median absolute deviation of sorted array
+static double median_abs_deviation(const double* sorted, size_t n, double median) {
+  double dev[IBENCH_SAMPLES];
+  for (size_t i = 0; i < n; ++i)
+    dev[i] = sorted[i] > median ? sorted[i] - median : median - sorted[i];
+  qsort(dev, n, sizeof(double), compare_doubles);
+  return quantile(dev, n, 0.5);
+}
+
+/// Print time with a sensible unit
+static void print_time(const char* color, double ns) {
+  static const char* units[] = { "ns", "us", "ms", "s " };
+  size_t unit = 0;
+  while (ns >= 1000.0 && unit < 3) {
+    ns /= 1000.0;
+    ++unit;
+  }
+  iout_printf(iout_stderr(), "%s%8.2f %s" ESC_RESET, color, ns, units[unit]);
+}
+
+//==== Comparison with baseline
+
+static const ibench_result_t* find_result(ia_arr$(ibench_result_t) list, const char* section, const char* name) {
+  for (size_t i = 0; i < ia_length(list); ++i)
+    if (!strcmp(list[i].section, section) && !strcmp(list[i].name, name))
+      return &list[i];
+  return NULL;
+}
+
+/**
+ * One-sided Mann–Whitney U test.
+ *
+ * Returns probability to see values of `b` ranked this high or higher
+ * among values of `a`, if both come from the same distribution. Small
+ * value means `b` is likely larger (slower) than `a`. Uses normal
+ * approximation with tie correction, which is fine for dozens of samples.
+ */
+static double mann_whitney_p(const double* a, size_t na, const double* b, size_t nb) {
+
+  size_t n = na + nb;
+  if (na == 0 || nb == 0)
+    return 1.0;
+
+  // Both arrays are sorted, so ranks are found by merging them
+  double rank_sum_b = 0, ties = 0;
+  size_t i = 0, j = 0;
+  while (i < na || j < nb) {
+
+    double value = j == nb || (i < na && a[i] < b[j]) ? a[i] : b[j];
+    size_t in_a = 0, in_b = 0;
+    while (i < na && a[i] == value) { ++i; ++in_a; }
+    while (j < nb && b[j] == value) { ++j; ++in_b; }
+
+    // Tied values share the average of their ranks
+    double t = (double) (in_a + in_b);
+    double first_rank = (double) (i + j) - t + 1;
+    rank_sum_b += (double) in_b * (first_rank + (t - 1) / 2);
+    ties += t * t * t - t;
+  }
+
+  double u = rank_sum_b - (double) nb * (double) (nb + 1) / 2;
+  double mean = (double) na * (double) nb / 2;
+  double var = (double) na * (double) nb / 12 * ((double) (n + 1) - ties / ((double) n * (double) (n - 1)));
+  if (var <= 0)
+    return 1.0;
+
+  double z = (u - mean - 0.5) / sqrt(var);
+  return 0.5 * erfc(z / sqrt(2.0));
+}
+
+static void compare_with_baseline(const ibench_result_t* res) {
+
+  const ibench_result_t* base = find_result(baseline, res->section, res->name);
+  if (!base || base->median_ns <= 0) {
+    iout_printf(iout_stderr(), ESC_GRAY "        not in baseline" ESC_RESET "\n");
+    return;
+  }
+
+  size_t n = ia_length(res->samples), nb = ia_length(base->samples);
+  double change = res->median_ns / base->median_ns - 1;
+  double p_slower = mann_whitney_p(base->samples, nb, res->samples, n);
+  double p_faster = mann_whitney_p(res->samples, n, base->samples, nb);
+
+  iout_printf(iout_stderr(), "        %+7.1f%% vs baseline  ", change * 100);
+  if (p_slower < IBENCH_ALPHA && change > regression_threshold) {
+    ++regressions;
+    iout_printf(iout_stderr(), ESC_RED ESC_BOLD "REGRESSION" ESC_RESET ESC_GRAY " (p = %.2g)" ESC_RESET "\n", p_slower);
+  } else if (p_faster < IBENCH_ALPHA && -change > regression_threshold) {
+    iout_printf(iout_stderr(), ESC_GREEN "improvement" ESC_RESET ESC_GRAY " (p = %.2g)" ESC_RESET "\n", p_faster);
+  } else {
+    iout_printf(iout_stderr(), ESC_GRAY "no significant change" ESC_RESET "\n");
+  }
+}
+
+static void report(void) {
+
+  size_t n = run.nsamples;
+  qsort(run.ns, n, sizeof(double), compare_doubles);
+  qsort(run.cycles, n, sizeof(double), compare_doubles);
+
+  ibench_result_t res = {
+    .section = strdup(run.section ? run.section : ""),
+    .name = strdup(run.name),
+    .batch = run.batch,
+    .median_ns = quantile(run.ns, n, 0.5),
+    .p99_ns = quantile(run.ns, n, 0.99),
+    .median_cycles = quantile(run.cycles, n, 0.5),
+    .samples = ia_new_empty_array$(double),
+  };
+  check$(res.section && res.name, "Should allocate names of bench results");
+  res.mad_ns = median_abs_deviation(run.ns, n, res.median_ns);
+  ia_append$(&res.samples, run.ns, n);
+
+  iout_printf(iout_stderr(), "    " ESC_BOLD "%-40s" ESC_RESET, run.name);
+  print_time(ESC_WHITE, res.median_ns);
+  iout_printf(iout_stderr(), ESC_GRAY "  ± " ESC_RESET);
+  print_time("", res.mad_ns);
+  iout_printf(iout_stderr(), ESC_GRAY "  p99 " ESC_RESET);
+  print_time(ESC_YELLOW, res.p99_ns);
+
+  if (cycles_source != CYCLES_NONE)
+    iout_printf(iout_stderr(), "  " ESC_AQUA "%10.1f" ESC_RESET " %s",
+            res.median_cycles,
+            cycles_source == CYCLES_PERF ? "cycles" : "ticks");
+
+  iout_printf(iout_stderr(), ESC_GRAY "  (%zu x %zu)" ESC_RESET "\n", n, run.batch);
+
+  if (has_baseline)
+    compare_with_baseline(&res);
+  // Results of long runs are seen as they come
+  iout_flush(iout_stderr());
+
+  ia_push$(&results, res);
+}
+
+//==== Implementations
+
+/// Registers given function in list of all benchmarks to be run.
+///
+void _ibench_register_function(
+    const char* id,
+    const char* name,
+    void(*fn)(void)
+  ) {
+
+  check$(id, "Bench section ID must be not null");
+  check$(name, "Bench section name must be not NULL");
+  check$(fn, "Bench section itself must be a function, not a NULL pointer");
+
+  ibench_section_t* sec = calloc_checked$(1, ibench_section_t, "Should allocate a bench section");
+
+  sec->prev = last_registered_bench;
+  last_registered_bench = sec;
+  sec->name = name;
+  sec->fn = fn;
+  itags_parse(&sec->tags, id);
+}
+
+/// Begins given benchmark case.
+///
+void _ibench_begin_case(const char* name) {
+
+  check$(run.phase == PHASE_IDLE, "You shall not nest bench cases");
+  check$(name, "Bench case should have a name");
+
+  if (!cycles_initialized)
+    init_cycles();
+
+  run.name = name;
+  run.phase = PHASE_WARMUP;
+  run.batch = 0;
+  run.nsamples = 0;
+
+  // First check of the loop goes straight to `_ibench_next_batch()`
+  _ibench_state.left = 0;
+}
+
+/// Ends a batch and starts the next one.
+/// Returns `false` when the case is done.
+///
+bool _ibench_next_batch(void) {
+
+  uint64_t end_ns = now_ns();
+  uint64_t end_cycles = now_cycles();
+  uint64_t elapsed = end_ns - run.batch_start_ns;
+
+  if (run.batch == 0) {
+    // Nothing was run yet
+    run.batch = 1;
+    run.warmup_start_ns = end_ns;
+
+  } else if (run.phase == PHASE_WARMUP) {
+
+    // Scale batch to take `IBENCH_BATCH_NS`, but do not grow it too fast:
+    // first batches are slow because of cold caches.
+    size_t batch = elapsed ? (size_t) ((double) run.batch * IBENCH_BATCH_NS / (double) elapsed) : run.batch * 10;
+    if (batch > run.batch * 10)
+      batch = run.batch * 10;
+    if (batch == 0)
+      batch = 1;
+
+    bool calibrated = elapsed >= IBENCH_BATCH_NS / 2 || run.batch == batch;
+    run.batch = batch;
+
+    if (calibrated && end_ns - run.warmup_start_ns >= IBENCH_WARMUP_NS)
+      run.phase = PHASE_SAMPLING;
+
+  } else {
+    run.ns[run.nsamples] = (double) elapsed / (double) run.batch;
+    run.cycles[run.nsamples] = (double) (end_cycles - run.batch_start_cycles) / (double) run.batch;
+
+    if (++run.nsamples == IBENCH_SAMPLES) {
+      report();
+      run.phase = PHASE_IDLE;
+      _ibench_state.left = 0;
+      return false;
+    }
+  }
+
+  // This call is one of the iterations
+  _ibench_state.left = run.batch - 1;
+
+  // Take time last, so that only the loop is measured
+  run.batch_start_cycles = now_cycles();
+  run.batch_start_ns = now_ns();
+  return true;
+}
+
+#if !defined(IBENCH_NO_MAIN) && defined(BENCH)
+
+//==== JSON results
+
+static void write_json_string(FILE* out, const char* str) {
+  fputc('"', out);
+  for (const unsigned char* c = (const unsigned char*) str; *c; ++c) {
+    if (*c == '"' || *c == '\\')
+      fprintf(out, "\\%c", *c);
+    else if (*c < 0x20)
+      fprintf(out, "\\u%04x", *c);
+    else
+      fputc(*c, out);
+  }
+  fputc('"', out);
+}
+
+/// Write all results, grouped by section
+static bool write_json(const char* path) {
+
+  FILE* out = fopen(path, "w");
+  if (!out)
+    return false;
+
+  static const char* sources[] = { "none", "perf", "tsc" };
+  fprintf(out, "{\n  \"version\": 1,\n  \"cycles\": \"%s\",\n  \"sections\": [", sources[cycles_source]);
+
+  for (size_t i = 0; i < ia_length(results); ++i) {
+    const ibench_result_t* r = &results[i];
+    bool new_section = i == 0 || strcmp(results[i - 1].section, r->section);
+
+    if (new_section) {
+      fprintf(out, "%s\n    {\n      \"name\": ", i ? "\n      ]\n    }," : "");
+      write_json_string(out, r->section);
+      fprintf(out, ",\n      \"cases\": [");
+    }
+
+    fprintf(out, "%s\n        {\n          \"name\": ", new_section ? "" : ",");
+    write_json_string(out, r->name);
+    fprintf(out, ",\n          \"batch\": %zu,\n"
+                 "          \"median_ns\": %.17g,\n"
+                 "          \"mad_ns\": %.17g,\n"
+                 "          \"p99_ns\": %.17g,\n"
+                 "          \"median_cycles\": %.17g,\n"
+                 "          \"samples_ns\": [",
+            r->batch, r->median_ns, r->mad_ns, r->p99_ns, r->median_cycles);
+    for (size_t j = 0; j < ia_length(r->samples); ++j)
+      fprintf(out, "%s%.17g", j ? ", " : "", r->samples[j]);
+    fprintf(out, "]\n        }");
+  }
+
+  fprintf(out, "%s\n  ]\n}\n", ia_length(results) ? "\n      ]\n    }" : "");
+  return fclose(out) == 0;
+}
+
+//---- Reading baselines back
+//
+// Only what `write_json()` writes is understood: objects, arrays,
+// strings, numbers and literals. Unknown keys are skipped.
+
+typedef struct {
+  const char* p;
+  bool ok;
+} json_reader_t;
+
+static void json_ws(json_reader_t* r) {
+  while (*r->p == ' ' || *r->p == '\n' || *r->p == '\r' || *r->p == '\t')
+    ++r->p;
+}
+
+/// Skip given character, if it is next
+static bool json_accept(json_reader_t* r, char c) {
+  json_ws(r);
+  if (r->ok && *r->p == c) {
+    ++r->p;
+    return true;
+  }
+  return false;
+}
+
+static void json_expect(json_reader_t* r, char c) {
+  if (!json_accept(r, c))
+    r->ok = false;
+}
+
+/// Read string into newly allocated memory
+static char* json_string(json_reader_t* r) {
+
+  json_expect(r, '"');
+  ia_arr$(char) str = ia_new_empty_array$(char);
+
+  while (r->ok && *r->p != '"') {
+    char c = *r->p++;
+    if (c == '\0') {
+      r->ok = false;
+    } else if (c == '\\') {
+      c = *r->p++;
+      if (c == 'u') {
+        unsigned code = 0;
+        if (sscanf(r->p, "%4x", &code) != 1)
+          r->ok = false;
+        r->p += 4;
+        // Only control characters are escaped this way
+        ia_push$(&str, (char) code);
+      } else if (c == 'n') {
+        ia_push$(&str, '\n');
+      } else if (c == '\0') {
+        r->ok = false;
+      } else {
+        ia_push$(&str, c);
+      }
+    } else {
+      ia_push$(&str, c);
+    }
+  }
+  json_expect(r, '"');
+
+  char* copy = strdup(str);
+  check$(copy, "Should allocate a string read from JSON");
+  ia_destroy_array(str);
+  return copy;
+}
+
+static double json_number(json_reader_t* r) {
+  json_ws(r);
+  char* end = NULL;
+  double value = strtod(r->p, &end);
+  if (end == r->p)
+    r->ok = false;
+  r->p = end;
+  return value;
+}
+
+/// Skip a comma before the next item, or the closing bracket
+static bool json_next(json_reader_t* r, char close) {
+  if (json_accept(r, ','))
+    return true;
+  json_expect(r, close);
+  return false;
+}
+
+/// Skip any value
+static void json_skip(json_reader_t* r) {
+
+  json_ws(r);
+  if (!r->ok)
+    return;
+
+  if (*r->p == '"') {
+    free(json_string(r));
+  } else if (json_accept(r, '[')) {
+    if (!json_accept(r, ']')) {
+      do json_skip(r); while (r->ok && json_next(r, ']'));
+    }
+  } else if (json_accept(r, '{')) {
+    if (!json_accept(r, '}')) {
+      do {
+        free(json_string(r));
+        json_expect(r, ':');
+        json_skip(r);
+      } while (r->ok && json_next(r, '}'));
+    }
+  } else if (!strncmp(r->p, "true", 4) || !strncmp(r->p, "null", 4)) {
+    r->p += 4;
+  } else if (!strncmp(r->p, "false", 5)) {
+    r->p += 5;
+  } else {
+    json_number(r);
+  }
+}
+
+/// Loop over keys of an object, `key` is set to each of them
+#define json_for_each_key$(r, key)                                             \
+  for (bool _first = (json_expect((r), '{'), true);                            \
+       (r)->ok && (_first ? !json_accept((r), '}') : json_next((r), '}'))     \
+         && (free(key), (key) = json_string(r), json_expect((r), ':'), (r)->ok); \
+       _first = false)
+
+/// Loop over items of an array
+#define json_for_each_item$(r)                                                 \
+  for (bool _first = (json_expect((r), '['), true);                            \
+       (r)->ok && (_first ? !json_accept((r), ']') : json_next((r), ']'));    \
+       _first = false)
+
+static void json_case(json_reader_t* r, const char* section, ia_arr$(ibench_result_t)* out) {
+
+  ibench_result_t res = { .samples = ia_new_empty_array$(double) };
+  char* key = NULL;
+
+  json_for_each_key$(r, key) {
+    if (!strcmp(key, "name")) {
+      free(res.name);
+      res.name = json_string(r);
+    } else if (!strcmp(key, "batch")) {
+      res.batch = (size_t) json_number(r);
+    } else if (!strcmp(key, "median_ns")) {
+      res.median_ns = json_number(r);
+    } else if (!strcmp(key, "mad_ns")) {
+      res.mad_ns = json_number(r);
+    } else if (!strcmp(key, "p99_ns")) {
+      res.p99_ns = json_number(r);
+    } else if (!strcmp(key, "median_cycles")) {
+      res.median_cycles = json_number(r);
+    } else if (!strcmp(key, "samples_ns")) {
+      json_for_each_item$(r)
+        ia_push$(&res.samples, json_number(r));
+    } else {
+      json_skip(r);
+    }
+  }
+  free(key);
+
+  // Comparison expects sorted samples
+  qsort(res.samples, ia_length(res.samples), sizeof(double), compare_doubles);
+  res.section = strdup(section);
+  check$(res.section, "Should allocate a name of bench section");
+  if (!res.name)
+    r->ok = false;
+  ia_push$(out, res);
+}
+
+static void json_section(json_reader_t* r, ia_arr$(ibench_result_t)* out) {
+
+  char* key = NULL;
+  char* name = NULL;
+  // Cases may come before the name, so collect them separately
+  ia_arr$(ibench_result_t) cases = ia_new_empty_array$(ibench_result_t);
+
+  json_for_each_key$(r, key) {
+    if (!strcmp(key, "name")) {
+      free(name);
+      name = json_string(r);
+    } else if (!strcmp(key, "cases")) {
+      json_for_each_item$(r)
+        json_case(r, "", &cases);
+    } else {
+      json_skip(r);
+    }
+  }
+  free(key);
+
+  for (size_t i = 0; i < ia_length(cases); ++i) {
+    free(cases[i].section);
+    cases[i].section = strdup(name ? name : "");
+    check$(cases[i].section, "Should allocate a name of bench section");
+    ia_push$(out, cases[i]);
+  }
+  ia_destroy_array(cases);
+  free(name);
+}
+
+/// Load results saved with `write_json()`
+static bool read_json(const char* path, ia_arr$(ibench_result_t)* out) {
+
+  FILE* in = fopen(path, "r");
+  if (!in)
+    return false;
+
+  ia_arr$(char) text = ia_new_empty_array$(char);
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+    ia_append$(&text, buf, n);
+  fclose(in);
+
+  json_reader_t r = { .p = text ? text : "", .ok = true };
+  char* key = NULL;
+
+  json_for_each_key$(&r, key) {
+    if (!strcmp(key, "sections")) {
+      json_for_each_item$(&r)
+        json_section(&r, out);
+    } else {
+      json_skip(&r);
+    }
+  }
+  free(key);
+  ia_destroy_array(text);
+  return r.ok;
+}
+
+#undef json_for_each_key$
+#undef json_for_each_item$
+
+//==== Runner
+
+static void destroy_results(ia_arr$(ibench_result_t)* list) {
+  for (size_t i = 0; i < ia_length(*list); ++i) {
+    free((*list)[i].section);
+    free((*list)[i].name);
+    ia_destroy_array((*list)[i].samples);
+  }
+  ia_destroy_array(*list);
+  *list = NULL;
+}
+
+#define ESC_HELP_TITLE ESC_UNDERLINE ESC_BOLD ESC_PURPLE
+#define ESC_CMD ESC_AQUA
+#define ESC_ARG ESC_GREEN
+
+static void print_bench_help() {
+
+  iout_printf(iout_stderr(), "\nISTD benchmark runner\n\n");
+  iout_printf(iout_stderr(), "Runs benchmarks specified by certain tags, or "
+          ESC_ARG "default" ESC_RESET " tag if nothing was specified\n\n");
+  iout_printf(iout_stderr(), ESC_HELP_TITLE "Usage:" ESC_RESET ESC_CMD " benches " ESC_ARG "[OPTION]... <TAG>...\n\n" ESC_RESET);
+  iout_printf(iout_stderr(), ESC_HELP_TITLE "Options:" ESC_RESET "\n");
+  iout_printf(iout_stderr(), ESC_ARG "  --json=FILE         " ESC_RESET "Write results to FILE as JSON\n");
+  iout_printf(iout_stderr(), ESC_ARG "  --save=NAME         " ESC_RESET "Save results as baseline NAME\n");
+  iout_printf(iout_stderr(), ESC_ARG "  --compare=NAME      " ESC_RESET "Compare with baseline NAME, fail on regressions\n");
+  iout_printf(iout_stderr(), ESC_ARG "  --threshold=PERCENT " ESC_RESET "Slowdown counted as regression, default %g\n", IBENCH_THRESHOLD * 100);
+  iout_printf(iout_stderr(), ESC_ARG "  --baselines=DIR     " ESC_RESET "Directory with baselines, default " ESC_ARG ".ibench\n" ESC_RESET);
+}
+
+#undef ESC_HELP_TITLE
+#undef ESC_CMD
+#undef ESC_ARG
+
+/// Value of `--name=value` option, or `NULL` if `arg` is another option
+static const char* option(const char* arg, const char* name) {
+  size_t len = strlen(name);
+  return !strncmp(arg, name, len) && arg[len] == '=' ? arg + len + 1 : NULL;
+}
+
+/// Path of a baseline, in memory which should be freed
+static char* baseline_path(const char* dir, const char* name) {
+  size_t len = strlen(dir) + strlen(name) + sizeof("/.json");
+  char* path = calloc_checked$(len, char, "Should allocate a path of baseline");
+  snprintf(path, len, "%s/%s.json", dir, name);
+  return path;
+}
+
+int main (int argc, const char** argv) {
+
+  const char* json_path = NULL;
+  const char* save_name = NULL;
+  const char* compare_name = NULL;
+  const char* baselines_dir = ".ibench";
+
+  for (size_t i = 1; i < (size_t) argc; ++i) {
+    const char* value;
+    if (!strcmp(argv[i], "--help")) {
+      print_bench_help();
+      return 0;
+    } else if ((value = option(argv[i], "--json"))) {
+      json_path = value;
+    } else if ((value = option(argv[i], "--save"))) {
+      save_name = value;
+    } else if ((value = option(argv[i], "--compare"))) {
+      compare_name = value;
+    } else if ((value = option(argv[i], "--baselines"))) {
+      baselines_dir = value;
+    } else if ((value = option(argv[i], "--threshold"))) {
+      regression_threshold = atof(value) / 100;
+    } else if (argv[i][0] == '-') {
+      iout_printf(iout_stderr(), ESC_RED "Unknown option " ESC_RESET "%s\n", argv[i]);
+      print_bench_help();
+      return 2;
+    }
+  }
+
+  if (compare_name) {
+    char* path = baseline_path(baselines_dir, compare_name);
+    has_baseline = read_json(path, &baseline);
+    if (!has_baseline) {
+      iout_printf(iout_stderr(), ESC_RED "Cannot read baseline " ESC_RESET "%s\n", path);
+      istd_free(path);
+      return 2;
+    }
+    istd_free(path);
+  }
+
+  itags_t wanted;
+  itags_from_args(&wanted, argc, argv);
+
+  size_t sections_run = 0;
+
+  for (const ibench_section_t* s = last_registered_bench; s != NULL; s = s->prev) {
+
+    if (!itags_intersect(&s->tags, &wanted))
+      continue;
+
+    sections_run++;
+    iout_printf(iout_stderr(), "\n" ESC_UNDERLINE ESC_GRAY "## " ESC_PURPLE ESC_BOLD "%s\n\n" ESC_RESET, s->name);
+    run.section = s->name;
+    s->fn();
+  }
+
+  if (!sections_run) {
+    iout_printf(iout_stderr(), "No bench sections match tags " ESC_GREEN);
+    for (size_t i = 0; i < wanted.ntags; ++i)
+      iout_printf(iout_stderr(), "%s ", wanted.tags[i]);
+    iout_printf(iout_stderr(), "\n" ESC_RESET);
+  }
+  iout_printf(iout_stderr(), "\n");
+
+  int status = 0;
+
+  if (json_path && !write_json(json_path)) {
+    iout_printf(iout_stderr(), ESC_RED "Cannot write results to " ESC_RESET "%s\n", json_path);
+    status = 2;
+  }
+
+  if (save_name) {
+    char* path = baseline_path(baselines_dir, save_name);
+    if (mkdir(baselines_dir, 0777) && errno != EEXIST) {
+      iout_printf(iout_stderr(), ESC_RED "Cannot create directory " ESC_RESET "%s\n", baselines_dir);
+      status = 2;
+    } else if (!write_json(path)) {
+      iout_printf(iout_stderr(), ESC_RED "Cannot save baseline to " ESC_RESET "%s\n", path);
+      status = 2;
+    } else {
+      iout_printf(iout_stderr(), "Saved baseline " ESC_GREEN "%s" ESC_RESET "\n\n", save_name);
+    }
+    istd_free(path);
+  }
+
+  if (regressions) {
+    iout_printf(iout_stderr(), ESC_RED "%zu cases have regressed compared to " ESC_RESET "%s\n\n", regressions, compare_name);
+    if (!status)
+      status = 1;
+  } else if (has_baseline) {
+    iout_printf(iout_stderr(), ESC_GREEN "No regressions compared to " ESC_RESET "%s\n\n", compare_name);
+  }
+
+  if (perf_fd >= 0)
+    close(perf_fd);
+  destroy_results(&results);
+  destroy_results(&baseline);
+  itags_destroy(&wanted);
+  return status;
+}
+
+#endif
@@ -0,0 +1,152 @@
+#include "istd/util/cpu.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ICPU_X86
+#include <cpuid.h>
+#endif
+
+static const char* const level_names[ICPU_LEVELS] = {
+  [ICPU_SCALAR] = "scalar",
+  [ICPU_SSE42] = "sse4.2",
+  [ICPU_AVX2] = "avx2",
+  [ICPU_AVX512] = "avx512",
+};
+
+static pthread_once_t   detect_once = PTHREAD_ONCE_INIT;
+static icpu_features_t  features;
+static icpu_level_t     detected_level;
+/// Level dispatched functions are set to
+static icpu_level_t     current_level;
+
+static pthread_mutex_t  slots_lock = PTHREAD_MUTEX_INITIALIZER;
+static _icpu_slot_t*    slots;
+
+//==== Detection
+
+#ifdef ICPU_X86
+
+/// Register state enabled by the OS, bits of XCR0
+static uint64_t enabled_state(void) {
+  uint32_t lo, hi;
+  __asm__ volatile ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+  return (uint64_t) hi << 32 | lo;
+}
+
+static void read_features(icpu_features_t* f) {
+
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return;
+
+  f->sse2 = edx & bit_SSE2;
+  f->ssse3 = ecx & bit_SSSE3;
+  f->sse41 = ecx & bit_SSE4_1;
+  f->sse42 = ecx & bit_SSE4_2;
+  f->popcnt = ecx & bit_POPCNT;
+
+  // AVX registers are usable only if the OS saves them
+  bool os_ymm = false, os_zmm = false;
+  if (ecx & bit_OSXSAVE) {
+    uint64_t xcr0 = enabled_state();
+    os_ymm = (xcr0 & 0x06) == 0x06;         // XMM, YMM
+    os_zmm = (xcr0 & 0xe6) == 0xe6;         // and opmask, ZMM
+  }
+
+  f->avx = os_ymm && (ecx & bit_AVX);
+  f->fma = os_ymm && (ecx & bit_FMA);
+
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    return;
+
+  f->bmi1 = ebx & bit_BMI;
+  f->bmi2 = ebx & bit_BMI2;
+  f->avx2 = f->avx && (ebx & bit_AVX2);
+  f->avx512f = os_zmm && (ebx & bit_AVX512F);
+  f->avx512bw = os_zmm && (ebx & bit_AVX512BW);
+  f->avx512vl = os_zmm && (ebx & bit_AVX512VL);
+  f->avx512dq = os_zmm && (ebx & bit_AVX512DQ);
+}
+
+#else
+
+static void read_features(icpu_features_t* f) {
+  (void) f;
+}
+
+#endif
+
+static icpu_level_t level_of(const icpu_features_t* f) {
+  if (!(f->ssse3 && f->sse41 && f->sse42 && f->popcnt))
+    return ICPU_SCALAR;
+  if (!(f->avx && f->avx2 && f->fma && f->bmi1 && f->bmi2))
+    return ICPU_SSE42;
+  if (!(f->avx512f && f->avx512bw && f->avx512vl && f->avx512dq))
+    return ICPU_AVX2;
+  return ICPU_AVX512;
+}
+
+static void detect(void) {
+
+  read_features(&features);
+  detected_level = current_level = level_of(&features);
+
+  const char* forced = getenv("ISTD_CPU");
+  if (!forced)
+    return;
+  for (int l = 0; l < ICPU_LEVELS; ++l)
+    if (!strcmp(forced, level_names[l]) && (icpu_level_t) l < detected_level)
+      current_level = (icpu_level_t) l;
+}
+
+//==== Implementations
+
+const icpu_features_t* icpu_features(void) {
+  pthread_once(&detect_once, detect);
+  return &features;
+}
+
+icpu_level_t icpu_detected_level(void) {
+  pthread_once(&detect_once, detect);
+  return detected_level;
+}
+
+icpu_level_t icpu_level(void) {
+  pthread_once(&detect_once, detect);
+  pthread_mutex_lock(&slots_lock);
+  icpu_level_t level = current_level;
+  pthread_mutex_unlock(&slots_lock);
+  return level;
+}
+
+icpu_level_t icpu_set_level(icpu_level_t level) {
+
+  pthread_once(&detect_once, detect);
+  if (level > detected_level)
+    level = detected_level;
+
+  pthread_mutex_lock(&slots_lock);
+  current_level = level;
+  for (_icpu_slot_t* s = slots; s; s = s->next)
+    s->select(level);
+  pthread_mutex_unlock(&slots_lock);
+
+  return level;
+}
+
+const char* icpu_level_name(icpu_level_t level) {
+  return level < ICPU_LEVELS ? level_names[level] : "unknown";
+}
+
+void _icpu_register(_icpu_slot_t* slot) {
+
+  pthread_once(&detect_once, detect);
+
+  pthread_mutex_lock(&slots_lock);
+  slot->next = slots;
+  slots = slot;
+  slot->select(current_level);
+  pthread_mutex_unlock(&slots_lock);
+}
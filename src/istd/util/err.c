@@ -1,8 +1,12 @@
 #include "istd/util/err.h"
+#include "istd/util/alloc.h"
+#include "istd/util/log.h"
+#include "istd/util/out.h"
 #include "istd/util/tty.h"
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #define ESC_PANIC   ESC_RED ESC_BOLD
 #define ESC_NOTE    ESC_BLUE
@@ -14,19 +18,34 @@ void _istd_internal_panic(const char* location, const char* fmt, ...) {
   va_list args;
   va_start(args, fmt);
 
-  fprintf(stderr, "\n");
-  fprintf(stderr, ESC_PANIC "Unrecoverable panic:" ESC_RESET "\n");
-  fprintf(stderr, "\n");
-  vfprintf(stderr, fmt, args);
-  fprintf(stderr, "\n");
-  fprintf(stderr, ESC_NOTE "Note: " ESC_RESET "This panic occured at %s\n", location);
+  // Output and messages logged before the panic explain it, so they go first
+  iout_t* out = iout_stderr();
+  iout_flush(out);
+  ilog_flush();
+
+  // Whole message is written at once, so it is not mixed with other output
+  char message[4096];
+  int len = snprintf(message, sizeof(message), "\n" ESC_PANIC "Unrecoverable panic:" ESC_RESET "\n\n");
+  len += vsnprintf(message + len, sizeof(message) - (size_t) len, fmt, args);
+  if ((size_t) len < sizeof(message))
+    len += snprintf(message + len, sizeof(message) - (size_t) len,
+                    "\n" ESC_NOTE "Note: " ESC_RESET "This panic occured at %s\n", location);
+  if ((size_t) len >= sizeof(message))
+    len = sizeof(message) - 1;
+  if (!out->colors)
+    len = (int) iout_strip_escapes(message, (size_t) len);
+
+  fflush(stderr);
+  ssize_t written = write(STDERR_FILENO, message, (size_t) len);
+  (void) written;
+  va_end(args);
   exit(EXIT_FAILURE);
 }
 
 
 void* _istd_calloc_checked(size_t num, size_t item_size, const char* errmsg) {
 
-  void* mem = calloc(num, item_size);
+  void* mem = istd_calloc(num, item_size);
 
   if (mem == NULL) {
     if (errmsg)
@@ -0,0 +1,630 @@
+#include "istd/util/log.h"
+#include "istd/ds/arr.h"
+#include "istd/util/err.h"
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+//==== Internal structures
+
+/// Ring buffer of one thread.
+///
+/// `head` and `tail` only grow, position in `data` is taken modulo its size.
+/// Producer writes records at `head`, consumer reads them at `tail`.
+typedef struct ilog_ring_t {
+  struct ilog_ring_t* next;
+  atomic_size_t head;
+  atomic_size_t tail;
+  /// Messages dropped since last drain
+  atomic_size_t dropped;
+  alignas(8) char data[ILOG_RING_SIZE];
+} ilog_ring_t;
+
+/// Header of a record, followed by arguments
+typedef struct {
+  /// Size of whole record, multiple of 8
+  uint32_t size;
+  /// `ilog_level_t`, or `LEVEL_PADDING` for the rest of the ring
+  uint8_t level;
+  uint32_t nsec;
+  int64_t sec;
+  const char* fmt;
+  const char* location;
+} ilog_header_t;
+
+#define LEVEL_PADDING 0xFF
+
+/// Largest record, larger are truncated
+#define MAX_RECORD (ILOG_RING_SIZE / 4)
+
+//---- Format parsing
+
+typedef enum {
+  LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_J, LEN_Z, LEN_T, LEN_BIG_L,
+} ilog_length_t;
+
+/// One conversion of format string
+typedef struct {
+  /// Flags, width and precision, as written
+  const char* flags_begin;
+  const char* flags_end;
+  bool star_width, star_precision;
+  ilog_length_t length;
+  char conv;
+} ilog_spec_t;
+
+/**
+ * Parse conversion starting at `%`, at `fmt`.
+ * Returns pointer after it, or `NULL` if conversion is broken.
+ */
+static const char* parse_spec(const char* fmt, ilog_spec_t* spec) {
+
+  const char* p = fmt + 1;
+  spec->flags_begin = p;
+  spec->star_width = spec->star_precision = false;
+
+  while (*p && strchr("-+ #0'", *p))
+    ++p;
+  if (*p == '*') {
+    spec->star_width = true;
+    ++p;
+  }
+  while (*p >= '0' && *p <= '9')
+    ++p;
+  if (*p == '.') {
+    ++p;
+    if (*p == '*') {
+      spec->star_precision = true;
+      ++p;
+    }
+    while (*p >= '0' && *p <= '9')
+      ++p;
+  }
+  spec->flags_end = p;
+
+  spec->length = LEN_NONE;
+  switch (*p) {
+    case 'h': spec->length = p[1] == 'h' ? LEN_HH : LEN_H; p += p[1] == 'h' ? 2 : 1; break;
+    case 'l': spec->length = p[1] == 'l' ? LEN_LL : LEN_L; p += p[1] == 'l' ? 2 : 1; break;
+    case 'j': spec->length = LEN_J; ++p; break;
+    case 'z': spec->length = LEN_Z; ++p; break;
+    case 't': spec->length = LEN_T; ++p; break;
+    case 'L': spec->length = LEN_BIG_L; ++p; break;
+    default: break;
+  }
+
+  if (!*p || !strchr("diouxXcsfFeEgGaApn%", *p))
+    return NULL;
+  spec->conv = *p;
+  return p + 1;
+}
+
+//==== Global variables here
+
+static _Atomic(ilog_ring_t*) all_rings;
+static _Thread_local ilog_ring_t* thread_ring;
+static _Thread_local bool in_drain;
+
+/// Serializes consumers: writer thread, and threads calling `ilog_flush()`
+static pthread_mutex_t drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static atomic_size_t total_dropped;
+
+static atomic_bool writer_running;
+static atomic_bool writer_stop;
+static pthread_t   writer_thread;
+static int         writer_fd = STDERR_FILENO;
+
+/// Formatted messages waiting for `writev()`, and ends of them
+static ia_arr$(char)   out_text;
+static ia_arr$(size_t) out_ends;
+
+//==== Capturing messages
+
+/// Record is built here before it is copied into the ring
+static _Thread_local alignas(8) char scratch[MAX_RECORD];
+
+static size_t align8(size_t n) {
+  return (n + 7) & ~(size_t) 7;
+}
+
+/// Append a value to the record, if it fits
+#define put$(record, size, value) do {                                         \
+    __typeof__(value) _ilog_value = (value);                                   \
+    if (*(size) + align8(sizeof(_ilog_value)) <= MAX_RECORD)                   \
+      memcpy((record) + *(size), &_ilog_value, sizeof(_ilog_value));           \
+    *(size) += align8(sizeof(_ilog_value));                                    \
+  } while(0)
+
+/// Precision written as digits in the conversion, or -1 if there is none
+static int written_precision(const ilog_spec_t* spec) {
+  const char* dot = memchr(spec->flags_begin, '.', (size_t) (spec->flags_end - spec->flags_begin));
+  if (!dot)
+    return -1;
+  int precision = 0;
+  for (const char* p = dot + 1; p < spec->flags_end && *p >= '0' && *p <= '9'; ++p)
+    precision = precision < ILOG_MAX_STRING ? precision * 10 + (*p - '0') : ILOG_MAX_STRING;
+  return precision;
+}
+
+/// Copy string into the record. With `precision` of zero or more, no more
+/// bytes are read, so strings do not have to be `\0`-terminated.
+static void put_string(char* record, size_t* size, const char* str, int precision) {
+
+  if (!str)
+    str = "(null)";
+
+  size_t max = precision >= 0 && precision < ILOG_MAX_STRING ? (size_t) precision : ILOG_MAX_STRING;
+  size_t len = strnlen(str, max);
+  if (*size + 8 + align8(len) > MAX_RECORD)
+    len = 0;
+
+  put$(record, size, (uint32_t) len);
+  if (*size + align8(len) <= MAX_RECORD)
+    memcpy(record + *size, str, len);
+  *size += align8(len);
+}
+
+/// Encode arguments of `fmt` after the header, returns size of the record
+static size_t encode(char* record, const char* fmt, va_list args) {
+
+  size_t size = align8(sizeof(ilog_header_t));
+  ilog_spec_t spec;
+
+  for (const char* p = fmt; *p; ) {
+
+    if (*p != '%') {
+      ++p;
+      continue;
+    }
+    const char* next = parse_spec(p, &spec);
+    if (!next)
+      break;
+    p = next;
+
+    if (spec.star_width)
+      put$(record, &size, (long long) va_arg(args, int));
+    // Negative precision from arguments is the same as none
+    int precision = -1;
+    if (spec.star_precision) {
+      precision = va_arg(args, int);
+      put$(record, &size, (long long) precision);
+    } else
+      precision = written_precision(&spec);
+
+    switch (spec.conv) {
+      case 'd': case 'i':
+        switch (spec.length) {
+          case LEN_HH: put$(record, &size, (long long) (signed char) va_arg(args, int)); break;
+          case LEN_H:  put$(record, &size, (long long) (short) va_arg(args, int)); break;
+          case LEN_L:  put$(record, &size, (long long) va_arg(args, long)); break;
+          case LEN_LL: put$(record, &size, (long long) va_arg(args, long long)); break;
+          case LEN_J:  put$(record, &size, (long long) va_arg(args, intmax_t)); break;
+          case LEN_Z:  put$(record, &size, (long long) va_arg(args, ssize_t)); break;
+          case LEN_T:  put$(record, &size, (long long) va_arg(args, ptrdiff_t)); break;
+          default:     put$(record, &size, (long long) va_arg(args, int)); break;
+        }
+        break;
+
+      case 'o': case 'u': case 'x': case 'X':
+        switch (spec.length) {
+          case LEN_HH: put$(record, &size, (unsigned long long) (unsigned char) va_arg(args, unsigned)); break;
+          case LEN_H:  put$(record, &size, (unsigned long long) (unsigned short) va_arg(args, unsigned)); break;
+          case LEN_L:  put$(record, &size, (unsigned long long) va_arg(args, unsigned long)); break;
+          case LEN_LL: put$(record, &size, (unsigned long long) va_arg(args, unsigned long long)); break;
+          case LEN_J:  put$(record, &size, (unsigned long long) va_arg(args, uintmax_t)); break;
+          case LEN_Z:  put$(record, &size, (unsigned long long) va_arg(args, size_t)); break;
+          case LEN_T:  put$(record, &size, (unsigned long long) va_arg(args, ptrdiff_t)); break;
+          default:     put$(record, &size, (unsigned long long) va_arg(args, unsigned)); break;
+        }
+        break;
+
+      case 'c':
+        put$(record, &size, (long long) va_arg(args, int));
+        break;
+
+      case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        if (spec.length == LEN_BIG_L)
+          put$(record, &size, va_arg(args, long double));
+        else
+          put$(record, &size, va_arg(args, double));
+        break;
+
+      case 's':
+        if (spec.length == LEN_L) {
+          (void) va_arg(args, void*);
+          put_string(record, &size, "(wide string)", precision);
+        } else {
+          put_string(record, &size, va_arg(args, const char*), precision);
+        }
+        break;
+
+      case 'p':
+        put$(record, &size, va_arg(args, void*));
+        break;
+
+      case 'n':
+        (void) va_arg(args, void*);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  return size <= MAX_RECORD ? size : 0;
+}
+
+static ilog_ring_t* current_ring(void) {
+
+  if (thread_ring)
+    return thread_ring;
+
+  // Rings live as long as the process, messages of exited
+  // threads may still be unwritten
+  ilog_ring_t* ring = calloc(1, sizeof(ilog_ring_t));
+  check$(ring, "Should allocate logging ring of a thread");
+
+  // Lock-free push into the list
+  ring->next = atomic_load(&all_rings);
+  while (!atomic_compare_exchange_weak(&all_rings, &ring->next, ring)) {}
+
+  thread_ring = ring;
+  return ring;
+}
+
+/// Copy record into the ring of current thread
+static void push_record(const char* record, size_t size) {
+
+  ilog_ring_t* ring = current_ring();
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+  // Records are not split, so the rest of the ring is skipped if it is too small
+  size_t offset = head & (ILOG_RING_SIZE - 1);
+  size_t padding = offset + size > ILOG_RING_SIZE ? ILOG_RING_SIZE - offset : 0;
+
+  if (head + padding + size - tail > ILOG_RING_SIZE) {
+    atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&total_dropped, 1, memory_order_relaxed);
+    return;
+  }
+
+  if (padding) {
+    ilog_header_t pad = { .size = (uint32_t) padding, .level = LEVEL_PADDING };
+    memcpy(ring->data + offset, &pad, offsetof(ilog_header_t, nsec));
+    head += padding;
+    offset = 0;
+  }
+
+  memcpy(ring->data + offset, record, size);
+  atomic_store_explicit(&ring->head, head + size, memory_order_release);
+}
+
+//==== Formatting messages
+
+/// Read next value of the record into new variable `var`.
+/// Values are only 8-byte aligned, so they are copied.
+#define take$(record, pos, type, var)                                          \
+  type var;                                                                    \
+  memcpy(&var, (record) + *(pos), sizeof(type));                               \
+  *(pos) += align8(sizeof(type))
+
+/// Format one value straight into room at the end of `out`, whatever its size
+#define format$(out, conv, value)                                              \
+  do {                                                                         \
+    int len = snprintf(NULL, 0, (conv), (value));                              \
+    if (len > 0) {                                                             \
+      size_t at = ia_length(*(out));                                           \
+      ia_reserve$((out), (size_t) len + 1);                                    \
+      snprintf(*(out) + at, (size_t) len + 1, (conv), (value));                \
+      ia_set_length$((out), at + (size_t) len);                                \
+    }                                                                          \
+  } while (0)
+
+static void format_message(const char* record, ia_arr$(char)* out) {
+
+  const ilog_header_t* h = (const ilog_header_t*) record;
+  static const char* level_names[] = { "debug", "info", "warn", "error", "fatal" };
+
+  char buf[128];
+  struct tm tm;
+  time_t sec = (time_t) h->sec;
+  localtime_r(&sec, &tm);
+  size_t n = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+  n += (size_t) snprintf(buf + n, sizeof(buf) - n, ".%06u [%s] ",
+                         (unsigned) (h->nsec / 1000), level_names[h->level < 5 ? h->level : 4]);
+  ia_append$(out, buf, n);
+  ia_append$(out, h->location, strlen(h->location));
+  ia_append$(out, ": ", 2);
+
+  size_t pos = align8(sizeof(ilog_header_t));
+  ilog_spec_t spec;
+
+  for (const char* p = h->fmt; *p; ) {
+
+    if (*p != '%') {
+      const char* next = strchr(p, '%');
+      size_t len = next ? (size_t) (next - p) : strlen(p);
+      ia_append$(out, p, len);
+      p += len;
+      continue;
+    }
+
+    const char* next = parse_spec(p, &spec);
+    if (!next) {
+      ia_append$(out, p, strlen(p));
+      break;
+    }
+    p = next;
+
+    if (spec.conv == '%') {
+      ia_push$(out, '%');
+      continue;
+    }
+    if (spec.conv == 'n')
+      continue;
+
+    // Rebuild the conversion, with widths from arguments written as numbers,
+    // and integers always passed as `long long`.
+    char conv[64];
+    size_t c = 0;
+    conv[c++] = '%';
+    for (const char* f = spec.flags_begin; f < spec.flags_end && c < 40; ++f) {
+      if (*f == '*') {
+        take$(record, &pos, long long, value);
+        c += (size_t) snprintf(conv + c, sizeof(conv) - c, "%lld", value);
+      } else {
+        conv[c++] = *f;
+      }
+    }
+    if (strchr("diouxX", spec.conv)) {
+      conv[c++] = 'l';
+      conv[c++] = 'l';
+    } else if (spec.length == LEN_BIG_L) {
+      conv[c++] = 'L';
+    }
+    conv[c++] = spec.conv;
+    conv[c] = '\0';
+
+    switch (spec.conv) {
+      case 'd': case 'i': {
+        take$(record, &pos, long long, value);
+        format$(out, conv, value);
+        break;
+      }
+      case 'c': {
+        take$(record, &pos, long long, value);
+        format$(out, conv, (int) value);
+        break;
+      }
+      case 'o': case 'u': case 'x': case 'X': {
+        take$(record, &pos, unsigned long long, value);
+        format$(out, conv, value);
+        break;
+      }
+      case 'p': {
+        take$(record, &pos, void*, value);
+        format$(out, conv, value);
+        break;
+      }
+      case 's': {
+        take$(record, &pos, uint32_t, slen);
+        char str[ILOG_MAX_STRING + 1];
+        memcpy(str, record + pos, slen);
+        str[slen] = '\0';
+        pos += align8(slen);
+        format$(out, conv, str);
+        break;
+      }
+      default:
+        if (spec.length == LEN_BIG_L) {
+          take$(record, &pos, long double, value);
+          format$(out, conv, value);
+        } else {
+          take$(record, &pos, double, value);
+          format$(out, conv, value);
+        }
+        break;
+    }
+  }
+
+  ia_push$(out, '\n');
+}
+
+#undef take$
+#undef format$
+
+//==== Writing messages
+
+/// Write formatted messages with as few `writev()` calls as possible
+static void write_out(int fd) {
+
+  size_t n = ia_length(out_ends);
+  size_t begin = 0;
+
+  for (size_t i = 0; i < n; ) {
+
+    struct iovec iov[64];
+    size_t count = 0;
+    for (; i < n && count < 64; ++i, ++count) {
+      iov[count].iov_base = out_text + begin;
+      iov[count].iov_len = out_ends[i] - begin;
+      begin = out_ends[i];
+    }
+
+    struct iovec* v = iov;
+    while (count > 0) {
+      ssize_t written = writev(fd, v, (int) count);
+      if (written < 0)
+        break;
+      // Skip what was written, partial writes are possible
+      while (count > 0 && (size_t) written >= v->iov_len) {
+        written -= (ssize_t) v->iov_len;
+        ++v;
+        --count;
+      }
+      if (count > 0) {
+        v->iov_base = (char*) v->iov_base + written;
+        v->iov_len -= (size_t) written;
+      }
+    }
+  }
+
+  ia_truncate$(&out_text, 0);
+  ia_truncate$(&out_ends, 0);
+}
+
+/// Take all messages from all rings, format and write them.
+/// Returns number of messages written.
+static size_t drain(int fd) {
+
+  size_t written = 0;
+  size_t dropped = 0;
+
+  for (ilog_ring_t* ring = atomic_load(&all_rings); ring; ring = ring->next) {
+
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    while (tail != head) {
+      const char* record = ring->data + (tail & (ILOG_RING_SIZE - 1));
+      const ilog_header_t* h = (const ilog_header_t*) record;
+
+      if (h->level != LEVEL_PADDING) {
+        format_message(record, &out_text);
+        ia_push$(&out_ends, ia_length(out_text));
+        ++written;
+      }
+      tail += h->size;
+    }
+
+    // Messages are copied, so the space can be reused
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    dropped += atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+  }
+
+  if (dropped) {
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "%zu log messages were dropped\n", dropped);
+    ia_append$(&out_text, buf, (size_t) len);
+    ia_push$(&out_ends, ia_length(out_text));
+  }
+
+  write_out(fd);
+  return written;
+}
+
+static void* writer_main(void* arg) {
+  (void) arg;
+
+  while (true) {
+    pthread_mutex_lock(&drain_mutex);
+    in_drain = true;
+    size_t written = drain(writer_fd);
+    in_drain = false;
+    pthread_mutex_unlock(&drain_mutex);
+
+    if (!written) {
+      if (atomic_load(&writer_stop))
+        break;
+      struct timespec pause = { .tv_sec = 0, .tv_nsec = 1000000 };
+      nanosleep(&pause, NULL);
+    }
+  }
+  return NULL;
+}
+
+//==== Implementations
+
+void _ilog_write(ilog_level_t level, const char* location, const char* fmt, ...) {
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  va_list args;
+  va_start(args, fmt);
+  size_t size = encode(scratch, fmt, args);
+  va_end(args);
+
+  if (!size) {
+    // Arguments do not fit, write only the format
+    size = align8(sizeof(ilog_header_t));
+    fmt = "(message too long)";
+  }
+
+  ilog_header_t* h = (ilog_header_t*) scratch;
+  h->size = (uint32_t) size;
+  h->level = (uint8_t) level;
+  h->sec = (int64_t) now.tv_sec;
+  h->nsec = (uint32_t) now.tv_nsec;
+  h->fmt = fmt;
+  h->location = location;
+
+  if (atomic_load_explicit(&writer_running, memory_order_acquire)) {
+    push_record(scratch, size);
+    return;
+  }
+
+  // No writer, format the message right here
+  ia_arr$(char) text = ia_new_empty_array$(char);
+  format_message(scratch, &text);
+  ssize_t written = write(STDERR_FILENO, text, ia_length(text));
+  (void) written;
+  ia_destroy_array(text);
+}
+
+void ilog_start(int fd) {
+
+  check$(!atomic_load(&writer_running), "Logging is already started");
+
+  writer_fd = fd;
+  atomic_store(&writer_stop, false);
+  check$(!pthread_create(&writer_thread, NULL, writer_main, NULL), "Should start logging thread");
+  atomic_store_explicit(&writer_running, true, memory_order_release);
+}
+
+void ilog_stop(void) {
+
+  if (!atomic_load(&writer_running))
+    return;
+
+  atomic_store(&writer_running, false);
+  atomic_store(&writer_stop, true);
+  pthread_join(writer_thread, NULL);
+
+  // Messages logged while the writer was stopping
+  ilog_flush();
+
+  ia_destroy_array(out_text);
+  ia_destroy_array(out_ends);
+  out_text = NULL;
+  out_ends = NULL;
+  writer_fd = STDERR_FILENO;
+}
+
+void ilog_flush(void) {
+
+  // Panic while draining must not deadlock
+  if (in_drain)
+    return;
+
+  pthread_mutex_lock(&drain_mutex);
+  in_drain = true;
+  drain(writer_fd);
+  in_drain = false;
+  pthread_mutex_unlock(&drain_mutex);
+}
+
+size_t ilog_dropped(void) {
+  return atomic_load(&total_dropped);
+}
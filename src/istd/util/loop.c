@@ -0,0 +1,229 @@
+#include "istd/util/loop.h"
+#include "istd/util/err.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+/// Events taken from epoll at once
+#define MAX_EVENTS 64
+
+//==== Timers
+
+/// Set timerfd to the earliest deadline, or disarm it
+static void arm_timer(iloop_t* loop) {
+
+  uint64_t deadline = ia_length(loop->timers) ? loop->timers[0]->deadline : 0;
+  if (deadline == loop->armed)
+    return;
+
+  // Zero value disarms the timer, so deadline is at least 1 ns
+  struct itimerspec spec = { .it_value = {
+    .tv_sec = (time_t) (deadline / 1000000000),
+    .tv_nsec = (long) (deadline % 1000000000),
+  }};
+  check$(!timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL),
+         "Should set timer of the loop: %s", strerror(errno));
+  loop->armed = deadline;
+}
+
+static void heap_push(iloop_t* loop, iloop_task_t* task) {
+
+  ia_push$(&loop->timers, task);
+  iloop_task_t** heap = loop->timers;
+
+  size_t i = ia_length(heap) - 1;
+  while (i > 0 && heap[(i - 1) / 2]->deadline > task->deadline) {
+    heap[i] = heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  heap[i] = task;
+}
+
+static iloop_task_t* heap_pop(iloop_t* loop) {
+
+  iloop_task_t** heap = loop->timers;
+  iloop_task_t* top = heap[0];
+  iloop_task_t* last = heap[ia_length(heap) - 1];
+  ia_pop$(&loop->timers);
+
+  size_t n = ia_length(heap), i = 0;
+  if (!n)
+    return top;
+
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= n)
+      break;
+    if (child + 1 < n && heap[child + 1]->deadline < heap[child]->deadline)
+      ++child;
+    if (heap[child]->deadline >= last->deadline)
+      break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = last;
+  return top;
+}
+
+/// Make tasks with passed deadlines ready
+static void expire_timers(iloop_t* loop) {
+
+  uint64_t expirations;
+  if (read(loop->timer_fd, &expirations, sizeof(expirations)) < 0)
+    check$(errno == EAGAIN, "Should read timer of the loop: %s", strerror(errno));
+
+  uint64_t now = iloop_now();
+  while (ia_length(loop->timers) && loop->timers[0]->deadline <= now)
+    iloop_wake(heap_pop(loop));
+
+  // Timer has fired, and is not armed any more
+  loop->armed = 0;
+  arm_timer(loop);
+}
+
+//==== Implementations
+
+void iloop_init(iloop_t* loop) {
+
+  memset(loop, 0, sizeof(*loop));
+
+  loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  check$(loop->epoll_fd >= 0, "Should create epoll instance: %s", strerror(errno));
+
+  loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  check$(loop->timer_fd >= 0, "Should create timer of the loop: %s", strerror(errno));
+
+  // Timer is told apart from tasks by NULL pointer
+  struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+  check$(!epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->timer_fd, &ev),
+         "Should add timer to epoll: %s", strerror(errno));
+
+  loop->timers = ia_new_empty_array$(iloop_task_t*);
+}
+
+void iloop_destroy(iloop_t* loop) {
+  close(loop->timer_fd);
+  close(loop->epoll_fd);
+  ia_destroy_array(loop->timers);
+  loop->timers = NULL;
+}
+
+void iloop_spawn(iloop_t* loop, iloop_task_t* task, iloop_fn_t fn) {
+
+  check$(task && fn, "Task and its function must be not NULL");
+
+  icoro_init(&task->co);
+  task->fn = fn;
+  task->loop = loop;
+  task->events = 0;
+  task->ready = false;
+  loop->live++;
+  iloop_wake(task);
+}
+
+void iloop_wake(iloop_task_t* task) {
+
+  if (task->ready || icoro_done(&task->co))
+    return;
+
+  iloop_t* loop = task->loop;
+  task->ready = true;
+  task->next = NULL;
+  if (loop->ready_tail)
+    loop->ready_tail->next = task;
+  else
+    loop->ready_head = task;
+  loop->ready_tail = task;
+}
+
+size_t iloop_run(iloop_t* loop) {
+
+  struct epoll_event events[MAX_EVENTS];
+
+  for (;;) {
+
+    // Tasks woken while these run go to the end of the queue
+    while (loop->ready_head) {
+      iloop_task_t* task = loop->ready_head;
+      loop->ready_head = task->next;
+      if (!loop->ready_head)
+        loop->ready_tail = NULL;
+      task->ready = false;
+
+      loop->resumes++;
+      task->fn(task);
+      if (icoro_done(&task->co))
+        loop->live--;
+    }
+
+    if (!loop->live)
+      return 0;
+    // Only parked tasks are left, and nothing can wake them
+    if (!loop->waiting_fds && !ia_length(loop->timers))
+      return loop->live;
+
+    int n = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, -1);
+    if (n < 0) {
+      check$(errno == EINTR, "Should wait for events: %s", strerror(errno));
+      continue;
+    }
+
+    for (int i = 0; i < n; ++i) {
+      iloop_task_t* task = events[i].data.ptr;
+      if (!task) {
+        expire_timers(loop);
+        continue;
+      }
+
+      uint32_t e = events[i].events;
+      task->events = (e & EPOLLIN ? ILOOP_READ : 0) | (e & EPOLLOUT ? ILOOP_WRITE : 0)
+                   | (e & (EPOLLHUP | EPOLLRDHUP) ? ILOOP_HANGUP : 0) | (e & EPOLLERR ? ILOOP_ERROR : 0);
+      loop->waiting_fds--;
+      iloop_wake(task);
+    }
+  }
+}
+
+uint64_t iloop_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+void _iloop_watch_fd(iloop_task_t* task, int fd, unsigned events) {
+
+  iloop_t* loop = task->loop;
+
+  // One-shot registration is disabled after it fires, and is enabled
+  // again with MOD. New descriptors, and ones closed since the last
+  // wait (which epoll forgets), are added.
+  struct epoll_event ev = {
+    .events = EPOLLONESHOT | EPOLLRDHUP
+            | (events & ILOOP_READ ? EPOLLIN : 0) | (events & ILOOP_WRITE ? EPOLLOUT : 0),
+    .data.ptr = task,
+  };
+  if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+    check$(errno == ENOENT, "Should wait for descriptor %d: %s", fd, strerror(errno));
+    check$(!epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev),
+           "Should wait for descriptor %d: %s", fd, strerror(errno));
+  }
+
+  task->events = 0;
+  loop->waiting_fds++;
+}
+
+void _iloop_sleep_until(iloop_task_t* task, uint64_t deadline) {
+
+  iloop_t* loop = task->loop;
+  if (deadline <= iloop_now()) {
+    iloop_wake(task);
+    return;
+  }
+
+  task->deadline = deadline;
+  heap_push(loop, task);
+  arm_timer(loop);
+}
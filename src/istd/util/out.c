@@ -0,0 +1,180 @@
+#include "istd/util/out.h"
+#include "istd/util/err.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Buffer lives as long as its writer, usually until the exit, so it is
+// allocated with plain `malloc()` and is not counted by `istd/util/alloc.h`.
+
+/// States of escape code removal
+enum {
+  TEXT,
+  AFTER_ESC,
+  IN_CSI,
+};
+
+/// Copy text without escape codes, `dst` may be the same as `src`.
+/// Returns number of bytes copied.
+static size_t strip(unsigned char* state, char* dst, const char* src, size_t len) {
+
+  size_t n = 0;
+  for (size_t i = 0; i < len; ++i) {
+    unsigned char c = (unsigned char) src[i];
+    switch (*state) {
+      case TEXT:
+        if (c == 0x1b)
+          *state = AFTER_ESC;
+        else
+          dst[n++] = (char) c;
+        break;
+      case AFTER_ESC:
+        // Sequences other than CSI are two bytes long
+        *state = c == '[' ? IN_CSI : TEXT;
+        break;
+      default:
+        // Parameters, until the final byte
+        if (c >= 0x40 && c <= 0x7e)
+          *state = TEXT;
+        break;
+    }
+  }
+  return n;
+}
+
+static void reserve(iout_t* out, size_t extra) {
+  if (out->len + extra <= out->cap)
+    return;
+
+  size_t cap = out->cap ? out->cap : IOUT_FLUSH_SIZE;
+  while (cap < out->len + extra)
+    cap *= 2;
+
+  char* buf = realloc(out->buf, cap);
+  check$(buf, "Should allocate %zu bytes of output buffer", cap);
+  out->buf = buf;
+  out->cap = cap;
+}
+
+/// Flush if appended text requires it
+static void appended(iout_t* out, size_t from) {
+  if (out->len >= IOUT_FLUSH_SIZE
+      || (out->line_buffered && memchr(out->buf + from, '\n', out->len - from)))
+    iout_flush(out);
+}
+
+void iout_init(iout_t* out, int fd) {
+
+  check$(out, "Writer must be not null");
+
+  bool tty = isatty(fd);
+  const char* no_color = getenv("NO_COLOR");
+
+  *out = (iout_t) {
+    .fd = fd,
+    .colors = tty && !(no_color && *no_color),
+    .line_buffered = tty,
+  };
+}
+
+void iout_destroy(iout_t* out) {
+  iout_flush(out);
+  free(out->buf);
+  out->buf = NULL;
+  out->cap = 0;
+}
+
+static iout_t stderr_out;
+static bool   stderr_out_ready;
+
+static void flush_stderr_at_exit(void) {
+  iout_flush(&stderr_out);
+}
+
+iout_t* iout_stderr(void) {
+  if (!stderr_out_ready) {
+    iout_init(&stderr_out, STDERR_FILENO);
+    atexit(flush_stderr_at_exit);
+    stderr_out_ready = true;
+  }
+  return &stderr_out;
+}
+
+void iout_write(iout_t* out, const char* text, size_t len) {
+
+  reserve(out, len);
+  size_t from = out->len;
+  if (out->colors) {
+    memcpy(out->buf + out->len, text, len);
+    out->len += len;
+  } else {
+    out->len += strip(&out->escape, out->buf + out->len, text, len);
+  }
+  appended(out, from);
+}
+
+void iout_puts(iout_t* out, const char* text) {
+  iout_write(out, text, strlen(text));
+}
+
+void iout_printf(iout_t* out, const char* fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  iout_vprintf(out, fmt, args);
+  va_end(args);
+}
+
+void iout_vprintf(iout_t* out, const char* fmt, va_list args) {
+
+  va_list again;
+  va_copy(again, args);
+
+  // Usually text fits into the rest of the buffer
+  reserve(out, 256);
+  size_t avail = out->cap - out->len;
+  int len = vsnprintf(out->buf + out->len, avail, fmt, args);
+  check$(len >= 0, "Should format output text");
+
+  if ((size_t) len >= avail) {
+    reserve(out, (size_t) len + 1);
+    vsnprintf(out->buf + out->len, (size_t) len + 1, fmt, again);
+  }
+  va_end(again);
+
+  size_t from = out->len;
+  if (out->colors)
+    out->len += (size_t) len;
+  else
+    out->len += strip(&out->escape, out->buf + out->len, out->buf + out->len, (size_t) len);
+  appended(out, from);
+}
+
+void iout_flush(iout_t* out) {
+
+  size_t done = 0;
+  while (done < out->len) {
+    ssize_t n = write(out->fd, out->buf + done, out->len - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += (size_t) n;
+  }
+  out->len = 0;
+}
+
+bool iout_rewrite_above(iout_t* out, unsigned lines_up, const char* text) {
+
+  if (!out->colors)
+    return false;
+
+  iout_printf(out, "\x1b[%uA\r%s\x1b[%uB\r", lines_up, text, lines_up);
+  return true;
+}
+
+size_t iout_strip_escapes(char* text, size_t len) {
+  unsigned char state = TEXT;
+  return strip(&state, text, text, len);
+}
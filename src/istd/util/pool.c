@@ -0,0 +1,477 @@
+// For mremap()
+#define _GNU_SOURCE
+
+#include "istd/util/pool.h"
+#include "istd/util/err.h"
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+//==== Size classes
+
+#define NUM_CLASSES 40
+#define LARGE_CLASS UINT32_MAX
+
+/// Space at the beginning of each span, blocks start after it
+#define SPAN_HEADER 64
+#define SPAN_MAGIC  0x15d9001u
+
+/// Bytes cached by a thread for one class, before it gives a batch back
+#define CACHED_BYTES (16 * 1024)
+
+/// Size class of `size`, computed
+static unsigned compute_class(size_t size) {
+  if (size <= 128)
+    return size ? (unsigned) ((size - 1) >> 4) : 0;
+
+  // 2^p < size <= 2^(p + 1), cut into four classes
+  unsigned p = 63u - (unsigned) __builtin_clzll((unsigned long long) size - 1);
+  return 8 + (p - 7) * 4 + (unsigned) ((size - 1) >> (p - 2)) - 4;
+}
+
+static size_t compute_class_size(unsigned cls) {
+  if (cls < 8)
+    return (cls + 1) * 16;
+
+  unsigned p = 7 + (cls - 8) / 4, step = (cls - 8) % 4;
+  return ((size_t) 1 << p) + (((size_t) step + 1) << (p - 2));
+}
+
+// Tables filled once, as computing classes on every call is slow
+
+/// Size class of sizes up to 1024, by `(size + 15) / 16`
+static uint8_t  small_classes[1024 / 16 + 1];
+static uint32_t class_sizes[NUM_CLASSES];
+/// Number of blocks moved between a thread and central list at once
+static uint32_t batch_sizes[NUM_CLASSES];
+
+static void fill_tables(void) {
+  for (size_t i = 0; i < sizeof(small_classes); ++i)
+    small_classes[i] = (uint8_t) compute_class(i * 16);
+  for (unsigned cls = 0; cls < NUM_CLASSES; ++cls) {
+    class_sizes[cls] = (uint32_t) compute_class_size(cls);
+    size_t n = CACHED_BYTES / class_sizes[cls];
+    batch_sizes[cls] = n < 2 ? 2 : n > IPOOL_MAX_BATCH ? IPOOL_MAX_BATCH : (uint32_t) n;
+  }
+}
+
+static unsigned size_class(size_t size) {
+  return size <= 1024 ? small_classes[(size + 15) >> 4] : compute_class(size);
+}
+
+static size_t class_size(unsigned cls) {
+  return class_sizes[cls];
+}
+
+static unsigned batch_size(unsigned cls) {
+  return batch_sizes[cls];
+}
+
+//==== Spans and blocks
+
+/// Beginning of a span, or of a large block
+typedef struct {
+  uint32_t magic;
+  /// Size class of all blocks, or `LARGE_CLASS`
+  uint32_t cls;
+  /// Large blocks: number of bytes mapped
+  size_t mapped;
+} span_t;
+
+_Static_assert(sizeof(span_t) <= SPAN_HEADER, "Span header should fit");
+
+/// Free block
+typedef struct block_t {
+  struct block_t* next;
+} block_t;
+
+static _Atomic size_t mapped_bytes, spans, large_blocks;
+
+static span_t* span_of(const void* ptr) {
+  span_t* span = (span_t*) ((uintptr_t) ptr & ~(uintptr_t) (IPOOL_SPAN_SIZE - 1));
+  check$(span->magic == SPAN_MAGIC, "Pointer %p was not allocated by ipool", ptr);
+  return span;
+}
+
+static size_t page_round(size_t size) {
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+  return (size + page - 1) & ~(page - 1);
+}
+
+/// Map `size` bytes aligned to `IPOOL_SPAN_SIZE`, size is a multiple of pages
+static void* map_aligned(size_t size) {
+
+  size_t total = size + IPOOL_SPAN_SIZE;
+  char* mem = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED)
+    return NULL;
+
+  char* aligned = (char*) (((uintptr_t) mem + IPOOL_SPAN_SIZE - 1) & ~(uintptr_t) (IPOOL_SPAN_SIZE - 1));
+  if (aligned > mem)
+    munmap(mem, (size_t) (aligned - mem));
+  if (mem + total > aligned + size)
+    munmap(aligned + size, (size_t) (mem + total - (aligned + size)));
+  return aligned;
+}
+
+//==== Central lists
+
+typedef struct {
+  alignas(64) pthread_mutex_t lock;
+  block_t* free;
+  /// Part of the newest span not cut into blocks yet
+  char *cut, *cut_end;
+} central_t;
+
+static central_t central[NUM_CLASSES];
+
+/// Take up to `n` blocks of given class, linked into a list.
+/// Returns number of blocks taken, `0` only if memory has run out.
+static unsigned central_take(unsigned cls, unsigned n, block_t** list) {
+
+  central_t* cen = &central[cls];
+  size_t size = class_size(cls);
+  unsigned taken = 0;
+  block_t* head = NULL;
+
+  pthread_mutex_lock(&cen->lock);
+
+  while (taken < n && cen->free) {
+    block_t* b = cen->free;
+    cen->free = b->next;
+    b->next = head;
+    head = b;
+    ++taken;
+  }
+
+  while (taken < n) {
+    if (cen->cut + size > cen->cut_end) {
+      span_t* span = map_aligned(IPOOL_SPAN_SIZE);
+      if (!span)
+        break;
+      span->magic = SPAN_MAGIC;
+      span->cls = cls;
+      cen->cut = (char*) span + SPAN_HEADER;
+      cen->cut_end = (char*) span + IPOOL_SPAN_SIZE;
+      atomic_fetch_add_explicit(&mapped_bytes, IPOOL_SPAN_SIZE, memory_order_relaxed);
+      atomic_fetch_add_explicit(&spans, 1, memory_order_relaxed);
+    }
+    block_t* b = (block_t*) cen->cut;
+    cen->cut += size;
+    b->next = head;
+    head = b;
+    ++taken;
+  }
+
+  pthread_mutex_unlock(&cen->lock);
+  *list = head;
+  return taken;
+}
+
+/// Give a list of blocks from `first` to `last` back
+static void central_give(unsigned cls, block_t* first, block_t* last) {
+  central_t* cen = &central[cls];
+  pthread_mutex_lock(&cen->lock);
+  last->next = cen->free;
+  cen->free = first;
+  pthread_mutex_unlock(&cen->lock);
+}
+
+//==== Thread caches
+
+typedef struct {
+  block_t* head;
+  unsigned count;
+} bin_t;
+
+typedef struct cache_t {
+  bin_t bins[NUM_CLASSES];
+  /// Counters, written only by the owning thread
+  _Atomic int64_t used;
+  _Atomic uint64_t hits, misses, batches;
+  /// List of caches of all threads
+  struct cache_t *prev, *next;
+  bool ready;
+} cache_t;
+
+/// Add to a counter written by one thread only, without a locked instruction
+#define bump$(counter, delta)                                                  \
+  atomic_store_explicit(&(counter),                                            \
+      atomic_load_explicit(&(counter), memory_order_relaxed) + (delta),        \
+      memory_order_relaxed)
+
+static _Thread_local cache_t cache;
+
+static pthread_once_t  init_once = PTHREAD_ONCE_INIT;
+static pthread_key_t   exit_key;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static cache_t*        caches;
+/// Counters of exited threads, under `registry_lock`
+static int64_t         retired_used;
+static uint64_t        retired_hits, retired_misses, retired_batches;
+
+static void release_thread(void* arg);
+
+static void init_globals(void) {
+  fill_tables();
+  for (unsigned i = 0; i < NUM_CLASSES; ++i)
+    pthread_mutex_init(&central[i].lock, NULL);
+  check$(!pthread_key_create(&exit_key, release_thread), "Should create a key for thread caches");
+}
+
+static void register_thread(void) {
+
+  pthread_once(&init_once, init_globals);
+
+  pthread_mutex_lock(&registry_lock);
+  cache.prev = NULL;
+  cache.next = caches;
+  if (caches)
+    caches->prev = &cache;
+  caches = &cache;
+  pthread_mutex_unlock(&registry_lock);
+
+  pthread_setspecific(exit_key, &cache);
+  cache.ready = true;
+}
+
+static void release_thread(void* arg) {
+
+  cache_t* c = arg;
+  ipool_thread_flush();
+
+  pthread_mutex_lock(&registry_lock);
+  retired_used += atomic_load(&c->used);
+  retired_hits += atomic_load(&c->hits);
+  retired_misses += atomic_load(&c->misses);
+  retired_batches += atomic_load(&c->batches);
+  if (c->prev)
+    c->prev->next = c->next;
+  else
+    caches = c->next;
+  if (c->next)
+    c->next->prev = c->prev;
+  pthread_mutex_unlock(&registry_lock);
+
+  // Frees by destructors running later register the thread again
+  memset(c, 0, sizeof(*c));
+}
+
+static cache_t* thread_cache(void) {
+  if (__builtin_expect(!cache.ready, 0))
+    register_thread();
+  return &cache;
+}
+
+/// Give a batch of cached blocks of the class back
+static void give_batch(cache_t* c, unsigned cls) {
+
+  bin_t* bin = &c->bins[cls];
+  unsigned n = batch_size(cls);
+  block_t* first = bin->head;
+  block_t* last = first;
+  for (unsigned i = 1; i < n; ++i)
+    last = last->next;
+
+  bin->head = last->next;
+  bin->count -= n;
+  central_give(cls, first, last);
+  bump$(c->batches, 1);
+}
+
+void ipool_thread_flush(void) {
+
+  if (!cache.ready)
+    return;
+
+  for (unsigned cls = 0; cls < NUM_CLASSES; ++cls) {
+    bin_t* bin = &cache.bins[cls];
+    if (!bin->head)
+      continue;
+
+    block_t* last = bin->head;
+    while (last->next)
+      last = last->next;
+    central_give(cls, bin->head, last);
+    bin->head = NULL;
+    bin->count = 0;
+    bump$(cache.batches, 1);
+  }
+}
+
+//==== Large blocks
+
+static void* large_alloc(size_t size) {
+
+  if (size > SIZE_MAX / 2)
+    return NULL;
+
+  size_t mapped = page_round(size + SPAN_HEADER);
+  span_t* span = map_aligned(mapped);
+  if (!span)
+    return NULL;
+
+  span->magic = SPAN_MAGIC;
+  span->cls = LARGE_CLASS;
+  span->mapped = mapped;
+
+  atomic_fetch_add_explicit(&mapped_bytes, mapped, memory_order_relaxed);
+  atomic_fetch_add_explicit(&large_blocks, 1, memory_order_relaxed);
+  bump$(thread_cache()->used, (int64_t) (mapped - SPAN_HEADER));
+  return (char*) span + SPAN_HEADER;
+}
+
+static void large_free(span_t* span) {
+  size_t mapped = span->mapped;
+  atomic_fetch_sub_explicit(&mapped_bytes, mapped, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&large_blocks, 1, memory_order_relaxed);
+  bump$(thread_cache()->used, -(int64_t) (mapped - SPAN_HEADER));
+  munmap(span, mapped);
+}
+
+/// Resize large block without moving it, if possible
+static bool large_resize(span_t* span, size_t size) {
+
+  if (size > SIZE_MAX / 2)
+    return false;
+
+  size_t old = span->mapped, mapped = page_round(size + SPAN_HEADER);
+  if (mapped < old)
+    munmap((char*) span + mapped, old - mapped);
+  else if (mapped > old && mremap(span, old, mapped, 0) == MAP_FAILED)
+    return false;
+
+  span->mapped = mapped;
+  atomic_fetch_add_explicit(&mapped_bytes, mapped - old, memory_order_relaxed);
+  bump$(thread_cache()->used, (int64_t) mapped - (int64_t) old);
+  return true;
+}
+
+//==== Allocation
+
+void* ipool_malloc(size_t size) {
+
+  if (size > IPOOL_MAX_SMALL)
+    return large_alloc(size);
+
+  cache_t* c = thread_cache();
+  unsigned cls = size_class(size);
+  bin_t* bin = &c->bins[cls];
+  block_t* b = bin->head;
+
+  if (__builtin_expect(b != NULL, 1)) {
+    bin->head = b->next;
+    --bin->count;
+    bump$(c->hits, 1);
+  } else {
+    unsigned n = central_take(cls, batch_size(cls), &b);
+    if (!n)
+      return NULL;
+    bin->head = b->next;
+    bin->count = n - 1;
+    bump$(c->misses, 1);
+    bump$(c->batches, 1);
+  }
+
+  bump$(c->used, (int64_t) class_size(cls));
+  return b;
+}
+
+void* ipool_calloc(size_t num, size_t size) {
+
+  if (size && num > SIZE_MAX / size)
+    return NULL;
+
+  size_t total = num * size;
+  void* ptr = ipool_malloc(total);
+  // Large blocks are freshly mapped, and are zeroed already
+  if (ptr && total <= IPOOL_MAX_SMALL)
+    memset(ptr, 0, total);
+  return ptr;
+}
+
+void* ipool_realloc(void* ptr, size_t size) {
+
+  if (!ptr)
+    return ipool_malloc(size);
+
+  span_t* span = span_of(ptr);
+  if (span->cls == LARGE_CLASS) {
+    if (size > IPOOL_MAX_SMALL && large_resize(span, size))
+      return ptr;
+  } else if (size <= IPOOL_MAX_SMALL && size_class(size) == span->cls) {
+    return ptr;
+  }
+
+  void* nw = ipool_malloc(size);
+  if (!nw)
+    return NULL;
+
+  size_t old_size = ipool_usable_size(ptr);
+  memcpy(nw, ptr, old_size < size ? old_size : size);
+  ipool_free(ptr);
+  return nw;
+}
+
+void ipool_free(void* ptr) {
+
+  if (!ptr)
+    return;
+
+  span_t* span = span_of(ptr);
+  if (span->cls == LARGE_CLASS) {
+    large_free(span);
+    return;
+  }
+
+  cache_t* c = thread_cache();
+  unsigned cls = span->cls;
+  bin_t* bin = &c->bins[cls];
+  block_t* b = ptr;
+
+  b->next = bin->head;
+  bin->head = b;
+  bump$(c->used, -(int64_t) class_size(cls));
+
+  if (++bin->count >= 2 * batch_size(cls))
+    give_batch(c, cls);
+}
+
+size_t ipool_usable_size(const void* ptr) {
+  span_t* span = span_of(ptr);
+  return span->cls == LARGE_CLASS ? span->mapped - SPAN_HEADER : class_size(span->cls);
+}
+
+//==== Statistics
+
+ipool_stats_t ipool_stats(void) {
+
+  pthread_mutex_lock(&registry_lock);
+  int64_t used = retired_used;
+  uint64_t hits = retired_hits, misses = retired_misses, batches = retired_batches;
+  for (cache_t* c = caches; c; c = c->next) {
+    used += atomic_load_explicit(&c->used, memory_order_relaxed);
+    hits += atomic_load_explicit(&c->hits, memory_order_relaxed);
+    misses += atomic_load_explicit(&c->misses, memory_order_relaxed);
+    batches += atomic_load_explicit(&c->batches, memory_order_relaxed);
+  }
+  pthread_mutex_unlock(&registry_lock);
+
+  ipool_stats_t stats = {
+    .mapped_bytes = atomic_load_explicit(&mapped_bytes, memory_order_relaxed),
+    .used_bytes = used > 0 ? (size_t) used : 0,
+    .cache_hits = hits,
+    .cache_misses = misses,
+    .batches = batches,
+    .spans = atomic_load_explicit(&spans, memory_order_relaxed),
+    .large_blocks = atomic_load_explicit(&large_blocks, memory_order_relaxed),
+  };
+  stats.fragmentation = stats.mapped_bytes ? 1.0 - (double) stats.used_bytes / (double) stats.mapped_bytes : 0;
+  stats.hit_rate = hits + misses ? (double) hits / (double) (hits + misses) : 0;
+  return stats;
+}
@@ -0,0 +1,306 @@
+#include "istd/util/prof.h"
+#include "istd/util/err.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//==== Internal structures
+
+/// Recorded event
+typedef struct {
+  const char* name;
+  uint64_t begin;
+  /// End of a zone, or value of a counter or a gauge
+  uint64_t end_or_value;
+  uint32_t depth;
+  uint8_t kind;
+} iprof_event_t;
+
+/// Events of one thread
+typedef struct iprof_buffer_t {
+  struct iprof_buffer_t* next;
+  uint32_t tid;
+  /// Events `[0, count)` are written, and may be read by other threads
+  atomic_size_t count;
+  atomic_size_t dropped;
+  iprof_event_t events[IPROF_BUFFER_EVENTS];
+} iprof_buffer_t;
+
+//==== Global variables here
+
+atomic_bool _iprof_enabled;
+_Thread_local _iprof_stack_t _iprof_stack;
+
+static _Thread_local iprof_buffer_t* thread_buffer;
+
+/// List of buffers of all threads, only ever grows
+static _Atomic(iprof_buffer_t*) all_buffers;
+static atomic_uint next_tid;
+
+/// Timestamps and time of `iprof_start()` and `iprof_stop()`,
+/// to convert one into another.
+static uint64_t start_ticks, start_ns, stop_ticks, stop_ns;
+
+//==== Recording
+
+static uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+void iprof_thread_init(void) {
+
+  if (thread_buffer)
+    return;
+
+  // Buffers live as long as the process, since events of exited
+  // threads are still to be dumped, so they are not counted as leaks
+  iprof_buffer_t* buf = calloc(1, sizeof(iprof_buffer_t));
+  check$(buf, "Should allocate profiling buffer of a thread");
+  buf->tid = atomic_fetch_add(&next_tid, 1) + 1;
+
+  // Lock-free push into the list
+  buf->next = atomic_load(&all_buffers);
+  while (!atomic_compare_exchange_weak(&all_buffers, &buf->next, buf)) {}
+
+  thread_buffer = buf;
+}
+
+void _iprof_record(iprof_kind_t kind, const char* name, uint64_t begin, uint64_t end_or_value, unsigned depth) {
+
+  if (!thread_buffer)
+    iprof_thread_init();
+
+  iprof_buffer_t* buf = thread_buffer;
+  size_t n = atomic_load_explicit(&buf->count, memory_order_relaxed);
+  if (n == IPROF_BUFFER_EVENTS) {
+    atomic_fetch_add_explicit(&buf->dropped, 1, memory_order_relaxed);
+    return;
+  }
+
+  buf->events[n] = (iprof_event_t) {
+    .name = name,
+    .begin = begin,
+    .end_or_value = end_or_value,
+    .depth = depth,
+    .kind = (uint8_t) kind,
+  };
+  // Publish the event to readers
+  atomic_store_explicit(&buf->count, n + 1, memory_order_release);
+}
+
+void iprof_start(void) {
+  start_ticks = _iprof_now();
+  start_ns = monotonic_ns();
+  stop_ticks = 0;
+  atomic_store(&_iprof_enabled, true);
+}
+
+void iprof_stop(void) {
+  atomic_store(&_iprof_enabled, false);
+  stop_ticks = _iprof_now();
+  stop_ns = monotonic_ns();
+}
+
+void iprof_reset(void) {
+  for (iprof_buffer_t* buf = atomic_load(&all_buffers); buf; buf = buf->next) {
+    atomic_store(&buf->count, 0);
+    atomic_store(&buf->dropped, 0);
+  }
+}
+
+size_t iprof_dropped(void) {
+  size_t dropped = 0;
+  for (iprof_buffer_t* buf = atomic_load(&all_buffers); buf; buf = buf->next)
+    dropped += atomic_load(&buf->dropped);
+  return dropped;
+}
+
+//==== Reading events
+
+/// Nanoseconds in one tick
+static double ns_per_tick(void) {
+  uint64_t ticks = stop_ticks ? stop_ticks : _iprof_now();
+  uint64_t ns = stop_ticks ? stop_ns : monotonic_ns();
+  if (ticks <= start_ticks || ns <= start_ns)
+    return 1.0;
+  return (double) (ns - start_ns) / (double) (ticks - start_ticks);
+}
+
+static iprof_stat_t* find_stat(ia_arr$(iprof_stat_t) stats, iprof_kind_t kind, const char* name) {
+  for (size_t i = 0; i < ia_length(stats); ++i)
+    if (stats[i].kind == kind && (stats[i].name == name || !strcmp(stats[i].name, name)))
+      return &stats[i];
+  return NULL;
+}
+
+static int compare_stats(const void* pa, const void* pb) {
+  const iprof_stat_t* a = pa;
+  const iprof_stat_t* b = pb;
+  if (a->kind != b->kind)
+    return (int) a->kind - (int) b->kind;
+  if (a->kind == IPROF_ZONE && a->total_ns != b->total_ns)
+    return a->total_ns < b->total_ns ? 1 : -1;
+  return strcmp(a->name, b->name);
+}
+
+ia_arr$(iprof_stat_t) iprof_collect(void) {
+
+  ia_arr$(iprof_stat_t) stats = ia_new_empty_array$(iprof_stat_t);
+  double scale = ns_per_tick();
+
+  // Last value of each gauge is the one with the latest timestamp
+  ia_arr$(uint64_t) gauge_time = ia_new_empty_array$(uint64_t);
+
+  for (iprof_buffer_t* buf = atomic_load(&all_buffers); buf; buf = buf->next) {
+
+    size_t n = atomic_load_explicit(&buf->count, memory_order_acquire);
+    for (size_t i = 0; i < n; ++i) {
+
+      const iprof_event_t* e = &buf->events[i];
+      iprof_stat_t* s = find_stat(stats, (iprof_kind_t) e->kind, e->name);
+      if (!s) {
+        iprof_stat_t nw = { .name = e->name, .kind = (iprof_kind_t) e->kind };
+        ia_push$(&stats, nw);
+        ia_push$(&gauge_time, 0);
+        s = &stats[ia_length(stats) - 1];
+      }
+
+      int64_t value = (int64_t) e->end_or_value;
+      double ns = (double) (e->end_or_value - e->begin) * scale;
+
+      switch ((iprof_kind_t) e->kind) {
+        case IPROF_ZONE:
+          s->total_ns += ns;
+          s->min_ns = s->count == 0 || ns < s->min_ns ? ns : s->min_ns;
+          s->max_ns = s->count == 0 || ns > s->max_ns ? ns : s->max_ns;
+          break;
+        case IPROF_COUNTER:
+          s->value += value;
+          break;
+        case IPROF_GAUGE:
+          if (s->count == 0 || e->begin >= gauge_time[s - stats]) {
+            s->value = value;
+            gauge_time[s - stats] = e->begin;
+          }
+          s->min = s->count == 0 || value < s->min ? value : s->min;
+          s->max = s->count == 0 || value > s->max ? value : s->max;
+          break;
+      }
+      s->count++;
+    }
+  }
+
+  ia_destroy_array(gauge_time);
+  qsort(stats, ia_length(stats), sizeof(iprof_stat_t), compare_stats);
+  return stats;
+}
+
+void iprof_print_summary(FILE* out) {
+
+  ia_arr$(iprof_stat_t) stats = iprof_collect();
+
+  for (size_t i = 0; i < ia_length(stats); ++i) {
+    const iprof_stat_t* s = &stats[i];
+
+    if (i == 0 || stats[i - 1].kind != s->kind) {
+      static const char* titles[] = {
+        [IPROF_ZONE]    = "\n%-32s %10s %14s %12s %12s %12s\n",
+        [IPROF_COUNTER] = "\n%-32s %10s %14s\n",
+        [IPROF_GAUGE]   = "\n%-32s %10s %14s %12s %12s\n",
+      };
+      switch (s->kind) {
+        case IPROF_ZONE:    fprintf(out, titles[s->kind], "Zone", "Count", "Total, ns", "Mean, ns", "Min, ns", "Max, ns"); break;
+        case IPROF_COUNTER: fprintf(out, titles[s->kind], "Counter", "Count", "Sum"); break;
+        case IPROF_GAUGE:   fprintf(out, titles[s->kind], "Gauge", "Count", "Last", "Min", "Max"); break;
+      }
+    }
+
+    switch (s->kind) {
+      case IPROF_ZONE:
+        fprintf(out, "%-32s %10zu %14.0f %12.1f %12.1f %12.1f\n",
+                s->name, s->count, s->total_ns, s->total_ns / (double) s->count, s->min_ns, s->max_ns);
+        break;
+      case IPROF_COUNTER:
+        fprintf(out, "%-32s %10zu %14lld\n", s->name, s->count, (long long) s->value);
+        break;
+      case IPROF_GAUGE:
+        fprintf(out, "%-32s %10zu %14lld %12lld %12lld\n",
+                s->name, s->count, (long long) s->value, (long long) s->min, (long long) s->max);
+        break;
+    }
+  }
+
+  size_t dropped = iprof_dropped();
+  if (dropped)
+    fprintf(out, "\n%zu events were dropped, buffers were full\n", dropped);
+
+  ia_destroy_array(stats);
+}
+
+static void write_trace_string(FILE* out, const char* str) {
+  fputc('"', out);
+  for (const unsigned char* c = (const unsigned char*) str; *c; ++c) {
+    if (*c == '"' || *c == '\\')
+      fprintf(out, "\\%c", *c);
+    else if (*c < 0x20)
+      fprintf(out, "\\u%04x", *c);
+    else
+      fputc(*c, out);
+  }
+  fputc('"', out);
+}
+
+bool iprof_write_trace(const char* path) {
+
+  FILE* out = fopen(path, "w");
+  if (!out)
+    return false;
+
+  double scale = ns_per_tick() / 1000.0;
+  bool first = true;
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+  for (iprof_buffer_t* buf = atomic_load(&all_buffers); buf; buf = buf->next) {
+
+    // Counters are shown as running totals, separately for each thread
+    ia_arr$(iprof_stat_t) totals = ia_new_empty_array$(iprof_stat_t);
+
+    size_t n = atomic_load_explicit(&buf->count, memory_order_acquire);
+    for (size_t i = 0; i < n; ++i) {
+
+      const iprof_event_t* e = &buf->events[i];
+      double ts = (double) (int64_t) (e->begin - start_ticks) * scale;
+
+      fprintf(out, "%s\n{\"name\":", first ? "" : ",");
+      write_trace_string(out, e->name);
+      first = false;
+
+      if (e->kind == IPROF_ZONE) {
+        fprintf(out, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                ts, (double) (e->end_or_value - e->begin) * scale, buf->tid);
+        continue;
+      }
+
+      int64_t value = (int64_t) e->end_or_value;
+      if (e->kind == IPROF_COUNTER) {
+        iprof_stat_t* total = find_stat(totals, IPROF_COUNTER, e->name);
+        if (!total) {
+          iprof_stat_t nw = { .name = e->name, .kind = IPROF_COUNTER };
+          ia_push$(&totals, nw);
+          total = &totals[ia_length(totals) - 1];
+        }
+        total->value += value;
+        value = total->value;
+      }
+      fprintf(out, ",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"thread %u\":%lld}}",
+              ts, buf->tid, buf->tid, (long long) value);
+    }
+
+    ia_destroy_array(totals);
+  }
+
+  fprintf(out, "\n]}\n");
+  return fclose(out) == 0;
+}
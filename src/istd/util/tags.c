@@ -0,0 +1,83 @@
+#include "istd/util/tags.h"
+#include "istd/util/alloc.h"
+#include "istd/util/err.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+void itags_parse(itags_t* tags, const char* list) {
+
+  check$(tags, "Tag list must be not null");
+  check$(list, "Tag string must be not null");
+
+  tags->storage = strdup(list);
+  check$(tags->storage, "Should allocate a duplicate of tag list");
+
+  size_t ntags = 0;
+  bool letter_found = false;
+  const char* found[ITAGS_MAX];
+  const char* begin = NULL;
+  char* last_letter = NULL;
+  for (char* c = tags->storage; *c != '\0'; ++c) {
+    if (isspace((unsigned char) *c)) {}
+    else if (*c == ',') {
+      if (letter_found) {
+        last_letter[1] = '\0';
+        check$(ntags < ITAGS_MAX, "There should be no more than %d tags", ITAGS_MAX);
+        found[ntags++] = begin;
+        letter_found = false;
+      }
+    } else {
+      if (!letter_found) {
+        begin = c;
+        letter_found = true;
+      }
+      last_letter = c;
+    }
+  }
+  if (letter_found) {
+    last_letter[1] = '\0';
+    check$(ntags < ITAGS_MAX, "There should be no more than %d tags", ITAGS_MAX);
+    found[ntags++] = begin;
+  }
+
+  tags->ntags = ntags;
+  tags->tags = calloc_checked$(ntags ? ntags : 1, const char*, "Should allocate an array of tags");
+  memcpy(tags->tags, found, sizeof(const char*) * ntags);
+}
+
+void itags_from_args(itags_t* tags, int argc, const char** argv) {
+
+  check$(tags, "Tag list must be not null");
+
+  tags->storage = NULL;
+  tags->ntags = 0;
+  tags->tags = calloc_checked$(argc > 1 ? (size_t) argc : 1, const char*,
+                               "Should allocate an array of tags");
+
+  for (size_t i = 1; i < (size_t) argc; ++i)
+    if (argv[i][0] != '-')
+      tags->tags[tags->ntags++] = argv[i];
+
+  // Run `default` tag when nothing was specified
+  if (tags->ntags == 0)
+    tags->tags[tags->ntags++] = "default";
+}
+
+bool itags_intersect(const itags_t* a, const itags_t* b) {
+
+  for (size_t i = 0; i < a->ntags; ++i)
+    for (size_t j = 0; j < b->ntags; ++j)
+      if (!strcmp(a->tags[i], b->tags[j]))
+        return true;
+
+  return false;
+}
+
+void itags_destroy(itags_t* tags) {
+  istd_free(tags->tags);
+  free(tags->storage);
+  tags->tags = NULL;
+  tags->storage = NULL;
+  tags->ntags = 0;
+}
@@ -1,23 +1,30 @@
 #include "istd/util/test.h"
+#include "istd/util/alloc.h"
+#include "istd/util/cpu.h"
 #include "istd/util/err.h"
+#include "istd/util/out.h"
+#include "istd/util/tags.h"
 #include "istd/util/tty.h"
+#include "istd/ds/arr.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <setjmp.h>
 #include <string.h>
-#include <ctype.h>
 #include <stdarg.h>
-
-#define MAX_TAGS 256
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 //==== Internal structures
 
 typedef struct itest_section_t {
   struct itest_section_t *prev;
   void (*fn)(void);
-  char** tags;
-  size_t ntags;
-  char* tag_string;
+  itags_t tags;
   const char* name;
 } itest_section_t;
 
@@ -28,6 +35,8 @@ static jmp_buf          jmpbuf_to_section_die  ;
 static size_t           num_failed             ;
 static bool             inside_test_case       ;
 static bool             case_failed            ;
+static bool             section_failed         ;
+static istd_alloc_stats_t allocs_at_case_begin ;
 
 //==== Implementations
 
@@ -50,42 +59,13 @@ void _itest_register_function(
   last_registered_section = sec;
   sec->name = name;
   sec->fn = fn;
-  sec->tag_string = strdup(id);
-  check$(sec->tag_string, "Should allocate a duplicate of tag list");
-
-  size_t ntags = 0;
-  bool letter_found = false;
-  const char* tags[MAX_TAGS];
-  const char* begin = NULL;
-  for (char* c = sec->tag_string; *c != '\0'; ++c) {
-    if (isspace(*c)) {}
-    else if (*c == ',') {
-      if (letter_found) {
-        *c = '\0';
-        check$(ntags < MAX_TAGS, "There should be no more than %d tags", MAX_TAGS);
-        tags[ntags++] = begin;
-        letter_found = false;
-      }
-    } else if (!letter_found) {
-      begin = c;
-      letter_found = true;
-    }
-  }
-  if (letter_found) {
-    check$(ntags < MAX_TAGS, "There should be no more than %d tags", MAX_TAGS);
-    tags[ntags++] = begin;
-  }
-
-  sec->ntags = ntags;
-  sec->tags = (char**) calloc(ntags, sizeof(const char*));
-  check$(sec->tags, "Should allocate an array to contain pointers to tags of the section");
-  memcpy(sec->tags, tags, sizeof(const char*) * ntags);
+  itags_parse(&sec->tags, id);
 
 }
 
 
-#define ESC_MOVE_UP_TO_TITLE "\x1b[2A"
-#define ESC_MOVE_DOWN_FROM_TITLE "\x1b[2B"
+/// Lines between title of the case and the cursor, when case ends
+#define LINES_BELOW_TITLE 2
 
 
 /// Begins given test of the section.
@@ -98,7 +78,11 @@ void _itest_begin_test(const char* name) {
   num_failed = 0;
   case_failed = false;
   inside_test_case = true;
-  fprintf(stderr, "    " ESC_BOLD "%s\n\n" ESC_RESET, name);
+  iout_printf(iout_stderr(), "    " ESC_BOLD "%s\n\n" ESC_RESET, name);
+  iout_flush(iout_stderr());
+
+  allocs_at_case_begin = istd_alloc_stats();
+  istd_alloc_reset_peak();
 }
 
 /// Ends given test
@@ -107,9 +91,30 @@ void _itest_end_test(void) {
   check$(inside_test_case, "You should end only existing test");
   inside_test_case = false;
 
+  // Cases are marked only on a terminal, in files failures speak for themselves
   if (!case_failed) {
-    fprintf(stderr, ESC_MOVE_UP_TO_TITLE ESC_GREEN "\r ok" ESC_RESET ESC_MOVE_DOWN_FROM_TITLE "\r");
+    iout_rewrite_above(iout_stderr(), LINES_BELOW_TITLE, ESC_GREEN " ok" ESC_RESET);
   }
+
+  // Memory allocated by the case, and still not freed
+  istd_alloc_stats_t now = istd_alloc_stats();
+  if (now.live_blocks > allocs_at_case_begin.live_blocks) {
+    iout_printf(iout_stderr(), ESC_YELLOW "      Leaked: " ESC_RESET "%zu allocations, %zu bytes\n\n",
+            now.live_blocks - allocs_at_case_begin.live_blocks,
+            now.live_bytes > allocs_at_case_begin.live_bytes ? now.live_bytes - allocs_at_case_begin.live_bytes : 0);
+  }
+  iout_flush(iout_stderr());
+}
+
+size_t _itest_case_allocs(void) {
+  check$(inside_test_case, "You must be inside a test case (itest_case$)");
+  return istd_alloc_stats().allocs - allocs_at_case_begin.allocs;
+}
+
+size_t _itest_case_peak_bytes(void) {
+  check$(inside_test_case, "You must be inside a test case (itest_case$)");
+  istd_alloc_stats_t now = istd_alloc_stats();
+  return now.peak_bytes > allocs_at_case_begin.live_bytes ? now.peak_bytes - allocs_at_case_begin.live_bytes : 0;
 }
 
 /// Mark current test as failed. This does not break the
@@ -123,14 +128,16 @@ void _itest_mark_failed(const char* fmt, ...) {
 
   ++num_failed;
   case_failed = true;
+  section_failed = true;
 
   if (num_failed == 1) {
     // first failed test, mark the case as failed
-    fprintf(stderr, ESC_MOVE_UP_TO_TITLE ESC_RED "\r =>" ESC_RESET ESC_MOVE_DOWN_FROM_TITLE "\r");
+    iout_rewrite_above(iout_stderr(), LINES_BELOW_TITLE, ESC_RED " =>" ESC_RESET);
   }
-  fprintf(stderr, ESC_RED "      Failed: " ESC_RESET);
-  vfprintf(stderr, fmt, args);
-  fprintf(stderr, "\n\n");
+  iout_puts(iout_stderr(), ESC_RED "      Failed: " ESC_RESET);
+  iout_vprintf(iout_stderr(), fmt, args);
+  iout_puts(iout_stderr(), "\n\n");
+  va_end(args);
 }
 
 /// Stop current test section. No further tests will be
@@ -141,21 +148,28 @@ __attribute__((noreturn)) void _itest_die(void)  {
 }
 
 bool _itest_has_something_failed(void) {
-  return num_failed != 0;
+  return section_failed;
 }
 
 #if !defined(ITEST_NO_MAIN) && defined(TEST)
 
+/// Seconds a section may run in parallel mode
+#define ITEST_DEFAULT_TIMEOUT 60
+
 #define ESC_HELP_TITLE ESC_UNDERLINE ESC_BOLD ESC_PURPLE
 #define ESC_CMD ESC_AQUA
 #define ESC_ARG ESC_GREEN
 
 static void print_help() {
 
-  fprintf(stderr, "\nISTD test runner\n\n");
-  fprintf(stderr, "Runs tests specified by certain tags, or "
+  iout_printf(iout_stderr(), "\nISTD test runner\n\n");
+  iout_printf(iout_stderr(), "Runs tests specified by certain tags, or "
           ESC_ARG "default" ESC_RESET " tag if nothing was specified\n\n");
-  fprintf(stderr, ESC_HELP_TITLE "Usage:" ESC_RESET ESC_CMD " tests " ESC_ARG "<TAG>...\n");
+  iout_printf(iout_stderr(), ESC_HELP_TITLE "Usage:" ESC_RESET ESC_CMD " tests " ESC_ARG "[OPTION]... <TAG>...\n\n" ESC_RESET);
+  iout_printf(iout_stderr(), ESC_HELP_TITLE "Options:" ESC_RESET "\n");
+  iout_printf(iout_stderr(), ESC_ARG "  --jobs[=N]        " ESC_RESET "Run sections in N worker processes, one per core by default\n");
+  iout_printf(iout_stderr(), ESC_ARG "  --timeout=SECONDS " ESC_RESET "Fail sections running longer than that with --jobs, default %d\n", ITEST_DEFAULT_TIMEOUT);
+  iout_printf(iout_stderr(), ESC_ARG "  --cpu-levels      " ESC_RESET "Run all sections under every CPU level, not only ones tagged " ESC_ARG "simd" ESC_RESET "\n");
 
   // TODO: add list of tags here
   //       (requires hash set)
@@ -165,63 +179,277 @@ static void print_help() {
 #undef ESC_CMD
 #undef ESC_ARG
 
-int main (int argc, const char** argv) {
+/// Section to be run, with CPU level of dispatched functions
+typedef struct {
+  const itest_section_t* section;
+  icpu_level_t level;
+  /// Level is shown in the title, when section runs under several levels
+  bool show_level;
+} itest_run_t;
+
+/// Run one section in this process, and print its results.
+/// Returns `true` if all tests passed.
+static bool run_section(const itest_run_t* run) {
+
+  const itest_section_t* s = run->section;
+  icpu_level_t level_before = icpu_level();
+  icpu_set_level(run->level);
+
+  if (run->show_level)
+    iout_printf(iout_stderr(), "\n" ESC_UNDERLINE ESC_GRAY "## " ESC_PURPLE ESC_BOLD "%s" ESC_RESET ESC_GRAY " (%s)\n\n" ESC_RESET,
+                s->name, icpu_level_name(run->level));
+  else
+    iout_printf(iout_stderr(), "\n" ESC_UNDERLINE ESC_GRAY "## " ESC_PURPLE ESC_BOLD "%s\n\n" ESC_RESET, s->name);
+
+  bool passed = false;
+  section_failed = false;
+  inside_test_case = false;
 
-  for (size_t i = 1; i < (size_t) argc; ++i) {
-    if (!strcmp(argv[i], "--help")) {
-      print_help();
-      return 0;
-    }
+  if (!setjmp(jmpbuf_to_section_die)) {
+    s->fn();
+    itest_die_if_something_failed$();
+    iout_printf(iout_stderr(), ESC_GREEN "(OK) All tests passed\n" ESC_RESET);
+    passed = true;
+  } else {
+    iout_printf(iout_stderr(), ESC_RED "(!!) A test had failed\n" ESC_RESET);
   }
+  iout_printf(iout_stderr(), "\n");
+  icpu_set_level(level_before);
+  return passed;
+}
+
+//---- Parallel runner
+//
+// Every section runs in a forked worker, with stdout and stderr sent
+// into a pipe. Output is collected while workers run, and printed in
+// the order of sections, as if they were run one after another.
+
+/// Section run by a worker
+typedef struct {
+  const itest_run_t* run;
+  pid_t pid;
+  /// Reading end of worker's output, `-1` after it was closed
+  int fd;
+  ia_arr$(char) output;
+  uint64_t started_ms;
+  bool running, done, timed_out;
+  int status;
+} itest_job_t;
+
+static uint64_t now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+static void start_job(itest_job_t* job) {
+
+  int fds[2];
+  check$(!pipe(fds), "Should create a pipe for worker output");
 
-  // A little bit hacky way to run `default` tag when nothing was specified
-  const char* fake_argv[] = { "", "default" };
-  if (argc == 1) {
-    argc = 2;
-    argv = fake_argv;
+  fflush(stdout);
+  fflush(stderr);
+  iout_flush(iout_stderr());
+
+  pid_t pid = fork();
+  check$(pid >= 0, "Should fork a worker");
+
+  if (pid == 0) {
+    close(fds[0]);
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[1]);
+
+    bool passed = run_section(job->run);
+    iout_flush(iout_stderr());
+    fflush(stdout);
+    fflush(stderr);
+    _exit(passed ? EXIT_SUCCESS : EXIT_FAILURE);
   }
 
-  size_t sections_run = 0, sections_passed = 0;
+  close(fds[1]);
+  job->pid = pid;
+  job->fd = fds[0];
+  job->output = ia_new_empty_array$(char);
+  job->started_ms = now_ms();
+  job->running = true;
+}
 
-  for (const itest_section_t* s = last_registered_section; s != NULL; s = s->prev) {
+/// Read what is available from worker's output
+static void read_job_output(itest_job_t* job) {
+  char buf[4096];
+  ssize_t n = read(job->fd, buf, sizeof(buf));
+  if (n > 0) {
+    ia_append$(&job->output, buf, (size_t) n);
+  } else if (n == 0 || errno != EINTR) {
+    close(job->fd);
+    job->fd = -1;
+  }
+}
 
-    // TODO: get this thing out of here, use hash sets again.
-    bool tag_matched = false;
+/// Print output of finished job, and explain how it has ended
+static bool report_job(itest_job_t* job, unsigned timeout) {
 
-    for (size_t i = 0; !tag_matched && i < s->ntags; ++i) {
-      for (size_t j = 1; !tag_matched && j < (size_t) argc; ++j) {
-        if (!strcmp(s->tags[i], argv[j]))
-          tag_matched = true;
+  iout_write(iout_stderr(), job->output, ia_length(job->output));
+  ia_destroy_array(job->output);
+  job->output = NULL;
+
+  if (job->timed_out) {
+    iout_printf(iout_stderr(), ESC_RED "\n(!!) Section has timed out after %u seconds\n\n" ESC_RESET, timeout);
+    return false;
+  }
+  if (WIFSIGNALED(job->status)) {
+    iout_printf(iout_stderr(), ESC_RED "\n(!!) Section has crashed with signal %d (%s)\n\n" ESC_RESET,
+            WTERMSIG(job->status), strsignal(WTERMSIG(job->status)));
+    return false;
+  }
+  return WIFEXITED(job->status) && WEXITSTATUS(job->status) == EXIT_SUCCESS;
+}
+
+/// Run sections in up to `jobs` workers at once.
+/// Returns number of sections passed.
+static size_t run_parallel(const itest_run_t* runs, size_t n, size_t jobs, unsigned timeout) {
+
+  itest_job_t* all = calloc_checked$(n ? n : 1, itest_job_t, "Should allocate array of jobs");
+  struct pollfd* polled = calloc_checked$(jobs, struct pollfd, "Should allocate array of polled pipes");
+  itest_job_t** polled_jobs = calloc_checked$(jobs, itest_job_t*, "Should allocate array of polled jobs");
+
+  size_t next_to_start = 0, next_to_print = 0, running = 0, passed = 0;
+  uint64_t timeout_ms = (uint64_t) timeout * 1000;
+
+  while (next_to_print < n) {
+
+    for (; running < jobs && next_to_start < n; ++next_to_start, ++running) {
+      all[next_to_start].run = &runs[next_to_start];
+      start_job(&all[next_to_start]);
+    }
+
+    // Wait for output, or for the nearest timeout
+    uint64_t now = now_ms();
+    int wait_ms = -1;
+    size_t npolled = 0;
+
+    for (size_t i = next_to_print; i < next_to_start; ++i) {
+      itest_job_t* job = &all[i];
+      if (!job->running)
+        continue;
+
+      uint64_t left = job->started_ms + timeout_ms > now ? job->started_ms + timeout_ms - now : 0;
+      if (job->fd < 0) {
+        // Output is closed, but worker has not exited yet
+        left = left < 10 ? left : 10;
+      } else {
+        polled[npolled].fd = job->fd;
+        polled[npolled].events = POLLIN;
+        polled[npolled].revents = 0;
+        polled_jobs[npolled++] = job;
       }
+      if (wait_ms < 0 || left < (uint64_t) wait_ms)
+        wait_ms = (int) left;
     }
 
-    if (!tag_matched)
-      continue;
+    if (poll(polled, npolled, wait_ms) > 0) {
+      for (size_t i = 0; i < npolled; ++i)
+        if (polled[i].revents)
+          read_job_output(polled_jobs[i]);
+    }
+
+    // Collect finished workers, and kill hanging ones
+    now = now_ms();
+    for (size_t i = next_to_print; i < next_to_start; ++i) {
+      itest_job_t* job = &all[i];
+      if (!job->running)
+        continue;
 
-    sections_run++;
-    fprintf(stderr, "\n" ESC_UNDERLINE ESC_GRAY "## " ESC_PURPLE ESC_BOLD "%s\n\n" ESC_RESET, s->name);
+      if (!job->timed_out && now - job->started_ms >= timeout_ms) {
+        job->timed_out = true;
+        kill(job->pid, SIGKILL);
+      }
 
-    if (!setjmp(jmpbuf_to_section_die)) {
-      s->fn();
-      itest_die_if_something_failed$();
-      fprintf(stderr, ESC_GREEN "(OK) All tests passed\n" ESC_RESET);
-      ++sections_passed;
-    } else {
-      fprintf(stderr, ESC_RED "(!!) A test had failed\n" ESC_RESET);
+      if (job->fd < 0 || job->timed_out) {
+        if (waitpid(job->pid, &job->status, job->timed_out ? 0 : WNOHANG) == job->pid) {
+          job->running = false;
+          job->done = true;
+          --running;
+          // Take the rest of output of killed worker
+          while (job->fd >= 0)
+            read_job_output(job);
+        }
+      }
     }
-    fprintf(stderr, "\n");
+
+    for (; next_to_print < next_to_start && all[next_to_print].done; ++next_to_print)
+      passed += report_job(&all[next_to_print], timeout);
+  }
+
+  istd_free(polled_jobs);
+  istd_free(polled);
+  istd_free(all);
+  return passed;
+}
+
+int main (int argc, const char** argv) {
+
+  size_t jobs = 0;
+  unsigned timeout = ITEST_DEFAULT_TIMEOUT;
+  bool all_levels = false;
+
+  for (size_t i = 1; i < (size_t) argc; ++i) {
+    if (!strcmp(argv[i], "--help")) {
+      print_help();
+      return 0;
+    } else if (!strcmp(argv[i], "--jobs")) {
+      long cores = sysconf(_SC_NPROCESSORS_ONLN);
+      jobs = cores > 0 ? (size_t) cores : 1;
+    } else if (!strncmp(argv[i], "--jobs=", 7)) {
+      jobs = (size_t) strtoul(argv[i] + 7, NULL, 10);
+    } else if (!strncmp(argv[i], "--timeout=", 10)) {
+      timeout = (unsigned) strtoul(argv[i] + 10, NULL, 10);
+    } else if (!strcmp(argv[i], "--cpu-levels")) {
+      all_levels = true;
+    }
+  }
+
+  itags_t wanted, simd;
+  itags_from_args(&wanted, argc, argv);
+  itags_parse(&simd, "simd");
+
+  // Sections with vectorized code are run under each level up to
+  // current one, from the fastest, others only under current one
+  icpu_level_t top_level = icpu_level();
+  ia_arr$(itest_run_t) selected = ia_new_empty_array$(itest_run_t);
+  for (const itest_section_t* s = last_registered_section; s != NULL; s = s->prev) {
+    if (!itags_intersect(&s->tags, &wanted))
+      continue;
+    bool each_level = top_level > ICPU_SCALAR && (all_levels || itags_intersect(&s->tags, &simd));
+    for (int l = (int) top_level; l >= (each_level ? 0 : (int) top_level); --l)
+      ia_push$(&selected, ((itest_run_t) { s, (icpu_level_t) l, each_level }));
+  }
+
+  size_t sections_run = ia_length(selected), sections_passed = 0;
+
+  if (jobs > 0) {
+    sections_passed = run_parallel(selected, sections_run, jobs, timeout);
+  } else {
+    for (size_t i = 0; i < sections_run; ++i)
+      sections_passed += run_section(&selected[i]);
   }
 
   if (!sections_run) {
-    fprintf(stderr, "No test sections match tags " ESC_GREEN);
-    for (size_t i = 1; i < (size_t) argc; ++i)
-      fprintf(stderr, "%s ", argv[i]);
-    fprintf(stderr, "\n");
+    iout_printf(iout_stderr(), "No test sections match tags " ESC_GREEN);
+    for (size_t i = 0; i < wanted.ntags; ++i)
+      iout_printf(iout_stderr(), "%s ", wanted.tags[i]);
+    iout_printf(iout_stderr(), "\n" ESC_RESET);
   } else if (sections_passed == sections_run) {
-    fprintf(stderr, "" ESC_GREEN "All tests passed\n\n" ESC_RESET);
+    iout_printf(iout_stderr(), "" ESC_GREEN "All tests passed\n\n" ESC_RESET);
   } else {
-    fprintf(stderr, "" ESC_RED "%zu of %zu test sections have failed \n\n" ESC_RESET, sections_run - sections_passed, sections_run);
+    iout_printf(iout_stderr(), "" ESC_RED "%zu of %zu test sections have failed \n\n" ESC_RESET, sections_run - sections_passed, sections_run);
   }
+
+  ia_destroy_array(selected);
+  itags_destroy(&wanted);
+  itags_destroy(&simd);
+  return sections_passed == sections_run ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-#endif 
+#endif
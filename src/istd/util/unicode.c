@@ -0,0 +1,231 @@
+/**
+ * \brief Implementation of grapheme cluster segmentation and display width.
+ *
+ * Segmentation follows UAX #29 rules for extended grapheme clusters,
+ * except GB9c (Indic conjuncts), which needs properties absent from
+ * `unicodedata` we generate tables from.
+ *
+ * Each codepoint has one byte of properties in generated table:
+ *
+ * ```
+ *   7   6   5   4   3   2   1   0
+ * ┌───┬───────┬───┬───────────────┐
+ * │ - │ width │ P │ grapheme brk. │
+ * └───┴───────┴───┴───────────────┘
+ *               └─ Extended_Pictographic
+ * ```
+ *
+ * Width of `3` is used for nonprintable codepoints.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "istd/util/unicode.h"
+#include "istd/util/utf8.h"
+#include "unicode_tables.h"
+
+/// Grapheme_Cluster_Break property values.
+/// Must be in sync with `GCB` in `tools/gen_unicode_tables.py`
+enum {
+  GCB_OTHER,
+  GCB_CR,
+  GCB_LF,
+  GCB_CONTROL,
+  GCB_EXTEND,
+  GCB_ZWJ,
+  GCB_RI,
+  GCB_PREPEND,
+  GCB_SPACING_MARK,
+  GCB_L,
+  GCB_V,
+  GCB_T,
+  GCB_LV,
+  GCB_LVT,
+};
+
+#define PROP_GCB_MASK     0x0f
+#define PROP_EXT_PICT     0x10
+#define PROP_WIDTH_SHIFT  5
+#define WIDTH_NONPRINTABLE 3
+
+#define VARIATION_SELECTOR_16 0xFE0F
+
+static inline unsigned gcb(uint8_t props) {
+  return props & PROP_GCB_MASK;
+}
+
+static inline bool is_pict(uint8_t props) {
+  return props & PROP_EXT_PICT;
+}
+
+/// Width of codepoint, with nonprintable ones being `0`
+static inline size_t printable_width(uint8_t props) {
+  size_t width = props >> PROP_WIDTH_SHIFT;
+  return width == WIDTH_NONPRINTABLE ? 0 : width;
+}
+
+/// Width of a printable ASCII char, which needs no table lookup
+static inline bool is_printable_ascii(uint8_t byte) {
+  return byte >= 0x20 && byte < 0x7f;
+}
+
+int unicode_width(rune cp) {
+  int width = unicode_props_lookup(cp) >> PROP_WIDTH_SHIFT;
+  return width == WIDTH_NONPRINTABLE ? UNICODE_NONPRINTABLE : width;
+}
+
+
+/// State of the cluster being scanned, needed for rules
+/// which look further back than one codepoint.
+typedef struct {
+  /// Number of regional indicators in a row (GB12, GB13)
+  size_t num_ri;
+  /// Last non-Extend codepoint was Extended_Pictographic (GB11)
+  bool after_pict;
+  /// Previous codepoint is ZWJ after `ExtPict Extend*` (GB11)
+  bool after_pict_zwj;
+} cluster_state_t;
+
+
+/// Check if there is no boundary between codepoints with
+/// properties `prev` and `cur`.
+static bool no_break(const cluster_state_t* st, uint8_t prev, uint8_t cur) {
+
+  unsigned a = gcb(prev), b = gcb(cur);
+
+  if (a == GCB_CR && b == GCB_LF) // GB3
+    return true;
+  if (a == GCB_CR || a == GCB_LF || a == GCB_CONTROL) // GB4
+    return false;
+  if (b == GCB_CR || b == GCB_LF || b == GCB_CONTROL) // GB5
+    return false;
+
+  switch (a) { // GB6 - GB8, Hangul syllables
+    case GCB_L:
+      if (b == GCB_L || b == GCB_V || b == GCB_LV || b == GCB_LVT)
+        return true;
+      break;
+    case GCB_LV:
+    case GCB_V:
+      if (b == GCB_V || b == GCB_T)
+        return true;
+      break;
+    case GCB_LVT:
+    case GCB_T:
+      if (b == GCB_T)
+        return true;
+      break;
+  }
+
+  if (b == GCB_EXTEND || b == GCB_ZWJ || b == GCB_SPACING_MARK) // GB9, GB9a
+    return true;
+  if (a == GCB_PREPEND) // GB9b
+    return true;
+  if (st->after_pict_zwj && is_pict(cur)) // GB11
+    return true;
+  if (a == GCB_RI && b == GCB_RI) // GB12, GB13
+    return st->num_ri % 2 == 1;
+
+  return false; // GB999
+}
+
+
+/// Update state after `cur` was appended to the cluster
+static void advance_state(cluster_state_t* st, uint8_t cur) {
+  st->num_ri = gcb(cur) == GCB_RI ? st->num_ri + 1 : 0;
+  st->after_pict_zwj = gcb(cur) == GCB_ZWJ && st->after_pict;
+  if (is_pict(cur))
+    st->after_pict = true;
+  else if (gcb(cur) != GCB_EXTEND)
+    st->after_pict = false;
+}
+
+
+/// Skip grapheme cluster. Long description is in the header.
+const char* utf8_next_grapheme(const char* str, size_t* width) {
+
+  assert(str);
+
+  rune cp = 0;
+  const char* next = utf8_next(str, &cp);
+  if (next == NULL)
+    return NULL;
+
+  // End of the string
+  if (cp == 0) {
+    if (width)
+      *width = 0;
+    return str;
+  }
+
+  // Fast path: ASCII followed by ASCII is always a boundary,
+  // except for CR LF.
+  if (cp < 0x80 && (uint8_t) *next < 0x80 && !(cp == '\r' && *next == '\n')) {
+    if (width)
+      *width = is_printable_ascii(cp) ? 1 : 0;
+    return next;
+  }
+
+  uint8_t first = unicode_props_lookup(cp);
+  uint8_t prev = first;
+  size_t cluster_width = printable_width(first);
+  cluster_state_t st = { 0 };
+  advance_state(&st, first);
+
+  while (true) {
+    const char* after = utf8_next(next, &cp);
+    if (after == NULL)
+      return NULL;
+    if (cp == 0)
+      break;
+
+    uint8_t cur = unicode_props_lookup(cp);
+    if (!no_break(&st, prev, cur))
+      break;
+
+    // Cluster takes as much space as its widest part, except for
+    // flags and emoji made wide by the variation selector.
+    if (printable_width(cur) > cluster_width)
+      cluster_width = printable_width(cur);
+    if (gcb(cur) == GCB_RI)
+      cluster_width = 2;
+    if (cp == VARIATION_SELECTOR_16 && is_pict(first))
+      cluster_width = 2;
+
+    advance_state(&st, cur);
+    prev = cur;
+    next = after;
+  }
+
+  if (width)
+    *width = cluster_width;
+  return next;
+}
+
+
+/// Compute width of the string
+size_t utf8_display_width(const char* str) {
+
+  assert(str);
+
+  size_t total = 0;
+
+  while (*str != '\0') {
+
+    // Most of the text we print is plain ASCII
+    if (is_printable_ascii((uint8_t) str[0]) && (uint8_t) str[1] < 0x80) {
+      ++total;
+      ++str;
+      continue;
+    }
+
+    size_t width = 0;
+    str = utf8_next_grapheme(str, &width);
+    if (str == NULL)
+      return UTF8_INVALID;
+    total += width;
+  }
+
+  return total;
+}
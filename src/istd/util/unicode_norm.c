@@ -0,0 +1,305 @@
+/**
+ * \brief Implementation of Unicode normalization and case folding.
+ *
+ * Normalization is done as described in UAX #15:
+ *
+ *  1. Every codepoint is replaced by its full canonical decomposition.
+ *     Decompositions in tables are already recursively expanded, Hangul
+ *     syllables are decomposed arithmetically.
+ *
+ *  2. Runs of non-starters (codepoints with nonzero combining class) are
+ *     stably sorted by their combining class. This is done while
+ *     decomposing, by moving each pushed codepoint backwards.
+ *
+ *  3. For NFC, each codepoint is combined with last starter if nothing
+ *     in between blocks it.
+ *
+ * Generated tables give for each codepoint:
+ *
+ *  - `unicode_norm` - combining class in low byte, quick check flags above,
+ *  - `unicode_decomp` - index of `[n, cp...]` decomposition in data,
+ *  - `unicode_comp` - index of `[n, second, composite, ...]` list of
+ *    primary composites starting with this codepoint,
+ *  - `unicode_fold` - index of `[n, cp...]` case folding.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "istd/ds/arr.h"
+#include "istd/util/unicode_norm.h"
+#include "istd/util/utf8.h"
+#include "unicode_norm_tables.h"
+
+// Must be in sync with `tools/gen_unicode_tables.py`
+#define NORM_CCC_MASK   0xff
+#define NORM_NFD_NO     (1 << 8)
+#define NORM_NFC_NO     (1 << 9)
+#define NORM_NFC_MAYBE  (1 << 10)
+
+//==== Hangul syllables
+
+#define HANGUL_S_BASE  0xAC00
+#define HANGUL_L_BASE  0x1100
+#define HANGUL_V_BASE  0x1161
+#define HANGUL_T_BASE  0x11A7
+#define HANGUL_L_COUNT 19
+#define HANGUL_V_COUNT 21
+#define HANGUL_T_COUNT 28
+#define HANGUL_N_COUNT (HANGUL_V_COUNT * HANGUL_T_COUNT)
+#define HANGUL_S_COUNT (HANGUL_L_COUNT * HANGUL_N_COUNT)
+
+//==== Table accessors
+
+static inline uint8_t ccc(rune cp) {
+  return unicode_norm_lookup(cp) & NORM_CCC_MASK;
+}
+
+/// Find primary composite of `a` and `b`, or return `0`
+static rune compose(rune a, rune b) {
+
+  // L + V -> LV
+  if (a - HANGUL_L_BASE < HANGUL_L_COUNT && b - HANGUL_V_BASE < HANGUL_V_COUNT)
+    return HANGUL_S_BASE
+         + ((a - HANGUL_L_BASE) * HANGUL_V_COUNT + (b - HANGUL_V_BASE)) * HANGUL_T_COUNT;
+
+  // LV + T -> LVT
+  if (a - HANGUL_S_BASE < HANGUL_S_COUNT && (a - HANGUL_S_BASE) % HANGUL_T_COUNT == 0
+      && b - HANGUL_T_BASE - 1 < HANGUL_T_COUNT - 1)
+    return a + (b - HANGUL_T_BASE);
+
+  uint16_t idx = unicode_comp_lookup(a);
+  if (!idx)
+    return 0;
+
+  const uint32_t* list = unicode_comp_data + idx;
+  for (size_t i = 0; i < list[0]; ++i)
+    if (list[1 + 2*i] == b)
+      return list[2 + 2*i];
+  return 0;
+}
+
+//==== Working buffer of codepoints
+
+/// Push codepoint, keeping non-starters in canonical order
+static void push_ordered(ia_arr$(rune)* buf, rune cp) {
+
+  ia_push$(buf, cp);
+
+  uint8_t cc = ccc(cp);
+  if (!cc)
+    return;
+
+  rune* data = *buf;
+  for (size_t i = ia_length(data) - 1; i > 0 && ccc(data[i-1]) > cc; --i) {
+    data[i] = data[i-1];
+    data[i-1] = cp;
+  }
+}
+
+/// Push full canonical decomposition of `cp`
+static void push_decomposed(ia_arr$(rune)* buf, rune cp) {
+
+  if (cp - HANGUL_S_BASE < HANGUL_S_COUNT) {
+    rune s = cp - HANGUL_S_BASE;
+    push_ordered(buf, HANGUL_L_BASE + s / HANGUL_N_COUNT);
+    push_ordered(buf, HANGUL_V_BASE + (s % HANGUL_N_COUNT) / HANGUL_T_COUNT);
+    if (s % HANGUL_T_COUNT)
+      push_ordered(buf, HANGUL_T_BASE + s % HANGUL_T_COUNT);
+    return;
+  }
+
+  uint16_t idx = unicode_decomp_lookup(cp);
+  if (!idx) {
+    push_ordered(buf, cp);
+    return;
+  }
+
+  const uint32_t* seq = unicode_decomp_data + idx;
+  for (size_t i = 0; i < seq[0]; ++i)
+    push_ordered(buf, seq[1 + i]);
+}
+
+/// Canonical composition of decomposed and ordered codepoints, in place
+static void compose_all(ia_arr$(rune)* buf) {
+
+  rune* data = *buf;
+  size_t n = ia_length(data);
+  size_t len = 0;
+
+  bool has_starter = false;
+  size_t starter = 0;
+  uint8_t last_cc = 0;
+
+  for (size_t i = 0; i < n; ++i) {
+    rune cp = data[i];
+    uint8_t cc = ccc(cp);
+
+    // Codepoint is blocked from the starter if something between
+    // them has the same or higher combining class, or is a starter.
+    bool adjacent = has_starter && len - 1 == starter;
+    bool blocked = !adjacent && (last_cc == 0 || last_cc >= cc);
+
+    if (has_starter && !blocked) {
+      rune composite = compose(data[starter], cp);
+      if (composite) {
+        data[starter] = composite;
+        continue;
+      }
+    }
+
+    if (cc == 0) {
+      has_starter = true;
+      starter = len;
+    }
+    last_cc = cc;
+    data[len++] = cp;
+  }
+
+  ia_truncate$(buf, len);
+}
+
+/// Encode codepoints and append them to the output
+static void append_encoded(ia_arr$(char)* out, const rune* runes, size_t n) {
+  char encoded[5];
+  for (size_t i = 0; i < n; ++i) {
+    size_t len = utf8_encode_codepoint(runes[i], encoded);
+    ia_append$(out, encoded, len);
+  }
+}
+
+//==== Public functions
+
+/// Check normalization form without normalizing.
+unicode_qc_t utf8_quick_check(const char* str, unicode_form_t form) {
+
+  assert(str);
+
+  uint16_t no_flag = form == UNICODE_NFC ? NORM_NFC_NO : NORM_NFD_NO;
+  unicode_qc_t result = UNICODE_QC_YES;
+  uint8_t last_cc = 0;
+
+  while (*str) {
+
+    // ASCII is the same in all forms, and is never combined
+    // with anything before it.
+    if ((uint8_t) *str < 0x80) {
+      last_cc = 0;
+      ++str;
+      continue;
+    }
+
+    rune cp = 0;
+    str = utf8_next(str, &cp);
+    if (str == NULL)
+      return UNICODE_QC_INVALID;
+
+    uint16_t props = unicode_norm_lookup(cp);
+    uint8_t cc = props & NORM_CCC_MASK;
+
+    if (cc && last_cc > cc)
+      return UNICODE_QC_NO;
+    if (props & no_flag)
+      return UNICODE_QC_NO;
+    if (form == UNICODE_NFC && (props & NORM_NFC_MAYBE))
+      result = UNICODE_QC_MAYBE;
+
+    last_cc = cc;
+  }
+
+  return result;
+}
+
+
+/// Normalize given string. More docs are in the header.
+const char* utf8_normalize(const char* str, unicode_form_t form, ia_arr$(char)* out) {
+
+  assert(str);
+  assert(out);
+
+  unicode_qc_t qc = utf8_quick_check(str, form);
+  if (qc == UNICODE_QC_INVALID)
+    return NULL;
+  if (qc == UNICODE_QC_YES)
+    return str;
+
+  ia_arr$(rune) buf = ia_new_array_for$(strlen(str), rune);
+  for (const char* c = str; *c; ) {
+    rune cp = 0;
+    c = utf8_next(c, &cp);
+    // Quick check stops at first codepoint which is not normalized, so
+    // bytes after it were not checked yet
+    if (c == NULL) {
+      ia_destroy_array(buf);
+      return NULL;
+    }
+    push_decomposed(&buf, cp);
+  }
+
+  if (form == UNICODE_NFC)
+    compose_all(&buf);
+
+  size_t start = ia_length(*out);
+  append_encoded(out, buf, ia_length(buf));
+  ia_destroy_array(buf);
+
+  // String was normalized after all
+  if (qc == UNICODE_QC_MAYBE && !strcmp(*out + start, str)) {
+    ia_truncate$(out, start);
+    return str;
+  }
+
+  return *out + start;
+}
+
+
+/// Case fold given string. More docs are in the header.
+const char* utf8_casefold(const char* str, ia_arr$(char)* out) {
+
+  assert(str);
+  assert(out);
+
+  // Find first character which changes
+  const char* first = str;
+  while (*first) {
+    if ((uint8_t) *first < 0x80) {
+      if (*first >= 'A' && *first <= 'Z')
+        break;
+      ++first;
+      continue;
+    }
+
+    rune cp = 0;
+    const char* next = utf8_next(first, &cp);
+    if (next == NULL)
+      return NULL;
+    if (unicode_fold_lookup(cp))
+      break;
+    first = next;
+  }
+
+  if (*first == '\0')
+    return str;
+
+  size_t start = ia_length(*out);
+  ia_append$(out, str, (size_t) (first - str));
+
+  for (const char* c = first; *c; ) {
+    rune cp = 0;
+    c = utf8_next(c, &cp);
+    if (c == NULL) {
+      ia_truncate$(out, start);
+      return NULL;
+    }
+
+    uint16_t idx = unicode_fold_lookup(cp);
+    if (idx)
+      append_encoded(out, unicode_fold_data + idx + 1, unicode_fold_data[idx]);
+    else
+      append_encoded(out, &cp, 1);
+  }
+
+  return *out + start;
+}
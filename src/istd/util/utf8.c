@@ -26,94 +26,16 @@
  * bits are stored in byte 1, while least significant are in
  * byte 4.
  *
+ * `utf8_next()` and helpers used by the whole file are defined in the
+ * header, so that decoding loops are inlined.
  */
 
 #include <errno.h>
 #include <stdint.h>
+#include <string.h>
 #include <assert.h>
 #include "istd/util/utf8.h"
 
-/// UTF8 continuation byte flag
-#define BAD_CODEPOINT 0
-
-
-/// Get length of utf8 codepoint starting from
-/// that byte or `BAD_CODEPOINT` if this is cont. byte
-static inline size_t cp_len(uint8_t byte) {
-
-  if ((byte >> 6) == 2) // 0b10xxxxxx
-    return BAD_CODEPOINT;
-  else if ((byte >> 5) == 6) // 0b110xxxxx
-    return 2;
-  else if ((byte >> 4) == 14) // 0b1110xxxx
-    return 3;
-  else if ((byte >> 3) == 30) // 0b11110xxx
-    return 4;
-  else
-    return 1;
-}
-
-
-/// Check if given byte is continuation byte
-static inline int is_continuation(uint8_t ch) {
-  // in form of 0b10xxxxxx
-  return (ch >> 6) == 2;
-}
-
-
-/// Trim top `nb` bits of given number.
-static inline uint8_t trim_top_bits(uint8_t num, size_t nb) {
-  return (uint8_t) (num << nb) >> nb;
-}
-
-
-/// Decode UTF8 codepoint starting from that position
-static inline rune decode(const uint8_t* ptr, uint8_t len) {
-  rune res = trim_top_bits(ptr[0], len);
-  for (size_t i = 1; i < len; ++i)
-    res = (res << 6) + trim_top_bits(ptr[i], 1);
-  return res;
-}
-
-
-/// Decode codepoint at `ptr`, store it in `cp` and return advanced position.
-/// I wrote a long text in header, so read it for more details.
-const char* utf8_next(const char* ptr, rune* cp) {
-
-  assert(ptr);
-
-  // End of the string reached (`\0` was found)
-  if (*ptr == '\0') {
-    // '\0'
-    if (cp)
-      *cp = 0;
-    return ptr;
-  }
-
-  // Decode codepoint length
-  size_t len = cp_len((uint8_t) ptr[0]);
-  if (len == BAD_CODEPOINT)
-    goto decoding_failed;
-
-  // Check continuation bytes
-  for (size_t i = 1; i < len; ++i)
-    if (!is_continuation(ptr[i]))
-      goto decoding_failed;
-
-  // Decode codepoint if user wants it.
-  if (cp) 
-    *cp = decode((const uint8_t*) ptr, len);
-
-  // Return advanced location
-  return ptr + len;
-
- decoding_failed:
-  // Set errno and fail
-  errno = EILSEQ;
-  return NULL; 
-}
-
-
 /// Move baсkwards one codepoint, and decode codepoint we are now at.
 /// Long description is also in the header, look there for full docs.
 const char* utf8_prev(const char* ptr, const char* begin, rune* cp) {
@@ -132,8 +54,8 @@ const char* utf8_prev(const char* ptr, const char* begin, rune* cp) {
   // Find start and length of the codepoint
   size_t len = 1;
   while (len < 4 && // Codepoint must up to 4 bytes in length 
-         ptr >= begin + len && // It must be contained after string beginning
-         is_continuation((uint8_t) *(ptr - len))) // 
+         ptr - len > begin && // It must be contained after string beginning
+         _utf8_is_continuation((uint8_t) *(ptr - len))) // 
     ++len;
 
   const char* codepoint_begin = ptr - len;
@@ -141,12 +63,16 @@ const char* utf8_prev(const char* ptr, const char* begin, rune* cp) {
   // We checked four bytes (or up to beginning of the string) before
   // given position, but there was no sign of
   // start of the character.
-  if (is_continuation((uint8_t) codepoint_begin[0]))
+  if (_utf8_is_continuation((uint8_t) codepoint_begin[0]))
     goto decoding_failed; // So, fail.
 
+  // Start byte should agree with number of continuation bytes after it
+  if (_utf8_cp_len((uint8_t) codepoint_begin[0]) != len)
+    goto decoding_failed;
+
   // Decode codepoint if needed
   if (cp)
-    *cp = decode((const uint8_t*) codepoint_begin, len);
+    *cp = _utf8_decode((const uint8_t*) codepoint_begin, len);
 
   return codepoint_begin;
 
@@ -174,6 +100,51 @@ size_t utf8_length(const char* str) {
   return len;
 }
 
+/// Check all codepoints of a span, skipping over ASCII a word at a time
+bool utf8_valid(const char* str, size_t len) {
+
+  assert(str || len == 0);
+
+  const uint8_t* s = (const uint8_t*) str;
+  size_t i = 0;
+
+  while (i < len) {
+
+    if (s[i] < 0x80) {
+      for (; i + 16 <= len; i += 16) {
+        uint64_t a, b;
+        memcpy(&a, s + i, 8);
+        memcpy(&b, s + i + 8, 8);
+        if ((a | b) & 0x8080808080808080ull)
+          break;
+      }
+      while (i < len && s[i] < 0x80)
+        ++i;
+      continue;
+    }
+
+    // Leading bytes of overlong 2-byte codepoints, and ones past U+10FFFF, are not allowed
+    size_t n = s[i] >= 0xC2 && s[i] <= 0xDF ? 2
+             : (s[i] >> 4) == 14 ? 3
+             : s[i] >= 0xF0 && s[i] <= 0xF4 ? 4
+             : 0;
+    if (!n || len - i < n)
+      return false;
+    for (size_t k = 1; k < n; ++k)
+      if (!_utf8_is_continuation(s[i + k]))
+        return false;
+
+    rune cp = _utf8_decode(s + i, n);
+    if (n == 3 && (cp < 0x800 || (cp >= 0xD800 && cp <= 0xDFFF)))
+      return false;
+    if (n == 4 && (cp < 0x10000 || cp > 0x10FFFF))
+      return false;
+    i += n;
+  }
+
+  return true;
+}
+
 /// Write given codepoint into given buffer, returning number of bytes used.
 /// Buffer must be at least 5 bytes long.
 size_t utf8_encode_codepoint(rune cp, char* output) {
@@ -194,7 +165,7 @@ size_t utf8_encode_codepoint(rune cp, char* output) {
   output[0] = (len == 1 ? 0 : first_top_bits) | (cp >> (len-1)*6);
 
   for (size_t i = 1; i < len; ++i)
-    output[i] = cont_top_bits | trim_top_bits(cp >> (len-1-i)*6, 2);
+    output[i] = cont_top_bits | _utf8_trim_top_bits(cp >> (len-1-i)*6, 2);
 
   output[len] = '\0';
 
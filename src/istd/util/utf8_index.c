@@ -0,0 +1,198 @@
+/**
+ * \brief Implementation of codepoint index.
+ *
+ * Everything here is built around one primitive: a 64-bit mask of lead
+ * (non-continuation) bytes in 64-byte chunk of the string. Number of
+ * codepoints is the popcount of that mask, and position of N-th codepoint
+ * is found by clearing N lowest bits of it.
+ *
+ * Continuation bytes are `0b10xxxxxx`, which are exactly bytes in range
+ * `-128..-65` when treated as signed. So lead bytes are found by one
+ * signed comparison per 16 bytes.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "istd/ds/arr.h"
+#include "istd/util/err.h"
+#include "istd/util/utf8_index.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define CHUNK 64
+
+/// Mask of lead bytes among 64 bytes starting at `p`
+static inline uint64_t lead_mask(const char* p) {
+#ifdef __SSE2__
+  const __m128i last_continuation = _mm_set1_epi8(-65);
+  uint64_t mask = 0;
+  for (size_t i = 0; i < CHUNK / 16; ++i) {
+    __m128i v = _mm_loadu_si128((const __m128i*) (p + 16 * i));
+    uint16_t m = (uint16_t) _mm_movemask_epi8(_mm_cmpgt_epi8(v, last_continuation));
+    mask |= (uint64_t) m << (16 * i);
+  }
+  return mask;
+#else
+  uint64_t mask = 0;
+  for (size_t i = 0; i < CHUNK; ++i)
+    mask |= (uint64_t) ((int8_t) p[i] > -65) << i;
+  return mask;
+#endif
+}
+
+/// Mask of lead bytes among first `n` < 64 bytes starting at `p`
+static inline uint64_t lead_mask_partial(const char* p, size_t n) {
+  assert(n < CHUNK);
+  char chunk[CHUNK] = { 0 };
+  memcpy(chunk, p, n);
+  return lead_mask(chunk) & ((UINT64_C(1) << n) - 1);
+}
+
+/// Position of `n`-th (from zero) set bit of the mask
+static inline size_t nth_bit(uint64_t mask, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    mask &= mask - 1;
+  return (size_t) __builtin_ctzll(mask);
+}
+
+/// Number of lead bytes in `n` bytes starting at `p`
+static size_t count_leads(const char* p, size_t n) {
+  size_t count = 0;
+  for (; n >= CHUNK; n -= CHUNK, p += CHUNK)
+    count += (size_t) __builtin_popcountll(lead_mask(p));
+  if (n)
+    count += (size_t) __builtin_popcountll(lead_mask_partial(p, n));
+  return count;
+}
+
+/// Append checkpoints for the string starting from byte `from`,
+/// which is a multiple of stride. `cps` codepoints begin before it.
+static void scan(utf8_index_t* idx, const char* str, size_t from, size_t cps) {
+
+  size_t stride_mask = ((size_t) 1 << idx->stride_shift) - 1;
+  size_t len = idx->num_bytes;
+  size_t next_checkpoint = ia_length(idx->cp_offsets) << idx->stride_shift;
+
+  for (size_t pos = from; pos < len; pos += CHUNK) {
+
+    if ((pos & stride_mask) == 0)
+      ia_push$(&idx->block_cps, cps);
+
+    uint64_t mask = len - pos >= CHUNK
+                  ? lead_mask(str + pos)
+                  : lead_mask_partial(str + pos, len - pos);
+    size_t n = (size_t) __builtin_popcountll(mask);
+
+    // Stride is at least the chunk size, so there is at most
+    // one checkpoint in each chunk.
+    if (cps + n > next_checkpoint) {
+      ia_push$(&idx->cp_offsets, pos + nth_bit(mask, next_checkpoint - cps));
+      next_checkpoint += stride_mask + 1;
+    }
+    cps += n;
+  }
+
+  idx->num_codepoints = cps;
+}
+
+
+void utf8_index_init(utf8_index_t* idx, const char* str, size_t len, size_t stride) {
+
+  assert(idx);
+  assert(str || len == 0);
+
+  if (stride == 0)
+    stride = UTF8_INDEX_DEFAULT_STRIDE;
+  check$((stride & (stride - 1)) == 0 && stride >= CHUNK,
+         "Index stride must be a power of two not less than %d, got %zu", CHUNK, stride);
+
+  idx->stride_shift = (size_t) __builtin_ctzll(stride);
+  idx->num_bytes = len;
+  idx->num_codepoints = 0;
+  idx->cp_offsets = ia_new_array_for$((len >> idx->stride_shift) + 1, size_t);
+  idx->block_cps = ia_new_array_for$((len >> idx->stride_shift) + 1, size_t);
+
+  scan(idx, str, 0, 0);
+}
+
+
+void utf8_index_destroy(utf8_index_t* idx) {
+  assert(idx);
+  ia_destroy_array(idx->cp_offsets);
+  ia_destroy_array(idx->block_cps);
+  idx->cp_offsets = idx->block_cps = NULL;
+}
+
+
+void utf8_index_update(utf8_index_t* idx, const char* str, size_t len, size_t pos) {
+
+  assert(idx);
+  assert(str || len == 0);
+
+  if (pos > idx->num_bytes)
+    pos = idx->num_bytes;
+  if (pos > len)
+    pos = len;
+
+  // Restart from the beginning of the block with the edit. Everything
+  // before that block start is unchanged.
+  size_t block = pos >> idx->stride_shift;
+  size_t from = block << idx->stride_shift;
+  size_t cps = block < ia_length(idx->block_cps) ? idx->block_cps[block] : idx->num_codepoints;
+  size_t stride = (size_t) 1 << idx->stride_shift;
+
+  ia_truncate$(&idx->block_cps, block < ia_length(idx->block_cps) ? block : ia_length(idx->block_cps));
+  ia_truncate$(&idx->cp_offsets, (cps + stride - 1) >> idx->stride_shift);
+
+  idx->num_bytes = len;
+  scan(idx, str, from, cps);
+}
+
+
+size_t utf8_index_byte_of(const utf8_index_t* idx, const char* str, size_t cp) {
+
+  assert(idx);
+
+  check$(cp <= idx->num_codepoints,
+         "Codepoint %zu is out of string with %zu codepoints", cp, idx->num_codepoints);
+  if (cp == idx->num_codepoints)
+    return idx->num_bytes;
+
+  size_t pos = idx->cp_offsets[cp >> idx->stride_shift];
+  size_t skip = cp & (((size_t) 1 << idx->stride_shift) - 1);
+
+  // `skip` more lead bytes after the one at `pos`
+  while (true) {
+    size_t left = idx->num_bytes - pos;
+    uint64_t mask = left >= CHUNK ? lead_mask(str + pos) : lead_mask_partial(str + pos, left);
+    size_t n = (size_t) __builtin_popcountll(mask);
+    if (skip < n)
+      return pos + nth_bit(mask, skip);
+    skip -= n;
+    pos += CHUNK;
+  }
+}
+
+
+size_t utf8_index_codepoint_of(const utf8_index_t* idx, const char* str, size_t byte) {
+
+  assert(idx);
+
+  check$(byte <= idx->num_bytes,
+         "Byte %zu is out of string with %zu bytes", byte, idx->num_bytes);
+  if (byte == idx->num_bytes)
+    return idx->num_codepoints;
+
+  size_t block = byte >> idx->stride_shift;
+  size_t from = block << idx->stride_shift;
+
+  // Codepoints which begin before the byte or at it, minus one for
+  // the codepoint containing the byte itself. There may be no such
+  // codepoint if the string begins with continuation bytes.
+  size_t n = idx->block_cps[block] + count_leads(str + from, byte - from + 1);
+  return n ? n - 1 : 0;
+}
@@ -0,0 +1,294 @@
+/**
+ * \brief Implementation of substring and byte set search.
+ *
+ * Substring search has two parts:
+ *
+ *  - SIMD filter. For 16 positions at a time, it compares haystack
+ *    with first and last bytes of the needle. Only positions where both
+ *    match are checked with `memcmp()`. On real text this rejects almost
+ *    everything, so search runs at memory speed.
+ *
+ *  - Two-Way (Crochemore-Perrin) algorithm, as in musl. It is linear
+ *    in worst case, and is used when the filter lets through too much
+ *    (like searching `aaab` in `aaaa...`), and for the tail of the
+ *    haystack which is shorter than one SIMD block.
+ *
+ * Byte sets are matched with the approach of Wojciech Muła: a table of
+ * bits indexed by low nibble, from which a bit is selected by high
+ * nibble. With SSSE3 both indexing steps are `pshufb`-s, used at
+ * `ICPU_SSE42` level of `istd/util/cpu.h` and above.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "istd/util/cpu.h"
+#include "istd/util/utf8_search.h"
+#include "istd/util/utf8.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef ICPU_X86
+#include <tmmintrin.h>
+#endif
+
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+/// Give up on filtering after checking this many bytes of false
+/// candidates per byte of haystack
+#define MAX_WASTE_RATIO 2
+
+/// Check that match of `n` bytes at `pos` does not cut a codepoint
+static inline bool on_boundaries(const char* hay, size_t hay_len, size_t pos, size_t n) {
+  return !_utf8_is_continuation((uint8_t) hay[pos])
+      && (pos + n == hay_len || !_utf8_is_continuation((uint8_t) hay[pos + n]));
+}
+
+//==== Two-Way
+
+
+/// Two-Way search for the needle in `hay`, starting from `start`
+static const char* two_way(
+    const char* hay, size_t hay_len, size_t start,
+    const unsigned char* n, size_t l
+  ) {
+
+  size_t ip, jp, k, p, ms, p0, mem, mem0;
+  size_t byteset[32 / sizeof(size_t)] = { 0 };
+  size_t shift[256];
+
+#define BITOP(a, b, op) \
+  ((a)[(size_t) (b) / (8 * sizeof *(a))] op (size_t) 1 << ((size_t) (b) % (8 * sizeof *(a))))
+
+  // Bad character shift table
+  for (size_t i = 0; i < l; ++i) {
+    BITOP(byteset, n[i], |=);
+    shift[n[i]] = i + 1;
+  }
+
+  // Compute maximal suffix
+  ip = -1; jp = 0; k = p = 1;
+  while (jp + k < l) {
+    if (n[ip + k] == n[jp + k]) {
+      if (k == p) { jp += p; k = 1; }
+      else k++;
+    } else if (n[ip + k] > n[jp + k]) {
+      jp += k; k = 1; p = jp - ip;
+    } else {
+      ip = jp++; k = p = 1;
+    }
+  }
+  ms = ip;
+  p0 = p;
+
+  // And with the opposite comparison
+  ip = -1; jp = 0; k = p = 1;
+  while (jp + k < l) {
+    if (n[ip + k] == n[jp + k]) {
+      if (k == p) { jp += p; k = 1; }
+      else k++;
+    } else if (n[ip + k] < n[jp + k]) {
+      jp += k; k = 1; p = jp - ip;
+    } else {
+      ip = jp++; k = p = 1;
+    }
+  }
+  if (ip + 1 > ms + 1) ms = ip;
+  else p = p0;
+
+  // Periodic needle?
+  if (memcmp(n, n + p, ms + 1)) {
+    mem0 = 0;
+    p = MAX(ms, l - ms - 1) + 1;
+  } else {
+    mem0 = l - p;
+  }
+  mem = 0;
+
+  const unsigned char* h = (const unsigned char*) hay + start;
+  const unsigned char* z = (const unsigned char*) hay + hay_len;
+
+  while ((size_t) (z - h) >= l) {
+
+    // Check last byte first, advance by shift on mismatch
+    if (BITOP(byteset, h[l - 1], &)) {
+      k = l - shift[h[l - 1]];
+      if (k) {
+        if (k < mem) k = mem;
+        h += k; mem = 0;
+        continue;
+      }
+    } else {
+      h += l; mem = 0;
+      continue;
+    }
+
+    // Compare right half
+    for (k = MAX(ms + 1, mem); k < l && n[k] == h[k]; k++);
+    if (k < l) {
+      h += k - ms; mem = 0;
+      continue;
+    }
+
+    // Compare left half
+    for (k = ms + 1; k > mem && n[k - 1] == h[k - 1]; k--);
+    if (k <= mem) {
+      size_t pos = (size_t) ((const char*) h - hay);
+      if (on_boundaries(hay, hay_len, pos, l))
+        return (const char*) h;
+      h += 1; mem = 0;
+      continue;
+    }
+
+    h += p; mem = mem0;
+  }
+
+#undef BITOP
+
+  return NULL;
+}
+
+//==== Substring search
+
+
+const char* utf8_find(const char* hay, size_t hay_len, const char* needle, size_t needle_len) {
+
+  assert(hay || hay_len == 0);
+  assert(needle || needle_len == 0);
+
+  if (needle_len == 0)
+    return hay;
+  if (needle_len > hay_len)
+    return NULL;
+
+  if (needle_len == 1) {
+    const char* end = hay + hay_len;
+    for (const char* p = hay; (p = memchr(p, needle[0], (size_t) (end - p))); ++p)
+      if (on_boundaries(hay, hay_len, (size_t) (p - hay), 1))
+        return p;
+    return NULL;
+  }
+
+  size_t pos = 0;
+
+#ifdef __SSE2__
+  size_t last = hay_len - needle_len;
+  size_t wasted = 0;
+  const __m128i first_byte = _mm_set1_epi8(needle[0]);
+  const __m128i last_byte = _mm_set1_epi8(needle[needle_len - 1]);
+
+  for (; pos + 16 <= last + 1; pos += 16) {
+
+    __m128i a = _mm_loadu_si128((const __m128i*) (hay + pos));
+    __m128i b = _mm_loadu_si128((const __m128i*) (hay + pos + needle_len - 1));
+    unsigned mask = (unsigned) _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(a, first_byte), _mm_cmpeq_epi8(b, last_byte))
+    );
+
+    while (mask) {
+      size_t candidate = pos + (size_t) __builtin_ctz(mask);
+      if (!memcmp(hay + candidate + 1, needle + 1, needle_len - 2)
+          && on_boundaries(hay, hay_len, candidate, needle_len))
+        return hay + candidate;
+      wasted += needle_len;
+      mask &= mask - 1;
+    }
+
+    // Filter does not work for this needle, fall back to linear search
+    if (wasted > MAX_WASTE_RATIO * (pos + 16)) {
+      pos += 16;
+      break;
+    }
+  }
+#endif
+
+  return two_way(hay, hay_len, pos, (const unsigned char*) needle, needle_len);
+}
+
+//==== Byte sets
+
+
+void utf8_byteset_init(utf8_byteset_t* set, const char* bytes, size_t n) {
+  assert(set);
+  assert(bytes || n == 0);
+
+  memset(set, 0, sizeof(*set));
+  for (size_t i = 0; i < n; ++i)
+    utf8_byteset_add(set, (uint8_t) bytes[i]);
+}
+
+
+void utf8_byteset_add(utf8_byteset_t* set, uint8_t byte) {
+  assert(set);
+
+  uint8_t bit = (uint8_t) (1 << ((byte >> 4) & 7));
+  if (byte < 0x80)
+    set->low[byte & 15] |= bit;
+  else
+    set->high[byte & 15] |= bit;
+}
+
+
+static const char* find_any_scalar(const char* str, size_t len, const utf8_byteset_t* set) {
+  for (size_t i = 0; i < len; ++i)
+    if (utf8_byteset_has(set, (uint8_t) str[i]))
+      return str + i;
+  return NULL;
+}
+
+
+#ifdef ICPU_X86
+
+ICPU_TARGET_SSE42
+static const char* find_any_ssse3(const char* str, size_t len, const utf8_byteset_t* set) {
+
+  const __m128i low = _mm_loadu_si128((const __m128i*) set->low);
+  const __m128i high = _mm_loadu_si128((const __m128i*) set->high);
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                     1, 2, 4, 8, 16, 32, 64, -128);
+  const __m128i zero = _mm_setzero_si128();
+
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+
+    __m128i v = _mm_loadu_si128((const __m128i*) (str + i));
+    __m128i lo = _mm_and_si128(v, nibble);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+
+    // Row of the table for each byte, picked from `low` or `high`
+    // depending on top bit of the byte
+    __m128i is_high = _mm_cmplt_epi8(v, zero);
+    __m128i row = _mm_or_si128(
+        _mm_andnot_si128(is_high, _mm_shuffle_epi8(low, lo)),
+        _mm_and_si128(is_high, _mm_shuffle_epi8(high, lo))
+    );
+
+    // Bit of the row for each byte
+    __m128i hit = _mm_and_si128(row, _mm_shuffle_epi8(bits, hi));
+    unsigned mask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(hit, zero)) ^ 0xffff;
+
+    if (mask)
+      return str + i + __builtin_ctz(mask);
+  }
+
+  return find_any_scalar(str + i, len - i, set);
+}
+
+#endif
+
+
+icpu_dispatch$(find_any, const char*, (const char* str, size_t len, const utf8_byteset_t* set),
+               find_any_scalar, icpu_x86$(find_any_ssse3), NULL, NULL)
+
+
+const char* utf8_find_any_of_set(const char* str, size_t len, const utf8_byteset_t* set) {
+
+  assert(str || len == 0);
+  assert(set);
+
+  return find_any(str, len, set);
+}
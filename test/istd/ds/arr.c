@@ -3,10 +3,27 @@
  */
 
 #include "istd/util/test.h"
+#include <fcntl.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "istd/ds/arr.h"
 
+#define READERS 4
+
+/// Sum items of a shared snapshot, and stop holding it
+static void* read_snapshot(void* arg) {
+  ia_arr$(int) snapshot = arg;
+  long sum = 0;
+  for (size_t i = 0; i < ia_length(snapshot); ++i)
+    sum += snapshot[i];
+  ia_destroy_array(snapshot);
+  return (void*) sum;
+}
+
 itest_section$("default, istd", "ISTD Arrays") {
 
   itest_case$("Empty arrays") {
@@ -17,6 +34,8 @@ itest_section$("default, istd", "ISTD Arrays") {
     itest_die_if_something_failed$();
     itest_check_uint_equal$(ia_length(empty), 0, "Empty array should have zero length");
     itest_check_uint_equal$((uintptr_t) empty % alignof(max_align_t), 0, "Array should be aligned properly");
+
+    ia_destroy_array(empty);
   }
 
   itest_case$("Array of given starting size") {
@@ -30,6 +49,8 @@ itest_section$("default, istd", "ISTD Arrays") {
     itest_check_uint_equal$((uintptr_t) not_empty % alignof(max_align_t), 0, "Array should be aligned properly");
     for (size_t i = 0; i < 10; ++i)
       itest_check_int_equal$(not_empty[i], 0, "Array should be zeroed: %zu-th item", i);
+
+    ia_destroy_array(not_empty);
   }
 
   itest_case$("Arrays with preallocated space") {
@@ -42,6 +63,7 @@ itest_section$("default, istd", "ISTD Arrays") {
     itest_check_uint_ge$(ia_avail(with_prealloc), 10, "There should be some space availiable");
     itest_check_uint_equal$((uintptr_t) with_prealloc % alignof(max_align_t), 0, "Array should be aligned properly");
 
+    ia_destroy_array(with_prealloc);
   }
 
   itest_case$("NULL handling") {
@@ -63,6 +85,8 @@ itest_section$("default, istd", "ISTD Arrays") {
 
     itest_check_char_equal$(str[0], 'a', "Array must contain pushed value");
     itest_check_char_equal$(str[1], '\0', "Array must be null-terminated");
+
+    ia_destroy_array(str);
   }
 
   itest_case$("Push() - structures and multibyte") {
@@ -83,7 +107,8 @@ itest_section$("default, istd", "ISTD Arrays") {
 
     itest_check_uint_equal$(struct_array[1].foo, 42, "Correct value should be pushed");
     itest_check_ptr_equal$(struct_array[1].bar, str, "Correct value should be pushed");
-    
+
+    ia_destroy_array(struct_array);
   }
 
   itest_case$("Pop()") {
@@ -100,6 +125,201 @@ itest_section$("default, istd", "ISTD Arrays") {
 
     itest_check_uint_equal$(ia_length(str), 0, "Array should decrease its length back after pop");
     itest_check_char_equal$(str[0], '\0', "Array must be null-terminated");
-    
+
+    ia_destroy_array(str);
+  }
+
+  itest_case$("Append() and truncate()") {
+
+    ia_arr$(char) str = NULL;
+    ia_append$(&str, "hello", 5);
+    itest_check_ptr_notnull$(str, "Appending to NULL should create an array");
+    itest_check_uint_equal$(ia_length(str), 5, "Array should have appended items");
+    itest_check$(!memcmp(str, "hello", 5), "Items should be copied");
+    itest_check_char_equal$(str[5], '\0', "Array must be null-terminated");
+    itest_check_allocs_le$(1, "Appending to NULL should allocate once");
+
+    ia_append$(&str, "ignored", 0);
+    itest_check_uint_equal$(ia_length(str), 5, "Appending no items should keep length");
+    itest_check_char_equal$(str[5], '\0', "Array must be null-terminated");
+    itest_check_allocs_le$(1, "Appending no items should not allocate");
+
+    char many[1000];
+    memset(many, 'x', sizeof(many));
+    itest_check_uint_lt$(ia_avail(str), 5 + sizeof(many), "Appended items should not fit yet");
+    ia_append$(&str, many, sizeof(many));
+    itest_check_uint_equal$(ia_length(str), 5 + sizeof(many), "Array should grow past its room");
+    itest_check_uint_ge$(ia_avail(str), 5 + sizeof(many), "Room should be made for all items");
+    itest_check$(!memcmp(str, "hello", 5), "Old items should be kept");
+    itest_check_char_equal$(str[5 + sizeof(many) - 1], 'x', "New items should be copied");
+    itest_check_char_equal$(str[5 + sizeof(many)], '\0', "Array must be null-terminated");
+    itest_check_allocs_le$(2, "Appending past room should grow once");
+
+    size_t avail = ia_avail(str);
+    ia_truncate$(&str, 3);
+    itest_check_uint_equal$(ia_length(str), 3, "Array should be truncated");
+    itest_check_char_equal$(str[3], '\0', "Array must be null-terminated");
+    itest_check_uint_equal$(ia_avail(str), avail, "Truncating should keep the room");
+    ia_truncate$(&str, 3);
+    itest_check_uint_equal$(ia_length(str), 3, "Truncating to same length should keep it");
+    ia_truncate$(&str, 0);
+    itest_check_char_equal$(str[0], '\0', "Array must be null-terminated");
+
+    ia_arr$(int64_t) ints = NULL;
+    ia_append$(&ints, ((int64_t[]) { 1, 2, 3 }), 3);
+    itest_check_uint_equal$(ia_length(ints), 3, "Larger items should be appended");
+    itest_check_int_equal$(ints[2], 3, "Larger items should be copied whole");
+
+    ia_destroy_array(ints);
+    ia_destroy_array(str);
+  }
+
+  itest_case$("Truncating past length panics") {
+
+    pid_t pid = fork();
+    itest_check$(pid >= 0, "Should fork");
+    itest_die_if_something_failed$();
+    if (!pid) {
+      // Message of the panic is expected, and not shown
+      int null = open("/dev/null", O_WRONLY);
+      dup2(null, STDERR_FILENO);
+      ia_arr$(char) str = NULL;
+      ia_append$(&str, "abc", 3);
+      ia_truncate$(&str, 4);
+      _exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    itest_check$(!WIFEXITED(status) || WEXITSTATUS(status), "Truncating past length should panic");
+  }
+
+  itest_case$("Reserve() and set_length()") {
+
+    ia_arr$(int) arr = NULL;
+    ia_reserve$(&arr, 100);
+    itest_check_ptr_notnull$(arr, "Reserving in NULL should create an array");
+    itest_check_uint_equal$(ia_length(arr), 0, "Reserving should not change length");
+    itest_check_uint_ge$(ia_avail(arr), 100, "Reserving should make room");
+
+    int* items = arr;
+    for (int i = 0; i < 100; ++i)
+      items[i] = i;
+    ia_set_length$(&arr, 100);
+    itest_check_ptr_equal$(arr, items, "Array should not move when room was reserved");
+    itest_check_uint_equal$(ia_length(arr), 100, "Length should be set");
+    itest_check_int_equal$(arr[99], 99, "Written items should be kept");
+
+    ia_reserve$(&arr, 1000);
+    itest_check_uint_ge$(ia_avail(arr), 1100, "Room should be made past length");
+    ia_set_length$(&arr, 10);
+    itest_check_uint_equal$(ia_length(arr), 10, "Length should go down too");
+
+    ia_destroy_array(arr);
+  }
+
+  itest_case$("Shared arrays") {
+
+    ia_arr$(int) arr = ia_new_aligned_array_of$(100, int, IA_CACHE_LINE);
+    for (int i = 0; i < 100; ++i)
+      arr[i] = i;
+    itest_check$(!ia_is_shared(arr), "New array should not be shared");
+
+    ia_arr$(int) snapshot = ia_share(arr);
+    itest_check_ptr_equal$(snapshot, arr, "Sharing should not copy");
+    itest_check$(ia_is_shared(arr), "Array should be shared");
+
+    ia_push$(&arr, 100);
+    itest_check$(snapshot != arr, "Shared array should be copied before a push");
+    itest_check_uint_equal$(ia_length(snapshot), 100, "Snapshot should keep its length");
+    itest_check_uint_equal$(ia_length(arr), 101, "Copy should get the item");
+    itest_check_int_equal$(arr[99], 99, "Copy should have all items");
+    itest_check_uint_equal$(ia_alignment(arr), IA_CACHE_LINE, "Copy should keep alignment");
+    itest_check$(!ia_is_shared(arr) && !ia_is_shared(snapshot), "Neither array should be shared any more");
+
+    // Each of these changes the copy of one holder
+    ia_arr$(int) second = ia_share(snapshot);
+    ia_pop$(&second);
+    itest_check_uint_equal$(ia_length(snapshot), 100, "Pop should not change other holders");
+    ia_arr$(int) third = ia_share(snapshot);
+    ia_truncate$(&third, 10);
+    itest_check_uint_equal$(ia_length(snapshot), 100, "Truncate should not change other holders");
+    ia_arr$(int) fourth = ia_share(snapshot);
+    ia_unshare$(&fourth);
+    fourth[0] = -1;
+    itest_check_int_equal$(snapshot[0], 0, "Writes after unsharing should not change other holders");
+
+    ia_arr$(int) last = ia_share(snapshot);
+    ia_destroy_array(snapshot);
+    itest_check$(!ia_is_shared(last), "Last holder should hold the array alone");
+    ia_push$(&last, 1);
+    itest_check_uint_equal$(ia_length(last), 101, "Last holder should change the array in place");
+
+    itest_check_ptr_null$(ia_share(NULL), "NULL should be shared as NULL");
+
+    ia_destroy_array(arr);
+    ia_destroy_array(second);
+    ia_destroy_array(third);
+    ia_destroy_array(fourth);
+    ia_destroy_array(last);
+  }
+
+  itest_case$("Snapshots for other threads") {
+
+    ia_arr$(int) arr = ia_new_empty_array$(int);
+    for (int i = 0; i < 10000; ++i)
+      ia_push$(&arr, 1);
+
+    // Readers sum snapshots while the array grows
+    pthread_t readers[READERS];
+    for (int r = 0; r < READERS; ++r) {
+      pthread_create(&readers[r], NULL, read_snapshot, ia_share(arr));
+      ia_push$(&arr, 1);
+    }
+
+    long sums = 0;
+    for (int r = 0; r < READERS; ++r) {
+      void* sum;
+      pthread_join(readers[r], &sum);
+      sums += (long) sum;
+    }
+    itest_check_int_equal$(sums, 4 * 10000 + 0 + 1 + 2 + 3, "Each reader should see its snapshot");
+    itest_check_uint_equal$(ia_length(arr), 10000 + READERS, "Array should get all items");
+
+    ia_destroy_array(arr);
+  }
+
+  itest_case$("Over-aligned arrays") {
+
+    size_t alignments[] = { 32, IA_CACHE_LINE, 256, IA_PAGE };
+    for (size_t a = 0; a < sizeof(alignments) / sizeof(*alignments); ++a) {
+
+      ia_arr$(int) arr = ia_new_aligned_array_of$(3, int, alignments[a]);
+      itest_check_uint_equal$((uintptr_t) arr % alignments[a], 0, "Array should be aligned to %zu", alignments[a]);
+      itest_check_uint_equal$(ia_alignment(arr), alignments[a], "Alignment should be kept");
+      itest_check_uint_equal$(ia_length(arr), 3, "Array should have requested length");
+
+      // Grows many times, each time memory may move
+      for (int i = 0; i < 5000; ++i) {
+        ia_push$(&arr, i);
+        if ((uintptr_t) arr % alignments[a]) {
+          itest_check_uint_equal$((uintptr_t) arr % alignments[a], 0, "Array should stay aligned after %d pushes", i);
+          break;
+        }
+      }
+
+      itest_check_uint_equal$(ia_length(arr), 5003, "All items should be pushed");
+      for (int i = 0; i < 5000; ++i)
+        if (arr[i + 3] != i) {
+          itest_check_int_equal$(arr[i + 3], i, "Items should be kept when array moves");
+          break;
+        }
+
+      ia_destroy_array(arr);
+    }
+
+    ia_arr$(char) usual = ia_new_aligned_array_for$(10, char, 1);
+    itest_check_uint_equal$(ia_alignment(usual), alignof(max_align_t), "Small alignment should give usual array");
+    ia_destroy_array(usual);
   }
 }
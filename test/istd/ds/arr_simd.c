@@ -0,0 +1,150 @@
+/**
+ * Vectorized array operation tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/ds/arr.h"
+#include "istd/ds/arr_simd.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+/// Lengths to test with, around multiples of all vector widths
+#define MAX_LEN 100
+
+static uint32_t rng = 1;
+
+static int32_t next_random(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return (int32_t) (rng % 2001) - 1000;
+}
+
+itest_section$("default, istd, simd", "ISTD Vectorized array operations") {
+
+  itest_case$("Fill and find") {
+    for (size_t len = 0; len <= MAX_LEN; ++len) {
+      ia_arr$(int32_t) arr = ia_new_aligned_array_of$(len, int32_t, IA_CACHE_LINE);
+
+      ia_simd_fill$(arr, 5);
+      for (size_t i = 0; i < len; ++i)
+        if (arr[i] != 5) {
+          itest_check_int_equal$(arr[i], 5, "Item %zu of %zu should be filled", i, len);
+          break;
+        }
+
+      itest_check_ptr_null$(ia_simd_find$(arr, 6), "Missing item should not be found in %zu items", len);
+      for (size_t at = 0; at < len; ++at) {
+        arr[at] = 6;
+        if (at + 1 < len)
+          arr[at + 1] = 6;
+        itest_check_ptr_equal$(ia_simd_find$(arr, 6), arr + at, "First item should be found at %zu of %zu", at, len);
+        arr[at] = 5;
+        if (at + 1 < len)
+          arr[at + 1] = 5;
+      }
+
+      ia_destroy_array(arr);
+    }
+
+    ia_arr$(double) doubles = ia_new_array_of$(37, double);
+    ia_simd_fill$(doubles, 0.5);
+    doubles[30] = -0.0;
+    itest_check_ptr_equal$(ia_simd_find$(doubles, 0.0), doubles + 30, "Zeroes should be equal");
+    ia_destroy_array(doubles);
+  }
+
+  itest_case$("Reductions compared with loops") {
+    for (size_t len = 1; len <= MAX_LEN; ++len) {
+      ia_arr$(int32_t) i32 = ia_new_array_of$(len, int32_t);
+      ia_arr$(int64_t) i64 = ia_new_array_of$(len, int64_t);
+      ia_arr$(float) f32 = ia_new_array_of$(len, float);
+      ia_arr$(double) f64 = ia_new_array_of$(len, double);
+
+      int64_t sum = 0, min = INT64_MAX, max = INT64_MIN;
+      for (size_t i = 0; i < len; ++i) {
+        int32_t x = next_random();
+        // Large values, so int32_t sums would overflow
+        i32[i] = x * 2000000;
+        i64[i] = (int64_t) x * ((int64_t) 1 << 40);
+        f32[i] = (float) x;
+        f64[i] = (double) x / 4;
+        sum += x;
+        min = x < min ? x : min;
+        max = x > max ? x : max;
+      }
+
+      itest_check_int_equal$(ia_simd_sum$(i32), sum * 2000000, "Sum of %zu int32_t", len);
+      itest_check_int_equal$(ia_simd_sum$(i64), sum * ((int64_t) 1 << 40), "Sum of %zu int64_t", len);
+      // Small integers are summed exactly in any order
+      itest_check$(ia_simd_sum$(f32) == (double) sum, "Sum of %zu floats is %g, not %lld", len, ia_simd_sum$(f32), (long long) sum);
+      itest_check$(ia_simd_sum$(f64) == (double) sum / 4, "Sum of %zu doubles", len);
+
+      itest_check_int_equal$(ia_simd_min$(i32), min * 2000000, "Minimum of %zu int32_t", len);
+      itest_check_int_equal$(ia_simd_max$(i32), max * 2000000, "Maximum of %zu int32_t", len);
+      itest_check_int_equal$(ia_simd_min$(i64), min * ((int64_t) 1 << 40), "Minimum of %zu int64_t", len);
+      itest_check_int_equal$(ia_simd_max$(i64), max * ((int64_t) 1 << 40), "Maximum of %zu int64_t", len);
+      itest_check$(ia_simd_min$(f32) == (float) min, "Minimum of %zu floats", len);
+      itest_check$(ia_simd_max$(f64) == (double) max / 4, "Maximum of %zu doubles", len);
+
+      ia_destroy_array(i32);
+      ia_destroy_array(i64);
+      ia_destroy_array(f32);
+      ia_destroy_array(f64);
+    }
+
+    ia_arr$(int32_t) empty = ia_new_empty_array$(int32_t);
+    itest_check_int_equal$(ia_simd_sum$(empty), 0, "Sum of empty array should be 0");
+    ia_destroy_array(empty);
+  }
+
+  itest_case$("Equality") {
+    for (size_t len = 0; len <= MAX_LEN; ++len) {
+      ia_arr$(int64_t) a = ia_new_array_of$(len, int64_t);
+      ia_arr$(int64_t) b = ia_new_aligned_array_of$(len, int64_t, IA_CACHE_LINE);
+      for (size_t i = 0; i < len; ++i)
+        a[i] = b[i] = next_random();
+
+      itest_check$(ia_simd_equal$(a, b), "Equal arrays of %zu items", len);
+      for (size_t at = 0; at < len; ++at) {
+        b[at]++;
+        itest_check$(!ia_simd_equal$(a, b), "Arrays of %zu items differ at %zu", len, at);
+        b[at]--;
+      }
+
+      ia_push$(&b, 1);
+      itest_check$(!ia_simd_equal$(a, b), "Arrays of different lengths differ");
+
+      ia_destroy_array(a);
+      ia_destroy_array(b);
+    }
+  }
+
+  itest_case$("Prefix sums compared with loops") {
+    for (size_t len = 0; len <= MAX_LEN; ++len) {
+      ia_arr$(int32_t) i32 = ia_new_array_of$(len, int32_t);
+      ia_arr$(double) f64 = ia_new_array_of$(len, double);
+      int32_t* expected = malloc((len + 1) * sizeof(*expected));
+
+      int32_t sum = 0;
+      for (size_t i = 0; i < len; ++i) {
+        i32[i] = next_random();
+        f64[i] = i32[i];
+        expected[i] = sum += i32[i];
+      }
+
+      ia_simd_prefix_sum$(i32);
+      ia_simd_prefix_sum$(f64);
+      for (size_t i = 0; i < len; ++i)
+        if (i32[i] != expected[i] || f64[i] != expected[i]) {
+          itest_check_int_equal$(i32[i], expected[i], "Prefix sum of int32_t at %zu of %zu", i, len);
+          itest_check$(f64[i] == expected[i], "Prefix sum of doubles at %zu of %zu", i, len);
+          break;
+        }
+
+      free(expected);
+      ia_destroy_array(i32);
+      ia_destroy_array(f64);
+    }
+  }
+}
@@ -0,0 +1,203 @@
+/**
+ * Set operations on sorted arrays tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/ds/arr.h"
+#include "istd/ds/arr_sorted.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint64_t next_random(uint64_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+/// Sorted array of about `count` items below `range`, starting from `first`
+static ia_arr$(uint32_t) random_set(uint64_t* rng, uint32_t first, uint32_t range, size_t count) {
+  ia_arr$(uint32_t) set = ia_new_empty_array$(uint32_t);
+  for (uint32_t x = first; x < range; ++x)
+    if (next_random(rng) % range < count)
+      ia_push$(&set, x);
+  return set;
+}
+
+/// Operations done with plain merge loops, to compare with
+typedef enum { INTERSECT, UNION, DIFFERENCE } op_t;
+
+static ia_arr$(uint32_t) expected(op_t op, const uint32_t* a, const uint32_t* b) {
+  ia_arr$(uint32_t) out = ia_new_empty_array$(uint32_t);
+  size_t i = 0, j = 0, na = ia_length(a), nb = ia_length(b);
+  while (i < na || j < nb) {
+    bool in_a = i < na && (j == nb || a[i] <= b[j]);
+    bool in_b = j < nb && (i == na || b[j] <= a[i]);
+    uint32_t x = in_a ? a[i] : b[j];
+    if ((op == INTERSECT && in_a && in_b) || op == UNION || (op == DIFFERENCE && in_a && !in_b))
+      ia_push$(&out, x);
+    i += in_a;
+    j += in_b;
+  }
+  return out;
+}
+
+static bool same(const uint32_t* x, const uint32_t* y) {
+  return ia_length(x) == ia_length(y) && !memcmp(x, y, ia_length(x) * sizeof(uint32_t));
+}
+
+/// Check all operations on `a` and `b`, and return number of wrong results
+static int check_all(const uint32_t* a, const uint32_t* b) {
+  ia_arr$(uint32_t) out = ia_new_empty_array$(uint32_t);
+  int wrong = 0;
+  for (op_t op = INTERSECT; op <= DIFFERENCE; ++op) {
+    ia_arr$(uint32_t) want = expected(op, a, b);
+    size_t n = op == INTERSECT ? ia_sorted_intersect(&out, a, b)
+             : op == UNION ? ia_sorted_union(&out, a, b)
+             : ia_sorted_difference(&out, a, b);
+    wrong += n != ia_length(out) || !same(out, want);
+    ia_destroy_array(want);
+  }
+  ia_destroy_array(out);
+  return wrong;
+}
+
+
+itest_section$("default, istd, simd", "ISTD Set operations on sorted arrays") {
+
+  itest_case$("Arrays of similar length") {
+    uint64_t rng = 88172645463325252ull;
+    // Lengths which are not multiples of a vector, and overlaps of all kinds
+    static const size_t counts[][2] = { { 1000, 1500 }, { 2000, 1999 }, { 37, 61 }, { 3900, 100 }, { 300, 3000 } };
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+      ia_arr$(uint32_t) a = random_set(&rng, (uint32_t) c, 4000, counts[c][0]);
+      ia_arr$(uint32_t) b = random_set(&rng, 0, 4000, counts[c][1]);
+      itest_check_int_equal$(check_all(a, b), 0, "Operations on %zu and %zu items should be right", ia_length(a), ia_length(b));
+      itest_check_int_equal$(check_all(b, a), 0, "Operations on %zu and %zu items should be right", ia_length(b), ia_length(a));
+      ia_destroy_array(a);
+      ia_destroy_array(b);
+    }
+  }
+
+  itest_case$("Arrays of very different length") {
+    uint64_t rng = 2463534242ull;
+    ia_arr$(uint32_t) large = random_set(&rng, 0, 200000, 100000);
+    ia_arr$(uint32_t) small = random_set(&rng, 0, 200000, 100);
+    ia_arr$(uint32_t) clustered = random_set(&rng, 50000, 51000, 500);
+    ia_push$(&small, 250000);
+
+    itest_check_uint_ge$(ia_length(large) / ia_length(small), IA_SORTED_GALLOP_RATIO, "Lengths should differ enough");
+    itest_check_int_equal$(check_all(small, large), 0, "Operations on short and long arrays should be right");
+    itest_check_int_equal$(check_all(large, small), 0, "Operations on long and short arrays should be right");
+    itest_check_int_equal$(check_all(clustered, large), 0, "Operations on clustered items should be right");
+    itest_check_int_equal$(check_all(large, clustered), 0, "Operations on clustered items should be right");
+
+    ia_destroy_array(large);
+    ia_destroy_array(small);
+    ia_destroy_array(clustered);
+  }
+
+  itest_case$("Empty and disjoint arrays") {
+    ia_arr$(uint32_t) none = ia_new_empty_array$(uint32_t);
+    ia_arr$(uint32_t) low = ia_new_empty_array$(uint32_t);
+    ia_arr$(uint32_t) high = ia_new_empty_array$(uint32_t);
+    for (uint32_t i = 0; i < 100; ++i) {
+      ia_push$(&low, i);
+      ia_push$(&high, i + 1000);
+    }
+
+    itest_check_int_equal$(check_all(none, low), 0, "Operations with empty array should be right");
+    itest_check_int_equal$(check_all(low, none), 0, "Operations with empty array should be right");
+    itest_check_int_equal$(check_all(low, high), 0, "Operations on disjoint arrays should be right");
+    itest_check_int_equal$(check_all(high, low), 0, "Operations on disjoint arrays should be right");
+    itest_check_int_equal$(check_all(low, low), 0, "Operations on the same arrays should be right");
+    itest_check_int_equal$(check_all(NULL, low), 0, "Operations with NULL array should be right");
+    itest_check_int_equal$(check_all(low, NULL), 0, "Operations with NULL array should be right");
+    itest_check_int_equal$(check_all(NULL, NULL), 0, "Operations on NULL arrays should be right");
+
+    ia_arr$(uint32_t) out = NULL;
+    itest_check_uint_equal$(ia_sorted_union(&out, low, high), 200, "Union should have all items");
+    itest_check_uint_equal$(ia_sorted_intersect(&out, low, high), 0, "Intersection should be empty");
+    itest_check_ptr_notnull$(out, "Output array should be created");
+
+    ia_destroy_array(out);
+    ia_destroy_array(none);
+    ia_destroy_array(low);
+    ia_destroy_array(high);
+  }
+
+  itest_case$("Output is reused") {
+    uint64_t rng = 1234567ull;
+    ia_arr$(uint32_t) a = random_set(&rng, 0, 10000, 5000);
+    ia_arr$(uint32_t) b = random_set(&rng, 0, 10000, 5000);
+    ia_arr$(uint32_t) out = ia_new_aligned_array_for$(20000, uint32_t, IA_CACHE_LINE);
+    uint32_t* room = out;
+
+    ia_sorted_union(&out, a, b);
+    ia_sorted_intersect(&out, a, b);
+    ia_sorted_difference(&out, a, b);
+    itest_check_ptr_equal$(out, room, "Reserved output should not move");
+
+    ia_destroy_array(a);
+    ia_destroy_array(b);
+    ia_destroy_array(out);
+  }
+
+  itest_case$("Unique items") {
+    uint64_t rng = 88172645463325252ull;
+    ia_arr$(uint32_t) a = ia_new_empty_array$(uint32_t);
+    ia_arr$(uint32_t) want = ia_new_empty_array$(uint32_t);
+    uint32_t x = 7;
+    for (size_t i = 0; i < 1001; ++i) {
+      // Runs of 1 to 4 equal items
+      size_t run = 1 + next_random(&rng) % 4;
+      for (size_t k = 0; k < run; ++k)
+        ia_push$(&a, x);
+      ia_push$(&want, x);
+      x += 1 + (uint32_t) (next_random(&rng) % 3);
+    }
+
+    ia_arr$(uint32_t) out = ia_new_empty_array$(uint32_t);
+    itest_check_uint_equal$(ia_sorted_unique(&out, a), ia_length(want), "Repeats should be dropped");
+    itest_check$(same(out, want), "Unique items should be kept in order");
+
+    itest_check_uint_equal$(ia_sorted_unique(&a, a), ia_length(want), "Repeats should be dropped in place");
+    itest_check$(same(a, want), "Unique items should be kept in order in place");
+
+    // Repeat across the end of last vector, which is stored over the
+    // items before the rest
+    static const uint32_t edge[] = { 0, 1, 1, 2, 3, 4, 5, 6, 7, 7, 8 };
+    ia_arr$(uint32_t) at_edge = ia_new_empty_array$(uint32_t);
+    ia_append$(&at_edge, edge, sizeof(edge) / sizeof(edge[0]));
+    itest_check_uint_equal$(ia_sorted_unique(&at_edge, at_edge), 9, "Repeats should be dropped in place");
+    for (uint32_t i = 0; i < ia_length(at_edge); ++i)
+      itest_check_uint_equal$(at_edge[i], i, "Unique items should be kept in order in place");
+    ia_destroy_array(at_edge);
+
+    // Every length and place of repeats around vectors
+    size_t wrong = 0;
+    for (size_t len = 0; len < 40; ++len) {
+      ia_arr$(uint32_t) items = ia_new_empty_array$(uint32_t);
+      for (uint32_t k = 0; k < len; ++k)
+        ia_push$(&items, k / 2 + (uint32_t) (next_random(&rng) % 2) * k);
+      for (size_t k = 1; k < len; ++k)
+        if (items[k] < items[k - 1])
+          items[k] = items[k - 1];
+      ia_sorted_unique(&out, items);
+      ia_sorted_unique(&items, items);
+      wrong += !same(out, items);
+      ia_destroy_array(items);
+    }
+    itest_check_uint_equal$(wrong, 0, "Unique items in place should be the ones copied");
+
+    ia_arr$(uint32_t) none = ia_new_empty_array$(uint32_t);
+    itest_check_uint_equal$(ia_sorted_unique(&out, none), 0, "Empty array should stay empty");
+    itest_check_uint_equal$(ia_length(out), 0, "Output should be emptied");
+
+    ia_destroy_array(a);
+    ia_destroy_array(want);
+    ia_destroy_array(out);
+    ia_destroy_array(none);
+  }
+}
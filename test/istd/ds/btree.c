@@ -0,0 +1,238 @@
+/**
+ * B+-tree tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/ds/arr.h"
+#include "istd/ds/btree.h"
+#include <stdint.h>
+#include <string.h>
+
+#define STR_LESS(a, b) (strcmp((a), (b)) < 0)
+
+IBTREE_DECLARE$(imap, int64_t, int64_t)
+IBTREE_DEFINE_NUMBERS$(imap, int64_t, int64_t)
+
+IBTREE_DECLARE$(smap, const char*, int)
+IBTREE_DEFINE$(smap, const char*, int, STR_LESS)
+
+#define N 100000
+
+/// Keys 0, 2, 4, ..., in scrambled order
+static int64_t scrambled(size_t i) {
+  // Odd multiplier is a permutation modulo a power of two
+  return (int64_t) ((i * 40503u) & 131071) * 2;
+}
+
+/// Check that all keys of the tree go in order, and count them
+static size_t check_order(const imap_t* t) {
+  size_t count = 0;
+  int64_t prev = -1;
+  bool ordered = true;
+  for (imap_iter_t it = imap_begin(t); imap_iter_valid(&it); imap_iter_next(&it), ++count) {
+    ordered &= imap_iter_key(&it) > prev;
+    prev = imap_iter_key(&it);
+  }
+  itest_check$(ordered, "Keys should go in order");
+  return count;
+}
+
+
+itest_section$("default, istd, simd", "ISTD B+-trees") {
+
+  itest_case$("Empty tree") {
+    imap_t t;
+    imap_init(&t);
+
+    itest_check_uint_equal$(imap_count(&t), 0, "Tree should be empty");
+    itest_check_ptr_null$(imap_find(&t, 1), "Nothing should be found");
+    imap_iter_t it = imap_begin(&t);
+    itest_check$(!imap_iter_valid(&it), "Iteration should end at once");
+    it = imap_lower_bound(&t, 5);
+    itest_check$(!imap_iter_valid(&it), "Lower bound should not be found");
+    itest_check$(!imap_erase(&t, 1), "Nothing should be erased");
+
+    imap_destroy(&t);
+  }
+
+  itest_case$("Inserts in any order") {
+    imap_t t;
+    imap_init(&t);
+
+    // Keys up to 2 * 131071, of which N are inserted
+    for (size_t i = 0; i < N; ++i)
+      itest_check$(imap_insert(&t, scrambled(i), scrambled(i) + 1), "Key %zu should be new", i);
+    itest_die_if_something_failed$();
+    itest_check_uint_equal$(imap_count(&t), N, "All keys should be counted");
+    itest_check_uint_gt$(t.height, 1, "Tree should have grown");
+
+    size_t found = 0;
+    for (size_t i = 0; i < N; ++i) {
+      int64_t* v = imap_find(&t, scrambled(i));
+      found += v && *v == scrambled(i) + 1;
+    }
+    itest_check_uint_equal$(found, N, "All keys should be found with their values");
+    itest_check_ptr_null$(imap_find(&t, 7), "Odd keys should not be found");
+    itest_check_ptr_null$(imap_find(&t, -2), "Smaller keys should not be found");
+    itest_check_ptr_null$(imap_find(&t, 1000000), "Larger keys should not be found");
+
+    itest_check$(!imap_insert(&t, scrambled(5), -1), "Existing key should be replaced");
+    itest_check_int_equal$(*imap_find(&t, scrambled(5)), -1, "Value should be replaced");
+    itest_check_uint_equal$(imap_count(&t), N, "Replacing should not add keys");
+
+    itest_check_uint_equal$(check_order(&t), N, "Iteration should see all keys");
+    imap_destroy(&t);
+  }
+
+  itest_case$("Appending fills nodes up") {
+    imap_t ordered, scattered;
+    imap_init(&ordered);
+    imap_init(&scattered);
+
+    for (size_t i = 0; i < N; ++i) {
+      imap_insert(&ordered, (int64_t) i * 2, 0);
+      imap_insert(&scattered, scrambled(i), 0);
+    }
+
+    itest_check_uint_equal$(check_order(&ordered), N, "Iteration should see all keys");
+    // Leaves of appended keys are full
+    size_t leaf_bytes = (sizeof(imap_leaf_t) + IA_CACHE_LINE - 1) / IA_CACHE_LINE * IA_CACHE_LINE;
+    size_t leaves = (N + IBTREE_SLOTS$(int64_t) - 1) / IBTREE_SLOTS$(int64_t);
+    itest_check_uint_le$(imap_memory(&ordered), leaves * leaf_bytes * 5 / 4 + 128 * 1024,
+                         "Appended keys should take little more than full leaves");
+    itest_check_uint_lt$(imap_memory(&ordered), imap_memory(&scattered),
+                         "Appended keys should take less memory than scattered ones");
+
+    imap_destroy(&ordered);
+    imap_destroy(&scattered);
+  }
+
+  itest_case$("Ranges") {
+    imap_t t;
+    imap_init(&t);
+    // All even keys up to 2 * 131071
+    for (size_t i = 0; i <= 131071; ++i)
+      imap_insert(&t, scrambled(i), 0);
+
+    // Both bounds are present
+    size_t count = 0;
+    int64_t first = -1, last = -1;
+    for (imap_iter_t it = imap_range(&t, 1000, 3000); imap_iter_valid(&it); imap_iter_next(&it), ++count) {
+      if (first < 0)
+        first = imap_iter_key(&it);
+      last = imap_iter_key(&it);
+    }
+    itest_check_uint_equal$(count, 1000, "Range should have keys from 1000 to 2998");
+    itest_check_int_equal$(first, 1000, "Range should start at its beginning");
+    itest_check_int_equal$(last, 2998, "Range should end before its end");
+
+    // Bounds are missing
+    imap_iter_t it = imap_range(&t, 999, 1003);
+    itest_check$(imap_iter_valid(&it) && imap_iter_key(&it) == 1000, "Range should start at next key");
+    imap_iter_next(&it);
+    itest_check$(imap_iter_valid(&it) && imap_iter_key(&it) == 1002, "Range should go on");
+    imap_iter_next(&it);
+    itest_check$(!imap_iter_valid(&it), "Range should end before 1003");
+
+    it = imap_range(&t, 5, 5);
+    itest_check$(!imap_iter_valid(&it), "Empty range should have no keys");
+
+    it = imap_lower_bound(&t, 2 * 131071 - 1);
+    itest_check$(imap_iter_valid(&it) && imap_iter_key(&it) == 2 * 131071, "Lower bound should be the last key");
+    imap_iter_next(&it);
+    itest_check$(!imap_iter_valid(&it), "Iteration should end after the last key");
+
+    imap_destroy(&t);
+  }
+
+  itest_case$("Erasing") {
+    imap_t t;
+    imap_init(&t);
+    for (size_t i = 0; i < N; ++i)
+      imap_insert(&t, (int64_t) i, (int64_t) i);
+
+    size_t erased = 0;
+    for (size_t i = 0; i < N; i += 2)
+      erased += imap_erase(&t, (int64_t) i);
+    // Whole leaves are emptied too
+    for (size_t i = 40000; i < 60000; ++i)
+      erased += imap_erase(&t, (int64_t) i);
+    itest_check_uint_equal$(erased, N / 2 + 10000, "Present keys should be erased");
+    itest_check$(!imap_erase(&t, 2), "Erased key should not be erased again");
+    itest_check_uint_equal$(imap_count(&t), N / 2 - 10000, "Count should go down");
+
+    itest_check_ptr_null$(imap_find(&t, 50001), "Erased key should not be found");
+    itest_check_ptr_notnull$(imap_find(&t, 60001), "Other keys should be found");
+    itest_check_uint_equal$(check_order(&t), N / 2 - 10000, "Iteration should skip erased keys");
+
+    imap_iter_t it = imap_lower_bound(&t, 40000);
+    itest_check$(imap_iter_valid(&it) && imap_iter_key(&it) == 60001, "Empty leaves should be skipped");
+
+    itest_check$(imap_insert(&t, 50000, 1), "Erased key should be inserted again");
+    itest_check_int_equal$(*imap_find(&t, 50000), 1, "Inserted again key should be found");
+
+    imap_destroy(&t);
+  }
+
+  itest_case$("Bulk loading") {
+    ia_arr$(int64_t) keys = ia_new_array_of$(N, int64_t);
+    ia_arr$(int64_t) values = ia_new_array_of$(N, int64_t);
+    for (size_t i = 0; i < N; ++i) {
+      keys[i] = (int64_t) i * 3;
+      values[i] = (int64_t) i;
+    }
+
+    imap_t t;
+    imap_init(&t);
+    imap_insert(&t, 1, 1);
+    imap_load(&t, keys, values);
+
+    itest_check_uint_equal$(imap_count(&t), N, "Loaded keys should be counted");
+    itest_check_ptr_null$(imap_find(&t, 1), "Old keys should be gone");
+    size_t found = 0;
+    for (size_t i = 0; i < N; ++i) {
+      int64_t* v = imap_find(&t, keys[i]);
+      found += v && *v == values[i];
+    }
+    itest_check_uint_equal$(found, N, "Loaded keys should be found");
+    itest_check_uint_equal$(check_order(&t), N, "Iteration should see loaded keys");
+
+    // Full leaves are split by inserts
+    for (size_t i = 0; i < N; i += 7)
+      imap_insert(&t, (int64_t) i * 3 + 1, -1);
+    itest_check_uint_equal$(imap_count(&t), N + (N + 6) / 7, "Inserted keys should be counted");
+    itest_check_uint_equal$(check_order(&t), imap_count(&t), "Keys should stay in order");
+    itest_check_int_equal$(*imap_find(&t, 7 * 3 + 1), -1, "Inserted key should be found");
+
+    ia_arr$(int64_t) none = ia_new_empty_array$(int64_t);
+    imap_load(&t, none, none);
+    itest_check_uint_equal$(imap_count(&t), 0, "Loading nothing should empty the tree");
+    imap_iter_t it = imap_begin(&t);
+    itest_check$(!imap_iter_valid(&it), "Empty tree should have no keys");
+
+    imap_destroy(&t);
+    ia_destroy_array(keys);
+    ia_destroy_array(values);
+    ia_destroy_array(none);
+  }
+
+  itest_case$("Keys with own order") {
+    static const char* words[] = { "pear", "apple", "fig", "kiwi", "banana", "cherry", "date" };
+    smap_t t;
+    smap_init(&t);
+    for (int i = 0; i < 7; ++i)
+      smap_insert(&t, words[i], i);
+
+    char key[] = "kiwi";
+    int* v = smap_find(&t, key);
+    itest_check$(v && *v == 3, "Equal string should be found");
+
+    const char* expected[] = { "banana", "cherry", "date" };
+    int i = 0;
+    for (smap_iter_t it = smap_range(&t, "b", "e"); smap_iter_valid(&it); smap_iter_next(&it), ++i)
+      itest_check$(i < 3 && !strcmp(smap_iter_key(&it), expected[i]), "Word %d should be in range", i);
+    itest_check_int_equal$(i, 3, "Range should have three words");
+
+    smap_destroy(&t);
+  }
+}
@@ -0,0 +1,178 @@
+/**
+ * String interning tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/ds/intern.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THREADS 4
+#define SHARED_STRINGS 2000
+
+static iintern_pool_t shared_pool;
+static const char* shared_results[THREADS][SHARED_STRINGS];
+
+/// Intern the same strings in every thread, in different order
+static void* intern_in_thread(void* arg) {
+  // Coprime with the number of strings, so each string is visited once
+  static const size_t steps[THREADS] = { 1, 3, 7, 11 };
+  size_t t = (size_t) arg;
+  char buf[32];
+  for (size_t n = 0; n < SHARED_STRINGS; ++n) {
+    size_t i = (n * steps[t] + t * 7) % SHARED_STRINGS;
+    int len = snprintf(buf, sizeof(buf), "shared-%zu", i);
+    shared_results[t][i] = iintern(&shared_pool, buf, (size_t) len);
+    // Lookups of strings added by other threads
+    iintern_find(&shared_pool, buf, (size_t) len - 1);
+  }
+  return NULL;
+}
+
+itest_section$("default, istd", "ISTD String interning") {
+
+  itest_case$("Equal strings are interned once") {
+    iintern_pool_t pool;
+    iintern_init(&pool, false);
+
+    char buf[] = "identifier";
+    const char* a = iintern_cstr(&pool, "identifier");
+    const char* b = iintern(&pool, buf, strlen(buf));
+    const char* c = iintern(&pool, "identifier_long", 10);
+    const char* other = iintern_cstr(&pool, "other");
+
+    itest_check_ptr_equal$(a, b, "Equal strings should be the same pointer");
+    itest_check_ptr_equal$(a, c, "Only given length should be interned");
+    itest_check$(a != buf, "String should be copied");
+    itest_check$(a != other, "Different strings should differ");
+    itest_check$(!strcmp(a, "identifier"), "String should be copied with \\0");
+    itest_check_uint_equal$(iintern_length(a), 10, "Length should be kept");
+    itest_check_uint_equal$(iintern_count(&pool), 2, "Pool should have two strings");
+
+    const char* empty = iintern(&pool, "", 0);
+    itest_check$(!strcmp(empty, ""), "Empty string should be interned");
+    itest_check_ptr_equal$(iintern_cstr(&pool, ""), empty, "Empty string should be interned once");
+
+    iintern_destroy(&pool);
+  }
+
+  itest_case$("Strings with zero bytes") {
+    iintern_pool_t pool;
+    iintern_init(&pool, false);
+
+    const char* a = iintern(&pool, "a\0b", 3);
+    const char* b = iintern(&pool, "a\0c", 3);
+    const char* c = iintern(&pool, "a", 1);
+
+    itest_check$(a != b && a != c && b != c, "Strings should be compared by length");
+    itest_check_uint_equal$(iintern_length(a), 3, "Length should include zero bytes");
+    itest_check$(!memcmp(b, "a\0c", 4), "Bytes should be copied");
+
+    iintern_destroy(&pool);
+  }
+
+  itest_case$("Pointers and ids are stable") {
+    iintern_pool_t pool;
+    iintern_init(&pool, false);
+
+    enum { N = 20000 };
+    const char** ptrs = malloc(N * sizeof(*ptrs));
+    char buf[32];
+
+    for (size_t i = 0; i < N; ++i) {
+      int len = snprintf(buf, sizeof(buf), "name%zu", i);
+      ptrs[i] = iintern(&pool, buf, (size_t) len);
+      itest_check_uint_equal$(iintern_id(ptrs[i]), i, "Ids should be given in order");
+    }
+
+    // Table has grown many times, and strings filled many chunks
+    for (size_t i = 0; i < N; ++i) {
+      int len = snprintf(buf, sizeof(buf), "name%zu", i);
+      itest_check_ptr_equal$(iintern(&pool, buf, (size_t) len), ptrs[i], "Pointer of %s should be kept", buf);
+      itest_check_ptr_equal$(iintern_find(&pool, buf, (size_t) len), ptrs[i], "%s should be found", buf);
+    }
+
+    itest_check_uint_equal$(iintern_count(&pool), N, "Repeated strings should not be added");
+    itest_check_ptr_null$(iintern_find(&pool, "missing", 7), "Missing string should not be found");
+    itest_check_uint_equal$(iintern_count(&pool), N, "Find should not add strings");
+
+    free(ptrs);
+    iintern_destroy(&pool);
+  }
+
+  itest_case$("Strings longer than a chunk") {
+    iintern_pool_t pool;
+    iintern_init(&pool, false);
+
+    size_t len = IINTERN_CHUNK * 2 + 3;
+    char* big = malloc(len);
+    memset(big, 'x', len);
+
+    const char* small = iintern_cstr(&pool, "small");
+    const char* a = iintern(&pool, big, len);
+    const char* b = iintern(&pool, big, len);
+    const char* after = iintern_cstr(&pool, "after");
+
+    itest_check_ptr_equal$(a, b, "Long string should be interned once");
+    itest_check_uint_equal$(iintern_length(a), len, "Long string should be kept whole");
+    itest_check_int_equal$(a[len], '\0', "Long string should be terminated");
+    itest_check$(!strcmp(small, "small"), "Earlier strings should be kept");
+    itest_check$(!strcmp(after, "after"), "Later strings should be added");
+
+    free(big);
+    iintern_destroy(&pool);
+  }
+
+  itest_case$("Statistics") {
+    iintern_pool_t pool;
+    iintern_init(&pool, false);
+
+    iintern_stats_t empty = iintern_stats(&pool);
+    itest_check_uint_equal$(empty.strings, 0, "Empty pool has no strings");
+    itest_check_uint_equal$(empty.chunk_bytes, 0, "Empty pool has no chunks");
+    itest_check_uint_gt$(empty.index_bytes, 0, "Empty pool has a table");
+
+    char buf[32];
+    size_t bytes = 0;
+    for (size_t i = 0; i < 1000; ++i) {
+      int len = snprintf(buf, sizeof(buf), "s%zu", i % 500);
+      iintern(&pool, buf, (size_t) len);
+      if (i < 500)
+        bytes += (size_t) len + 1;
+    }
+
+    iintern_stats_t stats = iintern_stats(&pool);
+    itest_check_uint_equal$(stats.strings, 500, "Distinct strings should be counted");
+    itest_check_uint_equal$(stats.string_bytes, bytes, "Bytes of strings should be counted");
+    itest_check_uint_ge$(stats.chunk_bytes, bytes + 500 * sizeof(_iintern_entry_t), "Chunks should hold strings");
+    itest_check_uint_gt$(stats.index_bytes, empty.index_bytes, "Table should have grown");
+    itest_check$(stats.load > 0.3 && stats.load <= 0.75, "Load is %g", stats.load);
+
+    iintern_destroy(&pool);
+  }
+
+  itest_case$("Concurrent pool") {
+    iintern_init(&shared_pool, true);
+
+    pthread_t threads[THREADS];
+    for (size_t t = 0; t < THREADS; ++t)
+      pthread_create(&threads[t], NULL, intern_in_thread, (void*) t);
+    for (size_t t = 0; t < THREADS; ++t)
+      pthread_join(threads[t], NULL);
+
+    itest_check_uint_equal$(iintern_count(&shared_pool), SHARED_STRINGS, "Each string should be added once");
+
+    char buf[32];
+    for (size_t i = 0; i < SHARED_STRINGS; ++i) {
+      snprintf(buf, sizeof(buf), "shared-%zu", i);
+      for (size_t t = 0; t < THREADS; ++t)
+        itest_check_ptr_equal$(shared_results[t][i], shared_results[0][i], "Threads should get the same %s", buf);
+      itest_check$(!strcmp(shared_results[0][i], buf), "String should be intact");
+      itest_check_uint_lt$(iintern_id(shared_results[0][i]), SHARED_STRINGS, "Ids should be dense");
+    }
+
+    iintern_destroy(&shared_pool);
+  }
+}
@@ -0,0 +1,174 @@
+/**
+ * Compressed arrays tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/ds/arr.h"
+#include "istd/ds/packed.h"
+#include <stdint.h>
+
+/// Not a multiple of block size, so the last block is partial
+#define N 10000
+
+static uint64_t next_random(uint64_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+/// Count values which `get()` and whole unpacking read back wrong
+static size_t mismatches_u32(const ipacked_t* p, const uint32_t* arr) {
+  size_t wrong = 0;
+  ia_arr$(uint32_t) copy = ipacked_to_u32(p);
+  wrong += ia_length(copy) != ia_length(arr);
+  for (size_t i = 0; i < ia_length(arr) && i < ia_length(copy); ++i)
+    wrong += copy[i] != arr[i] || ipacked_get(p, i) != arr[i];
+  ia_destroy_array(copy);
+  return wrong;
+}
+
+static size_t mismatches_u64(const ipacked_t* p, const uint64_t* arr) {
+  size_t wrong = 0;
+  ia_arr$(uint64_t) copy = ipacked_to_u64(p);
+  wrong += ia_length(copy) != ia_length(arr);
+  for (size_t i = 0; i < ia_length(arr) && i < ia_length(copy); ++i)
+    wrong += copy[i] != arr[i] || ipacked_get(p, i) != arr[i];
+  ia_destroy_array(copy);
+  return wrong;
+}
+
+static uint64_t sum_u32(const uint32_t* arr) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < ia_length(arr); ++i)
+    sum += arr[i];
+  return sum;
+}
+
+
+itest_section$("default, istd, simd", "ISTD Compressed arrays") {
+
+  itest_case$("Every number of bits") {
+    ia_arr$(uint32_t) arr = ia_new_array_of$(33 * IPACKED_BLOCK, uint32_t);
+    uint64_t rng = 88172645463325252ull;
+    // Block b has values below 2^b, with the largest one in it
+    for (size_t b = 0; b <= 32; ++b) {
+      uint32_t mask = (uint32_t) ((1ull << b) - 1);
+      for (size_t k = 0; k < IPACKED_BLOCK; ++k)
+        arr[b * IPACKED_BLOCK + k] = (uint32_t) next_random(&rng) & mask;
+      arr[b * IPACKED_BLOCK + b % IPACKED_BLOCK] = mask;
+    }
+
+    ipacked_t p;
+    ipacked_encode_u32(&p, arr, IPACKED_FOR);
+    for (size_t b = 0; b <= 32; ++b)
+      itest_check_uint_le$(p.blocks[b].bits, b, "Block %zu should take at most %zu bits", b, b);
+    itest_check_uint_equal$(mismatches_u32(&p, arr), 0, "Values should be read back");
+    itest_check_uint_equal$(ipacked_sum(&p), sum_u32(arr), "Sum should be the same");
+
+    uint32_t block[IPACKED_BLOCK];
+    itest_check_uint_equal$(ipacked_block_u32(&p, 7, block), IPACKED_BLOCK, "Block should be full");
+    itest_check_uint_equal$(block[7], 127, "Block should be unpacked");
+    ipacked_destroy(&p);
+
+    ipacked_encode_u32(&p, arr, IPACKED_DELTA);
+    itest_check_uint_equal$(mismatches_u32(&p, arr), 0, "Deltas should be read back");
+    itest_check_uint_equal$(ipacked_sum(&p), sum_u32(arr), "Sum of deltas should be the same");
+    ipacked_destroy(&p);
+
+    ia_destroy_array(arr);
+  }
+
+  itest_case$("Sorted values") {
+    ia_arr$(uint32_t) arr = ia_new_array_of$(N, uint32_t);
+    uint64_t rng = 2463534242ull;
+    uint32_t v = 1000000;
+    for (size_t i = 0; i < N; ++i)
+      arr[i] = v += (uint32_t) (next_random(&rng) % 16);
+
+    ipacked_t delta, frame;
+    ipacked_encode_u32(&delta, arr, IPACKED_DELTA);
+    ipacked_encode_u32(&frame, arr, IPACKED_FOR);
+
+    itest_check_uint_equal$(ipacked_length(&delta), N, "Length should be kept");
+    itest_check_uint_equal$(ipacked_blocks(&delta), (N + IPACKED_BLOCK - 1) / IPACKED_BLOCK, "Blocks should be counted");
+    itest_check_uint_equal$(mismatches_u32(&delta, arr), 0, "Deltas should be read back");
+    itest_check_uint_equal$(mismatches_u32(&frame, arr), 0, "Offsets should be read back");
+    itest_check_uint_equal$(ipacked_sum(&delta), sum_u32(arr), "Sum should be the same");
+
+    // Deltas of 4 values are below 64, offsets in a block go up to 2000
+    itest_check_uint_lt$(ipacked_bytes(&delta), N * sizeof(uint32_t) / 4, "Deltas should take 6 bits or so");
+    itest_check_uint_lt$(ipacked_bytes(&delta), ipacked_bytes(&frame), "Deltas should beat offsets");
+
+    uint32_t block[IPACKED_BLOCK];
+    size_t last = ipacked_blocks(&delta) - 1;
+    itest_check_uint_equal$(ipacked_block_u32(&delta, last, block), N % IPACKED_BLOCK, "Last block should be partial");
+    itest_check_uint_equal$(block[N % IPACKED_BLOCK - 1], arr[N - 1], "Last value should be unpacked");
+
+    ipacked_destroy(&delta);
+    ipacked_destroy(&frame);
+    ia_destroy_array(arr);
+  }
+
+  itest_case$("Unsorted deltas wrap around") {
+    ia_arr$(uint32_t) arr = ia_new_array_of$(N, uint32_t);
+    for (size_t i = 0; i < N; ++i)
+      arr[i] = i % 2 ? UINT32_MAX - (uint32_t) i : (uint32_t) i;
+
+    ipacked_t p;
+    ipacked_encode_u32(&p, arr, IPACKED_DELTA);
+    itest_check_uint_equal$(mismatches_u32(&p, arr), 0, "Values should be read back");
+    itest_check_uint_equal$(ipacked_sum(&p), sum_u32(arr), "Sum should be the same");
+    ipacked_destroy(&p);
+    ia_destroy_array(arr);
+  }
+
+  itest_case$("64-bit values") {
+    ia_arr$(uint64_t) arr = ia_new_array_of$(N, uint64_t);
+    uint64_t rng = 88172645463325252ull;
+    for (size_t i = 0; i < N; ++i)
+      // Timestamps, and then random values which do not pack
+      arr[i] = i < N / 2 ? 1700000000000000000ull + i * 1000 : next_random(&rng);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < N; ++i)
+      sum += arr[i];
+
+    ipacked_t p;
+    ipacked_encode_u64(&p, arr, IPACKED_DELTA);
+    itest_check_uint_equal$(p.blocks[0].bits, 12, "Deltas of 4000 should take 12 bits");
+    itest_check_uint_equal$(p.blocks[ipacked_blocks(&p) - 1].bits, 64, "Random values should be kept as they are");
+    itest_check_uint_equal$(mismatches_u64(&p, arr), 0, "Values should be read back");
+    itest_check_uint_equal$(ipacked_sum(&p), sum, "Sum should be the same");
+    ipacked_destroy(&p);
+
+    ipacked_encode_u64(&p, arr, IPACKED_FOR);
+    itest_check_uint_equal$(mismatches_u64(&p, arr), 0, "Offsets should be read back");
+    itest_check_uint_equal$(ipacked_sum(&p), sum, "Sum of offsets should be the same");
+
+    uint64_t block[IPACKED_BLOCK];
+    itest_check_uint_equal$(ipacked_block_u64(&p, 1, block), IPACKED_BLOCK, "Block should be full");
+    itest_check_uint_equal$(block[0], arr[IPACKED_BLOCK], "Block should be unpacked");
+    ipacked_destroy(&p);
+
+    ia_destroy_array(arr);
+  }
+
+  itest_case$("Empty and tiny arrays") {
+    ipacked_t p;
+    ia_arr$(uint32_t) none = ia_new_empty_array$(uint32_t);
+    ipacked_encode_u32(&p, none, IPACKED_DELTA);
+    itest_check_uint_equal$(ipacked_blocks(&p), 0, "Empty array should have no blocks");
+    itest_check_uint_equal$(ipacked_sum(&p), 0, "Empty array should sum to zero");
+    ia_arr$(uint32_t) copy = ipacked_to_u32(&p);
+    itest_check_uint_equal$(ia_length(copy), 0, "Empty array should be unpacked");
+    ia_destroy_array(copy);
+    ipacked_destroy(&p);
+
+    ia_push$(&none, 42);
+    ipacked_encode_u32(&p, none, IPACKED_FOR);
+    itest_check_uint_equal$(p.blocks[0].bits, 0, "Single value should take no bits");
+    itest_check_uint_equal$(mismatches_u32(&p, none), 0, "Single value should be read back");
+    ipacked_destroy(&p);
+    ia_destroy_array(none);
+  }
+}
@@ -0,0 +1,176 @@
+/**
+ * Bounded MPMC queue tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/ds/queue.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+/// Items pushed by each producer
+#define PER_PRODUCER 20000
+#define BATCH 7
+
+typedef struct {
+  uint32_t producer, n;
+} item_t;
+
+/// State of one run of producers and consumers, zeroed for each
+typedef struct {
+  iqueue_t queue;
+  _Atomic uint8_t seen[PRODUCERS][PER_PRODUCER];
+  /// Consumers which have found items of one producer out of order
+  atomic_int misordered;
+} run_t;
+
+typedef struct {
+  run_t* run;
+  uint32_t p;
+} producer_t;
+
+static void* produce(void* arg) {
+  run_t* run = ((producer_t*) arg)->run;
+  uint32_t p = ((producer_t*) arg)->p;
+  item_t batch[BATCH];
+  for (uint32_t n = 0; n < PER_PRODUCER;) {
+    // Odd producers push in batches
+    size_t k = p % 2 ? BATCH : 1;
+    if (k > PER_PRODUCER - n)
+      k = PER_PRODUCER - n;
+    for (size_t i = 0; i < k; ++i)
+      batch[i] = (item_t) { p, n + (uint32_t) i };
+    n += (uint32_t) iqueue_push_many(&run->queue, batch, k);
+  }
+  return NULL;
+}
+
+static void* consume(void* arg) {
+  run_t* run = arg;
+  // Items of each producer come in order of pushing
+  uint32_t next[PRODUCERS] = { 0 };
+  item_t batch[BATCH];
+  size_t k;
+  while ((k = iqueue_pop_many(&run->queue, batch, BATCH))) {
+    for (size_t i = 0; i < k; ++i) {
+      if (batch[i].n < next[batch[i].producer])
+        atomic_fetch_add(&run->misordered, 1);
+      next[batch[i].producer] = batch[i].n + 1;
+      atomic_fetch_add(&run->seen[batch[i].producer][batch[i].n], 1);
+    }
+  }
+  return NULL;
+}
+
+
+itest_section$("default, istd", "ISTD Bounded MPMC queue") {
+
+  itest_case$("Items come out in order") {
+    iqueue_t q;
+    iqueue_init_for$(&q, 5, int);
+    itest_check_uint_equal$(iqueue_capacity(&q), 8, "Capacity should be rounded up");
+
+    int x;
+    itest_check$(!iqueue_try_pop(&q, &x), "Empty queue should give nothing");
+
+    // Many laps around the ring
+    int pushed = 0, popped = 0;
+    for (int round = 0; round < 10; ++round) {
+      for (int i = 0; i < 8; ++i, ++pushed)
+        itest_check$(iqueue_try_push(&q, &pushed), "Push %d should fit", pushed);
+      itest_check$(!iqueue_try_push(&q, &pushed), "Full queue should refuse items");
+      itest_check_uint_equal$(iqueue_length(&q), 8, "Queue should be full");
+
+      for (int i = 0; i < 5; ++i, ++popped) {
+        itest_check$(iqueue_try_pop(&q, &x), "Pop should succeed");
+        itest_check_int_equal$(x, popped, "Items should be in order");
+      }
+      for (; popped < pushed; ++popped) {
+        iqueue_pop(&q, &x);
+        itest_check_int_equal$(x, popped, "Items should be in order");
+      }
+      itest_check_uint_equal$(iqueue_length(&q), 0, "Queue should be empty");
+    }
+
+    iqueue_destroy(&q);
+  }
+
+  itest_case$("Batches take what fits") {
+    iqueue_t q;
+    iqueue_init_for$(&q, 8, int64_t);
+
+    int64_t in[12], out[12] = { 0 };
+    for (int i = 0; i < 12; ++i)
+      in[i] = (int64_t) i * 1000000007;
+
+    itest_check_uint_equal$(iqueue_try_push_many(&q, in, 3), 3, "Batch should fit");
+    itest_check_uint_equal$(iqueue_try_push_many(&q, in + 3, 9), 5, "Only the room left should be taken");
+    itest_check_uint_equal$(iqueue_try_push_many(&q, in + 8, 4), 0, "Full queue should take nothing");
+
+    itest_check_uint_equal$(iqueue_try_pop_many(&q, out, 6), 6, "Batch should be popped");
+    itest_check_uint_equal$(iqueue_try_push_many(&q, in + 8, 4), 4, "Freed cells should be taken");
+    itest_check_uint_equal$(iqueue_pop_many(&q, out + 6, 12), 6, "Rest should be popped");
+    itest_check_uint_equal$(iqueue_try_pop_many(&q, out, 12), 0, "Empty queue should give nothing");
+
+    for (int i = 0; i < 12; ++i)
+      itest_check_int_equal$(out[i], in[i], "Item %d should match", i);
+
+    iqueue_destroy(&q);
+  }
+
+  itest_case$("Closed queue") {
+    iqueue_t q;
+    iqueue_init_for$(&q, 4, int);
+
+    int a = 1, b = 2, x = 0;
+    iqueue_push(&q, &a);
+    iqueue_push(&q, &b);
+    iqueue_close(&q);
+
+    itest_check$(!iqueue_push(&q, &a), "Closed queue should refuse items");
+    itest_check$(iqueue_pop(&q, &x) && x == 1, "Items should be left after closing");
+    itest_check$(iqueue_pop(&q, &x) && x == 2, "Items should be left after closing");
+    itest_check$(!iqueue_pop(&q, &x), "Closed empty queue should not wait");
+
+    iqueue_destroy(&q);
+  }
+
+  itest_case$("Many producers and consumers") {
+    // Fresh for each run, as sections may run many times
+    run_t* run = calloc(1, sizeof(run_t));
+    // Small queue, so threads often wait for each other
+    iqueue_init_for$(&run->queue, 16, item_t);
+
+    pthread_t producers[PRODUCERS], consumers[CONSUMERS];
+    producer_t args[PRODUCERS];
+    for (size_t i = 0; i < CONSUMERS; ++i)
+      pthread_create(&consumers[i], NULL, consume, run);
+    for (size_t i = 0; i < PRODUCERS; ++i) {
+      args[i] = (producer_t) { run, (uint32_t) i };
+      pthread_create(&producers[i], NULL, produce, &args[i]);
+    }
+
+    for (size_t i = 0; i < PRODUCERS; ++i)
+      pthread_join(producers[i], NULL);
+    iqueue_close(&run->queue);
+    for (size_t i = 0; i < CONSUMERS; ++i)
+      pthread_join(consumers[i], NULL);
+
+    size_t lost = 0, twice = 0;
+    for (size_t p = 0; p < PRODUCERS; ++p)
+      for (size_t n = 0; n < PER_PRODUCER; ++n) {
+        lost += !run->seen[p][n];
+        twice += run->seen[p][n] > 1;
+      }
+    itest_check_uint_equal$(lost, 0, "Every item should be popped");
+    itest_check_uint_equal$(twice, 0, "No item should be popped twice");
+    itest_check_int_equal$(atomic_load(&run->misordered), 0, "Each consumer should see items of a producer in order");
+    itest_check_uint_equal$(iqueue_length(&run->queue), 0, "Queue should be empty");
+
+    iqueue_destroy(&run->queue);
+    free(run);
+  }
+}
@@ -0,0 +1,168 @@
+/**
+ * Gap buffer and rope tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/ds/arr.h"
+#include "istd/ds/text.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define STR_AND_LEN(s) (s), (sizeof(s) - 1)
+
+/// Check that gap buffer contains given text
+static bool gap_equals(const itext_gap_t* gap, const char* expected) {
+  ia_arr$(char) text = ia_new_empty_array$(char);
+  itext_gap_copy(gap, &text);
+  bool eq = !strcmp(text, expected);
+  ia_destroy_array(text);
+  return eq;
+}
+
+/// Check that rope contains given text
+static bool rope_equals(const itext_rope_t* rope, const char* expected, size_t len) {
+  if (itext_rope_counts(rope).bytes != len)
+    return false;
+  ia_arr$(char) text = ia_new_empty_array$(char);
+  itext_rope_copy(rope, 0, len, &text);
+  bool eq = !memcmp(text, expected, len);
+  ia_destroy_array(text);
+  return eq;
+}
+
+itest_section$("default, istd", "ISTD Text containers") {
+
+  itest_case$("Gap buffer editing") {
+    itext_gap_t gap;
+    itext_gap_init(&gap, STR_AND_LEN("hello world"));
+
+    itest_check_uint_equal$(itext_gap_cursor(&gap), 11, "Cursor should be at the end");
+    itest_check_uint_equal$(itext_gap_length(&gap), 11, "Length should be the length of the text");
+
+    itext_gap_seek(&gap, 5);
+    itext_gap_insert(&gap, STR_AND_LEN(","));
+    itest_check$(gap_equals(&gap, "hello, world"), "Text should be inserted at the cursor");
+    itest_check_uint_equal$(itext_gap_cursor(&gap), 6, "Cursor should be after inserted text");
+
+    itext_gap_seek(&gap, 0);
+    itext_gap_insert(&gap, STR_AND_LEN("\xd0\x9f\xd1\x80\xd0\xb8, "));
+    itest_check$(gap_equals(&gap, "\xd0\x9f\xd1\x80\xd0\xb8, hello, world"), "Text should be inserted at the beginning");
+
+    itest_check_uint_equal$(itext_gap_erase_backward(&gap, 3), 3, "Three codepoints should be erased");
+    itest_check$(gap_equals(&gap, "\xd0\x9f\xd1\x80hello, world"), "Backspace should erase whole codepoints");
+
+    itext_gap_seek(&gap, 0);
+    itest_check_uint_equal$(itext_gap_erase_forward(&gap, 1), 1, "One codepoint should be erased");
+    itest_check$(gap_equals(&gap, "\xd1\x80hello, world"), "Delete should erase whole codepoints");
+    itest_check_uint_equal$(itext_gap_erase_backward(&gap, 1), 0, "Nothing is before the beginning");
+
+    itext_gap_destroy(&gap);
+  }
+
+  itest_case$("Gap buffer navigation and growth") {
+    itext_gap_t gap;
+    itext_gap_init(&gap, STR_AND_LEN("a\xd0\xb1\xe4\xb8\xad"));
+    itext_gap_seek(&gap, 0);
+
+    rune cp = 0;
+    itest_check$(itext_gap_forward(&gap, &cp) && cp == 'a', "First codepoint should be passed");
+    itest_check$(itext_gap_forward(&gap, &cp) && cp == 0x431, "Second codepoint should be passed");
+    itest_check$(itext_gap_forward(&gap, &cp) && cp == 0x4E2D, "Third codepoint should be passed");
+    itest_check$(!itext_gap_forward(&gap, &cp) && cp == 0, "End of text should be reported");
+    itest_check$(itext_gap_backward(&gap, &cp) && cp == 0x4E2D, "Moving back should decode codepoints");
+    itest_check_uint_equal$(itext_gap_cursor(&gap), 3, "Cursor should be before last codepoint");
+
+    for (size_t i = 0; i < 1000; ++i)
+      itext_gap_insert(&gap, STR_AND_LEN("xy"));
+    itest_check_uint_equal$(itext_gap_length(&gap), 2006, "Buffer should grow");
+    itest_check_uint_equal$(itext_gap_cursor(&gap), 2003, "Cursor should move while inserting");
+    itest_check$(itext_gap_forward(&gap, &cp) && cp == 0x4E2D, "Text after the cursor should be kept");
+
+    itext_gap_destroy(&gap);
+  }
+
+  itest_case$("Rope seeks") {
+    const char* text = "first line\nвторая строка\n\xe4\xb8\x89\n";
+    size_t len = strlen(text);
+    itext_rope_t rope;
+    itext_rope_init(&rope, text, len);
+
+    itext_counts_t c = itext_rope_counts(&rope);
+    itest_check_uint_equal$(c.bytes, len, "Bytes should be counted");
+    itest_check_uint_equal$(c.codepoints, 27, "Codepoints should be counted");
+    itest_check_uint_equal$(c.newlines, 3, "Newlines should be counted");
+
+    itest_check_uint_equal$(itext_rope_byte_of_line(&rope, 0), 0, "First line is at the beginning");
+    itest_check_uint_equal$(itext_rope_byte_of_line(&rope, 1), 11, "Second line begins after newline");
+    itest_check_uint_equal$(itext_rope_byte_of_line(&rope, 3), len, "Last line is after last newline");
+    itest_check_uint_equal$(itext_rope_byte_of_codepoint(&rope, 12), 13, "Cyrillic is two bytes long");
+
+    c = itext_rope_counts_before(&rope, 13);
+    itest_check_uint_equal$(c.codepoints, 12, "Codepoint index should be found");
+    itest_check_uint_equal$(c.newlines, 1, "Line index should be found");
+
+    rune cp = 0;
+    itest_check_uint_equal$(itext_rope_next(&rope, 11, &cp), 13, "Next should skip one codepoint");
+    itest_check_uint_equal$(cp, 0x432, "Next should decode codepoint");
+    itest_check_uint_equal$(itext_rope_prev(&rope, 13, &cp), 11, "Prev should skip one codepoint");
+    itest_check_uint_equal$(itext_rope_next(&rope, len, &cp), len, "Next at the end stays there");
+    itest_check_uint_equal$(cp, 0, "End of text is reported as zero");
+
+    itext_rope_destroy(&rope);
+  }
+
+  itest_case$("Rope random edits compared with an array") {
+    static const char* pieces[] = { "a", "\n", "\xd0\xb1", "\xe4\xb8\xad", "\xf0\x9f\x98\x80" };
+    ia_arr$(char) ref = ia_new_empty_array$(char);
+    itext_rope_t rope;
+    itext_rope_init(&rope, NULL, 0);
+    srand(1);
+
+    for (size_t round = 0; round < 3000; ++round) {
+
+      size_t len = ia_length(ref);
+      size_t ncp = itext_rope_counts(&rope).codepoints;
+      size_t pos = itext_rope_byte_of_codepoint(&rope, ncp ? (size_t) rand() % (ncp + 1) : 0);
+
+      if (rand() % 3 || len == 0) {
+        // Insert a few random pieces, sometimes a lot of them
+        ia_arr$(char) ins = ia_new_empty_array$(char);
+        size_t n = rand() % 20 ? (size_t) rand() % 8 + 1 : 700;
+        for (size_t i = 0; i < n; ++i) {
+          const char* p = pieces[rand() % 5];
+          ia_append$(&ins, p, strlen(p));
+        }
+
+        itext_rope_insert(&rope, pos, ins, ia_length(ins));
+        ia_append$(&ref, ins, ia_length(ins));
+        memmove(ref + pos + ia_length(ins), ref + pos, len - pos);
+        memcpy(ref + pos, ins, ia_length(ins));
+        ia_destroy_array(ins);
+      } else {
+        size_t end_cp = itext_rope_counts_before(&rope, pos).codepoints + (size_t) rand() % 40;
+        size_t end = itext_rope_byte_of_codepoint(&rope, end_cp < ncp ? end_cp : ncp);
+
+        itext_rope_delete(&rope, pos, end - pos);
+        memmove(ref + pos, ref + end, len - end);
+        ia_truncate$(&ref, len - (end - pos));
+      }
+
+      if (!rope_equals(&rope, ref, ia_length(ref))) {
+        itest_fail$("Rope should match the array after round %zu", round);
+        break;
+      }
+    }
+
+    itext_counts_t c = itext_rope_counts(&rope);
+    size_t newlines = 0, codepoints = 0;
+    for (size_t i = 0; i < ia_length(ref); ++i) {
+      newlines += ref[i] == '\n';
+      codepoints += ((uint8_t) ref[i] >> 6) != 2;
+    }
+    itest_check_uint_equal$(c.newlines, newlines, "Newline count should be kept up to date");
+    itest_check_uint_equal$(c.codepoints, codepoints, "Codepoint count should be kept up to date");
+
+    itext_rope_destroy(&rope);
+    ia_destroy_array(ref);
+  }
+}
@@ -0,0 +1,110 @@
+/**
+ * Loading many files tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/io/loader.h"
+#include "istd/ds/arr.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Number of files, more than a batch of them
+#define FILES 300
+
+/// Size of each file: a few around page size, many small, one large
+static size_t size_of(size_t i) {
+  static const size_t sizes[] = { 0, 1, 4095, 4096, 4097, 1 << 20 };
+  return i < sizeof(sizes) / sizeof(sizes[0]) ? sizes[i] : 10 + i * 37 % 2000;
+}
+
+static char byte_of(size_t file, size_t at) {
+  return (char) ('a' + (file + at) % 26);
+}
+
+/// Check loaded files made by the test, and return number of wrong ones
+static size_t check_files(const iloader_file_t* files) {
+  size_t wrong = 0;
+  for (size_t i = 0; i < FILES; ++i) {
+    const char* data = files[i].data;
+    size_t size = size_of(i);
+    if (files[i].error || !data || ia_length(data) != size || ia_avail(data) != size || data[size]) {
+      wrong++;
+      continue;
+    }
+    for (size_t at = 0; at < size; ++at)
+      if (data[at] != byte_of(i, at)) {
+        wrong++;
+        break;
+      }
+  }
+  return wrong;
+}
+
+
+itest_section$("default, istd", "ISTD Loading files") {
+
+  char dir[] = "/tmp/istd-loader-XXXXXX";
+  itest_check$(mkdtemp(dir), "Should make temporary directory");
+  itest_die_if_something_failed$();
+
+  // Files, then a missing one and a directory
+  char* paths[FILES + 2];
+  char* buffer = malloc(size_of(5));
+  for (size_t i = 0; i < FILES + 2; ++i) {
+    paths[i] = malloc(64);
+    snprintf(paths[i], 64, "%s/%zu", dir, i);
+    if (i >= FILES)
+      continue;
+    for (size_t at = 0; at < size_of(i); ++at)
+      buffer[at] = byte_of(i, at);
+    FILE* f = fopen(paths[i], "wb");
+    fwrite(buffer, 1, size_of(i), f);
+    fclose(f);
+  }
+  mkdir(paths[FILES + 1], 0700);
+  free(buffer);
+
+  iloader_file_t files[FILES + 2];
+  const char* const* names = (const char* const*) paths;
+
+  itest_case$("Loading with io_uring") {
+    if (iloader_load(names, FILES + 2, files, ILOADER_URING)) {
+      itest_check_uint_equal$(check_files(files), 0, "Files should be read with exact sizes");
+      itest_check_int_equal$(files[FILES].error, ENOENT, "Missing file should not be read");
+      itest_check_ptr_null$(files[FILES].data, "Missing file should have no data");
+      itest_check_int_equal$(files[FILES + 1].error, EISDIR, "Directory should not be read");
+      itest_check_ptr_null$(files[FILES + 1].data, "Directory should have no data");
+      iloader_release(files, FILES + 2);
+    } else
+      itest_check$(errno, "Kernel without io_uring should be told by errno");
+  }
+
+  itest_case$("Loading with threads") {
+    itest_check$(iloader_load(names, FILES + 2, files, ILOADER_THREADS), "Files should be loaded");
+    itest_check_uint_equal$(check_files(files), 0, "Files should be read with exact sizes");
+    itest_check_int_equal$(files[FILES].error, ENOENT, "Missing file should not be read");
+    itest_check_ptr_null$(files[FILES].data, "Missing file should have no data");
+    itest_check_int_equal$(files[FILES + 1].error, EISDIR, "Directory should not be read");
+    itest_check_ptr_null$(files[FILES + 1].data, "Directory should have no data");
+    iloader_release(files, FILES + 2);
+  }
+
+  itest_case$("Loading few files") {
+    itest_check$(iloader_load(names, 0, files, ILOADER_AUTO), "No files should be loaded");
+    itest_check$(iloader_load(names + 2, 1, files, ILOADER_AUTO), "One file should be loaded");
+    itest_check_uint_equal$(ia_length(files[0].data), size_of(2), "File should be read");
+    iloader_release(files, 1);
+    itest_check_ptr_null$(files[0].data, "Released file should have no data");
+  }
+
+  for (size_t i = 0; i < FILES; ++i)
+    unlink(paths[i]);
+  rmdir(paths[FILES + 1]);
+  rmdir(dir);
+  for (size_t i = 0; i < FILES + 2; ++i)
+    free(paths[i]);
+}
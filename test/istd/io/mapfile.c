@@ -0,0 +1,138 @@
+/**
+ * Mapped files tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/io/mapfile.h"
+#include "istd/util/utf8.h"
+#include "istd/ds/arr.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/// Write `len` bytes into a new temporary file, and put its path into `path`
+static bool write_temp(char* path, const char* bytes, size_t len) {
+  strcpy(path, "/tmp/istd-mapfile-XXXXXX");
+  int fd = mkstemp(path);
+  if (fd < 0)
+    return false;
+  bool ok = write(fd, bytes, len) == (ssize_t) len;
+  close(fd);
+  return ok;
+}
+
+/// Check that records of `bytes` are the ones found with `memchr()`,
+/// and return number of wrong ones
+static size_t check_records(const char* bytes, size_t len, char sep) {
+  size_t wrong = 0;
+  const char* begin = bytes;
+  const char* end = bytes + len;
+
+  imapfile_span_t span;
+  imapfile_iter_t it = imapfile_records(bytes, len, sep, false);
+  while (begin < end) {
+    const char* at = memchr(begin, sep, (size_t) (end - begin));
+    size_t expected = at ? (size_t) (at - begin) : (size_t) (end - begin);
+    if (!imapfile_next(&it, &span) || span.ptr != begin || span.len != expected)
+      return wrong + 1;
+    begin += expected + 1;
+  }
+  wrong += imapfile_next(&it, &span);
+  return wrong;
+}
+
+
+itest_section$("default, istd, simd", "ISTD Mapped files") {
+
+  itest_case$("Lines of a file") {
+    // Lines of all lengths up to 200, so they end everywhere in blocks
+    ia_arr$(char) text = ia_new_empty_array$(char);
+    for (size_t n = 0; n <= 200; ++n) {
+      for (size_t i = 0; i < n; ++i)
+        ia_push$(&text, (char) ('a' + i % 26));
+      ia_push$(&text, '\n');
+    }
+    ia_append$(&text, "last", 4);
+
+    char path[64];
+    itest_check$(write_temp(path, text, ia_length(text)), "Should write temporary file");
+    itest_die_if_something_failed$();
+
+    imapfile_t f;
+    itest_check$(imapfile_open(&f, path), "File should be opened");
+    itest_die_if_something_failed$();
+    itest_check_uint_equal$(f.size, ia_length(text), "Whole file should be mapped");
+    itest_check$(!memcmp(f.data, text, f.size), "Mapped bytes should be the ones of the file");
+
+    size_t lines = 0, wrong = 0;
+    imapfile_span_t line;
+    for (imapfile_iter_t it = imapfile_lines(&f, false); imapfile_next(&it, &line); ++lines)
+      wrong += lines <= 200 ? line.len != lines : line.len != 4 || memcmp(line.ptr, "last", 4);
+    itest_check_uint_equal$(lines, 202, "All lines should be found, with the last one");
+    itest_check_uint_equal$(wrong, 0, "Lines should have their lengths");
+
+    imapfile_close(&f);
+    unlink(path);
+    ia_destroy_array(text);
+  }
+
+  itest_case$("Records of any bytes") {
+    char bytes[1000];
+    for (size_t i = 0; i < sizeof(bytes); ++i)
+      bytes[i] = (char) ('0' + i % 10);
+    // Separators on both sides of block boundaries, next to each other
+    static const size_t seps[] = { 0, 1, 62, 63, 64, 65, 127, 128, 300, 301, 302, 999 };
+    for (size_t i = 0; i < sizeof(seps) / sizeof(seps[0]); ++i)
+      bytes[seps[i]] = ',';
+
+    itest_check_uint_equal$(check_records(bytes, sizeof(bytes), ','), 0, "Records should be found");
+    itest_check_uint_equal$(check_records(bytes, 64, ','), 0, "Records of one block should be found");
+    itest_check_uint_equal$(check_records(bytes + 2, 500, ','), 0, "Records of unaligned bytes should be found");
+    itest_check_uint_equal$(check_records(bytes, 130, 'x'), 0, "Bytes without separators should be one record");
+    itest_check_uint_equal$(check_records(",,,", 3, ','), 0, "Separators alone should make empty records");
+    itest_check_uint_equal$(check_records("", 0, ','), 0, "No bytes should make no records");
+  }
+
+  itest_case$("Checking UTF8") {
+    const char* text_ok = "Съешь 中文 \xF0\x9F\x98\x80";
+    itest_check$(utf8_valid("plain", 5), "ASCII should be valid");
+    itest_check$(utf8_valid(text_ok, strlen(text_ok)), "Text should be valid");
+    itest_check$(utf8_valid("a\0b", 3), "Zero bytes should be valid");
+    itest_check$(!utf8_valid("\xD0", 1), "Cut codepoint should be invalid");
+    itest_check$(!utf8_valid("\x80", 1), "Lone continuation should be invalid");
+    itest_check$(!utf8_valid("\xC0\xAF", 2), "Overlong codepoint should be invalid");
+    itest_check$(!utf8_valid("\xE0\x80\xAF", 3), "Overlong codepoint should be invalid");
+    itest_check$(!utf8_valid("\xED\xA0\x80", 3), "Surrogate should be invalid");
+    itest_check$(!utf8_valid("\xF4\x90\x80\x80", 4), "Codepoint past U+10FFFF should be invalid");
+    itest_check$(!utf8_valid("\xFF", 1), "Byte 0xFF should be invalid");
+    itest_check$(!utf8_valid("0123456789abcdefghijklmnopqrstu\xC3", 32), "Bad byte after long ASCII should be found");
+
+    const char text[] = "good\nbad \xC3\x28\nstill good, ещё\n\xFF\nend";
+    size_t count = 0;
+    imapfile_span_t line;
+    imapfile_iter_t it = imapfile_records(text, sizeof(text) - 1, '\n', true);
+    while (imapfile_next(&it, &line))
+      count++;
+    itest_check_uint_equal$(count, 3, "Valid lines should be given");
+    itest_check_uint_equal$(it.invalid, 2, "Invalid lines should be counted");
+  }
+
+  itest_case$("Missing and empty files") {
+    imapfile_t f;
+    errno = 0;
+    itest_check$(!imapfile_open(&f, "/nonexistent/istd/file"), "Missing file should not be opened");
+    itest_check_int_equal$(errno, ENOENT, "Error should be kept in errno");
+
+    char path[64];
+    itest_check$(write_temp(path, "", 0), "Should write temporary file");
+    itest_check$(imapfile_open(&f, path), "Empty file should be opened");
+    itest_check_uint_equal$(f.size, 0, "Empty file should have no bytes");
+    imapfile_span_t line;
+    imapfile_iter_t it = imapfile_lines(&f, true);
+    itest_check$(!imapfile_next(&it, &line), "Empty file should have no lines");
+    imapfile_close(&f);
+    unlink(path);
+  }
+}
@@ -0,0 +1,70 @@
+/**
+ * Allocation accounting tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/util/alloc.h"
+#include "istd/util/utf8_search.h"
+#include "istd/ds/arr.h"
+#include "istd/ds/text.h"
+#include <string.h>
+
+itest_section$("default, istd", "ISTD Allocation accounting") {
+
+  itest_case$("Counters follow allocations") {
+    istd_alloc_stats_t before = istd_alloc_stats();
+
+    void* a = istd_malloc(100);
+    void* b = istd_calloc(10, 10);
+    istd_alloc_stats_t during = istd_alloc_stats();
+
+    itest_check_uint_equal$(during.allocs - before.allocs, 2, "Both allocations should be counted");
+    itest_check_uint_equal$(during.live_blocks - before.live_blocks, 2, "Both blocks should be live");
+    itest_check_uint_ge$(during.live_bytes - before.live_bytes, 200, "At least requested size should be counted");
+    itest_check_uint_ge$(_itest_case_peak_bytes(), 200, "Peak should include both blocks");
+
+    a = istd_realloc(a, 1000);
+    istd_free(a);
+    istd_free(b);
+    istd_alloc_stats_t after = istd_alloc_stats();
+
+    itest_check_uint_equal$(after.frees - before.frees, 3, "Frees and reallocation should be counted");
+    itest_check_uint_equal$(after.live_blocks, before.live_blocks, "Nothing should be left");
+    itest_check_uint_equal$(after.live_bytes, before.live_bytes, "Nothing should be left");
+    itest_check_uint_ge$(_itest_case_peak_bytes(), 1000, "Peak should include reallocated block");
+  }
+
+  itest_case$("Budgets of array operations") {
+    ia_arr$(int) arr = ia_new_array_for$(16, int);
+    itest_check_allocs_le$(1, "Array should be allocated once");
+
+    for (int i = 0; i < 16; ++i)
+      ia_push$(&arr, i);
+    itest_check_allocs_le$(1, "Pushing into preallocated space should not allocate");
+
+    ia_push$(&arr, 16);
+    itest_check_allocs_le$(2, "Growing should take one reallocation");
+
+    ia_destroy_array(arr);
+  }
+
+  itest_case$("Search does not allocate") {
+    const char* hay = "one two three four five six seven";
+    itest_check_ptr_notnull$(utf8_find(hay, strlen(hay), "six", 3), "Needle should be found");
+    itest_check_allocs_le$(0, "Search should not allocate");
+  }
+
+  itest_case$("Rope frees all of its memory") {
+    istd_alloc_stats_t before = istd_alloc_stats();
+    itext_rope_t rope;
+    itext_rope_init(&rope, NULL, 0);
+    for (size_t i = 0; i < 100; ++i)
+      itext_rope_insert(&rope, 0, "some text to insert ", 20);
+    itext_rope_delete(&rope, 100, 1000);
+    itext_rope_destroy(&rope);
+
+    istd_alloc_stats_t after = istd_alloc_stats();
+    itest_check_uint_equal$(after.live_blocks, before.live_blocks, "All nodes should be freed");
+    itest_check_uint_le$(_itest_case_peak_bytes(), 16 * 1024, "Rope should not take much more than its text");
+  }
+}
@@ -0,0 +1,52 @@
+/**
+ * CPU detection and dispatch tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/util/cpu.h"
+#include <string.h>
+
+static int version_scalar(int x) { return x; }
+static int version_sse42(int x) { return x + 1; }
+static int version_avx512(int x) { return x + 3; }
+
+// No AVX2 version, so AVX2 level takes SSE4.2 one
+icpu_dispatch$(versioned, int, (int x),
+               version_scalar, version_sse42, NULL, version_avx512)
+
+itest_section$("default, istd", "ISTD CPU dispatch") {
+
+  itest_case$("Levels follow features") {
+    const icpu_features_t* f = icpu_features();
+    icpu_level_t detected = icpu_detected_level();
+
+    itest_check_uint_le$(icpu_level(), detected, "Current level should not exceed detected one");
+    if (detected >= ICPU_SSE42)
+      itest_check$(f->ssse3 && f->sse42 && f->popcnt, "SSE4.2 level needs SSE4.2 features");
+    if (detected >= ICPU_AVX2)
+      itest_check$(f->avx && f->avx2 && f->bmi2, "AVX2 level needs AVX2 features");
+    if (detected >= ICPU_AVX512)
+      itest_check$(f->avx512f && f->avx512bw, "AVX-512 level needs AVX-512 features");
+#if defined(__x86_64__)
+    itest_check$(f->sse2, "x86-64 always has SSE2");
+#endif
+
+    itest_check$(!strcmp(icpu_level_name(ICPU_SCALAR), "scalar"), "Name of scalar level");
+    itest_check$(!strcmp(icpu_level_name(ICPU_AVX512), "avx512"), "Name of AVX-512 level");
+  }
+
+  itest_case$("Functions follow the level") {
+    icpu_level_t before = icpu_level();
+    int expected[ICPU_LEVELS] = { 10, 11, 11, 13 };
+
+    for (int l = 0; l < ICPU_LEVELS; ++l) {
+      icpu_level_t set = icpu_set_level((icpu_level_t) l);
+      itest_check_uint_le$(set, icpu_detected_level(), "Level should be limited by CPU");
+      itest_check_uint_equal$(icpu_level(), set, "Level should be set");
+      itest_check_int_equal$(versioned(10), expected[set], "Version for level %s should be called",
+                             icpu_level_name(set));
+    }
+
+    icpu_set_level(before);
+  }
+}
@@ -0,0 +1,182 @@
+/**
+ * Logging tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/util/log.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/// Open an empty temporary file
+static int open_temp(char* path) {
+  strcpy(path, "/tmp/istd-log-XXXXXX");
+  return mkstemp(path);
+}
+
+/// Read whole file, result should be freed with `free()`
+static char* read_all(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file)
+    return NULL;
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char* text = calloc((size_t) size + 1, 1);
+  size_t read = fread(text, 1, (size_t) size, file);
+  text[read] = '\0';
+  fclose(file);
+  return text;
+}
+
+static size_t count_lines(const char* text, const char* needle) {
+  size_t n = 0;
+  for (const char* line = text; (line = strstr(line, needle)); line += strlen(needle))
+    ++n;
+  return n;
+}
+
+static void* log_in_thread(void* arg) {
+  for (int i = 0; i < 1000; ++i)
+    ilog_info$("thread %d message %d", *(int*) arg, i);
+  return NULL;
+}
+
+itest_section$("default, istd", "ISTD Logging") {
+
+  itest_case$("Arguments are formatted like printf") {
+    char path[32];
+    int fd = open_temp(path);
+    itest_check$(fd >= 0, "Should create temporary file");
+
+    const char* str = "text";
+    void* ptr = &fd;
+
+    ilog_start(fd);
+    ilog_warn$("%d %s %5.2f %zu %p %c %x %lld %*d %-6s| %Lg %%",
+               -42, str, 3.14159, (size_t) 7, ptr, 'z', 255u, 1ll << 40, 4, 9, "ab", 2.5L);
+    // Copied when logged, not when written
+    char changing[8] = "before";
+    ilog_error$("%s", changing);
+    strcpy(changing, "after");
+    ilog_stop();
+    close(fd);
+
+    char expected[256];
+    snprintf(expected, sizeof(expected), "%d %s %5.2f %zu %p %c %x %lld %*d %-6s| %Lg %%\n",
+             -42, str, 3.14159, (size_t) 7, ptr, 'z', 255u, 1ll << 40, 4, 9, "ab", 2.5L);
+
+    char* text = read_all(path);
+    itest_check_ptr_notnull$(text, "Should read the log");
+    itest_check_ptr_notnull$(strstr(text, expected), "Log should have `%s`", expected);
+    itest_check_ptr_notnull$(strstr(text, "[warn] "), "Level should be written");
+    itest_check_ptr_notnull$(strstr(text, "[error] "), "Level should be written");
+    itest_check_ptr_notnull$(strstr(text, ": before\n"), "String should be copied");
+    itest_check_ptr_notnull$(strstr(text, "test/istd/util/log.c"), "Location should be written");
+    free(text);
+    unlink(path);
+  }
+
+  itest_case$("Strings are read only up to precision") {
+    char path[32];
+    int fd = open_temp(path);
+    itest_check$(fd >= 0, "Should create temporary file");
+
+    // Spans of a buffer, without `\0` after them
+    char* span = malloc(4);
+    memcpy(span, "abcd", 4);
+
+    ilog_start(fd);
+    ilog_info$("star [%.*s]", 4, span);
+    ilog_info$("digits [%.3s]", span);
+    ilog_info$("padded [%6.*s]", 2, span);
+    ilog_stop();
+    close(fd);
+    free(span);
+
+    char* text = read_all(path);
+    itest_check_ptr_notnull$(text, "Should read the log");
+    itest_check_ptr_notnull$(strstr(text, "star [abcd]\n"), "Precision from arguments should be kept");
+    itest_check_ptr_notnull$(strstr(text, "digits [abc]\n"), "Written precision should be kept");
+    itest_check_ptr_notnull$(strstr(text, "padded [    ab]\n"), "Width should be kept with precision");
+    free(text);
+    unlink(path);
+  }
+
+  itest_case$("Long arguments are written whole") {
+    char path[32];
+    int fd = open_temp(path);
+    itest_check$(fd >= 0, "Should create temporary file");
+
+    // Longer than any small buffer, and within `ILOG_MAX_STRING`
+    char long_str[901];
+    for (size_t i = 0; i < 900; ++i)
+      long_str[i] = (char) ('a' + i % 26);
+    long_str[900] = '\0';
+
+    ilog_start(fd);
+    ilog_info$("long [%s]", long_str);
+    ilog_info$("wide [%*d]", 700, 42);
+    ilog_stop();
+    close(fd);
+
+    char expected[1024];
+    snprintf(expected, sizeof(expected), "long [%s]\n", long_str);
+    char* text = read_all(path);
+    itest_check_ptr_notnull$(text, "Should read the log");
+    itest_check_ptr_notnull$(strstr(text, expected), "Long string should be written whole");
+    snprintf(expected, sizeof(expected), "wide [%700d]\n", 42);
+    itest_check_ptr_notnull$(strstr(text, expected), "Wide number should be written whole");
+    free(text);
+    unlink(path);
+  }
+
+  itest_case$("Messages of all threads are written") {
+    char path[32];
+    int fd = open_temp(path);
+    itest_check$(fd >= 0, "Should create temporary file");
+
+    size_t dropped = ilog_dropped();
+    ilog_start(fd);
+
+    pthread_t threads[4];
+    int ids[4];
+    for (int i = 0; i < 4; ++i) {
+      ids[i] = i;
+      pthread_create(&threads[i], NULL, log_in_thread, &ids[i]);
+    }
+    for (int i = 0; i < 4; ++i)
+      pthread_join(threads[i], NULL);
+
+    ilog_stop();
+    close(fd);
+
+    char* text = read_all(path);
+    itest_check_ptr_notnull$(text, "Should read the log");
+    itest_check_uint_equal$(count_lines(text, " message ") + ilog_dropped() - dropped, 4000,
+                            "Every message should be written or dropped");
+    itest_check_ptr_notnull$(strstr(text, "thread 3 message 0\n"), "Message should be written");
+    free(text);
+    unlink(path);
+  }
+
+  itest_case$("Flush writes pending messages") {
+    char path[32];
+    int fd = open_temp(path);
+    itest_check$(fd >= 0, "Should create temporary file");
+
+    ilog_start(fd);
+    ilog_info$("flushed %d", 1);
+    ilog_flush();
+
+    char* text = read_all(path);
+    itest_check_ptr_notnull$(strstr(text, "flushed 1\n"), "Message should be written by flush");
+    free(text);
+
+    ilog_stop();
+    close(fd);
+    unlink(path);
+  }
+}
@@ -0,0 +1,249 @@
+/**
+ * Coroutine and event loop tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/util/coro.h"
+#include "istd/util/loop.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define MESSAGES 100
+
+//---- Plain coroutine
+
+typedef struct {
+  icoro_t co;
+  int i, j;
+} pairs_t;
+
+/// Gives pairs (i, j) with j < i < n, one per call
+static void pairs(pairs_t* f, int n, int* out) {
+  icoro$(&f->co) {
+    for (f->i = 0; f->i < n; ++f->i)
+      for (f->j = 0; f->j < f->i; ++f->j) {
+        *out = f->i * 10 + f->j;
+        icoro_yield$(&f->co);
+      }
+  }
+}
+
+//---- Tasks
+
+typedef struct {
+  iloop_task_t task;
+  int fd;
+  char buf[64];
+  ssize_t got, sent;
+  int count;
+} echo_t;
+
+/// Sends back everything it reads, until the other side closes
+static void echo_server(iloop_task_t* task) {
+  echo_t* e = (echo_t*) task;
+  icoro$(&task->co) {
+    for (;;) {
+      iloop_wait_fd$(task, e->fd, ILOOP_READ);
+      e->got = read(e->fd, e->buf, sizeof(e->buf));
+      if (e->got <= 0 || write(e->fd, e->buf, (size_t) e->got) != e->got)
+        break;
+      e->count++;
+    }
+  }
+}
+
+/// Sends numbered messages, and checks that they come back
+static void echo_client(iloop_task_t* task) {
+  echo_t* e = (echo_t*) task;
+  icoro$(&task->co) {
+    for (e->count = 0; e->count < MESSAGES; ++e->count) {
+      iloop_wait_fd$(task, e->fd, ILOOP_WRITE);
+      // Locals do not survive waits, so the message is kept in the frame
+      e->sent = snprintf(e->buf, sizeof(e->buf), "message %d", e->count);
+      if (write(e->fd, e->buf, (size_t) e->sent) != e->sent)
+        icoro_return$(&task->co);
+
+      iloop_wait_fd$(task, e->fd, ILOOP_READ);
+      char reply[64];
+      e->got = read(e->fd, reply, sizeof(reply));
+      if (e->got != e->sent || memcmp(reply, e->buf, (size_t) e->sent))
+        icoro_return$(&task->co);
+    }
+    close(e->fd);
+  }
+}
+
+typedef struct {
+  iloop_task_t task;
+  uint64_t ns;
+  int* order;
+  int* next;
+  int id;
+} sleeper_t;
+
+static void sleeper(iloop_task_t* task) {
+  sleeper_t* s = (sleeper_t*) task;
+  icoro$(&task->co) {
+    iloop_sleep$(task, s->ns);
+    s->order[(*s->next)++] = s->id;
+  }
+}
+
+typedef struct {
+  iloop_task_t task;
+  int id, step;
+  char* log;
+  size_t* len;
+  /// Task woken after each step, may be NULL
+  iloop_task_t* partner;
+} stepper_t;
+
+/// Writes its id on each step, and lets others run in between
+static void stepper(iloop_task_t* task) {
+  stepper_t* s = (stepper_t*) task;
+  icoro$(&task->co) {
+    for (s->step = 0; s->step < 3; ++s->step) {
+      s->log[(*s->len)++] = (char) ('a' + s->id);
+      iloop_yield$(task);
+    }
+  }
+}
+
+/// Waits to be woken three times
+static void parked(iloop_task_t* task) {
+  stepper_t* s = (stepper_t*) task;
+  icoro$(&task->co) {
+    for (s->step = 0; s->step < 3; ++s->step) {
+      iloop_park$(task);
+      s->log[(*s->len)++] = 'p';
+    }
+  }
+}
+
+/// Wakes its partner on each step
+static void waker(iloop_task_t* task) {
+  stepper_t* s = (stepper_t*) task;
+  icoro$(&task->co) {
+    for (s->step = 0; s->step < 3; ++s->step) {
+      s->log[(*s->len)++] = 'w';
+      iloop_wake(s->partner);
+      iloop_yield$(task);
+    }
+  }
+}
+
+
+itest_section$("default, istd", "ISTD Coroutines and event loop") {
+
+  itest_case$("Coroutine resumes where it yielded") {
+    pairs_t f = { .co = ICORO_INIT };
+    int out = -1, expected[] = { 10, 20, 21, 30, 31, 32 };
+
+    for (size_t k = 0; k < 6; ++k) {
+      pairs(&f, 4, &out);
+      itest_check$(!icoro_done(&f.co), "Coroutine should not be done after %zu values", k);
+      itest_check_int_equal$(out, expected[k], "Value %zu should be given", k);
+    }
+
+    pairs(&f, 4, &out);
+    itest_check$(icoro_done(&f.co), "Coroutine should be done");
+    pairs(&f, 4, &out);
+    itest_check$(icoro_done(&f.co), "Done coroutine should stay done");
+
+    icoro_init(&f.co);
+    pairs(&f, 4, &out);
+    itest_check_int_equal$(out, 10, "Restarted coroutine should begin again");
+  }
+
+  itest_case$("Tasks take turns") {
+    iloop_t loop;
+    iloop_init(&loop);
+
+    char log[16] = { 0 };
+    size_t len = 0;
+    stepper_t a = { .id = 0, .log = log, .len = &len };
+    stepper_t b = { .id = 1, .log = log, .len = &len };
+    iloop_spawn(&loop, &a.task, stepper);
+    iloop_spawn(&loop, &b.task, stepper);
+
+    itest_check_uint_equal$(iloop_run(&loop), 0, "All tasks should be done");
+    itest_check$(!strcmp(log, "ababab"), "Tasks should alternate, not \"%s\"", log);
+
+    iloop_destroy(&loop);
+  }
+
+  itest_case$("Parked tasks are woken by others") {
+    iloop_t loop;
+    iloop_init(&loop);
+
+    char log[16] = { 0 };
+    size_t len = 0;
+    stepper_t p = { .log = log, .len = &len };
+    stepper_t w = { .log = log, .len = &len, .partner = &p.task };
+    iloop_spawn(&loop, &p.task, parked);
+    iloop_spawn(&loop, &w.task, waker);
+
+    itest_check_uint_equal$(iloop_run(&loop), 0, "All tasks should be done");
+    itest_check$(!strcmp(log, "wpwpwp"), "Parked task should run after waker, not \"%s\"", log);
+
+    iloop_wake(&p.task);
+    itest_check_uint_equal$(iloop_run(&loop), 0, "Waking a done task should do nothing");
+    itest_check_uint_equal$(len, 6, "Done task should not run again");
+
+    // Nobody is left to wake it
+    stepper_t lonely = { .log = log, .len = &len };
+    iloop_spawn(&loop, &lonely.task, parked);
+    itest_check_uint_equal$(iloop_run(&loop), 1, "Parked task should be reported");
+
+    iloop_destroy(&loop);
+  }
+
+  itest_case$("Timers fire in order of deadlines") {
+    iloop_t loop;
+    iloop_init(&loop);
+
+    enum { N = 5 };
+    uint64_t delays_ms[N] = { 30, 10, 0, 20, 10 };
+    int order[N], next = 0;
+    sleeper_t s[N];
+    for (int i = 0; i < N; ++i) {
+      s[i] = (sleeper_t) { .ns = delays_ms[i] * 1000000, .order = order, .next = &next, .id = i };
+      iloop_spawn(&loop, &s[i].task, sleeper);
+    }
+
+    uint64_t start = iloop_now();
+    itest_check_uint_equal$(iloop_run(&loop), 0, "All tasks should be done");
+    uint64_t took = iloop_now() - start;
+
+    int expected[N] = { 2, 1, 4, 3, 0 };
+    for (int i = 0; i < N; ++i)
+      itest_check_int_equal$(order[i], expected[i], "Task %d should wake up in order", i);
+    itest_check_uint_ge$(took, 30000000, "Loop should run until the last deadline");
+    itest_check_uint_lt$(took, 1000000000, "Loop should not wait much longer");
+
+    iloop_destroy(&loop);
+  }
+
+  itest_case$("Echo over a socket pair") {
+    int fds[2];
+    itest_check_int_equal$(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0, "Should create sockets");
+    itest_die_if_something_failed$();
+
+    iloop_t loop;
+    iloop_init(&loop);
+
+    echo_t server = { .fd = fds[0] }, client = { .fd = fds[1] };
+    iloop_spawn(&loop, &server.task, echo_server);
+    iloop_spawn(&loop, &client.task, echo_client);
+
+    itest_check_uint_equal$(iloop_run(&loop), 0, "All tasks should be done");
+    itest_check_int_equal$(client.count, MESSAGES, "All replies should match");
+    itest_check_int_equal$(server.count, MESSAGES, "All messages should be echoed");
+    itest_check_uint_equal$(loop.waiting_fds, 0, "No task should be waiting");
+
+    close(fds[0]);
+    iloop_destroy(&loop);
+  }
+}
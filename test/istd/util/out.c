@@ -0,0 +1,79 @@
+/**
+ * Buffered output tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/util/out.h"
+#include "istd/util/tty.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/// Read what is available in a pipe, as a string
+static size_t read_pipe(int fd, char* buf, size_t size) {
+  ssize_t n = read(fd, buf, size - 1);
+  buf[n > 0 ? n : 0] = '\0';
+  return n > 0 ? (size_t) n : 0;
+}
+
+itest_section$("default, istd", "ISTD Buffered output") {
+
+  itest_case$("Escape codes are stripped") {
+    char text[] = ESC_RED "red" ESC_RESET " and " ESC_BOLD ESC_GREEN "bold" ESC_RESET "\x1b" "c!";
+    size_t len = iout_strip_escapes(text, strlen(text));
+    text[len] = '\0';
+    itest_check$(!strcmp(text, "red and bold!"), "Text is `%s`", text);
+  }
+
+  itest_case$("Output is buffered until flushed") {
+    int fds[2];
+    itest_check$(!pipe(fds), "Should create a pipe");
+
+    iout_t out;
+    iout_init(&out, fds[1]);
+    itest_check$(!out.colors, "Pipe is not a terminal");
+    itest_check$(!out.line_buffered, "Pipe is not a terminal");
+
+    iout_puts(&out, ESC_GREEN "ok" ESC_RESET "\n");
+    // Escape code split between writes
+    iout_write(&out, "\x1b[9", 3);
+    iout_printf(&out, "1m%d %s\n", 42, "items");
+    itest_check$(!iout_rewrite_above(&out, 2, "no"), "Pipe can not be rewritten");
+    itest_check_uint_equal$(out.len, strlen("ok\n42 items\n"), "Nothing should be written yet");
+
+    iout_flush(&out);
+    char buf[64];
+    read_pipe(fds[0], buf, sizeof(buf));
+    itest_check$(!strcmp(buf, "ok\n42 items\n"), "Written `%s`", buf);
+
+    iout_destroy(&out);
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  itest_case$("Large output is written in parts") {
+    int fds[2];
+    itest_check$(!pipe(fds), "Should create a pipe");
+
+    iout_t out;
+    iout_init(&out, fds[1]);
+
+    char* big = calloc(IOUT_FLUSH_SIZE / 2 + 1, 1);
+    memset(big, 'x', IOUT_FLUSH_SIZE / 2);
+    iout_printf(&out, "%s", big);
+    itest_check_uint_equal$(out.len, IOUT_FLUSH_SIZE / 2, "Half of buffer should be kept");
+    iout_printf(&out, "%s%s", big, big);
+    itest_check_uint_equal$(out.len, 0, "Full buffer should be written");
+
+    size_t total = 0;
+    char buf[4096];
+    while (total < 3 * (IOUT_FLUSH_SIZE / 2))
+      total += read_pipe(fds[0], buf, sizeof(buf));
+    itest_check_uint_equal$(total, 3 * (IOUT_FLUSH_SIZE / 2), "Everything should be written");
+
+    free(big);
+    iout_destroy(&out);
+    close(fds[0]);
+    close(fds[1]);
+  }
+}
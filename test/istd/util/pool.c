@@ -0,0 +1,131 @@
+/**
+ * Thread-caching allocator tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/util/pool.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CROSS_BLOCKS 1000
+
+static void* allocate_in_thread(void* arg) {
+  void** blocks = arg;
+  for (size_t i = 0; i < CROSS_BLOCKS; ++i) {
+    blocks[i] = ipool_malloc(16 + i % 200);
+    memset(blocks[i], (int) i, 16);
+  }
+  return NULL;
+}
+
+static void* free_in_thread(void* arg) {
+  void** blocks = arg;
+  for (size_t i = 0; i < CROSS_BLOCKS; ++i)
+    ipool_free(blocks[i]);
+  return NULL;
+}
+
+itest_section$("default, istd", "ISTD Thread-caching allocator") {
+
+  itest_case$("Sizes are rounded to classes") {
+    size_t sizes[] = { 0, 1, 16, 17, 100, 128, 129, 200, 1000, 4097, 32767, 32768, 32769, 100000 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+      char* p = ipool_malloc(sizes[i]);
+      itest_check_ptr_notnull$(p, "Should allocate %zu bytes", sizes[i]);
+      itest_check_uint_equal$((uintptr_t) p % 16, 0, "Block of %zu bytes should be aligned", sizes[i]);
+      size_t usable = ipool_usable_size(p);
+      itest_check_uint_ge$(usable, sizes[i], "Block should fit requested size");
+      itest_check_uint_le$(usable, sizes[i] < 128 ? 128 : sizes[i] + sizes[i] / 4 + 4096,
+                           "Block of %zu bytes should not be much larger", sizes[i]);
+      memset(p, 0xab, usable);
+      ipool_free(p);
+    }
+  }
+
+  itest_case$("Blocks are reused and zeroed by calloc") {
+    char* a = ipool_malloc(48);
+    memset(a, 0xff, 48);
+    ipool_free(a);
+
+    char* b = ipool_calloc(3, 16);
+    itest_check_ptr_equal$(b, a, "Freed block should be reused first");
+    for (size_t i = 0; i < 48; ++i)
+      itest_check_int_equal$(b[i], 0, "Block should be zeroed at %zu", i);
+    ipool_free(b);
+
+    itest_check_ptr_null$(ipool_calloc(SIZE_MAX / 2, 4), "Overflowing size should fail");
+  }
+
+  itest_case$("Reallocation keeps contents") {
+    size_t size = 10;
+    char* p = ipool_malloc(size);
+    for (size_t i = 0; i < size; ++i)
+      p[i] = (char) i;
+
+    // Through small classes, into large blocks, and back
+    size_t steps[] = { 12, 100, 5000, 40000, 300000, 1000000, 64, 5 };
+    for (size_t s = 0; s < sizeof(steps) / sizeof(*steps); ++s) {
+      p = ipool_realloc(p, steps[s]);
+      itest_check_ptr_notnull$(p, "Should reallocate to %zu bytes", steps[s]);
+      size_t kept = size < steps[s] ? size : steps[s];
+      for (size_t i = 0; i < kept; ++i)
+        itest_check_int_equal$(p[i], (char) i, "Byte %zu should be kept after realloc to %zu", i, steps[s]);
+      for (size_t i = kept; i < steps[s]; ++i)
+        p[i] = (char) i;
+      size = steps[s];
+    }
+
+    char* same = ipool_realloc(p, 4);
+    itest_check_ptr_equal$(same, p, "Block of the same class should stay in place");
+    ipool_free(same);
+  }
+
+  itest_case$("Statistics follow allocations") {
+    ipool_stats_t before = ipool_stats();
+
+    void* blocks[500];
+    for (size_t i = 0; i < 500; ++i)
+      blocks[i] = ipool_malloc(64);
+    void* large = ipool_malloc(1 << 20);
+
+    ipool_stats_t during = ipool_stats();
+    itest_check_uint_ge$(during.used_bytes - before.used_bytes, 500 * 64 + (1 << 20), "Blocks should be used");
+    itest_check_uint_equal$(during.large_blocks - before.large_blocks, 1, "Large block should be counted");
+    itest_check_uint_ge$(during.mapped_bytes, during.used_bytes, "Used memory should be mapped");
+    itest_check_uint_gt$(during.cache_hits - before.cache_hits, 400, "Most allocations should hit the cache");
+    itest_check$(during.hit_rate > 0 && during.hit_rate <= 1, "Hit rate is %g", during.hit_rate);
+    itest_check$(during.fragmentation >= 0 && during.fragmentation < 1, "Fragmentation is %g", during.fragmentation);
+
+    for (size_t i = 0; i < 500; ++i)
+      ipool_free(blocks[i]);
+    ipool_free(large);
+
+    ipool_stats_t after = ipool_stats();
+    itest_check_uint_equal$(after.used_bytes, before.used_bytes, "Nothing should be used after free");
+    itest_check_uint_equal$(after.large_blocks, before.large_blocks, "Large block should be unmapped");
+    itest_check_uint_gt$(after.batches, during.batches, "Freed blocks should go back in batches");
+  }
+
+  itest_case$("Blocks are freed by other threads") {
+    static void* blocks[CROSS_BLOCKS];
+    ipool_stats_t before = ipool_stats();
+
+    for (int round = 0; round < 3; ++round) {
+      pthread_t t;
+      pthread_create(&t, NULL, allocate_in_thread, blocks);
+      pthread_join(t, NULL);
+
+      for (size_t i = 0; i < CROSS_BLOCKS; ++i)
+        itest_check_int_equal$(*(unsigned char*) blocks[i], i & 0xff, "Block %zu should be intact", i);
+
+      pthread_create(&t, NULL, free_in_thread, blocks);
+      pthread_join(t, NULL);
+    }
+
+    ipool_stats_t after = ipool_stats();
+    itest_check_uint_equal$(after.used_bytes, before.used_bytes, "Exited threads should be accounted for");
+    // Blocks cached by exited threads are reused
+    itest_check_uint_le$(after.spans - before.spans, 8, "Spans should be reused between rounds");
+  }
+}
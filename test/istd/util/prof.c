@@ -0,0 +1,137 @@
+/**
+ * Profiling tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/util/prof.h"
+#include "istd/ds/arr.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/// Find summary of given name and kind
+static const iprof_stat_t* stat_of(ia_arr$(iprof_stat_t) stats, iprof_kind_t kind, const char* name) {
+  for (size_t i = 0; i < ia_length(stats); ++i)
+    if (stats[i].kind == kind && !strcmp(stats[i].name, name))
+      return &stats[i];
+  return NULL;
+}
+
+static void* zones_in_thread(void* arg) {
+  (void) arg;
+  for (size_t i = 0; i < 1000; ++i) {
+    iprof_zone$("test thread zone") {
+      iprof_counter_add$("test thread counter", 2);
+    }
+  }
+  return NULL;
+}
+
+itest_section$("default, istd", "ISTD Profiling") {
+
+  itest_case$("Nothing is recorded when stopped") {
+    iprof_reset();
+    iprof_zone$("test stopped") {
+      iprof_counter_add$("test stopped counter", 1);
+    }
+
+    ia_arr$(iprof_stat_t) stats = iprof_collect();
+    itest_check_ptr_null$(stat_of(stats, IPROF_ZONE, "test stopped"), "Zone should not be recorded");
+    itest_check_ptr_null$(stat_of(stats, IPROF_COUNTER, "test stopped counter"), "Counter should not be recorded");
+    ia_destroy_array(stats);
+  }
+
+  itest_case$("Zones, counters and gauges") {
+    iprof_reset();
+    iprof_start();
+
+    for (size_t i = 0; i < 10; ++i) {
+      iprof_zone$("test outer") {
+        iprof_zone$("test inner") {
+          iprof_counter_add$("test counter", i);
+        }
+      }
+    }
+    iprof_gauge_set$("test gauge", 5);
+    iprof_gauge_set$("test gauge", -3);
+    iprof_gauge_set$("test gauge", 7);
+
+    // Growing an array is instrumented too
+    ia_arr$(int) arr = ia_new_empty_array$(int);
+    for (int i = 0; i < 100; ++i)
+      ia_push$(&arr, i);
+    ia_destroy_array(arr);
+
+    iprof_stop();
+
+    ia_arr$(iprof_stat_t) stats = iprof_collect();
+    const iprof_stat_t* outer = stat_of(stats, IPROF_ZONE, "test outer");
+    const iprof_stat_t* inner = stat_of(stats, IPROF_ZONE, "test inner");
+    const iprof_stat_t* counter = stat_of(stats, IPROF_COUNTER, "test counter");
+    const iprof_stat_t* gauge = stat_of(stats, IPROF_GAUGE, "test gauge");
+    const iprof_stat_t* grow = stat_of(stats, IPROF_ZONE, "ia grow");
+
+    itest_check$(outer && inner && counter && gauge && grow, "All events should be recorded");
+    itest_die_if_something_failed$();
+
+    itest_check_uint_equal$(outer->count, 10, "Every zone should be recorded");
+    itest_check_uint_equal$(inner->count, 10, "Every nested zone should be recorded");
+    itest_check$(outer->total_ns >= inner->total_ns, "Outer zones should take longer");
+    itest_check$(inner->min_ns <= inner->max_ns, "Shortest zone should be shorter than longest");
+    itest_check_int_equal$(counter->value, 45, "Counter should sum its additions");
+    itest_check_int_equal$(gauge->value, 7, "Gauge should keep last value");
+    itest_check_int_equal$(gauge->min, -3, "Gauge should keep smallest value");
+    itest_check_int_equal$(gauge->max, 7, "Gauge should keep largest value");
+    itest_check_uint_gt$(grow->count, 0, "Array growth should be recorded");
+    itest_check_uint_equal$(iprof_dropped(), 0, "Nothing should be dropped");
+    ia_destroy_array(stats);
+  }
+
+  itest_case$("Threads record into their own buffers") {
+    iprof_reset();
+    iprof_start();
+
+    pthread_t threads[4];
+    for (size_t i = 0; i < 4; ++i)
+      pthread_create(&threads[i], NULL, zones_in_thread, NULL);
+    for (size_t i = 0; i < 4; ++i)
+      pthread_join(threads[i], NULL);
+
+    iprof_stop();
+
+    ia_arr$(iprof_stat_t) stats = iprof_collect();
+    const iprof_stat_t* zone = stat_of(stats, IPROF_ZONE, "test thread zone");
+    const iprof_stat_t* counter = stat_of(stats, IPROF_COUNTER, "test thread counter");
+
+    itest_check$(zone && counter, "Events of all threads should be recorded");
+    itest_die_if_something_failed$();
+    itest_check_uint_equal$(zone->count, 4000, "Zones of all threads should be collected");
+    itest_check_int_equal$(counter->value, 8000, "Counters of all threads should be summed");
+    ia_destroy_array(stats);
+  }
+
+  itest_case$("Trace and summary are written") {
+    char path[] = "/tmp/istd_prof_XXXXXX";
+    int fd = mkstemp(path);
+    itest_check_int_ge$(fd, 0, "Temporary file should be created");
+    itest_die_if_something_failed$();
+    close(fd);
+
+    itest_check$(iprof_write_trace(path), "Trace should be written");
+
+    FILE* f = fopen(path, "r");
+    char head[64] = { 0 };
+    itest_check$(f && fread(head, 1, sizeof(head) - 1, f) > 0, "Trace should be readable");
+    itest_check$(strstr(head, "traceEvents") != NULL, "Trace should have events array");
+    if (f)
+      fclose(f);
+    remove(path);
+
+    f = tmpfile();
+    iprof_print_summary(f);
+    itest_check_int_gt$(ftell(f), 0, "Summary should be printed");
+    fclose(f);
+    iprof_reset();
+  }
+}
@@ -0,0 +1,63 @@
+/**
+ * Display width and grapheme cluster tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/util/unicode.h"
+#include <stddef.h>
+
+/// Count clusters in given string
+static size_t count_clusters(const char* str) {
+  size_t n = 0;
+  while (*str) {
+    str = utf8_next_grapheme(str, NULL);
+    if (str == NULL)
+      return UTF8_INVALID;
+    ++n;
+  }
+  return n;
+}
+
+itest_section$("default, istd, unicode", "ISTD Unicode width and graphemes") {
+
+  itest_case$("Codepoint widths") {
+    itest_check_int_equal$(unicode_width('a'), 1, "ASCII letters are narrow");
+    itest_check_int_equal$(unicode_width(0x0416), 1, "Cyrillic is narrow");
+    itest_check_int_equal$(unicode_width(0x4E2D), 2, "CJK ideographs are wide");
+    itest_check_int_equal$(unicode_width(0xFF21), 2, "Fullwidth forms are wide");
+    itest_check_int_equal$(unicode_width(0x1F600), 2, "Emoji are wide");
+    itest_check_int_equal$(unicode_width(0x0301), 0, "Combining marks take no space");
+    itest_check_int_equal$(unicode_width(0x200B), 0, "Zero width space takes no space");
+    itest_check_int_equal$(unicode_width('\n'), UNICODE_NONPRINTABLE, "Newline is nonprintable");
+    itest_check_int_equal$(unicode_width(0x110000), 0, "Out of range runes have no properties");
+  }
+
+  itest_case$("Cluster boundaries") {
+    itest_check_uint_equal$(count_clusters("hello"), 5, "ASCII letters are separate clusters");
+    itest_check_uint_equal$(count_clusters("e\xcc\x81"), 1, "Combining accent joins the base");
+    itest_check_uint_equal$(count_clusters("\r\n"), 1, "CR LF is one cluster");
+    itest_check_uint_equal$(count_clusters("\n\r"), 2, "LF CR is two clusters");
+    itest_check_uint_equal$(count_clusters("\xe1\x84\x80\xe1\x85\xa1\xe1\x86\xa8"), 1,
+                            "Hangul L V T jamo form one syllable");
+    itest_check_uint_equal$(count_clusters("\xf0\x9f\x87\xba\xf0\x9f\x87\xa6\xf0\x9f\x87\xba"), 2,
+                            "Regional indicators are paired");
+    // man + ZWJ + woman + ZWJ + girl
+    itest_check_uint_equal$(count_clusters("\xf0\x9f\x91\xa8\xe2\x80\x8d\xf0\x9f\x91\xa9\xe2\x80\x8d\xf0\x9f\x91\xa7"), 1,
+                            "ZWJ emoji sequence is one cluster");
+    itest_check_uint_equal$(count_clusters("a\xe2\x80\x8d\xf0\x9f\x91\xa8"), 2,
+                            "ZWJ joins emoji only after an emoji");
+    itest_check_uint_equal$(count_clusters("a\xc3"), UTF8_INVALID, "Invalid UTF8 is reported");
+  }
+
+  itest_case$("Display width of strings") {
+    itest_check_uint_equal$(utf8_display_width(""), 0, "Empty string takes no space");
+    itest_check_uint_equal$(utf8_display_width("hello"), 5, "ASCII width is its length");
+    itest_check_uint_equal$(utf8_display_width("caf\x65\xcc\x81!"), 5, "Accents take no space");
+    itest_check_uint_equal$(utf8_display_width("\xe4\xb8\xad\xe6\x96\x87"), 4, "CJK takes two columns");
+    itest_check_uint_equal$(utf8_display_width("\xe2\x9d\xa4\xef\xb8\x8f"), 2,
+                            "Emoji presentation selector makes glyph wide");
+    itest_check_uint_equal$(utf8_display_width("\xf0\x9f\x87\xba\xf0\x9f\x87\xa6"), 2, "Flags are wide");
+    itest_check_uint_equal$(utf8_display_width("a\tb\n"), 2, "Control characters take no space");
+    itest_check_uint_equal$(utf8_display_width("ab\xc3"), UTF8_INVALID, "Invalid UTF8 is reported");
+  }
+}
@@ -0,0 +1,111 @@
+/**
+ * Normalization and case folding tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/util/unicode_norm.h"
+#include <errno.h>
+#include <string.h>
+
+#define E_ACUTE      "\xc3\xa9"      // U+00E9
+#define E_DECOMPOSED "e\xcc\x81"     // e + U+0301
+#define ANGSTROM     "\xe2\x84\xab"  // U+212B, a singleton
+#define A_RING       "\xc3\x85"      // U+00C5
+#define DOT_BELOW    "\xcc\xa3"      // U+0323, ccc 220
+#define DOT_ABOVE    "\xcc\x87"      // U+0307, ccc 230
+#define HANGUL_GAG   "\xea\xb0\x81"  // U+AC01
+#define JAMO_GAG     "\xe1\x84\x80\xe1\x85\xa1\xe1\x86\xa8"
+
+itest_section$("default, istd, unicode", "ISTD Unicode normalization") {
+
+  itest_case$("Quick check") {
+    itest_check_int_equal$(utf8_quick_check("plain ascii", UNICODE_NFC), UNICODE_QC_YES, "ASCII is in NFC");
+    itest_check_int_equal$(utf8_quick_check("plain ascii", UNICODE_NFD), UNICODE_QC_YES, "ASCII is in NFD");
+    itest_check_int_equal$(utf8_quick_check(E_ACUTE, UNICODE_NFC), UNICODE_QC_YES, "Precomposed is in NFC");
+    itest_check_int_equal$(utf8_quick_check(E_ACUTE, UNICODE_NFD), UNICODE_QC_NO, "Precomposed is not in NFD");
+    itest_check_int_equal$(utf8_quick_check(E_DECOMPOSED, UNICODE_NFC), UNICODE_QC_MAYBE, "Accent may combine");
+    itest_check_int_equal$(utf8_quick_check(ANGSTROM, UNICODE_NFC), UNICODE_QC_NO, "Singletons are never in NFC");
+    itest_check_int_equal$(utf8_quick_check("a" DOT_ABOVE DOT_BELOW, UNICODE_NFD), UNICODE_QC_NO,
+                           "Misordered marks are not normalized");
+    itest_check_int_equal$(utf8_quick_check("a\xc3", UNICODE_NFC), UNICODE_QC_INVALID, "Invalid UTF8 is reported");
+  }
+
+  itest_case$("Already normalized strings are not copied") {
+    ia_arr$(char) out = NULL;
+    const char* str = "caf" E_ACUTE;
+
+    itest_check_ptr_equal$(utf8_normalize(str, UNICODE_NFC, &out), str, "NFC string is returned as is");
+    itest_check_ptr_equal$(utf8_normalize("xy", UNICODE_NFD, &out), "xy", "NFD string is returned as is");
+    itest_check_ptr_null$(out, "Nothing should be appended");
+
+    const char* maybe = "x" DOT_BELOW;
+    itest_check_ptr_equal$(utf8_normalize(maybe, UNICODE_NFC, &out), maybe,
+                           "Maybe-normalized string which is normalized is returned as is");
+    itest_check_uint_equal$(ia_length(out), 0, "Nothing should be left in the output");
+    ia_destroy_array(out);
+  }
+
+  itest_case$("NFD") {
+    ia_arr$(char) out = NULL;
+
+    const char* r = utf8_normalize("caf" E_ACUTE, UNICODE_NFD, &out);
+    itest_check$(r && !strcmp(r, "caf" E_DECOMPOSED), "Precomposed letter is decomposed");
+
+    r = utf8_normalize(HANGUL_GAG, UNICODE_NFD, &out);
+    itest_check$(r && !strcmp(r, JAMO_GAG), "Hangul syllable is decomposed into jamo");
+
+    r = utf8_normalize("a" DOT_ABOVE DOT_BELOW, UNICODE_NFD, &out);
+    itest_check$(r && !strcmp(r, "a" DOT_BELOW DOT_ABOVE), "Marks are reordered by combining class");
+
+    itest_check_ptr_null$(utf8_normalize("\xe2\x84", UNICODE_NFD, &out), "Invalid UTF8 is reported");
+    // Quick check stops before invalid bytes after a letter to decompose
+    size_t length = ia_length(out);
+    errno = 0;
+    itest_check_ptr_null$(utf8_normalize(E_ACUTE "\xc3", UNICODE_NFD, &out),
+                          "Invalid UTF8 after decomposed letter is reported");
+    itest_check_int_equal$(errno, EILSEQ, "Invalid UTF8 should set errno");
+    itest_check_ptr_null$(utf8_normalize(ANGSTROM "\xe2\x84", UNICODE_NFC, &out),
+                          "Invalid UTF8 after singleton is reported");
+    itest_check_uint_equal$(ia_length(out), length, "Nothing should be added to the output");
+    ia_destroy_array(out);
+  }
+
+  itest_case$("NFC") {
+    ia_arr$(char) out = NULL;
+
+    const char* r = utf8_normalize("caf" E_DECOMPOSED, UNICODE_NFC, &out);
+    itest_check$(r && !strcmp(r, "caf" E_ACUTE), "Accent is combined with the letter");
+
+    r = utf8_normalize(ANGSTROM, UNICODE_NFC, &out);
+    itest_check$(r && !strcmp(r, A_RING), "Singleton is replaced");
+
+    r = utf8_normalize(JAMO_GAG, UNICODE_NFC, &out);
+    itest_check$(r && !strcmp(r, HANGUL_GAG), "Jamo are combined into a syllable");
+
+    // q + dot below + dot above: `q` has no composites, stays as is;
+    // s + dot above + dot below -> U+1E69 (s with dot below and dot above)
+    r = utf8_normalize("s" DOT_ABOVE DOT_BELOW, UNICODE_NFC, &out);
+    itest_check$(r && !strcmp(r, "\xe1\xb9\xa9"), "Marks are reordered and combined");
+    ia_destroy_array(out);
+  }
+
+  itest_case$("Case folding") {
+    ia_arr$(char) out = NULL;
+    const char* lower = "already folded " E_ACUTE;
+
+    itest_check_ptr_equal$(utf8_casefold(lower, &out), lower, "Folded string is returned as is");
+    itest_check_ptr_null$(out, "Nothing should be appended");
+
+    const char* r = utf8_casefold("Hello", &out);
+    itest_check$(r && !strcmp(r, "hello"), "ASCII is folded");
+
+    r = utf8_casefold("STRA\xc3\x9f" "E", &out);
+    itest_check$(r && !strcmp(r, "strasse"), "Sharp s is fully folded");
+
+    r = utf8_casefold("\xd0\x9f\xd0\xa0\xd0\x98", &out);
+    itest_check$(r && !strcmp(r, "\xd0\xbf\xd1\x80\xd0\xb8"), "Cyrillic is folded");
+
+    itest_check_ptr_null$(utf8_casefold("A\xc3", &out), "Invalid UTF8 is reported");
+    ia_destroy_array(out);
+  }
+}
@@ -0,0 +1,105 @@
+/**
+ * Codepoint index tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/util/utf8.h"
+#include "istd/util/utf8_index.h"
+#include "istd/ds/arr.h"
+#include <string.h>
+
+/// Build string of `n` codepoints of all lengths
+static ia_arr$(char) mixed_string(size_t n) {
+  static const char* parts[] = { "a", "\xd0\xb1", "\xe4\xb8\xad", "\xf0\x9f\x98\x80" };
+  ia_arr$(char) str = NULL;
+  for (size_t i = 0; i < n; ++i) {
+    const char* p = parts[(i * 7 + i / 3) % 4];
+    ia_append$(&str, p, strlen(p));
+  }
+  return str;
+}
+
+/// Check index against walking the string with `utf8_next()`
+static void check_index(const utf8_index_t* idx, const char* str) {
+
+  size_t cp = 0;
+  const char* p = str;
+
+  while (*p) {
+    size_t byte = (size_t) (p - str);
+    const char* next = utf8_next(p, NULL);
+
+    if (utf8_index_byte_of(idx, str, cp) != byte) {
+      itest_fail$("Codepoint %zu should be at byte %zu, got %zu", cp, byte, utf8_index_byte_of(idx, str, cp));
+      return;
+    }
+    for (const char* b = p; b < next; ++b) {
+      if (utf8_index_codepoint_of(idx, str, (size_t) (b - str)) != cp) {
+        itest_fail$("Byte %zu should belong to codepoint %zu", (size_t) (b - str), cp);
+        return;
+      }
+    }
+
+    p = next;
+    ++cp;
+  }
+
+  itest_check_uint_equal$(idx->num_codepoints, cp, "Index should count all codepoints");
+  itest_check_uint_equal$(utf8_index_byte_of(idx, str, cp), strlen(str), "Codepoint past the end is the length");
+  itest_check_uint_equal$(utf8_index_codepoint_of(idx, str, strlen(str)), cp, "Byte past the end is the count");
+}
+
+itest_section$("default, istd, unicode", "ISTD UTF8 codepoint index") {
+
+  itest_case$("Empty string") {
+    utf8_index_t idx;
+    utf8_index_init(&idx, "", 0, 0);
+    itest_check_uint_equal$(idx.num_codepoints, 0, "Empty string has no codepoints");
+    itest_check_uint_equal$(utf8_index_byte_of(&idx, "", 0), 0, "End of empty string is at zero");
+    utf8_index_destroy(&idx);
+  }
+
+  itest_case$("Translation in both directions") {
+    ia_arr$(char) str = mixed_string(5000);
+    utf8_index_t idx;
+
+    utf8_index_init(&idx, str, ia_length(str), 64);
+    check_index(&idx, str);
+    utf8_index_destroy(&idx);
+
+    utf8_index_init(&idx, str, ia_length(str), 1024);
+    check_index(&idx, str);
+    utf8_index_destroy(&idx);
+
+    ia_destroy_array(str);
+  }
+
+  itest_case$("Incremental updates") {
+    ia_arr$(char) str = mixed_string(3000);
+    utf8_index_t idx;
+    utf8_index_init(&idx, str, ia_length(str), 64);
+
+    // Append at the end
+    ia_append$(&str, "\xe4\xb8\xad\xe4\xb8\xad", 6);
+    utf8_index_update(&idx, str, ia_length(str), ia_length(str) - 6);
+    check_index(&idx, str);
+
+    // Cut the middle, replacing multibyte chars with ASCII
+    size_t pos = utf8_index_byte_of(&idx, str, 1000);
+    memset(str + pos, 'x', 40);
+    size_t tail = utf8_index_byte_of(&idx, str, 1500);
+    memmove(str + pos + 40, str + tail, ia_length(str) - tail);
+    ia_truncate$(&str, ia_length(str) - (tail - pos - 40));
+    utf8_index_update(&idx, str, ia_length(str), pos);
+    check_index(&idx, str);
+
+    // Truncate at the checkpoint
+    size_t end = utf8_index_byte_of(&idx, str, 128);
+    ia_truncate$(&str, end);
+    utf8_index_update(&idx, str, ia_length(str), end);
+    check_index(&idx, str);
+
+    utf8_index_destroy(&idx);
+    ia_destroy_array(str);
+  }
+}
@@ -0,0 +1,124 @@
+/**
+ * Substring and byte set search tests
+ */
+
+#include "istd/util/test.h"
+#include "istd/util/utf8_search.h"
+#include "istd/ds/arr.h"
+#include <stdlib.h>
+#include <string.h>
+
+/// Naive search, to compare with
+static const char* naive_find(const char* hay, size_t hay_len, const char* needle, size_t needle_len) {
+  for (size_t i = 0; i + needle_len <= hay_len; ++i) {
+    bool cont_begin = ((uint8_t) hay[i] >> 6) == 2;
+    bool cont_end = i + needle_len < hay_len && ((uint8_t) hay[i + needle_len] >> 6) == 2;
+    if (!cont_begin && !cont_end && !memcmp(hay + i, needle, needle_len))
+      return hay + i;
+  }
+  return NULL;
+}
+
+#define STR_AND_LEN(s) (s), (sizeof(s) - 1)
+
+itest_section$("default, istd, unicode, simd", "ISTD UTF8 search") {
+
+  itest_case$("Simple substrings") {
+    const char* hay = "the quick brown fox jumps over the lazy dog";
+    size_t len = strlen(hay);
+
+    itest_check_ptr_equal$(utf8_find(hay, len, STR_AND_LEN("fox")), hay + 16, "Word should be found");
+    itest_check_ptr_equal$(utf8_find(hay, len, STR_AND_LEN("the")), hay, "First occurence should be found");
+    itest_check_ptr_equal$(utf8_find(hay, len, STR_AND_LEN("dog")), hay + 40, "Match at the end should be found");
+    itest_check_ptr_null$(utf8_find(hay, len, STR_AND_LEN("cat")), "Missing word should not be found");
+    itest_check_ptr_null$(utf8_find(hay, len - 1, STR_AND_LEN("dog")), "Search should not go past given length");
+    itest_check_ptr_equal$(utf8_find(hay, len, "", 0), hay, "Empty needle is found at the beginning");
+    itest_check_ptr_equal$(utf8_find(hay, len, STR_AND_LEN("q")), hay + 4, "Single byte needle should be found");
+  }
+
+  itest_case$("No matches inside of codepoints") {
+    // U+0431 (d0 b1), U+0432 (d0 b2)
+    const char* hay = "\xd0\xb1\xd0\xb2";
+
+    itest_check_ptr_null$(utf8_find(hay, 4, STR_AND_LEN("\xb1")), "Continuation byte should not match");
+    itest_check_ptr_null$(utf8_find(hay, 4, STR_AND_LEN("\xb1\xd0")), "Match should not begin mid-codepoint");
+    itest_check_ptr_null$(utf8_find(hay, 4, STR_AND_LEN("\xd0")), "Match should not end mid-codepoint");
+    itest_check_ptr_equal$(utf8_find(hay, 4, STR_AND_LEN("\xd0\xb2")), hay + 2, "Whole codepoint should match");
+  }
+
+  itest_case$("Long and periodic inputs") {
+    ia_arr$(char) hay = NULL;
+    for (size_t i = 0; i < 5000; ++i)
+      ia_push$(&hay, 'a');
+    ia_append$(&hay, "aab", 3);
+
+    itest_check_ptr_equal$(utf8_find(hay, ia_length(hay), STR_AND_LEN("aaaaaaaaab")), hay + 4993,
+                           "Periodic needle should be found at the end");
+    itest_check_ptr_null$(utf8_find(hay, ia_length(hay), STR_AND_LEN("aaaaaaaaac")),
+                          "Periodic needle should not be found");
+    ia_destroy_array(hay);
+  }
+
+  itest_case$("Random texts compared with naive search") {
+    static const char* alphabet[] = { "a", "b", "\xd0\xb1", "\xe4\xb8\xad" };
+    srand(42);
+
+    for (size_t round = 0; round < 400; ++round) {
+      ia_arr$(char) hay = NULL;
+      size_t n = (size_t) rand() % 300 + 1;
+      // Every other round uses only two letters, to get lots of false candidates
+      int letters = round % 2 ? 2 : 4;
+      for (size_t i = 0; i < n; ++i) {
+        const char* s = alphabet[rand() % letters];
+        ia_append$(&hay, s, strlen(s));
+      }
+
+      size_t len = ia_length(hay);
+      size_t from = len ? (size_t) rand() % len : 0;
+      size_t needle_len = (size_t) rand() % 24 + 1;
+      if (from + needle_len > len)
+        needle_len = len - from;
+
+      const char* needle = hay + from;
+      const char* expected = naive_find(hay, len, needle, needle_len);
+      const char* got = utf8_find(hay, len, needle, needle_len);
+      if (got != expected) {
+        itest_fail$("Round %zu: expected match at %td, got %td", round,
+                    expected ? expected - hay : -1, got ? got - hay : -1);
+        break;
+      }
+      ia_destroy_array(hay);
+    }
+  }
+
+  itest_case$("Byte sets") {
+    utf8_byteset_t set;
+    utf8_byteset_init(&set, STR_AND_LEN(" \t,;\xff"));
+
+    itest_check$(utf8_byteset_has(&set, ','), "Comma should be in the set");
+    itest_check$(utf8_byteset_has(&set, 0xff), "High bytes should be in the set");
+    itest_check$(!utf8_byteset_has(&set, 'a'), "Letters should not be in the set");
+    itest_check$(!utf8_byteset_has(&set, 0x7f), "Other bytes should not be in the set");
+
+    const char* text = "long_identifier_without_delimiters_inside;tail";
+    size_t len = strlen(text);
+    itest_check_ptr_equal$(utf8_find_any_of_set(text, len, &set), text + 41, "Delimiter should be found");
+    itest_check_ptr_null$(utf8_find_any_of_set(text, 41, &set), "Search should not go past given length");
+    const char* high = "x\xff";
+    itest_check_ptr_equal$(utf8_find_any_of_set(high, 2, &set), high + 1, "High byte should be found");
+
+    for (size_t i = 0; i < 256; ++i) {
+      char all[256];
+      for (size_t j = 0; j < 256; ++j)
+        all[j] = (char) (i == j ? 0 : i);
+      utf8_byteset_t one;
+      char zero = 0;
+      utf8_byteset_init(&one, &zero, 1);
+      const char* found = utf8_find_any_of_set(all, 256, &one);
+      if (found != all + i) {
+        itest_fail$("Zero byte should be found at %zu", i);
+        break;
+      }
+    }
+  }
+}
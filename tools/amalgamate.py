@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""
+Generator of the single-header distribution of istd.
+
+Run by meson at build time:
+
+    amalgamate.py <output.h> <include dir> <source or generated header>...
+
+All public headers are put first, each one once, with includes of other
+istd headers replaced by their text. Then, under `ISTD_IMPLEMENTATION`,
+all sources are put in the order given, with generated headers (Unicode
+tables) put where they are included. Use it like stb libraries:
+
+    // In exactly one file
+    #define ISTD_IMPLEMENTATION
+    #include "istd.h"
+
+    // Everywhere else
+    #include "istd.h"
+
+Hot accessors (`ia_length()`, `utf8_next()`, ...) are `static inline` in
+the headers, so they are inlined into the user's code either way.
+
+Sources are one translation unit here, so macros defined by a source are
+undefined after it, and the generator fails if two sources have static
+functions or variables with the same name.
+"""
+
+import os
+import re
+import sys
+
+INCLUDE = re.compile(r'^\s*#\s*include\s+"([^"]+)"')
+DEFINE = re.compile(r'^\s*#\s*define\s+([A-Za-z_][A-Za-z0-9_$]*)')
+STATIC = re.compile(r'^static\s+(?:inline\s+)?[^=(;]*?[\s*]([A-Za-z_][A-Za-z0-9_]*)\s*[(=;\[]')
+
+# Feature macros, which must come before any system header
+FEATURES = ['_GNU_SOURCE']
+
+
+class Amalgamation:
+
+    def __init__(self, include_dir, generated):
+        self.include_dir = include_dir
+        # Generated headers, by name they are included with
+        self.generated = {os.path.basename(g): g for g in generated}
+        self.seen = set()
+        self.lines = []
+
+    def resolve(self, name, current):
+        for path in (os.path.join(self.include_dir, name),
+                     os.path.join(os.path.dirname(current), name),
+                     self.generated.get(name, '')):
+            if path and os.path.exists(path):
+                return os.path.normpath(path)
+        sys.exit(f'{current}: cannot find included "{name}"')
+
+    def put_file(self, path, is_source=False):
+        """Put text of the file, with istd includes expanded"""
+
+        path = os.path.normpath(path)
+        if path in self.seen:
+            return
+        self.seen.add(path)
+
+        defined = []
+        self.lines.append(f'//---- {os.path.relpath(path, os.path.dirname(self.include_dir))}\n')
+        with open(path) as f:
+            for line in f:
+                m = INCLUDE.match(line)
+                if m:
+                    self.put_file(self.resolve(m.group(1), path))
+                    continue
+                m = DEFINE.match(line)
+                if m and m.group(1) in FEATURES:
+                    continue
+                if m and is_source:
+                    defined.append(m.group(1))
+                self.lines.append(line)
+
+        if not self.lines[-1].endswith('\n'):
+            self.lines.append('\n')
+        for name in dict.fromkeys(defined):
+            self.lines.append(f'#undef {name}\n')
+        self.lines.append('\n')
+
+
+def check_statics(sources):
+    owners = {}
+    for src in sources:
+        with open(src) as f:
+            for name in {m.group(1) for m in map(STATIC.match, f) if m}:
+                owners.setdefault(name, []).append(src)
+    clashes = {k: v for k, v in owners.items() if len(v) > 1}
+    if clashes:
+        sys.exit('Static names defined in several sources:\n' + '\n'.join(
+            f'  {k}: {", ".join(v)}' for k, v in sorted(clashes.items())))
+
+
+def main():
+    if len(sys.argv) < 4:
+        sys.exit(f'usage: {sys.argv[0]} <output.h> <include dir> <source or generated header>...')
+
+    output, include_dir, inputs = sys.argv[1], sys.argv[2], sys.argv[3:]
+    sources = [i for i in inputs if i.endswith('.c')]
+    generated = [i for i in inputs if i.endswith('.h')]
+    check_statics(sources)
+
+    a = Amalgamation(include_dir, generated)
+
+    headers = []
+    for root, _, files in os.walk(include_dir):
+        headers += [os.path.join(root, f) for f in files if f.endswith('.h')]
+    for h in sorted(headers):
+        a.put_file(h)
+    interface = a.lines
+
+    a.lines = []
+    for src in sources:
+        a.put_file(src, is_source=True)
+    implementation = a.lines
+
+    with open(output, 'w') as f:
+        f.write('/**\n'
+                ' * \\file\n'
+                ' * \\brief istd as a single header, generated by tools/amalgamate.py.\n'
+                ' *\n'
+                ' * Define `ISTD_IMPLEMENTATION` in one file before including it,\n'
+                ' * and before any system header.\n'
+                ' */\n\n')
+        f.write('#ifdef ISTD_IMPLEMENTATION\n')
+        for feature in FEATURES:
+            f.write(f'#ifndef {feature}\n#define {feature}\n#endif\n')
+        f.write('#endif\n\n')
+        f.write('#ifndef ISTD_SINGLE_HEADER\n#define ISTD_SINGLE_HEADER\n\n')
+        f.writelines(interface)
+        f.write('#endif\n\n')
+        f.write('#if defined(ISTD_IMPLEMENTATION) && !defined(ISTD_IMPLEMENTED)\n#define ISTD_IMPLEMENTED\n\n')
+        f.writelines(implementation)
+        f.write('#endif\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,372 @@
+#!/usr/bin/env python3
+"""
+Generator of Unicode property tables for istd.
+
+Run by meson at build time:
+
+    gen_unicode_tables.py props <output.h>
+    gen_unicode_tables.py norm <output.h>
+
+Everything is derived from Python's own `unicodedata` module, so tables
+follow the Unicode version of the Python used for the build. The few
+properties which `unicodedata` does not expose (grapheme break classes
+like Prepend, Extended_Pictographic) are listed by hand below, taken
+from UAX #29 and emoji-data.txt.
+
+Tables are stored as three-stage tries:
+
+    value = leaf[(mid[(top[cp >> (A+B)] << B) | ((cp >> A) & mask_B)] << A)
+                 | (cp & mask_A)]
+
+Identical blocks are shared at each level, and `A`/`B` are picked to
+make the whole thing as small as possible.
+"""
+
+import sys
+import unicodedata
+
+MAX_RUNE = 0x110000
+
+
+#==== Hand-written property lists
+
+
+# Grapheme_Cluster_Break=Prepend
+PREPEND = [
+    (0x0600, 0x0605), (0x06DD, 0x06DD), (0x070F, 0x070F), (0x0890, 0x0891),
+    (0x08E2, 0x08E2), (0x0D4E, 0x0D4E), (0x110BD, 0x110BD), (0x110CD, 0x110CD),
+    (0x111C2, 0x111C3), (0x1193F, 0x1193F), (0x11941, 0x11941),
+    (0x11A3A, 0x11A3A), (0x11A84, 0x11A89), (0x11D46, 0x11D46),
+]
+
+# Other_Grapheme_Extend, plus emoji modifiers, which are Extend too
+OTHER_EXTEND = [
+    (0x09BE, 0x09BE), (0x09D7, 0x09D7), (0x0B3E, 0x0B3E), (0x0B57, 0x0B57),
+    (0x0BBE, 0x0BBE), (0x0BD7, 0x0BD7), (0x0CC2, 0x0CC2), (0x0CD5, 0x0CD6),
+    (0x0D3E, 0x0D3E), (0x0D57, 0x0D57), (0x0DCF, 0x0DCF), (0x0DDF, 0x0DDF),
+    (0x1B35, 0x1B35), (0x200C, 0x200C), (0x302E, 0x302F), (0xFF9E, 0xFF9F),
+    (0x1133E, 0x1133E), (0x11357, 0x11357), (0x114B0, 0x114B0),
+    (0x114BD, 0x114BD), (0x115AF, 0x115AF), (0x11930, 0x11930),
+    (0x1D165, 0x1D165), (0x1D16E, 0x1D172), (0xE0020, 0xE007F),
+    (0x1F3FB, 0x1F3FF),
+]
+
+# Extended_Pictographic
+EXT_PICT = [
+    (0x00A9, 0x00A9), (0x00AE, 0x00AE), (0x203C, 0x203C), (0x2049, 0x2049),
+    (0x2122, 0x2122), (0x2139, 0x2139), (0x2194, 0x2199), (0x21A9, 0x21AA),
+    (0x231A, 0x231B), (0x2328, 0x2328), (0x2388, 0x2388), (0x23CF, 0x23CF),
+    (0x23E9, 0x23F3), (0x23F8, 0x23FA), (0x24C2, 0x24C2), (0x25AA, 0x25AB),
+    (0x25B6, 0x25B6), (0x25C0, 0x25C0), (0x25FB, 0x25FE), (0x2600, 0x2605),
+    (0x2607, 0x2612), (0x2614, 0x2685), (0x2690, 0x2705), (0x2708, 0x2712),
+    (0x2714, 0x2714), (0x2716, 0x2716), (0x271D, 0x271D), (0x2721, 0x2721),
+    (0x2728, 0x2728), (0x2733, 0x2734), (0x2744, 0x2744), (0x2747, 0x2747),
+    (0x274C, 0x274C), (0x274E, 0x274E), (0x2753, 0x2755), (0x2757, 0x2757),
+    (0x2763, 0x2767), (0x2795, 0x2797), (0x27A1, 0x27A1), (0x27B0, 0x27B0),
+    (0x27BF, 0x27BF), (0x2934, 0x2935), (0x2B05, 0x2B07), (0x2B1B, 0x2B1C),
+    (0x2B50, 0x2B50), (0x2B55, 0x2B55), (0x3030, 0x3030), (0x303D, 0x303D),
+    (0x3297, 0x3297), (0x3299, 0x3299), (0x1F000, 0x1F0FF),
+    (0x1F10D, 0x1F10F), (0x1F12F, 0x1F12F), (0x1F16C, 0x1F171),
+    (0x1F17E, 0x1F17F), (0x1F18E, 0x1F18E), (0x1F191, 0x1F19A),
+    (0x1F1AD, 0x1F1E5), (0x1F201, 0x1F20F), (0x1F21A, 0x1F21A),
+    (0x1F22F, 0x1F22F), (0x1F232, 0x1F23A), (0x1F23C, 0x1F23F),
+    (0x1F249, 0x1F3FA), (0x1F400, 0x1F53D), (0x1F546, 0x1F64F),
+    (0x1F680, 0x1F6FF), (0x1F774, 0x1F77F), (0x1F7D5, 0x1F7FF),
+    (0x1F80C, 0x1F80F), (0x1F848, 0x1F84F), (0x1F85A, 0x1F85F),
+    (0x1F888, 0x1F88F), (0x1F8AE, 0x1F8FF), (0x1F90C, 0x1F93A),
+    (0x1F93C, 0x1F945), (0x1F947, 0x1FAFF), (0x1FC00, 0x1FFFD),
+]
+
+# Hangul jamo, which are not covered by syllable arithmetic
+HANGUL_L = [(0x1100, 0x115F), (0xA960, 0xA97C)]
+HANGUL_V = [(0x1160, 0x11A7), (0xD7B0, 0xD7C6)]
+HANGUL_T = [(0x11A8, 0x11FF), (0xD7CB, 0xD7FB)]
+HANGUL_S_BASE, HANGUL_S_COUNT, HANGUL_T_COUNT = 0xAC00, 11172, 28
+
+
+#==== Property computation
+
+
+# Must be in sync with `enum` in `src/istd/util/unicode.c`
+GCB = {name: i for i, name in enumerate([
+    'Other', 'CR', 'LF', 'Control', 'Extend', 'ZWJ', 'RI', 'Prepend',
+    'SpacingMark', 'L', 'V', 'T', 'LV', 'LVT',
+])}
+
+PROP_EXT_PICT = 1 << 4
+PROP_WIDTH_SHIFT = 5
+WIDTH_NONPRINTABLE = 3
+
+
+def in_ranges(cp, ranges):
+    return any(lo <= cp <= hi for lo, hi in ranges)
+
+
+def fill_ranges(table, ranges, value):
+    for lo, hi in ranges:
+        for cp in range(lo, hi + 1):
+            table[cp] = value
+
+
+def grapheme_break_classes():
+    gcb = [GCB['Other']] * MAX_RUNE
+
+    for cp in range(MAX_RUNE):
+        cat = unicodedata.category(chr(cp))
+        if cat in ('Mn', 'Me'):
+            gcb[cp] = GCB['Extend']
+        elif cat == 'Mc':
+            gcb[cp] = GCB['SpacingMark']
+        elif cat in ('Cc', 'Zl', 'Zp', 'Cs') or \
+                (cat == 'Cf' and cp not in (0x200C, 0x200D)):
+            gcb[cp] = GCB['Control']
+
+    fill_ranges(gcb, OTHER_EXTEND, GCB['Extend'])
+    fill_ranges(gcb, PREPEND, GCB['Prepend'])
+    fill_ranges(gcb, HANGUL_L, GCB['L'])
+    fill_ranges(gcb, HANGUL_V, GCB['V'])
+    fill_ranges(gcb, HANGUL_T, GCB['T'])
+    for i in range(HANGUL_S_COUNT):
+        gcb[HANGUL_S_BASE + i] = \
+            GCB['LV'] if i % HANGUL_T_COUNT == 0 else GCB['LVT']
+
+    gcb[0x0D] = GCB['CR']
+    gcb[0x0A] = GCB['LF']
+    gcb[0x200D] = GCB['ZWJ']
+    fill_ranges(gcb, [(0x1F1E6, 0x1F1FF)], GCB['RI'])
+    return gcb
+
+
+def rune_width(cp):
+    cat = unicodedata.category(chr(cp))
+    if cat == 'Cc':
+        return WIDTH_NONPRINTABLE
+    if cp == 0x00AD: # Soft hyphen is shown by terminals
+        return 1
+    if cat in ('Mn', 'Me', 'Cf', 'Zl', 'Zp') or cp == 0x200B:
+        return 0
+    if in_ranges(cp, HANGUL_V + HANGUL_T):
+        return 0
+    if unicodedata.east_asian_width(chr(cp)) in ('W', 'F'):
+        return 2
+    return 1
+
+
+def props_table():
+    gcb = grapheme_break_classes()
+    ext_pict = [False] * MAX_RUNE
+    for lo, hi in EXT_PICT:
+        for cp in range(lo, hi + 1):
+            ext_pict[cp] = True
+
+    return [
+        gcb[cp]
+        | (PROP_EXT_PICT if ext_pict[cp] else 0)
+        | (rune_width(cp) << PROP_WIDTH_SHIFT)
+        for cp in range(MAX_RUNE)
+    ]
+
+
+#==== Normalization and case folding
+
+
+# Must be in sync with `src/istd/util/unicode_norm.c`
+NORM_NFD_NO = 1 << 8
+NORM_NFC_NO = 1 << 9
+NORM_NFC_MAYBE = 1 << 10
+
+
+def is_hangul_syllable(cp):
+    return HANGUL_S_BASE <= cp < HANGUL_S_BASE + HANGUL_S_COUNT
+
+
+def canonical_pairs():
+    """Primary composites, as (first, second, composite) triples."""
+    pairs = []
+    for cp in range(MAX_RUNE):
+        raw = unicodedata.decomposition(chr(cp))
+        if not raw or raw.startswith('<'):
+            continue
+        parts = [int(p, 16) for p in raw.split()]
+        # Composition exclusions and non-starter decompositions
+        # are exactly those which do not survive NFC.
+        if len(parts) == 2 and unicodedata.normalize('NFC', chr(cp)) == chr(cp):
+            pairs.append((parts[0], parts[1], cp))
+    return pairs
+
+
+class Sequences:
+    """Storage of codepoint sequences, as `[length, cp...]` runs.
+
+    Index `0` is reserved for "no sequence".
+    """
+
+    def __init__(self):
+        self.data = [0]
+        self.known = {}
+
+    def add(self, seq):
+        seq = tuple(seq)
+        if seq not in self.known:
+            self.known[seq] = len(self.data)
+            self.data.append(len(seq))
+            self.data.extend(seq)
+        return self.known[seq]
+
+
+def norm_tables():
+    pairs = canonical_pairs()
+    seconds = {second for _, second, _ in pairs}
+    # Hangul jamo which combine with L or LV
+    seconds.update(range(0x1161, 0x1176))
+    seconds.update(range(0x11A8, 0x11C3))
+
+    norm = [0] * MAX_RUNE
+    decomp_index = [0] * MAX_RUNE
+    decomps = Sequences()
+    for cp in range(MAX_RUNE):
+        c = chr(cp)
+        nfd = unicodedata.normalize('NFD', c)
+        norm[cp] = unicodedata.combining(c)
+        if nfd != c:
+            norm[cp] |= NORM_NFD_NO
+            # Hangul syllables are decomposed arithmetically
+            if not is_hangul_syllable(cp):
+                decomp_index[cp] = decomps.add(ord(x) for x in nfd)
+        if unicodedata.normalize('NFC', c) != c:
+            norm[cp] |= NORM_NFC_NO
+        elif cp in seconds:
+            norm[cp] |= NORM_NFC_MAYBE
+
+    # Compositions are stored as `[n, second, composite, ...]`
+    # lists for each first codepoint.
+    by_first = {}
+    for first, second, composite in pairs:
+        by_first.setdefault(first, []).extend((second, composite))
+    comp_index = [0] * MAX_RUNE
+    comps = [0]
+    for first, lst in sorted(by_first.items()):
+        comp_index[first] = len(comps)
+        comps.append(len(lst) // 2)
+        comps.extend(lst)
+
+    fold_index = [0] * MAX_RUNE
+    folds = Sequences()
+    for cp in range(MAX_RUNE):
+        folded = chr(cp).casefold()
+        if folded != chr(cp):
+            fold_index[cp] = folds.add(ord(x) for x in folded)
+
+    return norm, decomp_index, decomps.data, comp_index, comps, \
+        fold_index, folds.data
+
+
+#==== Trie compression
+
+
+def dedup_blocks(values, size):
+    """Split `values` into blocks of `size`, merge identical ones."""
+    blocks, index, data = {}, [], []
+    for i in range(0, len(values), size):
+        block = tuple(values[i:i + size])
+        if block not in blocks:
+            blocks[block] = len(blocks)
+            data.extend(block)
+        index.append(blocks[block])
+    return index, data
+
+
+def int_type(values):
+    top = max(values) if values else 0
+    return ('uint8_t', 1) if top < 1 << 8 else \
+           ('uint16_t', 2) if top < 1 << 16 else \
+           ('uint32_t', 4)
+
+
+def three_stage(values):
+    best = None
+    for a in range(2, 10):
+        mid_index, leaf = dedup_blocks(values, 1 << a)
+        for b in range(2, 13):
+            if (1 << (a + b)) > len(values):
+                continue
+            top, mid = dedup_blocks(mid_index, 1 << b)
+            size = sum(len(t) * int_type(t)[1] for t in (top, mid, leaf))
+            if best is None or size < best[0]:
+                best = (size, a, b, top, mid, leaf)
+    return best
+
+
+def emit_array(out, name, values):
+    ctype, _ = int_type(values)
+    out.append(f'static const {ctype} {name}[{len(values)}] = {{')
+    for i in range(0, len(values), 16):
+        out.append('  ' + ', '.join(str(v) for v in values[i:i + 16]) + ',')
+    out.append('};\n')
+
+
+def emit_trie(out, prefix, values, ret_type):
+    size, a, b, top, mid, leaf = three_stage(values)
+    upper = prefix.upper()
+    out.append(f'// {prefix}: {size} bytes total')
+    out.append(f'#define {upper}_SHIFT_A {a}')
+    out.append(f'#define {upper}_SHIFT_B {b}\n')
+    emit_array(out, f'{prefix}_top', top)
+    emit_array(out, f'{prefix}_mid', mid)
+    emit_array(out, f'{prefix}_leaf', leaf)
+    out.append(f'static inline {ret_type} {prefix}_lookup(uint32_t cp) {{')
+    out.append(f'  if (cp >= {hex(len(values))}) return 0;')
+    out.append(f'  size_t mid = ((size_t) {prefix}_top[cp >> ({a} + {b})] << {b})'
+               f' | ((cp >> {a}) & {(1 << b) - 1});')
+    out.append(f'  return {prefix}_leaf[((size_t) {prefix}_mid[mid] << {a})'
+               f' | (cp & {(1 << a) - 1})];')
+    out.append('}\n')
+
+
+#==== Main
+
+
+HEADER = f'''\
+// Generated by tools/gen_unicode_tables.py, do not edit.
+// Unicode version: {unicodedata.unidata_version}
+
+#include <stddef.h>
+#include <stdint.h>
+'''
+
+
+def gen_props():
+    out = [HEADER]
+    emit_trie(out, 'unicode_props', props_table(), 'uint8_t')
+    return out
+
+
+def gen_norm():
+    norm, decomp_index, decomps, comp_index, comps, fold_index, folds = \
+        norm_tables()
+    out = [HEADER]
+    emit_trie(out, 'unicode_norm', norm, 'uint16_t')
+    emit_trie(out, 'unicode_decomp', decomp_index, 'uint16_t')
+    emit_array(out, 'unicode_decomp_data', decomps)
+    emit_trie(out, 'unicode_comp', comp_index, 'uint16_t')
+    emit_array(out, 'unicode_comp_data', comps)
+    emit_trie(out, 'unicode_fold', fold_index, 'uint16_t')
+    emit_array(out, 'unicode_fold_data', folds)
+    return out
+
+
+MODES = {
+    'props': gen_props,
+    'norm': gen_norm,
+}
+
+
+def main():
+    if len(sys.argv) != 3 or sys.argv[1] not in MODES:
+        sys.exit(f'usage: {sys.argv[0]} <{"|".join(MODES)}> <output>')
+    with open(sys.argv[2], 'w') as f:
+        f.write('\n'.join(MODES[sys.argv[1]]()))
+
+
+if __name__ == '__main__':
+    main()